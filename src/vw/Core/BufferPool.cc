@@ -0,0 +1,372 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file Core/BufferPool.cc
+///
+/// The aligned, pooled allocator behind ImageView buffers.
+///
+#include <vw/Core/BufferPool.h>
+#include <vw/Core/Thread.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <set>
+#include <vector>
+#include <iomanip>
+
+#include <boost/static_assert.hpp>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#define VW_BUFFER_POOL_HAVE_MMAP 1
+#endif
+
+namespace {
+  using namespace vw;
+
+  // Every block starts with a header, padded out to buffer_alignment
+  // bytes, that records where the block came from.  The buffer
+  // itself follows the header.
+  enum BlockKind { HEAP_BLOCK, MAPPED_BLOCK };
+  struct BlockHeader {
+    void *base;
+    size_t size;
+    int kind;
+  };
+  BOOST_STATIC_ASSERT( sizeof(BlockHeader) <= size_t(buffer_alignment) );
+
+  struct ThreadBufferPool;
+
+  // The thread pools take their share of the total pool limit in
+  // chunks of at least this many bytes, so that most frees and pool
+  // hits only need the thread's own pool.
+  const size_t pool_budget_chunk = 4*1024*1024;
+
+  // The process-wide settings and statistics, and the set of live
+  // thread pools.  Everything here is guarded by the mutex.  Lock
+  // order: this mutex before any thread pool's.
+  struct GlobalState {
+    Mutex mutex;
+    size_t pool_limit, total_pool_limit;
+    bool huge_pages;
+    size_t huge_page_min;
+    uint64 system_bytes, peak_system_bytes;
+    // The sum of the thread pools' budgets.
+    uint64 reserved_bytes;
+    // The statistics of threads that have exited.
+    int64 retired_live_bytes;
+    uint64 retired_allocations, retired_pool_hits;
+    std::set<ThreadBufferPool*> pools;
+
+    GlobalState() : pool_limit(64*1024*1024), total_pool_limit(256*1024*1024),
+                    huge_pages(false), huge_page_min(32*1024*1024),
+                    system_bytes(0), peak_system_bytes(0), reserved_bytes(0), retired_live_bytes(0),
+                    retired_allocations(0), retired_pool_hits(0) {}
+  };
+
+  // Like the thread id mutex in Thread.cc, the global state is never
+  // destroyed, so that buffers can still be freed by the destructors
+  // of static objects.
+  vw::RunOnce global_state_once = VW_RUNONCE_INIT;
+  GlobalState *global_state_ptr = 0;
+  boost::thread_specific_ptr<ThreadBufferPool> *thread_pool_ptr = 0;
+  void init_global_state() {
+    global_state_ptr = new GlobalState();
+    thread_pool_ptr = new boost::thread_specific_ptr<ThreadBufferPool>();
+  }
+  GlobalState& global_state() {
+    global_state_once.run( init_global_state );
+    return *global_state_ptr;
+  }
+
+  // Rounds a block size up to a multiple of the alignment for small
+  // blocks, and to one of four size classes per power of two for the
+  // rest, so that no more than a quarter of a block is wasted.
+  size_t class_size( size_t bytes ) {
+    if( bytes <= 256 )
+      return (bytes + buffer_alignment - 1) & ~size_t(buffer_alignment - 1);
+    size_t top = 256;
+    while( top < bytes ) top <<= 1;
+    size_t step = top / 8;
+    return (bytes + step - 1) / step * step;
+  }
+
+  BlockHeader* system_allocate( size_t size ) {
+    GlobalState& global = global_state();
+    bool huge_pages;
+    {
+      Mutex::Lock lock( global.mutex );
+      huge_pages = global.huge_pages && size >= global.huge_page_min;
+    }
+    BlockHeader *header = 0;
+#if VW_BUFFER_POOL_HAVE_MMAP
+    if( huge_pages ) {
+      void *base = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0 );
+      if( base != MAP_FAILED ) {
+#ifdef MADV_HUGEPAGE
+        madvise( base, size, MADV_HUGEPAGE );
+#endif
+        header = static_cast<BlockHeader*>( base );
+        header->base = base;
+        header->kind = MAPPED_BLOCK;
+      }
+    }
+#endif
+    if( !header ) {
+      void *base = malloc( size + buffer_alignment );
+      if( !base ) throw std::bad_alloc();
+      size_t aligned = (size_t(base) + buffer_alignment - 1) & ~size_t(buffer_alignment - 1);
+      header = reinterpret_cast<BlockHeader*>( aligned );
+      header->base = base;
+      header->kind = HEAP_BLOCK;
+    }
+    header->size = size;
+
+    Mutex::Lock lock( global.mutex );
+    global.system_bytes += size;
+    if( global.system_bytes > global.peak_system_bytes )
+      global.peak_system_bytes = global.system_bytes;
+    return header;
+  }
+
+  void system_free( BlockHeader *header ) {
+    GlobalState& global = global_state();
+    size_t size = header->size;
+#if VW_BUFFER_POOL_HAVE_MMAP
+    if( header->kind == MAPPED_BLOCK )
+      munmap( header->base, size );
+    else
+#endif
+      free( header->base );
+
+    Mutex::Lock lock( global.mutex );
+    global.system_bytes -= size;
+  }
+
+  // A thread's pool of freed blocks, by size class, and its share of
+  // the statistics.  The pool's own thread is the only one that adds
+  // or removes blocks, so its mutex is only ever contended by
+  // buffer_pool_stats() and the limit setters.
+  //
+  // Each pool holds a budget, taken from the total pool limit, that
+  // covers its blocks.  Blocks are added and removed within the budget
+  // without the global mutex; it is only taken to grow the budget, or
+  // to give back a large unused part of it.
+  struct ThreadBufferPool {
+    Mutex mutex;
+    std::map<size_t, std::vector<BlockHeader*> > blocks;
+    size_t pooled_bytes, budget, max_block;
+    int64 live_bytes;
+    uint64 allocations, pool_hits;
+
+    ThreadBufferPool() : pooled_bytes(0), budget(0), live_bytes(0), allocations(0), pool_hits(0) {
+      GlobalState& global = global_state();
+      Mutex::Lock lock( global.mutex );
+      max_block = global.pool_limit / 4;
+      global.pools.insert( this );
+    }
+
+    void add_block( BlockHeader *header ) {
+      blocks[header->size].push_back( header );
+      pooled_bytes += header->size;
+    }
+
+    // Grows the budget to cover size more bytes in the pool, if the
+    // limits allow it.  Both the global mutex and ours must be held.
+    bool reserve( GlobalState& global, size_t size ) {
+      if( size > max_block )
+        return false;
+      if( pooled_bytes + size <= budget )
+        return true;
+      size_t needed = pooled_bytes + size - budget;
+      size_t own_room = global.pool_limit > budget ? global.pool_limit - budget : 0;
+      size_t total_room = global.total_pool_limit > global.reserved_bytes ?
+        size_t( global.total_pool_limit - global.reserved_bytes ) : 0;
+      size_t grant = std::min( std::max( needed, pool_budget_chunk ), std::min( own_room, total_room ) );
+      if( grant < needed )
+        return false;
+      budget += grant;
+      global.reserved_bytes += grant;
+      return true;
+    }
+
+    // Gives back the part of the budget that is not covering blocks,
+    // beyond keep bytes.  Both the global mutex and ours must be held.
+    void trim( GlobalState& global, size_t keep ) {
+      if( budget > pooled_bytes + keep ) {
+        global.reserved_bytes -= budget - pooled_bytes - keep;
+        budget = pooled_bytes + keep;
+      }
+    }
+
+    // Takes all of the blocks out of the pool, to be freed once the
+    // lock is released.
+    void take_blocks( std::vector<BlockHeader*> &out ) {
+      GlobalState& global = global_state();
+      Mutex::Lock global_lock( global.mutex );
+      Mutex::Lock lock( mutex );
+      for( std::map<size_t, std::vector<BlockHeader*> >::iterator it = blocks.begin(); it != blocks.end(); ++it )
+        out.insert( out.end(), it->second.begin(), it->second.end() );
+      blocks.clear();
+      pooled_bytes = 0;
+      trim( global, 0 );
+    }
+
+    ~ThreadBufferPool() {
+      std::vector<BlockHeader*> freed;
+      take_blocks( freed );
+      {
+        GlobalState& global = global_state();
+        Mutex::Lock lock( global.mutex );
+        global.pools.erase( this );
+        global.retired_live_bytes += live_bytes;
+        global.retired_allocations += allocations;
+        global.retired_pool_hits += pool_hits;
+      }
+      for( size_t i = 0; i < freed.size(); ++i )
+        system_free( freed[i] );
+    }
+  };
+
+  ThreadBufferPool& this_thread_pool() {
+    global_state();
+    ThreadBufferPool *pool = thread_pool_ptr->get();
+    if( !pool ) {
+      pool = new ThreadBufferPool();
+      thread_pool_ptr->reset( pool );
+    }
+    return *pool;
+  }
+
+} // namespace
+
+
+void* vw::allocate_buffer( size_t bytes ) {
+  size_t size = class_size( bytes + buffer_alignment );
+  ThreadBufferPool& pool = this_thread_pool();
+  BlockHeader *header = 0;
+  bool trim = false;
+  {
+    Mutex::Lock lock( pool.mutex );
+    std::map<size_t, std::vector<BlockHeader*> >::iterator it = pool.blocks.find( size );
+    if( it != pool.blocks.end() && !it->second.empty() ) {
+      header = it->second.back();
+      it->second.pop_back();
+      pool.pooled_bytes -= size;
+      pool.pool_hits++;
+      trim = pool.budget - pool.pooled_bytes > 2 * pool_budget_chunk;
+    }
+  }
+  if( trim ) {
+    GlobalState& global = global_state();
+    Mutex::Lock global_lock( global.mutex );
+    Mutex::Lock lock( pool.mutex );
+    pool.trim( global, pool_budget_chunk );
+  }
+  if( !header )
+    header = system_allocate( size );
+
+  Mutex::Lock lock( pool.mutex );
+  pool.allocations++;
+  pool.live_bytes += size;
+  return reinterpret_cast<char*>( header ) + buffer_alignment;
+}
+
+void vw::free_buffer( void* ptr ) {
+  if( !ptr ) return;
+  BlockHeader *header = reinterpret_cast<BlockHeader*>( static_cast<char*>( ptr ) - buffer_alignment );
+  size_t size = header->size;
+  ThreadBufferPool& pool = this_thread_pool();
+  bool poolable;
+  {
+    Mutex::Lock lock( pool.mutex );
+    pool.live_bytes -= size;
+    poolable = header->kind == HEAP_BLOCK && size <= pool.max_block;
+    if( poolable && pool.pooled_bytes + size <= pool.budget ) {
+      pool.add_block( header );
+      return;
+    }
+  }
+  if( poolable ) {
+    GlobalState& global = global_state();
+    Mutex::Lock global_lock( global.mutex );
+    Mutex::Lock lock( pool.mutex );
+    if( pool.reserve( global, size ) ) {
+      pool.add_block( header );
+      return;
+    }
+  }
+  system_free( header );
+}
+
+void vw::release_buffer_pool() {
+  std::vector<BlockHeader*> freed;
+  this_thread_pool().take_blocks( freed );
+  for( size_t i = 0; i < freed.size(); ++i )
+    system_free( freed[i] );
+}
+
+void vw::set_buffer_pool_limit( size_t bytes ) {
+  GlobalState& global = global_state();
+  Mutex::Lock global_lock( global.mutex );
+  global.pool_limit = bytes;
+  for( std::set<ThreadBufferPool*>::const_iterator it = global.pools.begin(); it != global.pools.end(); ++it ) {
+    Mutex::Lock pool_lock( (*it)->mutex );
+    (*it)->max_block = bytes / 4;
+    (*it)->trim( global, 0 );
+  }
+}
+
+void vw::set_buffer_pool_total_limit( size_t bytes ) {
+  GlobalState& global = global_state();
+  Mutex::Lock global_lock( global.mutex );
+  global.total_pool_limit = bytes;
+  for( std::set<ThreadBufferPool*>::const_iterator it = global.pools.begin(); it != global.pools.end(); ++it ) {
+    Mutex::Lock pool_lock( (*it)->mutex );
+    (*it)->trim( global, 0 );
+  }
+}
+
+void vw::set_buffer_huge_pages( bool enable, size_t min_bytes ) {
+  GlobalState& global = global_state();
+  Mutex::Lock lock( global.mutex );
+  global.huge_page_min = min_bytes;
+  global.huge_pages = enable;
+}
+
+vw::BufferPoolStats vw::buffer_pool_stats() {
+  GlobalState& global = global_state();
+  Mutex::Lock lock( global.mutex );
+  int64 live_bytes = global.retired_live_bytes;
+  BufferPoolStats stats;
+  stats.pooled_bytes = 0;
+  stats.allocations = global.retired_allocations;
+  stats.pool_hits = global.retired_pool_hits;
+  for( std::set<ThreadBufferPool*>::const_iterator it = global.pools.begin(); it != global.pools.end(); ++it ) {
+    Mutex::Lock pool_lock( (*it)->mutex );
+    stats.pooled_bytes += (*it)->pooled_bytes;
+    live_bytes += (*it)->live_bytes;
+    stats.allocations += (*it)->allocations;
+    stats.pool_hits += (*it)->pool_hits;
+  }
+  stats.live_bytes = live_bytes;
+  stats.system_bytes = global.system_bytes;
+  stats.peak_system_bytes = global.peak_system_bytes;
+  return stats;
+}
+
+std::ostream& vw::operator<<( std::ostream& os, BufferPoolStats const& stats ) {
+  std::ios_base::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(1)
+     << "live " << stats.live_bytes / 1048576.0 << " MB, pooled " << stats.pooled_bytes / 1048576.0
+     << " MB, system " << stats.system_bytes / 1048576.0 << " MB (peak " << stats.peak_system_bytes / 1048576.0
+     << " MB), " << stats.allocations << " allocations, " << stats.pool_hits << " from pools";
+  os.flags( flags );
+  return os;
+}
@@ -0,0 +1,95 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file Core/BufferPool.h
+///
+/// Memory for large, short-lived buffers such as the pixels of an
+/// ImageView.
+///
+/// Buffers are aligned to buffer_alignment bytes, so that rows of
+/// pixels can be loaded with aligned vector instructions.  Sizes are
+/// rounded up to one of four size classes per power of two, and freed
+/// buffers are kept in a pool belonging to the thread that freed
+/// them, to be handed out again by that thread's next allocation of
+/// the same class.  This keeps the temporaries that image operations
+/// create and discard at a high rate out of the system allocator.
+/// Each thread's pool is limited in size, and so are all of the pools
+/// together, so that many threads cannot between them hold on to much
+/// more memory than one would.  A thread's pool is emptied when the
+/// thread exits or calls release_buffer_pool().
+///
+/// Very large buffers are never pooled.  On systems that support it,
+/// they can optionally be backed by huge pages; see
+/// set_buffer_huge_pages().
+///
+#ifndef __VW_CORE_BUFFERPOOL_H__
+#define __VW_CORE_BUFFERPOOL_H__
+
+#include <vw/Core/FundamentalTypes.h>
+
+#include <cstddef>
+#include <ostream>
+
+namespace vw {
+
+  /// The alignment, in bytes, of every buffer returned by
+  /// allocate_buffer().
+  enum { buffer_alignment = 64 };
+
+  /// Returns a buffer of at least the given number of bytes, aligned
+  /// to buffer_alignment bytes.  The contents are uninitialized.
+  /// Throws std::bad_alloc if the memory is not available.  A zero size
+  /// returns a valid, unique pointer.
+  void* allocate_buffer( size_t bytes );
+
+  /// Frees a buffer returned by allocate_buffer().  It may be called
+  /// from any thread.  Null pointers are ignored.
+  void free_buffer( void* ptr );
+
+  /// Frees all of the buffers in the calling thread's pool.
+  void release_buffer_pool();
+
+  /// Sets the most memory, in bytes, that each thread's pool may hold.
+  /// Buffers larger than a quarter of this are never pooled.  The
+  /// default is 64 MB; zero disables pooling.
+  void set_buffer_pool_limit( size_t bytes );
+
+  /// Sets the most memory, in bytes, that all of the threads' pools
+  /// together may hold.  The default is 256 MB.  Lowering it does not
+  /// free buffers that are already pooled.
+  void set_buffer_pool_total_limit( size_t bytes );
+
+  /// Enables or disables huge page backing for buffers of at least
+  /// min_bytes bytes.  It is off by default, and has no effect on
+  /// systems without transparent huge pages.
+  void set_buffer_huge_pages( bool enable, size_t min_bytes = 32*1024*1024 );
+
+  /// Process-wide buffer statistics, returned by buffer_pool_stats().
+  struct BufferPoolStats {
+    /// Bytes in buffers that are currently allocated.
+    uint64 live_bytes;
+    /// Bytes in freed buffers held in the threads' pools.
+    uint64 pooled_bytes;
+    /// Bytes currently obtained from the system, live or pooled.
+    uint64 system_bytes;
+    /// The most bytes ever obtained from the system at once.
+    uint64 peak_system_bytes;
+    /// The total number of calls to allocate_buffer().
+    uint64 allocations;
+    /// How many of those were satisfied from a pool.
+    uint64 pool_hits;
+  };
+
+  /// Returns the current buffer statistics.  Sizes include the
+  /// rounding up to size classes.
+  BufferPoolStats buffer_pool_stats();
+
+  std::ostream& operator<<( std::ostream& os, BufferPoolStats const& stats );
+
+} // namespace vw
+
+#endif // __VW_CORE_BUFFERPOOL_H__
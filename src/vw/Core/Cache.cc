@@ -13,11 +13,21 @@
 #include <vw/Core/Debugging.h>
 #include <vw/Core/Settings.h>
 
+#include <algorithm>
+#include <fstream>
+
 namespace {
   vw::RunOnce system_cache_once = VW_RUNONCE_INIT;
   vw::Cache *system_cache_ptr = 0;
   void init_system_cache() {
-    system_cache_ptr = new vw::Cache( vw::vw_settings().system_cache_size() );
+    // One shard per thread keeps block reads from the rasterization
+    // threads from contending on the same lock.
+    system_cache_ptr = new vw::Cache( vw::vw_settings().system_cache_size(),
+                                      vw::vw_settings().default_num_threads(),
+                                      vw::vw_settings().system_cache_policy() );
+    std::string trace = vw::vw_settings().system_cache_trace();
+    if( ! trace.empty() )
+      system_cache_ptr->start_trace( trace );
   }
 }
 
@@ -26,79 +36,328 @@ vw::Cache& vw::vw_system_cache() {
   return *system_cache_ptr;
 }
 
-void vw::Cache::allocate( size_t size ) {
-  while( m_size+size > m_max_size ) {
-    if( ! m_last_valid ) {
-      vw_out(WarningMessage, "console") << "Warning: Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current Size = " << m_size << "\n";
-      vw_out(WarningMessage, "cache") << "Warning: Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current Size = " << m_size << "\n";
-      break;
+vw::Cache::Cache( size_t max_size, int num_shards, CachePolicy policy ) :
+  m_next_shard(0), m_next_line_id(0), m_size(0), m_max_size(max_size), m_tracing(0) {
+  if (num_shards < 1)
+    num_shards = 1;
+  for (int i = 0; i < num_shards; ++i)
+    m_shards.push_back( boost::shared_ptr<Shard>( new Shard(policy) ) );
+}
+
+// New cache lines are spread across the shards round-robin.
+vw::Cache::Shard& vw::Cache::next_shard() {
+  long index = ++m_next_shard;
+  return *m_shards[size_t(index) % m_shards.size()];
+}
+
+bool vw::Cache::over_budget() {
+  Mutex::Lock lock(m_mutex);
+  return m_size > m_max_size;
+}
+
+// Pick the line to evict from the shard, or return zero if the shard
+// has no valid lines.  Lines that were hit while the shard was locked
+// get a second chance, up to a limit so that a stream of concurrent
+// hits can't keep us here forever.  Must be called with the shard
+// lock held.
+vw::Cache::CacheLineBase* vw::Cache::choose_victim( Shard& shard ) {
+  // Lines that the user has explicitly deprioritized always go first.
+  if( shard.m_probation.last && shard.m_probation.last->m_deprioritized )
+    return shard.m_probation.last;
+  if( shard.m_main.last && shard.m_main.last->m_deprioritized )
+    return shard.m_main.last;
+
+  if( shard.m_policy == COST_WEIGHTED_CACHE_POLICY ) {
+    // Take the cheapest of the least recently used few lines.  Lines
+    // that were hit since their priority was last set get it refreshed
+    // now, since the hit path may not have been able to lock the shard.
+    const int sample_size = 8;
+    CacheLineBase *victim = 0;
+    CacheLineBase *line = shard.m_main.last;
+    for( int i = 0; line && i < sample_size; ++i, line = line->m_prev ) {
+      if( line->take_referenced() )
+        line->m_priority = shard.m_inflation + line->m_cost / std::max( line->m_size, size_t(1) );
+      if( ! victim || line->m_priority < victim->m_priority )
+        victim = line;
     }
-    m_last_valid->invalidate();
-    m_evictions++;
+    // Everything that stays behind ages relative to newcomers.
+    if( victim && victim->m_priority > shard.m_inflation )
+      shard.m_inflation = victim->m_priority;
+    return victim;
   }
-  m_size += size;
-  VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache allocated " << size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
+
+  if( shard.m_policy == SCAN_RESISTANT_CACHE_POLICY && shard.m_probation.last ) {
+    size_t quota;
+    {
+      Mutex::Lock lock(m_mutex);
+      quota = m_max_size / m_shards.size() / 4;
+    }
+    if( shard.m_probation.bytes > quota || ! shard.m_main.last )
+      return shard.m_probation.last;
+  }
+
+  const int max_second_chances = 16;
+  int second_chances = 0;
+  CacheLineBase *line = shard.m_main.last;
+  while( line && line != shard.m_main.first && second_chances < max_second_chances &&
+         line->take_referenced() ) {
+    second_chances++;
+    unlink(line);
+    push_front(shard.m_main, line);
+    line = shard.m_main.last;
+  }
+  if( ! line ) line = shard.m_probation.last;
+  return line;
+}
+
+// Evict one line from the shard.  Must be called with the shard lock
+// held.
+bool vw::Cache::evict( Shard& shard ) {
+  CacheLineBase *line = choose_victim(shard);
+  if( ! line ) return false;
+  line->take_referenced();
+  line->m_deprioritized = false;
+  line->m_evicted_at = ++shard.m_eviction_count;
+  line->invalidate();
+  shard.m_evictions.increment();
+  return true;
+}
+
+// Called with the line's own lock held but no shard locks held.
+void vw::Cache::allocate( CacheLineBase *line ) {
+  size_t size = line->m_size;
+  size_t share;
+  {
+    Mutex::Lock lock(m_mutex);
+    m_size += size;
+    share = m_max_size / m_shards.size();
+  }
+  {
+    Mutex::Lock shard_lock(line->m_shard.m_mutex);
+    line->m_shard.m_size += size;
+  }
+
+  // Make room cooperatively: first shrink our own shard to its share
+  // of the budget, then take lines from the other shards, and finally
+  // fall back on the rest of our own shard.
+  size_t num_shards = m_shards.size();
+  size_t own = 0;
+  while( m_shards[own].get() != &line->m_shard ) ++own;
+  for( size_t i = 0; i <= num_shards && over_budget(); ++i ) {
+    Shard& shard = *m_shards[(own + i) % num_shards];
+    size_t floor = (i == 0) ? share : 0;
+    Mutex::Lock shard_lock(shard.m_mutex);
+    while( shard.m_size > floor && over_budget() && evict(shard) ) {}
+  }
+
+  if( over_budget() ) {
+    Mutex::Lock lock(m_mutex);
+    vw_out(WarningMessage, "console") << "Warning: Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current Size = " << m_size << "\n";
+    vw_out(WarningMessage, "cache") << "Warning: Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current Size = " << m_size << "\n";
+  }
+  VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache allocated " << size << " bytes\n"; )
 }
 
 void vw::Cache::resize( size_t size ) {
-  Mutex::Lock lock(m_mutex);
-  m_max_size = size;
-  while( m_size > m_max_size ) {
-    VW_ASSERT( m_last_valid, LogicErr() << "Cache is empty but has nonzero size!" );
-    m_last_valid->invalidate();
+  {
+    Mutex::Lock lock(m_mutex);
+    m_max_size = size;
+  }
+  for( size_t i = 0; i < m_shards.size() && over_budget(); ++i ) {
+    Shard& shard = *m_shards[i];
+    Mutex::Lock shard_lock(shard.m_mutex);
+    while( over_budget() && evict(shard) ) {}
   }
 }
 
-void vw::Cache::deallocate( size_t size ) {
-  m_size -= size;
-  VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache deallocated " << size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
+// Must be called with the line's shard lock held.
+void vw::Cache::deallocate( CacheLineBase *line ) {
+  line->m_shard.m_size -= line->m_size;
+  Mutex::Lock lock(m_mutex);
+  m_size -= line->m_size;
+  VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache deallocated " << line->m_size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
 }
 
-// Move the cache line to the top of the valid list.
-void vw::Cache::validate( CacheLineBase *line ) {
-  if( line == m_first_valid ) return;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line == m_first_invalid ) m_first_invalid = line->m_next;
+void vw::Cache::set_policy( CachePolicy policy ) {
+  for( size_t i = 0; i < m_shards.size(); ++i ) {
+    Shard& shard = *m_shards[i];
+    Mutex::Lock shard_lock(shard.m_mutex);
+    // Probation lines join the main list behind the established ones.
+    while( CacheLineBase *line = shard.m_probation.first ) {
+      unlink(line);
+      push_back(shard.m_main, line);
+    }
+    shard.m_policy = policy;
+  }
+}
+
+// ---------------------------------------------------------------------------
+//                           List manipulation
+// ---------------------------------------------------------------------------
+
+// The list manipulation functions below must all be called with the
+// line's shard lock held.
+
+void vw::Cache::unlink( CacheLineBase *line ) {
+  LineList *list = line->m_list;
+  if( ! list ) return;
+  if( line == list->first ) list->first = line->m_next;
+  if( line == list->last ) list->last = line->m_prev;
   if( line->m_next ) line->m_next->m_prev = line->m_prev;
   if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = m_first_valid;
+  line->m_next = line->m_prev = 0;
+  list->bytes -= line->m_size;
+  list->count--;
+  line->m_list = 0;
+}
+
+void vw::Cache::push_front( LineList& list, CacheLineBase *line ) {
   line->m_prev = 0;
-  if( m_first_valid ) m_first_valid->m_prev = line;
-  m_first_valid = line;
-  if( ! m_last_valid ) m_last_valid = line;
+  line->m_next = list.first;
+  if( list.first ) list.first->m_prev = line;
+  list.first = line;
+  if( ! list.last ) list.last = line;
+  list.bytes += line->m_size;
+  list.count++;
+  line->m_list = &list;
+}
+
+void vw::Cache::push_back( LineList& list, CacheLineBase *line ) {
+  line->m_next = 0;
+  line->m_prev = list.last;
+  if( list.last ) list.last->m_next = line;
+  list.last = line;
+  if( ! list.first ) list.first = line;
+  list.bytes += line->m_size;
+  list.count++;
+  line->m_list = &list;
+}
+
+// Record that the line is valid and has just been used.
+void vw::Cache::validate( CacheLineBase *line ) {
+  Shard& s = line->m_shard;
+  line->m_deprioritized = false;
+  bool newly_valid = ( line->m_list == 0 || line->m_list == &s.m_invalid );
+
+  switch( s.m_policy ) {
+  case SCAN_RESISTANT_CACHE_POLICY:
+    if( newly_valid ) {
+      // A line that comes back while it would still have been resident
+      // in a cache twice the size is being reused, not scanned.
+      size_t resident = s.m_main.count + s.m_probation.count;
+      bool reused = line->m_evicted_at != 0 &&
+                    s.m_eviction_count - line->m_evicted_at <= std::max( resident, size_t(1) );
+      unlink(line);
+      push_front( reused ? s.m_main : s.m_probation, line );
+    } else if( line->m_list == &s.m_main && line != s.m_main.first ) {
+      unlink(line);
+      push_front(s.m_main, line);
+    }
+    // Hits on probation lines leave them where they are.
+    break;
+  case COST_WEIGHTED_CACHE_POLICY:
+    line->m_priority = s.m_inflation + line->m_cost / std::max( line->m_size, size_t(1) );
+    // Fall through
+  default:
+    if( line != s.m_main.first ) {
+      unlink(line);
+      push_front(s.m_main, line);
+    }
+  }
 }
 
 // Move the cache line to the top of the invalid list.
 void vw::Cache::invalidate( CacheLineBase *line ) {
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = m_first_invalid;
-  line->m_prev = 0;
-  if( m_first_invalid ) m_first_invalid->m_prev = line;
-  m_first_invalid = line;
+  Shard& s = line->m_shard;
+  unlink(line);
+  push_front(s.m_invalid, line);
 }
 
 // Remove the cache line from the cache lists.
 void vw::Cache::remove( CacheLineBase *line ) {
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line == m_first_invalid ) m_first_invalid = line->m_next;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = line->m_prev = 0;
+  unlink(line);
 }
 
-// Move the cache line to the bottom of the valid list.
+// Move the cache line to the bottom of its list and mark it to be
+// evicted before anything else.
 void vw::Cache::deprioritize( CacheLineBase *line ) {
-  if( line == m_last_valid ) return;
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_prev = m_last_valid;
-  line->m_next = 0;
-  m_last_valid->m_next = line;
-  m_last_valid = line;
+  LineList *list = line->m_list;
+  line->take_referenced();
+  line->m_deprioritized = true;
+  line->m_priority = 0;
+  if( line == list->last ) return;
+  unlink(line);
+  push_back(*list, line);
 }
 
+// ---------------------------------------------------------------------------
+//                               Tracing
+// ---------------------------------------------------------------------------
+
+void vw::Cache::start_trace( std::string const& filename ) {
+  boost::shared_ptr<std::ofstream> stream( new std::ofstream( filename.c_str() ) );
+  if( ! stream->is_open() )
+    vw_throw( IOErr() << "Cache: unable to open trace file \"" << filename << "\"." );
+  Mutex::Lock lock(m_trace_mutex);
+  m_trace_stream = stream;
+  if( ! m_tracing ) ++m_tracing;
+}
+
+void vw::Cache::stop_trace() {
+  Mutex::Lock lock(m_trace_mutex);
+  if( m_tracing ) --m_tracing;
+  m_trace_stream.reset();
+}
+
+void vw::Cache::trace( CacheLineBase *line, bool hit ) {
+  Mutex::Lock lock(m_trace_mutex);
+  if( m_trace_stream )
+    *m_trace_stream << line->m_id << " " << line->m_size << " "
+                    << line->m_cost << " " << (hit ? 1 : 0) << "\n";
+}
+
+// ---------------------------------------------------------------------------
+//                              Statistics
+// ---------------------------------------------------------------------------
+
+vw::Cache::ShardStats vw::Cache::shard_stats( int shard ) const {
+  VW_ASSERT( shard >= 0 && shard < num_shards(),
+             ArgumentErr() << "Cache: shard " << shard << " does not exist." );
+  Shard& s = *m_shards[shard];
+  ShardStats stats;
+  stats.hits = s.m_hits.value();
+  stats.misses = s.m_misses.value();
+  stats.evictions = s.m_evictions.value();
+  Mutex::Lock shard_lock(s.m_mutex);
+  stats.size = s.m_size;
+  return stats;
+}
+
+vw::uint64 vw::Cache::hits() const {
+  uint64 total = 0;
+  for( size_t i = 0; i < m_shards.size(); ++i )
+    total += m_shards[i]->m_hits.value();
+  return total;
+}
+
+vw::uint64 vw::Cache::misses() const {
+  uint64 total = 0;
+  for( size_t i = 0; i < m_shards.size(); ++i )
+    total += m_shards[i]->m_misses.value();
+  return total;
+}
+
+vw::uint64 vw::Cache::evictions() const {
+  uint64 total = 0;
+  for( size_t i = 0; i < m_shards.size(); ++i )
+    total += m_shards[i]->m_evictions.value();
+  return total;
+}
+
+void vw::Cache::clear_stats() {
+  for( size_t i = 0; i < m_shards.size(); ++i ) {
+    m_shards[i]->m_hits.clear();
+    m_shards[i]->m_misses.clear();
+    m_shards[i]->m_evictions.clear();
+  }
+}
@@ -32,13 +32,32 @@
 ///  The entire Handle<GeneratorT> class
 ///
 /// No other functions are guaranteed to be thread-safe.  There are
-/// two levels of synchronization: one lock per cache to protect the
-/// cache data structure itself, and one lock per cache line to
-/// protect the m_value pointer and synchronize the (potentially very
-/// expensive) generation operation.  However, the lock on the cache
-/// line ends just before the generate() method is called on the
-/// m_value object itself, so that object is responsible for its own
-/// thread safety.
+/// three levels of synchronization: one lock per cache shard to
+/// protect the shard's LRU lists, one lock per cache to protect the
+/// byte budget, and one lock per cache line to protect the m_value
+/// pointer and synchronize the (potentially very expensive)
+/// generation operation.  However, the lock on the cache line ends
+/// just before the generate() method is called on the m_value object
+/// itself, so that object is responsible for its own thread safety.
+///
+/// A cache can be split into several independently locked shards.
+/// Each cache line belongs to one shard, and each shard keeps its own
+/// LRU list, but all shards share the cache's byte budget: a shard
+/// that needs room first evicts its own least recently used lines,
+/// and then evicts lines from the other shards.  A cache hit never
+/// waits for the shard: it moves the line to the front of its shard's
+/// LRU list if the shard lock is free, and otherwise just bumps an
+/// atomic reference count on the line so that eviction will give it a
+/// second chance.  The hit path is not lock-free, though.  It still
+/// takes the line's own lock, because a shared_ptr cannot be copied
+/// atomically without one in C++98, and that lock is what keeps the
+/// value alive against a concurrent invalidation.  The line lock is
+/// only contended by threads that hit the same line.  A cache with a
+/// single shard behaves as a strict LRU cache when used from one
+/// thread.
+///
+/// The choice of which line to evict can be changed per cache; see
+/// CachePolicy below.
 ///
 /// Note also that the valid() function is only useful as a heuristic:
 /// there is no guarantee that the cache line won't be invalidated
@@ -59,8 +78,11 @@
 #include <vw/Core/FundamentalTypes.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/detail/atomic_count.hpp>
 #include <typeinfo>
 #include <sstream>
+#include <ostream>
+#include <vector>
 
 namespace vw {
 namespace core {
@@ -89,27 +111,112 @@ namespace vw {
   // virtual and contains {generator,object,valid} Handle contains a
   // shared pointer to CacheLine
 
+  /// Eviction policies for vw::Cache.
+  ///
+  /// LRU_CACHE_POLICY evicts the least recently used line.
+  ///
+  /// SCAN_RESISTANT_CACHE_POLICY is a variant of 2Q.  Newly generated
+  /// lines go on a FIFO probation list that is limited to a quarter of
+  /// the cache, so a single long sequential pass only cycles through
+  /// the probation list.  A line that is regenerated soon after it was
+  /// evicted from probation has shown that it is reused, and goes on
+  /// the main LRU list instead.
+  ///
+  /// COST_WEIGHTED_CACHE_POLICY prefers to evict lines that were cheap
+  /// to generate, per byte, using the measured time of each line's
+  /// last generate() call (GreedyDual-Size with the candidates sampled
+  /// from the least recently used end of the list).
+  enum CachePolicy { LRU_CACHE_POLICY = 0,
+                     SCAN_RESISTANT_CACHE_POLICY,
+                     COST_WEIGHTED_CACHE_POLICY };
+
   // An LRU-based regeneratable-data cache
   class Cache {
 
+    // A statistics counter that can be incremented without holding
+    // a lock.
+    class Counter {
+      boost::detail::atomic_count m_count;
+      long m_base;
+    public:
+      Counter() : m_count(0), m_base(0) {}
+      void increment() { ++m_count; }
+      uint64 value() const { return uint64(long(m_count) - m_base); }
+      void clear() { m_base = m_count; }
+    };
+
+    class CacheLineBase;
+
+    // An intrusive doubly-linked list of cache lines, most recently
+    // used first.
+    struct LineList {
+      CacheLineBase *first, *last;
+      size_t bytes, count;
+      LineList() : first(0), last(0), bytes(0), count(0) {}
+    };
+
+    // An independently locked portion of the cache.  Valid lines live
+    // on the main list or, under the scan-resistant policy, on the
+    // probation list until they prove themselves.
+    struct Shard {
+      Mutex m_mutex;
+      CachePolicy m_policy;
+      LineList m_main, m_probation, m_invalid;
+      size_t m_size;
+      uint64 m_eviction_count;
+      double m_inflation;
+      Counter m_hits, m_misses, m_evictions;
+      Shard(CachePolicy policy) : m_policy(policy), m_size(0), m_eviction_count(0), m_inflation(0) {}
+    };
+
     // The abstract base class for all cache line objects.
     class CacheLineBase {
       Cache& m_cache;
+      Shard& m_shard;
       CacheLineBase *m_prev, *m_next;
+      LineList *m_list;           // The list the line is on (shard lock)
       const size_t m_size;
+      const uint64 m_id;
+      boost::detail::atomic_count m_references; // Hits that found the shard locked
+      long m_references_seen;     // m_references when last checked (shard lock)
+      bool m_deprioritized;
+      double m_cost;              // Last generation time, in seconds
+      double m_priority;          // Used by the cost-weighted policy
+      uint64 m_evicted_at;        // Shard eviction count at last eviction
       friend class Cache;
     protected:
       Cache& cache() const { return m_cache; }
-      inline void allocate() { m_cache.allocate(m_size); }
-      inline void deallocate() { m_cache.deallocate(m_size); }
+      Shard& shard() const { return m_shard; }
+      inline void allocate() { m_cache.allocate(this); }
+      inline void deallocate() { m_cache.deallocate(this); }
       inline void validate() { m_cache.validate(this); }
       inline void remove() { m_cache.remove( this ); }
-      inline void deprioritize() { m_cache.deprioritize(this); }
+      inline void referenced() { ++m_references; }
+      inline void set_cost( double seconds ) { m_cost = seconds; }
+      inline void trace( bool hit ) { if (m_cache.m_tracing) m_cache.trace(this, hit); }
     public:
-      CacheLineBase( Cache& cache, size_t size ) : m_cache(cache), m_prev(0), m_next(0), m_size(size) {}
+      CacheLineBase( Cache& cache, size_t size ) : m_cache(cache), m_shard(cache.next_shard()),
+                                                   m_prev(0), m_next(0), m_list(0), m_size(size),
+                                                   m_id(cache.next_line_id()), m_references(0), m_references_seen(0),
+                                                   m_deprioritized(false), m_cost(0), m_priority(0),
+                                                   m_evicted_at(0) {}
       virtual ~CacheLineBase() {}
+      // Returns whether the line was hit since the last call, without
+      // the shard lock, and clears the mark.  Must be called with the
+      // shard lock held.
+      bool take_referenced() {
+        long references = m_references;
+        bool hit = references != m_references_seen;
+        m_references_seen = references;
+        return hit;
+      }
       virtual inline void invalidate() { m_cache.invalidate(this); }
       virtual size_t size() const { return m_size; }
+      void deprioritize() {
+        Mutex::Lock shard_lock(m_shard.m_mutex);
+        if (m_list && m_list != &m_shard.m_invalid)
+          m_cache.deprioritize(this);
+      }
     };
     friend class CacheLineBase;
 
@@ -127,17 +234,18 @@ namespace vw {
         : CacheLineBase(cache,core::detail::pointerish(generator)->size()), m_generator(generator), m_generation_count(0)
       {
         VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache creating CacheLine " << info() << "\n"; )
-        Mutex::Lock cache_lock(cache.m_mutex);
+        Mutex::Lock shard_lock(shard().m_mutex);
         CacheLineBase::invalidate();
       }
       
       virtual ~CacheLine() {
-        Mutex::Lock cache_lock(cache().m_mutex);
+        Mutex::Lock shard_lock(shard().m_mutex);
         invalidate();
         VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache destroying CacheLine " << info() << "\n"; )
         remove();
       }
       
+      // Must be called with the shard lock held.
       virtual void invalidate() {
         Mutex::Lock line_lock(m_mutex);
         if( ! m_value ) return;
@@ -154,30 +262,43 @@ namespace vw {
         return oss.str();
       }
       
-      value_type const& value() {
-        bool hit = true;
+      // Returns a new reference to the value, so that the caller's
+      // copy stays alive even if the line is invalidated right after
+      // the line lock is released.
+      value_type value() {
         Mutex::Lock line_lock(m_mutex);
-        if( !m_value ) {
-          m_generation_count++;
-          hit = false;
-          VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache generating CacheLine " << info() << "\n"; )
-          {
-            Mutex::Lock cache_lock(cache().m_mutex);
-            CacheLineBase::allocate();
+        if( m_value ) {
+          // Hit: don't wait for the shard.  If someone else holds it,
+          // leave a mark for the evictor instead of moving the line.
+          Shard& s = shard();
+          if (s.m_mutex.try_lock()) {
+            CacheLineBase::validate();
+            s.m_mutex.unlock();
+          } else {
+            CacheLineBase::referenced();
           }
+          s.m_hits.increment();
+          CacheLineBase::trace(true);
+          return m_value;
+        }
+
+        m_generation_count++;
+        VW_CACHE_DEBUG( vw_out(DebugMessage, "cache") << "Cache generating CacheLine " << info() << "\n"; )
+        CacheLineBase::allocate();
+        unsigned long long start = Stopwatch::microtime();
+        {
           ScopedWatch sw((std::string("Cache ")
                           + (m_generation_count == 1 ? "generating " : "regenerating ")
                           + typeid(this).name()).c_str());
           m_value = core::detail::pointerish(m_generator)->generate();
         }
+        CacheLineBase::set_cost( (Stopwatch::microtime() - start) / 1.0e6 );
         {
-          Mutex::Lock cache_lock(cache().m_mutex);
+          Mutex::Lock shard_lock(shard().m_mutex);
           CacheLineBase::validate();
-          if (hit)
-            cache().m_hits++;
-          else
-            cache().m_misses++;
         }
+        shard().m_misses.increment();
+        CacheLineBase::trace(false);
         return m_value;
       }
 
@@ -185,24 +306,30 @@ namespace vw {
         Mutex::Lock line_lock(m_mutex);
         return (bool)m_value;
       }
-
-      void deprioritize() {
-        Mutex::Lock line_lock(m_mutex);
-        if( m_value ) {
-          Mutex::Lock cache_lock(cache().m_mutex);
-          CacheLineBase::deprioritize();
-        }
-      }
     };
 
 
-    CacheLineBase *m_first_valid, *m_last_valid, *m_first_invalid;
+    std::vector<boost::shared_ptr<Shard> > m_shards;
+    boost::detail::atomic_count m_next_shard, m_next_line_id;
     size_t m_size, m_max_size;
-    Mutex m_mutex;
-    vw::uint64 m_hits, m_misses, m_evictions;
-
-    void allocate( size_t size );
-    void deallocate( size_t size );
+    Mutex m_mutex; // Protects m_size and m_max_size
+
+    boost::detail::atomic_count m_tracing; // Nonzero while a trace is open
+    boost::shared_ptr<std::ostream> m_trace_stream;
+    Mutex m_trace_mutex;
+
+    static void unlink( CacheLineBase *line );
+    static void push_front( LineList& list, CacheLineBase *line );
+    static void push_back( LineList& list, CacheLineBase *line );
+
+    Shard& next_shard();
+    uint64 next_line_id() { return uint64(++m_next_line_id); }
+    bool over_budget();
+    CacheLineBase* choose_victim( Shard& shard );
+    bool evict( Shard& shard );
+    void trace( CacheLineBase *line, bool hit );
+    void allocate( CacheLineBase *line );
+    void deallocate( CacheLineBase *line );
     void validate( CacheLineBase *line );
     void invalidate( CacheLineBase *line );
     void remove( CacheLineBase *line );
@@ -249,10 +376,16 @@ namespace vw {
       }
     };
 
-    Cache( size_t max_size ) :
-      m_first_valid(0), m_last_valid(0), m_first_invalid(0),
-      m_size(0), m_max_size(max_size),
-      m_hits(0), m_misses(0), m_evictions(0) {}
+    /// Per-shard statistics, as returned by shard_stats().
+    struct ShardStats {
+      uint64 hits, misses, evictions;
+      size_t size;
+    };
+
+    /// Create a cache holding at most max_size bytes, split into
+    /// num_shards independently locked shards, which evicts lines
+    /// according to the given policy.
+    Cache( size_t max_size, int num_shards = 1, CachePolicy policy = LRU_CACHE_POLICY );
 
     template <class GeneratorT>
     Handle<GeneratorT> insert( GeneratorT const& generator ) {
@@ -263,14 +396,30 @@ namespace vw {
 
     void resize( size_t size );
     size_t max_size() { return m_max_size; }
-
-    uint64 hits() const { return m_hits; }
-    uint64 misses() const { return m_misses; }
-    uint64 evictions() const {return m_evictions; }
-    void clear_stats() {
-      Mutex::Lock cache_lock(m_mutex);
-      m_hits = m_misses = m_evictions = 0;
+    size_t size() {
+      Mutex::Lock lock(m_mutex);
+      return m_size;
     }
+
+    int num_shards() const { return int(m_shards.size()); }
+    ShardStats shard_stats( int shard ) const;
+
+    /// Change the eviction policy.  Lines that are already cached are
+    /// kept, and treated as well established under the new policy.
+    void set_policy( CachePolicy policy );
+    CachePolicy policy() const { return m_shards[0]->m_policy; }
+
+    /// Record every lookup to a text file, one line per lookup:
+    /// "<line id> <size in bytes> <last generation time in seconds>
+    /// <hit>".  Traces recorded from real runs can be replayed with
+    /// cache_perftest to compare eviction policies.
+    void start_trace( std::string const& filename );
+    void stop_trace();
+
+    uint64 hits() const;
+    uint64 misses() const;
+    uint64 evictions() const;
+    void clear_stats();
   };
 
   /// Use this method to return a reference to the Vision Workbench
@@ -91,6 +91,18 @@ void vw::parse_config(std::basic_istream<char>& stream,
         settings.set_default_num_threads(boost::lexical_cast<int>(o.value[0]));
       else if (o.string_key == "general.system_cache_size")
         settings.set_system_cache_size(boost::lexical_cast<size_t>(o.value[0]));
+      else if (o.string_key == "general.system_cache_policy") {
+        if (o.value[0] == "lru")
+          settings.set_system_cache_policy(LRU_CACHE_POLICY);
+        else if (o.value[0] == "scan_resistant")
+          settings.set_system_cache_policy(SCAN_RESISTANT_CACHE_POLICY);
+        else if (o.value[0] == "cost_weighted")
+          settings.set_system_cache_policy(COST_WEIGHTED_CACHE_POLICY);
+        else
+          std::cerr << "Unknown system_cache_policy \"" << o.value[0] << "\". Ignoring." << std::endl;
+      }
+      else if (o.string_key == "general.system_cache_trace")
+        settings.set_system_cache_trace(o.value[0]);
       else if (o.string_key == "general.default_tile_size")
 	settings.set_default_tile_size(boost::lexical_cast<int>(o.value[0]));
       else if (o.string_key == "general.write_pool_size")
@@ -102,6 +102,7 @@
 
 #if defined(VW_ENABLE_EXCEPTIONS) && (VW_ENABLE_EXCEPTIONS==1)
 #include <exception>
+#include <boost/exception/enable_current_exception.hpp>
 #define VW_IF_EXCEPTIONS(x) x
 #else
 #define VW_IF_EXCEPTIONS(x)
@@ -150,7 +151,10 @@ namespace vw {
     /// Returns a string version of this exception's type.
     virtual std::string name() const { return "Exception"; }
 
-    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )
+    /// Throws a copy of this exception.  The copy can be captured by
+    /// boost::current_exception() without losing its type, which is
+    /// how errors are carried across threads (see TaskGroup).
+    VW_IF_EXCEPTIONS( virtual void default_throw() const { throw boost::enable_current_exception(*this); } )
 
   protected:
     // The error message text.
@@ -215,7 +219,8 @@ namespace vw {
                                                                                             \
     exception_type& reset() { m_desc.str("");  return *this; }                              \
                                                                                             \
-    VW_IF_EXCEPTIONS(virtual void default_throw() const { throw *this; })                   \
+    VW_IF_EXCEPTIONS(virtual void default_throw() const                                     \
+                     { throw boost::enable_current_exception(*this); })                     \
   }
 
   /// Invalid function argument exception
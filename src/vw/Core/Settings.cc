@@ -163,6 +163,7 @@ vw::Settings::Settings() : m_rc_last_polltime(0),
   // Set defaults
   m_default_num_threads = VW_NUM_THREADS;
   m_system_cache_size = 768 * 1024 * 1024; // Default cache size is 768-MB
+  m_system_cache_policy = LRU_CACHE_POLICY;
   m_write_pool_size  = 21;                 // Default pool size is 21 threads. About 252-MB for RGB f32 1024^2
   m_default_tile_size = 1024;
   m_tmp_directory = "/tmp";
@@ -172,6 +173,8 @@ vw::Settings::Settings() : m_rc_last_polltime(0),
   // system_settings() API.
   m_default_num_threads_override = false;
   m_system_cache_size_override = false;
+  m_system_cache_policy_override = false;
+  m_system_cache_trace_override = false;
   m_default_tile_size_override = false;
   m_tmp_directory_override = false;
   m_write_pool_size_override = false;
@@ -228,6 +231,49 @@ void vw::Settings::set_system_cache_size(size_t size) {
   vw_system_cache().resize(size);
 }
 
+vw::CachePolicy vw::Settings::system_cache_policy() {
+  if (!m_system_cache_policy_override)
+    reload_config();
+  Mutex::Lock lock(m_settings_mutex);
+  return m_system_cache_policy;
+}
+
+void vw::Settings::set_system_cache_policy(CachePolicy policy) {
+  {
+    Mutex::Lock lock(m_settings_mutex);
+    m_system_cache_policy_override = true;
+    if (policy == m_system_cache_policy)
+      return;
+    m_system_cache_policy = policy;
+  }
+  vw_system_cache().set_policy(policy);
+}
+
+std::string vw::Settings::system_cache_trace() {
+  if (!m_system_cache_trace_override)
+    reload_config();
+  Mutex::Lock lock(m_settings_mutex);
+  return m_system_cache_trace;
+}
+
+void vw::Settings::set_system_cache_trace(std::string const& filename) {
+  {
+    Mutex::Lock lock(m_settings_mutex);
+    m_system_cache_trace_override = true;
+    // The config file is re-read whenever it changes; don't truncate
+    // a trace that is already being recorded.
+    if (filename == m_system_cache_trace)
+      return;
+  }
+  if (filename.empty())
+    vw_system_cache().stop_trace();
+  else
+    vw_system_cache().start_trace(filename);
+
+  Mutex::Lock lock(m_settings_mutex);
+  m_system_cache_trace = filename;
+}
+
 int vw::Settings::write_pool_size(void) {
   if (!m_write_pool_size_override)
     reload_config();
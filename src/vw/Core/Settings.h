@@ -21,6 +21,7 @@
 #include <vector>
 
 #include <vw/Core/Thread.h>
+#include <vw/Core/Cache.h>
 
 namespace vw {
 
@@ -42,6 +43,10 @@ namespace vw {
     bool m_default_num_threads_override;
     size_t m_system_cache_size;
     bool m_system_cache_size_override;
+    CachePolicy m_system_cache_policy;
+    bool m_system_cache_policy_override;
+    std::string m_system_cache_trace;
+    bool m_system_cache_trace_override;
     size_t m_write_pool_size;
     bool m_write_pool_size_override;
     int m_default_tile_size;
@@ -100,6 +105,23 @@ namespace vw {
     /// BlockRasterizeView<>'s, including DiskImageView<>'s.
     void set_system_cache_size(size_t size);
 
+    /// Query for the eviction policy of the system cache.
+    CachePolicy system_cache_policy();
+
+    /// Set the eviction policy of the system cache.  In ~/.vwrc this
+    /// is system_cache_policy = lru, scan_resistant or cost_weighted.
+    void set_system_cache_policy(CachePolicy policy);
+
+    /// Query for the file that system cache lookups are recorded to.
+    /// An empty string means that lookups are not being recorded.
+    std::string system_cache_trace();
+
+    /// Record every system cache lookup to the given file (see
+    /// Cache::start_trace()), or stop recording if the filename is
+    /// empty.  The trace can be replayed with cache_perftest to pick
+    /// a policy for a particular workload.
+    void set_system_cache_trace(std::string const& filename);
+
     /// Query for the default tile size used for block processing ops.
     int default_tile_size();
     
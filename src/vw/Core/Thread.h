@@ -87,6 +87,10 @@ namespace vw {
     void lock()   { boost::mutex::lock(); }
     void unlock() { boost::mutex::unlock(); }
 
+    // Lock the mutex if it is free and return true, or return false
+    // immediately if another thread holds it.
+    bool try_lock() { return boost::mutex::try_lock(); }
+
     // A scoped lock class, used to lock and unlock a Mutex.
     class Lock : private boost::unique_lock<Mutex>,
                  private boost::noncopyable {
@@ -0,0 +1,354 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file Core/ThreadPool.cc
+///
+/// The work stealing thread pool that backs TaskGroup and the
+/// WorkQueue classes.
+///
+#include <vw/Core/ThreadPool.h>
+
+#include <deque>
+
+namespace {
+  vw::RunOnce thread_pool_once = VW_RUNONCE_INIT;
+  vw::WorkStealingPool *thread_pool_ptr = 0;
+  void init_thread_pool() {
+    thread_pool_ptr = new vw::WorkStealingPool( vw::vw_settings().default_num_threads() );
+  }
+
+  // Identifies the pool (and deque) that owns the current thread, if
+  // the current thread is a pool worker.
+  struct WorkerContext {
+    vw::WorkStealingPool *pool;
+    int deque_index;
+    WorkerContext(vw::WorkStealingPool *pool, int deque_index) :
+      pool(pool), deque_index(deque_index) {}
+  };
+  boost::thread_specific_ptr<WorkerContext> worker_context_ptr;
+
+  // How many tasks the current thread is running on behalf of
+  // run_pending_task(), and the most it may run nested that way.
+  boost::thread_specific_ptr<int> help_depth_ptr;
+  const int MAX_HELP_DEPTH = 8;
+
+  // Run a task that was handed to the pool directly.  Such a task has
+  // nobody to report an error to, so an exception is logged instead of
+  // being allowed to unwind out of the worker.  The task is marked
+  // finished either way so that anyone joining it does not hang.
+  void run_task(vw::Task& task) {
+    try {
+      task();
+    } catch (std::exception const& e) {
+      vw::vw_out(vw::ErrorMessage, "thread") << "ThreadPool: task failed: " << e.what() << "\n";
+    } catch (...) {
+      vw::vw_out(vw::ErrorMessage, "thread") << "ThreadPool: task failed with an unknown exception.\n";
+    }
+    task.signal_finished();
+  }
+}
+
+// The pool is intentionally never destroyed, for the same reason as
+// the system cache: its workers may be needed by other static
+// objects during program shutdown.
+vw::WorkStealingPool& vw::vw_thread_pool() {
+  thread_pool_once.run( init_thread_pool );
+  return *thread_pool_ptr;
+}
+
+// ---------------------------------------------------------------------------
+//                           Pool internals
+// ---------------------------------------------------------------------------
+
+// A double-ended task queue.  The owning worker pushes and pops at
+// the back, which keeps recently created (and likely cache-warm)
+// nested tasks on the same thread, while thieves take the oldest
+// task from the front.
+class vw::WorkStealingPool::WorkerDeque {
+  Mutex m_mutex;
+  std::deque<boost::shared_ptr<Task> > m_tasks;
+public:
+  void push_back(boost::shared_ptr<Task> const& task) {
+    Mutex::Lock lock(m_mutex);
+    m_tasks.push_back(task);
+  }
+
+  bool pop_back(boost::shared_ptr<Task>& task) {
+    Mutex::Lock lock(m_mutex);
+    if (m_tasks.empty()) return false;
+    task = m_tasks.back();
+    m_tasks.pop_back();
+    return true;
+  }
+
+  bool pop_front(boost::shared_ptr<Task>& task) {
+    Mutex::Lock lock(m_mutex);
+    if (m_tasks.empty()) return false;
+    task = m_tasks.front();
+    m_tasks.pop_front();
+    return true;
+  }
+};
+
+// Wraps a task submitted with add_blocking_task() so that the pool
+// can keep track of how many threads are tied up in blocking tasks.
+class vw::WorkStealingPool::BlockingTask : public Task {
+  WorkStealingPool &m_pool;
+  boost::shared_ptr<Task> m_task;
+public:
+  BlockingTask(WorkStealingPool& pool, boost::shared_ptr<Task> task) :
+    m_pool(pool), m_task(task) {}
+  virtual ~BlockingTask() {}
+  virtual void operator()() {
+    run_task(*m_task);
+    m_pool.blocking_task_complete();
+  }
+};
+
+struct vw::WorkStealingPool::WorkerThread {
+  WorkStealingPool *m_pool;
+  int m_deque_index;
+  WorkerThread(WorkStealingPool *pool, int deque_index) :
+    m_pool(pool), m_deque_index(deque_index) {}
+  void operator()() { m_pool->worker_loop(m_deque_index); }
+};
+
+// ---------------------------------------------------------------------------
+//                           WorkStealingPool
+// ---------------------------------------------------------------------------
+
+vw::WorkStealingPool::WorkStealingPool(int num_threads) :
+  m_injection_queue(new WorkerDeque), m_blocking_queue(new WorkerDeque),
+  m_num_blocking(0), m_num_pending(0), m_num_sleeping(0), m_steal_index(0),
+  m_shutdown(false) {
+
+  VW_ASSERT(num_threads > 0, ArgumentErr() << "WorkStealingPool: num_threads must be positive.");
+
+  // All of the deques must exist before any worker starts stealing.
+  for (int i = 0; i < num_threads; ++i)
+    m_deques.push_back( boost::shared_ptr<WorkerDeque>(new WorkerDeque) );
+
+  Mutex::Lock lock(m_spawn_mutex);
+  for (int i = 0; i < num_threads; ++i)
+    spawn_worker(i);
+}
+
+vw::WorkStealingPool::~WorkStealingPool() {
+  {
+    Mutex::Lock lock(m_sleep_mutex);
+    m_shutdown = true;
+    m_wake_event.notify_all();
+  }
+
+  std::vector<boost::shared_ptr<Thread> > threads;
+  {
+    Mutex::Lock lock(m_spawn_mutex);
+    threads = m_threads;
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i]->join();
+}
+
+// Must be called with m_spawn_mutex held.
+void vw::WorkStealingPool::spawn_worker(int deque_index) {
+  m_threads.push_back( boost::shared_ptr<Thread>( new Thread( WorkerThread(this, deque_index) ) ) );
+  vw_out(DebugMessage, "thread") << "ThreadPool: started pool worker " << m_threads.size()-1
+                                 << " [ " << m_num_blocking << " blocking tasks ]\n";
+}
+
+void vw::WorkStealingPool::wake_worker() {
+  if (m_num_sleeping > 0) {
+    Mutex::Lock lock(m_sleep_mutex);
+    m_wake_event.notify_one();
+  }
+}
+
+bool vw::WorkStealingPool::find_task(int deque_index, bool include_blocking, bool include_others,
+                                     boost::shared_ptr<Task>& task) {
+  if (m_num_pending <= 0)
+    return false;
+
+  // Our own work first, then (if allowed) work that is not owned by
+  // anyone, and finally work stolen from the other workers.
+  bool found = deque_index >= 0 && m_deques[deque_index]->pop_back(task);
+
+  if (!found && include_others) {
+    found = ( include_blocking && m_blocking_queue->pop_front(task) ) ||
+            m_injection_queue->pop_front(task);
+
+    size_t n = m_deques.size();
+    size_t start = size_t(++m_steal_index);
+    for (size_t i = 0; i < n && !found; ++i) {
+      size_t victim = (start + i) % n;
+      if (int(victim) != deque_index)
+        found = m_deques[victim]->pop_front(task);
+    }
+  }
+
+  if (found)
+    --m_num_pending;
+  return found;
+}
+
+void vw::WorkStealingPool::worker_loop(int deque_index) {
+  worker_context_ptr.reset(new WorkerContext(this, deque_index));
+
+  boost::shared_ptr<Task> task;
+  while (true) {
+    if (find_task(deque_index, true, true, task)) {
+      run_task(*task);
+      task.reset();
+      continue;
+    }
+
+    Mutex::Lock lock(m_sleep_mutex);
+    if (m_shutdown)
+      break;
+
+    // The timeout covers the (rare) case where a task is queued
+    // between our check of m_num_pending and the wait below.
+    ++m_num_sleeping;
+    if (m_num_pending <= 0)
+      m_wake_event.timed_wait(lock, 50);
+    --m_num_sleeping;
+  }
+}
+
+void vw::WorkStealingPool::blocking_task_complete() {
+  Mutex::Lock lock(m_spawn_mutex);
+  m_num_blocking--;
+}
+
+void vw::WorkStealingPool::add_task(boost::shared_ptr<Task> task) {
+  WorkerContext *context = worker_context_ptr.get();
+  if (context && context->pool == this && context->deque_index >= 0)
+    m_deques[context->deque_index]->push_back(task);
+  else
+    m_injection_queue->push_back(task);
+
+  ++m_num_pending;
+  wake_worker();
+}
+
+void vw::WorkStealingPool::add_blocking_task(boost::shared_ptr<Task> task) {
+  {
+    // Make sure there is a thread for every blocking task, so that a
+    // pool full of blocked tasks can always make progress.
+    Mutex::Lock lock(m_spawn_mutex);
+    m_num_blocking++;
+    if (m_num_blocking > int(m_threads.size()))
+      spawn_worker(-1);
+  }
+
+  m_blocking_queue->push_back( boost::shared_ptr<Task>( new BlockingTask(*this, task) ) );
+  ++m_num_pending;
+  wake_worker();
+}
+
+bool vw::WorkStealingPool::run_pending_task() {
+  WorkerContext *context = worker_context_ptr.get();
+  int deque_index = (context && context->pool == this) ? context->deque_index : -1;
+
+  // Tasks from our own deque were created further up this thread's
+  // stack, so running them here is always safe.  Other tasks are
+  // unrelated to the one we are waiting on; each one we pick up while
+  // waiting nests another task on this thread's stack, so we limit
+  // how deep that can go.
+  if (!help_depth_ptr.get())
+    help_depth_ptr.reset(new int(0));
+  int &help_depth = *help_depth_ptr;
+
+  boost::shared_ptr<Task> task;
+  if (!find_task(deque_index, false, help_depth < MAX_HELP_DEPTH, task))
+    return false;
+
+  help_depth++;
+  run_task(*task);
+  help_depth--;
+  return true;
+}
+
+int vw::WorkStealingPool::num_spawned_threads() {
+  Mutex::Lock lock(m_spawn_mutex);
+  return int(m_threads.size());
+}
+
+// ---------------------------------------------------------------------------
+//                              TaskGroup
+// ---------------------------------------------------------------------------
+
+class vw::TaskGroup::GroupTask : public Task {
+  TaskGroup &m_group;
+  boost::shared_ptr<Task> m_task;
+public:
+  GroupTask(TaskGroup& group, boost::shared_ptr<Task> task) :
+    m_group(group), m_task(task) {}
+  virtual ~GroupTask() {}
+  virtual void operator()() {
+    // The first error is handed back to whoever joins the group.
+    try {
+      (*m_task)();
+    } catch (...) {
+      m_group.task_failed( boost::current_exception() );
+    }
+    m_task->signal_finished();
+    // The group may be destroyed as soon as this returns.
+    m_group.task_complete();
+  }
+};
+
+void vw::TaskGroup::add_task(boost::shared_ptr<Task> task) {
+  {
+    Mutex::Lock lock(m_mutex);
+    m_num_outstanding++;
+  }
+  m_pool.add_task( boost::shared_ptr<Task>( new GroupTask(*this, task) ) );
+}
+
+void vw::TaskGroup::task_complete() {
+  Mutex::Lock lock(m_mutex);
+  if (--m_num_outstanding == 0)
+    m_finished_event.notify_all();
+}
+
+void vw::TaskGroup::task_failed(boost::exception_ptr const& error) {
+  Mutex::Lock lock(m_mutex);
+  if (!m_error)
+    m_error = error;
+}
+
+void vw::TaskGroup::join() {
+  this->wait();
+
+  boost::exception_ptr error;
+  {
+    Mutex::Lock lock(m_mutex);
+    std::swap(error, m_error);
+  }
+  if (error)
+    boost::rethrow_exception(error);
+}
+
+void vw::TaskGroup::wait() {
+  while (true) {
+    {
+      Mutex::Lock lock(m_mutex);
+      if (m_num_outstanding == 0)
+        return;
+    }
+
+    // Help out rather than block.  This is what allows tasks to join
+    // their own nested groups without starving the pool.
+    if (m_pool.run_pending_task())
+      continue;
+
+    Mutex::Lock lock(m_mutex);
+    if (m_num_outstanding == 0)
+      return;
+    m_finished_event.timed_wait(lock, 5);
+  }
+}
@@ -10,12 +10,20 @@
 /// Note: All tasks need to be of the same type, but you can have a
 /// common abstract base class if you want.
 ///
+/// All of the classes in this file execute their tasks on a
+/// persistent WorkStealingPool.  Fine-grained parallel work should
+/// use a TaskGroup directly; the WorkQueue classes add concurrency
+/// limits and ordering on top of the same pool.
+///
 #ifndef __VW_CORE_THREADPOOL_H__
 #define __VW_CORE_THREADPOOL_H__
 
 #include <vector>
 #include <list>
 
+#include <boost/detail/atomic_count.hpp>
+#include <boost/exception_ptr.hpp>
+
 #include <vw/Core/Settings.h>
 #include <vw/Core/Thread.h>
 #include <vw/Core/Log.h>
@@ -58,91 +66,251 @@ namespace vw {
     }
   };
 
+  // ----------------------  --------------  ---------------------------
+  // ----------------------  WorkStealingPool  -------------------------
+  // ----------------------  --------------  ---------------------------
+
+  /// A persistent pool of worker threads that schedules Tasks using
+  /// per-worker deques and work stealing.
+  ///
+  /// Each of the pool's core workers owns a deque of tasks.  A task
+  /// submitted from inside one of those workers (a "nested" task) is
+  /// pushed onto the back of that worker's own deque, and the worker
+  /// pops work from the back of its own deque first.  Idle workers
+  /// steal from the front of other workers' deques.  Tasks submitted
+  /// from threads outside of the pool go into a shared injection
+  /// queue.  None of these paths share a single lock, so many small
+  /// tasks can be dispatched without serializing on one mutex.
+  ///
+  /// Tasks that may block for a long time (such as the worker loops
+  /// that drive a WorkQueue) should be submitted with
+  /// add_blocking_task().  The pool guarantees each such task its own
+  /// thread, spawning additional persistent workers when needed, so
+  /// that blocking tasks can never starve each other.
+  ///
+  /// Most code should use the singleton returned by vw_thread_pool(),
+  /// typically through a TaskGroup or one of the WorkQueue classes
+  /// below.
+  class WorkStealingPool : private boost::noncopyable {
+    class WorkerDeque;
+    class BlockingTask;
+    struct WorkerThread;
+    friend class BlockingTask;
+    friend struct WorkerThread;
+
+    std::vector<boost::shared_ptr<WorkerDeque> > m_deques;
+    boost::shared_ptr<WorkerDeque> m_injection_queue;
+    boost::shared_ptr<WorkerDeque> m_blocking_queue;
+
+    std::vector<boost::shared_ptr<Thread> > m_threads;
+    int m_num_blocking;
+    Mutex m_spawn_mutex;
+
+    boost::detail::atomic_count m_num_pending;
+    boost::detail::atomic_count m_num_sleeping;
+    boost::detail::atomic_count m_steal_index;
+    volatile bool m_shutdown;
+    Mutex m_sleep_mutex;
+    Condition m_wake_event;
+
+    void spawn_worker(int deque_index);
+    void worker_loop(int deque_index);
+    void wake_worker();
+    bool find_task(int deque_index, bool include_blocking, bool include_others,
+                   boost::shared_ptr<Task>& task);
+    void blocking_task_complete();
+
+  public:
+    /// Create a pool with the given number of core worker threads.
+    /// The threads are started immediately and persist until the
+    /// pool is destroyed.
+    WorkStealingPool(int num_threads = vw_settings().default_num_threads());
+
+    /// Waits for all queued tasks to finish, then stops the workers.
+    ~WorkStealingPool();
+
+    /// Submit a task for execution.  When called from one of this
+    /// pool's workers, the task is pushed onto that worker's own
+    /// deque.  The pool calls signal_finished() on the task once it
+    /// has run.
+    void add_task(boost::shared_ptr<Task> task);
+
+    /// Submit a task that may block for a long time.  The task is
+    /// guaranteed a thread of its own, even if every other worker is
+    /// currently occupied by a blocking task.
+    void add_blocking_task(boost::shared_ptr<Task> task);
+
+    /// Run one queued (non-blocking) task on the calling thread, if
+    /// one is available.  Returns false if no task was found.  This
+    /// is used by threads that are waiting on other tasks so that
+    /// they help out instead of sitting idle.
+    bool run_pending_task();
+
+    /// Return the number of core worker threads.
+    int num_threads() const { return int(m_deques.size()); }
+
+    /// Return the total number of threads owned by the pool,
+    /// including any extra threads spawned for blocking tasks.
+    int num_spawned_threads();
+  };
+
+  /// Static method to access the process-wide work stealing pool.
+  /// The pool is created on first use with
+  /// vw_settings().default_num_threads() core workers.
+  WorkStealingPool& vw_thread_pool();
+
+  /// A set of tasks that can be waited on together.  Tasks added to a
+  /// group run on a WorkStealingPool; join() waits for all of them to
+  /// complete.  A thread that calls join() executes queued tasks while
+  /// it waits, so tasks may themselves create TaskGroups, add tasks to
+  /// them and join them without deadlocking the pool.
+  ///
+  /// If a task throws, the remaining tasks still run, and join()
+  /// rethrows the first exception once they have all finished.
+  /// Exceptions raised with vw_throw() keep their type.
+  ///
+  /// For example:
+  ///
+  ///     TaskGroup group;
+  ///     for (int i = 0; i < n; ++i)
+  ///       group.add_task( boost::shared_ptr<Task>( new MyTask(i) ) );
+  ///     group.join();
+  ///
+  class TaskGroup : private boost::noncopyable {
+    class GroupTask;
+    friend class GroupTask;
+
+    WorkStealingPool& m_pool;
+    int m_num_outstanding;
+    boost::exception_ptr m_error;
+    Mutex m_mutex;
+    Condition m_finished_event;
+
+    void task_complete();
+    void task_failed(boost::exception_ptr const& error);
+    void wait();
+
+  public:
+    TaskGroup(WorkStealingPool& pool = vw_thread_pool())
+      : m_pool(pool), m_num_outstanding(0) {}
+    /// Waits for any outstanding tasks.  Errors that were never
+    /// collected by join() are discarded.
+    ~TaskGroup() { this->wait(); }
+
+    /// Add a task to the group and submit it to the pool.
+    void add_task(boost::shared_ptr<Task> task);
+
+    /// Return the number of tasks in this group that have not yet
+    /// finished.
+    int size() {
+      Mutex::Lock lock(m_mutex);
+      return m_num_outstanding;
+    }
+
+    /// Wait for every task in the group to finish, then rethrow the
+    /// first exception thrown by any of them.
+    void join();
+  };
+
   // ----------------------  --------------  ---------------------------
   // ----------------------  Task Generator  ---------------------------
   // ----------------------  --------------  ---------------------------
 
   // Work Queue Base Class
+  //
+  // A WorkQueue limits the number of its tasks that run concurrently
+  // and lets subclasses decide the order in which they are run.  The
+  // worker loops that execute a WorkQueue's tasks are scheduled as
+  // blocking tasks on a WorkStealingPool, so no threads are created
+  // or destroyed as queues fill and drain.
   class WorkQueue {
 
-    // The worker thread class is the Task object that is spun out to
-    // do the actual work of the WorkQueue.  When a worker thread
-    // finishes its task it notifies the threadpool, which farms out
-    // the next task to the worker thread.
-    class WorkerThread {
+    // The worker task is spun out onto the thread pool to do the
+    // actual work of the WorkQueue.  When it finishes its task it asks
+    // the queue for the next one, and it terminates when none are
+    // left.
+    class WorkerTask : public Task {
       WorkQueue &m_queue;
       boost::shared_ptr<Task> m_task;
-      int m_thread_id;
-      bool &m_should_die;
+      int m_worker_id;
     public:
-      WorkerThread(WorkQueue& queue, boost::shared_ptr<Task> initial_task, 
-                   int thread_id, bool &should_die) :
-        m_queue(queue), m_task(initial_task), m_thread_id(thread_id), m_should_die(should_die) {}
-      ~WorkerThread() {}
-      void operator()() { 
+      WorkerTask(WorkQueue& queue, boost::shared_ptr<Task> initial_task, int worker_id) :
+        m_queue(queue), m_task(initial_task), m_worker_id(worker_id) {}
+      virtual ~WorkerTask() {}
+      virtual void operator()() {
         do {
-          vw_out(DebugMessage, "thread") << "ThreadPool: running worker thread " 
-                                         << m_thread_id << "\n";
-          (*m_task)();
+          vw_out(DebugMessage, "thread") << "ThreadPool: running worker "
+                                         << m_worker_id << "\n";
+          // The worker survives a failing task, so that join_all()
+          // still returns; the first error is rethrown from there.
+          try {
+            (*m_task)();
+          } catch (...) {
+            m_queue.task_failed( boost::current_exception() );
+          }
           m_task->signal_finished();
-          
+
           {
             // We lock m_queue_mutex to prevent WorkQueue::notify() from running
             // until we either sucessfully have grabbed the next task, or we have
-            // completely terminated the worker.
+            // completely terminated the worker.  Once worker_thread_complete()
+            // has been called, the queue may be destroyed at any time, so we
+            // must not touch it again.
             Mutex::Lock lock(m_queue.m_queue_mutex);
-            m_task = m_queue.get_next_task();
+            if (m_queue.m_should_die)
+              m_task.reset();
+            else
+              m_task = m_queue.get_next_task();
 
             if (!m_task)
-              m_queue.worker_thread_complete(m_thread_id); 
+              m_queue.worker_thread_complete(m_worker_id);
           }
-        } while ( m_task && !m_should_die );
+        } while ( m_task );
       }
     };
 
-    int m_active_workers, m_max_workers;
+    WorkStealingPool &m_pool;
+    int m_active_workers, m_max_workers, m_next_worker_id;
     Mutex m_queue_mutex;
-    std::vector<boost::shared_ptr<Thread> > m_running_threads;
-    std::list<int> m_available_thread_ids;
     Condition m_joined_event;
     bool m_should_die;
+    boost::exception_ptr m_error;
 
-    // This is called whenever a worker thread finishes its task. If
-    // there are more tasks available, the worker is given more work.
-    // Otherwise, the worker terminates.
-    //
-    // *************************************************************
-    // IMPORANT NOTE: The worker_thread_complete() method is called
-    // from within child thread so that we can clean up the list of
-    // available threads.  As such, one must be very careful about
-    // what is done in this method, because for the duration of this
-    // method, the child thread has access to it's own shared pointer.
-    // This method has been carefully written so as not to
-    // accidentally allow the thread to delete it's own shared
-    // pointer, which could cause the thread to call its own join()
-    // method.
-    // *************************************************************
+    void task_failed(boost::exception_ptr const& error) {
+      Mutex::Lock lock(m_queue_mutex);
+      if (!m_error)
+        m_error = error;
+    }
+
+    // This is called whenever a worker finishes its task and there
+    // are no more tasks available for it, just before the worker
+    // terminates.  It is called with m_queue_mutex held.
     void worker_thread_complete(int worker_id) {
       m_active_workers--;
-      vw_out(DebugMessage, "thread") << "ThreadPool: terminating worker thread " << worker_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n"; 
-      
-      // Erase the worker thread from the list of active threads
-      VW_ASSERT(worker_id >= 0 && worker_id < int(m_running_threads.size()), 
-                LogicErr() << "WorkQueue: request to terminate thread " << worker_id << ", which does not exist.");
-      m_available_thread_ids.push_back(worker_id);
+      vw_out(DebugMessage, "thread") << "ThreadPool: terminating worker " << worker_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n";
 
       // Notify any threads that are waiting for the join event.
       m_joined_event.notify_all();
     }
 
-  public:
-    WorkQueue(int num_threads = vw_settings().default_num_threads() ) 
-      : m_active_workers(0), m_max_workers(num_threads), m_should_die(false) {
-      m_running_threads.resize(num_threads);
-      for (int i = 0; i < num_threads; ++i)
-        m_available_thread_ids.push_back(i);
+  protected:
+    // Wait for the workers to clean up the threadpool state and exit.
+    // Subclasses call this from their destructors, since the workers
+    // ask them for tasks until the last one exits.
+    void wait_for_workers() {
+      Mutex::Lock lock(m_queue_mutex);
+      while (m_active_workers != 0)
+        m_joined_event.wait(lock);
     }
-    virtual ~WorkQueue() { this->join_all(); }
+
+  public:
+    WorkQueue(int num_threads = vw_settings().default_num_threads(),
+              WorkStealingPool& pool = vw_thread_pool() )
+      : m_pool(pool), m_active_workers(0), m_max_workers(num_threads),
+        m_next_worker_id(0), m_should_die(false) {}
+    /// Waits for any running tasks.  Errors that were never collected
+    /// by join_all() are discarded.
+    virtual ~WorkQueue() { this->wait_for_workers(); }
 
     /// Return a shared pointer to the next task.  If no tasks are
     /// available, return an empty shared pointer.
@@ -151,60 +319,56 @@ namespace vw {
     // Notify can be called by a child class that inherits from
     // WorkQueue.  A call to notify will cause the WorkQueue to
     // re-examine the list of tasks it has available for execution.
-    // If there are any idle slots for worker threads, it will spin
-    // off WorkerThreads to execute these tasks.
+    // If there are any idle slots for workers, it will submit
+    // WorkerTasks to the thread pool to execute these tasks.
     void notify() {
       Mutex::Lock lock(m_queue_mutex);
 
-      // While there are available threads, farm out the tasks from
-      // the task generator
+      // While there are available worker slots, farm out the tasks
+      // from the task generator
       boost::shared_ptr<Task> task;
-      while ( !m_available_thread_ids.empty() &&
+      while ( m_active_workers < m_max_workers && !m_should_die &&
               (task = this->get_next_task()) ) {
-        int next_available_thread_id = m_available_thread_ids.front();
-        m_available_thread_ids.pop_front();
-
-        boost::shared_ptr<WorkerThread> next_worker( new WorkerThread(*this, task, 
-                                                                      next_available_thread_id,
-                                                                      m_should_die) );
-        boost::shared_ptr<Thread> thread(new Thread(next_worker));
-        m_running_threads[next_available_thread_id] = thread;
+        int worker_id = m_next_worker_id++;
         m_active_workers++;
-        vw_out(DebugMessage, "thread") << "ThreadPool: creating worker thread " << next_available_thread_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n"; 
-      } 
+        vw_out(DebugMessage, "thread") << "ThreadPool: creating worker " << worker_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n";
+        m_pool.add_blocking_task( boost::shared_ptr<Task>( new WorkerTask(*this, task, worker_id) ) );
+      }
     }
 
     /// Return the max number threads that can run concurrently at any
     /// given time using this threadpool.
-    int max_threads() { 
+    int max_threads() {
       Mutex::Lock lock(m_queue_mutex);
       return m_max_workers;
     }
 
     /// Return the max number threads that can run concurrently at any
     /// given time using this threadpool.
-    int active_threads() { 
+    int active_threads() {
       Mutex::Lock lock(m_queue_mutex);
       return m_active_workers;
     }
 
-    // Join all currently running threads and wait for the task pool to be empty.
+    /// Join all currently running threads and wait for the task pool
+    /// to be empty, then rethrow the first exception thrown by any
+    /// task since the last join.
     void join_all() {
-      bool finished = false;
-      
-      // Wait for the threads to clean up the threadpool state and exit.
-      while(!finished) {
+      this->wait_for_workers();
+      boost::exception_ptr error;
+      {
         Mutex::Lock lock(m_queue_mutex);
-        if (m_active_workers != 0) {
-          m_joined_event.wait(lock);
-        } else {
-          finished = true;
-        }
+        std::swap(error, m_error);
       }
+      if (error)
+        boost::rethrow_exception(error);
     }
 
-    void kill_and_join() { 
-      m_should_die = true;
+    void kill_and_join() {
+      {
+        Mutex::Lock lock(m_queue_mutex);
+        m_should_die = true;
+      }
       this->join_all();
     }
 
@@ -218,7 +382,10 @@ namespace vw {
     Mutex m_mutex;
   public:
 
-    FifoWorkQueue(int num_threads = vw_settings().default_num_threads()) : WorkQueue(num_threads) {}
+    FifoWorkQueue(int num_threads = vw_settings().default_num_threads(),
+                  WorkStealingPool& pool = vw_thread_pool())
+      : WorkQueue(num_threads, pool) {}
+    virtual ~FifoWorkQueue() { this->wait_for_workers(); }
 
     int size() { 
       Mutex::Lock lock(m_mutex);
@@ -255,9 +422,12 @@ namespace vw {
     Mutex m_mutex;
   public:
 
-    OrderedWorkQueue(int num_threads = vw_settings().default_num_threads()) : WorkQueue(num_threads) {
+    OrderedWorkQueue(int num_threads = vw_settings().default_num_threads(),
+                     WorkStealingPool& pool = vw_thread_pool())
+      : WorkQueue(num_threads, pool) {
       m_next_index = 0;
     }
+    virtual ~OrderedWorkQueue() { this->wait_for_workers(); }
 
     int size() { 
       Mutex::Lock lock(m_mutex);
@@ -0,0 +1,267 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file cache_perftest.cc
+///
+/// Hammers a vw::Cache from many threads at once, the way a set of
+/// block rasterization threads reading a DiskImageView would, and
+/// reports lookup throughput along with per-shard statistics.  By
+/// default it runs against vw_system_cache(); use --shards to compare
+/// against a private cache with a given number of shards.
+///
+/// With --policies it instead compares the cache's eviction policies
+/// on synthetic stereo-like and mosaic-like access patterns, and with
+/// --trace it replays a trace recorded by Cache::start_trace() against
+/// each policy.  Each miss spins for the line's recorded generation
+/// time, scaled by --time-scale.
+///
+#include <vw/Core/Cache.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Thread.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <map>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+// Generates a block of bytes.  The generation cost is mostly the
+// allocation, so misses stay cheap and the benchmark is dominated by
+// the cache's own overhead.
+class ByteBlockGenerator {
+  size_t m_size;
+public:
+  typedef std::vector<uint8> value_type;
+  ByteBlockGenerator(size_t size) : m_size(size) {}
+  size_t size() const { return m_size; }
+  boost::shared_ptr<value_type> generate() const {
+    return boost::shared_ptr<value_type>( new value_type(m_size) );
+  }
+};
+
+typedef Cache::Handle<ByteBlockGenerator> handle_type;
+
+class CacheHammer {
+  std::vector<handle_type> &m_handles;
+  int m_num_lookups;
+  unsigned m_seed;
+public:
+  CacheHammer(std::vector<handle_type>& handles, int num_lookups, unsigned seed) :
+    m_handles(handles), m_num_lookups(num_lookups), m_seed(seed) {}
+  void operator()() {
+    unsigned state = m_seed;
+    for (int i = 0; i < m_num_lookups; ++i) {
+      state = state * 1103515245 + 12345;
+      boost::shared_ptr<ByteBlockGenerator::value_type> block = m_handles[(state >> 8) % m_handles.size()];
+    }
+  }
+};
+
+void run(std::string const& name, Cache& cache, int num_threads, int num_blocks,
+         size_t block_size, int num_lookups) {
+  std::vector<handle_type> handles;
+  for (int i = 0; i < num_blocks; ++i)
+    handles.push_back( cache.insert( ByteBlockGenerator(block_size) ) );
+  cache.clear_stats();
+
+  Stopwatch sw;
+  sw.start();
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for (int i = 0; i < num_threads; ++i)
+    threads.push_back( boost::shared_ptr<Thread>( new Thread( CacheHammer(handles, num_lookups, i+1) ) ) );
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->join();
+  sw.stop();
+
+  double lookups = double(num_threads) * num_lookups;
+  std::cout << name << ": " << cache.num_shards() << " shards, "
+            << std::fixed << std::setprecision(3) << sw.elapsed_seconds() << " s, "
+            << std::setprecision(0) << lookups / sw.elapsed_seconds() << " lookups/s\n";
+  for (int i = 0; i < cache.num_shards(); ++i) {
+    Cache::ShardStats stats = cache.shard_stats(i);
+    std::cout << "  shard " << std::setw(3) << i
+              << "  hits " << std::setw(10) << stats.hits
+              << "  misses " << std::setw(8) << stats.misses
+              << "  evictions " << std::setw(8) << stats.evictions
+              << "  bytes " << stats.size << "\n";
+  }
+}
+
+// ---------------------------------------------------------------------------
+//                         Eviction policy comparison
+// ---------------------------------------------------------------------------
+
+// One lookup, in the format written by Cache::start_trace().
+struct TraceRecord {
+  uint64 id;
+  size_t size;
+  double cost;
+};
+
+std::vector<TraceRecord> read_trace(std::string const& filename) {
+  std::ifstream in(filename.c_str());
+  if (!in.is_open())
+    vw_throw( IOErr() << "Unable to open trace file \"" << filename << "\"." );
+  std::vector<TraceRecord> trace;
+  TraceRecord record;
+  int hit;
+  while (in >> record.id >> record.size >> record.cost >> hit)
+    trace.push_back(record);
+  return trace;
+}
+
+// A stereo-like pattern: a sliding window of expensive correlation
+// tiles that are each revisited several times, interleaved with a
+// sequential read of cheap image blocks that are never reused.
+std::vector<TraceRecord> stereo_workload(int num_lookups, size_t block_size) {
+  std::vector<TraceRecord> trace;
+  uint64 next_scan_id = 1000000;
+  unsigned state = 1;
+  for (int i = 0; trace.size() < size_t(num_lookups); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      state = state * 1103515245 + 12345;
+      TraceRecord tile = { uint64(i/16 + (state >> 8) % 32), block_size, 200e-6 };
+      trace.push_back(tile);
+    }
+    for (int j = 0; j < 4; ++j) {
+      TraceRecord block = { next_scan_id++, block_size, 10e-6 };
+      trace.push_back(block);
+    }
+  }
+  trace.resize(num_lookups);
+  return trace;
+}
+
+// A mosaic-like pattern: a skewed working set of source tiles that
+// are composited into many output tiles, with an occasional full
+// sweep over a large set of cheap tiles (e.g. computing a preview).
+std::vector<TraceRecord> mosaic_workload(int num_lookups, size_t block_size) {
+  std::vector<TraceRecord> trace;
+  unsigned state = 7;
+  uint64 next_sweep_id = 1000000;
+  while (trace.size() < size_t(num_lookups)) {
+    for (int j = 0; j < 1000; ++j) {
+      state = state * 1103515245 + 12345;
+      unsigned r = (state >> 8) % 1024;
+      TraceRecord tile = { uint64(r * r / 4096), block_size, 100e-6 };
+      trace.push_back(tile);
+    }
+    for (int j = 0; j < 500; ++j) {
+      TraceRecord tile = { next_sweep_id++, block_size, 20e-6 };
+      trace.push_back(tile);
+    }
+  }
+  trace.resize(num_lookups);
+  return trace;
+}
+
+// Generates a block of bytes after spinning for the recorded cost,
+// and accumulates the (unscaled) cost of every regeneration.
+class SpinGenerator {
+  size_t m_size;
+  double m_cost, m_time_scale;
+  double *m_total_cost;
+public:
+  typedef std::vector<uint8> value_type;
+  SpinGenerator(size_t size, double cost, double time_scale, double *total_cost) :
+    m_size(size), m_cost(cost), m_time_scale(time_scale), m_total_cost(total_cost) {}
+  size_t size() const { return m_size; }
+  boost::shared_ptr<value_type> generate() const {
+    unsigned long long end = Stopwatch::microtime() + (unsigned long long)(m_cost * m_time_scale * 1e6);
+    while (Stopwatch::microtime() < end) {}
+    *m_total_cost += m_cost;
+    return boost::shared_ptr<value_type>( new value_type(m_size) );
+  }
+};
+
+void replay(std::string const& name, std::vector<TraceRecord> const& trace,
+            size_t cache_size, double time_scale) {
+  static const CachePolicy policies[] = { LRU_CACHE_POLICY, SCAN_RESISTANT_CACHE_POLICY,
+                                          COST_WEIGHTED_CACHE_POLICY };
+  static const char* policy_names[] = { "lru", "scan-resistant", "cost-weighted" };
+
+  std::cout << name << ": " << trace.size() << " lookups, "
+            << cache_size << " byte cache\n";
+  for (int p = 0; p < 3; ++p) {
+    Cache cache(cache_size, 1, policies[p]);
+    double total_cost = 0;
+    std::map<uint64, Cache::Handle<SpinGenerator> > handles;
+    for (size_t i = 0; i < trace.size(); ++i)
+      if (handles.find(trace[i].id) == handles.end())
+        handles[trace[i].id] = cache.insert( SpinGenerator(trace[i].size, trace[i].cost,
+                                                           time_scale, &total_cost) );
+
+    Stopwatch sw;
+    sw.start();
+    for (size_t i = 0; i < trace.size(); ++i)
+      boost::shared_ptr<SpinGenerator::value_type> block = handles[trace[i].id];
+    sw.stop();
+
+    std::cout << "  " << std::setw(16) << std::left << policy_names[p] << std::right
+              << "  hit rate " << std::fixed << std::setprecision(3)
+              << double(cache.hits()) / trace.size()
+              << "  misses " << std::setw(8) << cache.misses()
+              << "  regeneration " << std::setprecision(3) << total_cost << " s"
+              << "  elapsed " << sw.elapsed_seconds() << " s\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  int num_threads, num_blocks, num_lookups, num_shards;
+  size_t block_size, cache_size;
+  std::string trace_file;
+  double time_scale;
+
+  po::options_description general_options("Cache Performance Test Program");
+  general_options.add_options()
+    ("threads,t", po::value<int>(&num_threads)->default_value(vw_settings().default_num_threads()), "Number of reader threads")
+    ("blocks,b", po::value<int>(&num_blocks)->default_value(256), "Number of distinct cache lines")
+    ("block-size", po::value<size_t>(&block_size)->default_value(64*1024), "Size of each cache line in bytes")
+    ("cache-size", po::value<size_t>(&cache_size)->default_value(128*64*1024), "Cache size in bytes for --shards runs")
+    ("lookups,n", po::value<int>(&num_lookups)->default_value(200000), "Lookups per thread")
+    ("shards,s", po::value<int>(&num_shards)->default_value(0), "Also run against a private cache with this many shards")
+    ("policies", "Compare eviction policies on synthetic workloads")
+    ("trace", po::value<std::string>(&trace_file), "Compare eviction policies on a recorded cache trace")
+    ("time-scale", po::value<double>(&time_scale)->default_value(1.0), "Scale factor for generation times in policy comparisons")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  if( vm.count("trace") ) {
+    replay(trace_file, read_trace(trace_file), cache_size, time_scale);
+    return 0;
+  }
+
+  if( vm.count("policies") ) {
+    replay("stereo", stereo_workload(num_lookups / 10, block_size), cache_size, time_scale);
+    replay("mosaic", mosaic_workload(num_lookups / 10, block_size), cache_size, time_scale);
+    return 0;
+  }
+
+  run("vw_system_cache", vw_system_cache(), num_threads, num_blocks, block_size, num_lookups);
+
+  if (num_shards > 0) {
+    Cache single(cache_size, 1);
+    run("single shard", single, num_threads, num_blocks, block_size, num_lookups);
+    Cache sharded(cache_size, num_shards);
+    run("sharded", sharded, num_threads, num_blocks, block_size, num_lookups);
+  }
+
+  return 0;
+}
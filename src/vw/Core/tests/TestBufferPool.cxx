@@ -0,0 +1,186 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <gtest/gtest.h>
+
+#include <vw/Core/BufferPool.h>
+#include <vw/Core/Thread.h>
+
+#include <cstring>
+#include <vector>
+
+using namespace vw;
+
+TEST( BufferPool, Alignment ) {
+  size_t sizes[] = { 0, 1, 63, 64, 65, 1000, 4096, 123457, 5000000 };
+  for( size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i ) {
+    char *buffer = static_cast<char*>( allocate_buffer( sizes[i] ) );
+    ASSERT_TRUE( buffer != 0 );
+    EXPECT_EQ( 0u, size_t(buffer) % buffer_alignment ) << sizes[i];
+    memset( buffer, 0xff, sizes[i] );
+    free_buffer( buffer );
+  }
+  free_buffer( 0 );
+}
+
+TEST( BufferPool, Reuse ) {
+  release_buffer_pool();
+  BufferPoolStats before = buffer_pool_stats();
+
+  // A freed buffer goes to this thread's pool, and comes back for the
+  // next buffer of the same size class.
+  void *a = allocate_buffer( 100000 );
+  free_buffer( a );
+  void *b = allocate_buffer( 99000 );
+  EXPECT_EQ( a, b );
+
+  BufferPoolStats during = buffer_pool_stats();
+  EXPECT_EQ( before.allocations + 2, during.allocations );
+  EXPECT_EQ( before.pool_hits + 1, during.pool_hits );
+  EXPECT_GE( during.live_bytes, before.live_bytes + 99000 );
+  EXPECT_LE( during.live_bytes, before.live_bytes + 130000 );
+  EXPECT_GE( during.peak_system_bytes, during.system_bytes );
+
+  free_buffer( b );
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+  EXPECT_GT( after.pooled_bytes, before.pooled_bytes );
+
+  release_buffer_pool();
+  after = buffer_pool_stats();
+  EXPECT_EQ( 0u, after.pooled_bytes );
+  EXPECT_EQ( before.system_bytes, after.system_bytes );
+}
+
+TEST( BufferPool, Limit ) {
+  release_buffer_pool();
+  set_buffer_pool_limit( 0 );
+  void *a = allocate_buffer( 1000 );
+  free_buffer( a );
+  EXPECT_EQ( 0u, buffer_pool_stats().pooled_bytes );
+
+  // Buffers bigger than a quarter of the limit are not pooled either.
+  set_buffer_pool_limit( 1000000 );
+  a = allocate_buffer( 300000 );
+  free_buffer( a );
+  EXPECT_EQ( 0u, buffer_pool_stats().pooled_bytes );
+  a = allocate_buffer( 200000 );
+  free_buffer( a );
+  EXPECT_LT( 0u, buffer_pool_stats().pooled_bytes );
+
+  set_buffer_pool_limit( 64*1024*1024 );
+  release_buffer_pool();
+}
+
+TEST( BufferPool, HugePages ) {
+  BufferPoolStats before = buffer_pool_stats();
+  set_buffer_huge_pages( true, 1024*1024 );
+  char *buffer = static_cast<char*>( allocate_buffer( 4*1024*1024 ) );
+  EXPECT_EQ( 0u, size_t(buffer) % buffer_alignment );
+  memset( buffer, 1, 4*1024*1024 );
+  free_buffer( buffer );
+  set_buffer_huge_pages( false );
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+  EXPECT_EQ( before.system_bytes, after.system_bytes );
+  EXPECT_GE( after.peak_system_bytes, before.system_bytes + 4*1024*1024 );
+}
+
+class FreeBufferTask {
+  void *m_buffer;
+  uint64 *m_pooled_bytes;
+public:
+  FreeBufferTask( void *buffer, uint64 *pooled_bytes = 0 ) : m_buffer(buffer), m_pooled_bytes(pooled_bytes) {}
+  void operator()() {
+    free_buffer( m_buffer );
+    if( m_pooled_bytes ) *m_pooled_bytes = buffer_pool_stats().pooled_bytes;
+  }
+};
+
+TEST( BufferPool, OtherThread ) {
+  // A buffer freed by another thread goes to that thread's pool,
+  // which is emptied when the thread exits.
+  BufferPoolStats before = buffer_pool_stats();
+  void *a = allocate_buffer( 50000 );
+  {
+    FreeBufferTask task( a );
+    Thread thread( task );
+    thread.join();
+  }
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+  EXPECT_EQ( before.pooled_bytes, after.pooled_bytes );
+  EXPECT_EQ( before.system_bytes, after.system_bytes );
+}
+
+TEST( BufferPool, TotalLimit ) {
+  // Once the pools together hold the total limit, freed buffers go
+  // back to the system, whichever thread frees them.
+  release_buffer_pool();
+  BufferPoolStats before = buffer_pool_stats();
+  set_buffer_pool_total_limit( before.pooled_bytes + 150000 );
+  void *a = allocate_buffer( 100000 ), *b = allocate_buffer( 100000 ), *c = allocate_buffer( 100000 );
+  free_buffer( a );
+  uint64 pooled = buffer_pool_stats().pooled_bytes;
+  EXPECT_LT( before.pooled_bytes, pooled );
+  free_buffer( b );
+  EXPECT_EQ( pooled, buffer_pool_stats().pooled_bytes );
+
+  uint64 thread_pooled = 0;
+  {
+    FreeBufferTask task( c, &thread_pooled );
+    Thread thread( task );
+    thread.join();
+  }
+  EXPECT_EQ( pooled, thread_pooled );
+
+  set_buffer_pool_total_limit( 256*1024*1024 );
+  release_buffer_pool();
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.pooled_bytes, after.pooled_bytes );
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+}
+
+class ChurnTask {
+  int m_seed;
+public:
+  ChurnTask( int seed ) : m_seed(seed) {}
+  void operator()() {
+    std::vector<void*> buffers;
+    for( int i = 0; i < 2000; ++i ) {
+      buffers.push_back( allocate_buffer( 1000 * ((i * m_seed) % 97 + 1) ) );
+      if( i % 3 == 2 ) {
+        for( size_t j = 0; j < buffers.size(); ++j )
+          free_buffer( buffers[j] );
+        buffers.clear();
+      }
+    }
+    for( size_t j = 0; j < buffers.size(); ++j )
+      free_buffer( buffers[j] );
+    EXPECT_GE( 400000u, buffer_pool_stats().pooled_bytes );
+  }
+};
+
+TEST( BufferPool, ManyThreads ) {
+  // Threads that allocate and free at once keep within the total
+  // limit between them, and account for every buffer.
+  release_buffer_pool();
+  BufferPoolStats before = buffer_pool_stats();
+  set_buffer_pool_total_limit( before.pooled_bytes + 400000 );
+  {
+    ChurnTask task1( 3 ), task2( 5 ), task3( 7 ), task4( 11 );
+    Thread thread1( task1 ), thread2( task2 ), thread3( task3 ), thread4( task4 );
+    thread1.join(); thread2.join(); thread3.join(); thread4.join();
+  }
+  set_buffer_pool_total_limit( 256*1024*1024 );
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+  EXPECT_EQ( before.pooled_bytes, after.pooled_bytes );
+  EXPECT_EQ( before.system_bytes, after.system_bytes );
+  EXPECT_EQ( before.allocations + 4*2000, after.allocations );
+  EXPECT_LT( before.pool_hits, after.pool_hits );
+}
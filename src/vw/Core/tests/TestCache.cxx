@@ -6,6 +6,8 @@
 
 
 #include <memory>
+#include <fstream>
+#include <cstdio>
 #include <gtest/gtest.h>
 
 #include <vw/Core/Cache.h>
@@ -223,3 +225,204 @@ TEST(Cache, Stats) {
   EXPECT_EQ(0, cache.misses());
   EXPECT_EQ(0, cache.evictions());
 }
+
+TEST(Cache, ShardedBudget) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+  const int dimension = 16, block_size = dimension*dimension;
+
+  // Room for 6 blocks, spread across 4 shards
+  vw::Cache cache(6*block_size, 4);
+  ASSERT_EQ(4, cache.num_shards());
+
+  std::vector<handle_t> h;
+  for (int i = 0; i < 20; ++i)
+    h.push_back(cache.insert(BlockGenerator(dimension, i)));
+
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < 20; ++i) {
+      EXPECT_EQ(i, *h[i]);
+      EXPECT_LE(cache.size(), cache.max_size());
+    }
+  }
+
+  // The most recently used block is always valid
+  EXPECT_TRUE(h[19].valid());
+
+  int valid = 0;
+  for (int i = 0; i < 20; ++i)
+    valid += h[i].valid();
+  EXPECT_EQ(6, valid);
+
+  // Per-shard statistics add up to the totals
+  uint64 hits = 0, misses = 0, evictions = 0;
+  size_t size = 0;
+  for (int i = 0; i < cache.num_shards(); ++i) {
+    Cache::ShardStats stats = cache.shard_stats(i);
+    hits += stats.hits;
+    misses += stats.misses;
+    evictions += stats.evictions;
+    size += stats.size;
+  }
+  EXPECT_EQ(cache.hits(), hits);
+  EXPECT_EQ(cache.misses(), misses);
+  EXPECT_EQ(cache.evictions(), evictions);
+  EXPECT_EQ(cache.size(), size);
+  EXPECT_EQ(40u, cache.hits() + cache.misses());
+  EXPECT_EQ(cache.misses(), cache.evictions() + 6);
+
+  cache.resize(2*block_size);
+  EXPECT_LE(cache.size(), cache.max_size());
+}
+
+// Reads random blocks from a shared set of handles and checks their
+// contents.
+class CacheReader {
+  std::vector<Cache::Handle<BlockGenerator> > &m_handles;
+  int m_seed, &m_errors;
+public:
+  CacheReader(std::vector<Cache::Handle<BlockGenerator> >& handles, int seed, int& errors) :
+    m_handles(handles), m_seed(seed), m_errors(errors) {}
+  void operator()() {
+    unsigned state = m_seed;
+    for (int i = 0; i < 5000; ++i) {
+      state = state * 1103515245 + 12345;
+      int index = (state >> 8) % m_handles.size();
+      boost::shared_ptr<vw::uint8> block = m_handles[index];
+      if (*block != index)
+        m_errors++;
+    }
+  }
+};
+
+TEST(Cache, ShardedThreads) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+  const int dimension = 8;
+
+  vw::Cache cache(10*dimension*dimension, 4);
+  std::vector<handle_t> h;
+  for (int i = 0; i < 32; ++i)
+    h.push_back(cache.insert(BlockGenerator(dimension, i)));
+
+  int errors[4] = {0, 0, 0, 0};
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for (int i = 0; i < 4; ++i)
+    threads.push_back(boost::shared_ptr<Thread>(new Thread(CacheReader(h, i, errors[i]))));
+  for (int i = 0; i < 4; ++i)
+    threads[i]->join();
+
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(0, errors[i]);
+  EXPECT_EQ(20000u, cache.hits() + cache.misses());
+  EXPECT_LE(cache.size(), cache.max_size());
+}
+
+// Warms up a hot set, then reads it between long sequential scans.
+// Returns the number of hot set lookups that hit during the final pass.
+static int hot_set_hits_after_scan(vw::CachePolicy policy) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+  const int dimension = 4, num_hot = 4, cache_blocks = 10;
+
+  vw::Cache cache(cache_blocks*dimension*dimension, 1, policy);
+  std::vector<handle_t> hot, scan;
+  for (int i = 0; i < num_hot; ++i)
+    hot.push_back(cache.insert(BlockGenerator(dimension, i)));
+  for (int i = 0; i < 110; ++i)
+    scan.push_back(cache.insert(BlockGenerator(dimension, i)));
+
+  // Read the hot set, push it out with a short scan, and come back for
+  // it soon afterwards.  Then run a long scan.
+  for (int i = 0; i < num_hot; ++i) EXPECT_EQ(i, *hot[i]);
+  for (int i = 0; i < cache_blocks; ++i) EXPECT_EQ(i, *scan[i]);
+  for (int i = 0; i < num_hot; ++i) EXPECT_EQ(i, *hot[i]);
+  for (int i = cache_blocks; i < 110; ++i) EXPECT_EQ(i, *scan[i]);
+  EXPECT_LE(cache.size(), cache.max_size());
+
+  cache.clear_stats();
+  for (int i = 0; i < num_hot; ++i) EXPECT_EQ(i, *hot[i]);
+  return int(cache.hits());
+}
+
+TEST(Cache, ScanResistantPolicy) {
+  EXPECT_EQ(0, hot_set_hits_after_scan(LRU_CACHE_POLICY));
+  EXPECT_EQ(4, hot_set_hits_after_scan(SCAN_RESISTANT_CACHE_POLICY));
+}
+
+// A BlockGenerator that takes a while to generate its block.
+class SlowBlockGenerator : public BlockGenerator {
+public:
+  SlowBlockGenerator(int dimension, vw::uint8 fill_value = 0) :
+    BlockGenerator(dimension, fill_value) {}
+  boost::shared_ptr< value_type > generate() const {
+    Thread::sleep_ms(20);
+    return BlockGenerator::generate();
+  }
+};
+
+TEST(Cache, CostWeightedPolicy) {
+  const int dimension = 4;
+  for (int p = 0; p < 2; ++p) {
+    vw::CachePolicy policy = p ? COST_WEIGHTED_CACHE_POLICY : LRU_CACHE_POLICY;
+    vw::Cache cache(4*dimension*dimension, 1, policy);
+    EXPECT_EQ(policy, cache.policy());
+
+    Cache::Handle<SlowBlockGenerator> slow = cache.insert(SlowBlockGenerator(dimension, 100));
+    std::vector<Cache::Handle<BlockGenerator> > cheap;
+    for (int i = 0; i < 20; ++i)
+      cheap.push_back(cache.insert(BlockGenerator(dimension, i)));
+
+    EXPECT_EQ(100, *slow);
+    for (int i = 0; i < 20; ++i)
+      EXPECT_EQ(i, *cheap[i]);
+    EXPECT_LE(cache.size(), cache.max_size());
+
+    // Only the cost-weighted policy keeps the expensive line around.
+    EXPECT_EQ(policy == COST_WEIGHTED_CACHE_POLICY, slow.valid());
+    EXPECT_TRUE(cheap[19].valid());
+  }
+}
+
+TEST(Cache, SetPolicy) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+  const int dimension = 4;
+  vw::Cache cache(4*dimension*dimension, 1, SCAN_RESISTANT_CACHE_POLICY);
+  std::vector<handle_t> h;
+  for (int i = 0; i < 8; ++i)
+    h.push_back(cache.insert(BlockGenerator(dimension, i)));
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(i, *h[i]);
+
+  // Switching policies keeps what is cached, and then behaves as LRU.
+  cache.set_policy(LRU_CACHE_POLICY);
+  EXPECT_EQ(LRU_CACHE_POLICY, cache.policy());
+  for (int i = 0; i < 4; ++i)
+    EXPECT_TRUE(h[i].valid());
+  EXPECT_EQ(0, *h[0]);
+  for (int i = 4; i < 7; ++i)
+    EXPECT_EQ(i, *h[i]);
+  EXPECT_TRUE(h[0].valid());
+  EXPECT_FALSE(h[1].valid());
+}
+
+TEST(Cache, Trace) {
+  vw::Cache cache(1024);
+  Cache::Handle<BlockGenerator> h = cache.insert(BlockGenerator(4, 7));
+  std::string filename = "TestCache-trace.txt";
+  cache.start_trace(filename);
+  EXPECT_EQ(7, *h);
+  EXPECT_EQ(7, *h);
+  cache.stop_trace();
+  EXPECT_EQ(7, *h);
+
+  std::ifstream in(filename.c_str());
+  uint64 id; size_t size; double cost; int hit;
+  ASSERT_TRUE(in >> id >> size >> cost >> hit);
+  EXPECT_EQ(16u, size);
+  EXPECT_EQ(0, hit);
+  uint64 id2;
+  ASSERT_TRUE(in >> id2 >> size >> cost >> hit);
+  EXPECT_EQ(id, id2);
+  EXPECT_EQ(1, hit);
+  EXPECT_FALSE(in >> id2);
+  in.close();
+  std::remove(filename.c_str());
+}
@@ -28,6 +28,7 @@ TEST(Settings, HAS_CONFIG_FILE(VWrc)) {
       nonexistent_entry = 1               \n\
       default_num_threads = 20            \n\
       system_cache_size = 623             \n\
+      system_cache_policy = scan_resistant\n\
       # Comment                           \n\
                                           \n\
       [logfile console]                   \n\
@@ -51,12 +52,17 @@ TEST(Settings, HAS_CONFIG_FILE(VWrc)) {
   vw_settings().set_rc_filename(file);
   EXPECT_EQ( 20, vw_settings().default_num_threads() );
   EXPECT_EQ( 623u, vw_settings().system_cache_size() );
+  EXPECT_EQ( SCAN_RESISTANT_CACHE_POLICY, vw_settings().system_cache_policy() );
+  EXPECT_EQ( SCAN_RESISTANT_CACHE_POLICY, vw_system_cache().policy() );
 
   // Test to make sure that the API overrides the contents of vwrc
   vw_settings().set_default_num_threads(5);
   vw_settings().set_system_cache_size(223);
+  vw_settings().set_system_cache_policy(LRU_CACHE_POLICY);
   EXPECT_EQ( 5, vw_settings().default_num_threads() );
   EXPECT_EQ( 223u, vw_settings().system_cache_size() );
+  EXPECT_EQ( LRU_CACHE_POLICY, vw_settings().system_cache_policy() );
+  EXPECT_EQ( LRU_CACHE_POLICY, vw_system_cache().policy() );
 }
 
 TEST(Settings, Override) {
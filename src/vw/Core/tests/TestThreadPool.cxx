@@ -212,3 +212,171 @@ TEST(ThreadPool, OrderedWorkQueue) {
 
   queue.join_all();
 }
+
+class CountTask : public Task {
+  Mutex &m_mutex;
+  int &m_count;
+public:
+  CountTask(Mutex& mutex, int& count) : m_mutex(mutex), m_count(count) {}
+  void operator()() {
+    Mutex::Lock lock(m_mutex);
+    m_count++;
+  }
+};
+
+// Adds a nested group of CountTasks from inside a pool worker.
+class NestedTask : public Task {
+  WorkStealingPool &m_pool;
+  Mutex &m_mutex;
+  int &m_count;
+  int m_depth;
+public:
+  NestedTask(WorkStealingPool& pool, Mutex& mutex, int& count, int depth) :
+    m_pool(pool), m_mutex(mutex), m_count(count), m_depth(depth) {}
+  void operator()() {
+    TaskGroup group(m_pool);
+    for (int i = 0; i < 4; ++i) {
+      if (m_depth > 0)
+        group.add_task( boost::shared_ptr<Task>( new NestedTask(m_pool, m_mutex, m_count, m_depth-1) ) );
+      else
+        group.add_task( boost::shared_ptr<Task>( new CountTask(m_mutex, m_count) ) );
+    }
+    group.join();
+  }
+};
+
+class ThrowTask : public Task {
+public:
+  void operator()() { vw_throw( IOErr() << "ThrowTask" ); }
+};
+
+// Joins a nested group whose only task throws.
+class NestedThrowTask : public Task {
+  WorkStealingPool &m_pool;
+public:
+  NestedThrowTask(WorkStealingPool& pool) : m_pool(pool) {}
+  void operator()() {
+    TaskGroup group(m_pool);
+    group.add_task( boost::shared_ptr<Task>( new ThrowTask ) );
+    group.join();
+  }
+};
+
+TEST(ThreadPool, TaskGroup) {
+  WorkStealingPool pool(4);
+  Mutex mutex;
+  int count = 0;
+
+  std::vector<boost::shared_ptr<Task> > tasks;
+  TaskGroup group(pool);
+  for (int i = 0; i < 1000; ++i) {
+    tasks.push_back( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+    group.add_task( tasks.back() );
+  }
+  group.join();
+
+  EXPECT_EQ( 0, group.size() );
+  EXPECT_EQ( 1000, count );
+  for (size_t i = 0; i < tasks.size(); ++i)
+    EXPECT_TRUE( tasks[i]->is_finished() );
+}
+
+TEST(ThreadPool, NestedTaskGroups) {
+  // A single worker must be able to run a deeply nested set of
+  // groups, since joining a group runs queued tasks.
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    WorkStealingPool pool(threads);
+    Mutex mutex;
+    int count = 0;
+    {
+      TaskGroup group(pool);
+      group.add_task( boost::shared_ptr<Task>( new NestedTask(pool, mutex, count, 3) ) );
+      group.join();
+    }
+    EXPECT_EQ( 256, count );
+  }
+}
+
+TEST(ThreadPool, TaskGroupError) {
+  // The error reaches join() with its type intact, whether the task
+  // ran on a worker or on the joining thread, and the other tasks
+  // still run.
+  for (int threads = 1; threads <= 4; threads *= 2) {
+    WorkStealingPool pool(threads);
+    Mutex mutex;
+    int count = 0;
+
+    TaskGroup group(pool);
+    for (int i = 0; i < 100; ++i) {
+      if (i % 10 == 5)
+        group.add_task( boost::shared_ptr<Task>( new ThrowTask ) );
+      group.add_task( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+    }
+    EXPECT_THROW( group.join(), IOErr );
+    EXPECT_EQ( 0, group.size() );
+    EXPECT_EQ( 100, count );
+
+    // The error is reported once; the group can then be reused.
+    group.add_task( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+    EXPECT_NO_THROW( group.join() );
+    EXPECT_EQ( 101, count );
+  }
+}
+
+TEST(ThreadPool, NestedTaskGroupError) {
+  // An error in a nested group propagates out through the outer one.
+  WorkStealingPool pool(2);
+  TaskGroup outer(pool);
+  outer.add_task( boost::shared_ptr<Task>( new NestedThrowTask(pool) ) );
+  EXPECT_THROW( outer.join(), IOErr );
+}
+
+TEST(ThreadPool, WorkQueueError) {
+  // A failing task must not take down the queue's worker, and its
+  // error reaches join_all() with its type intact.
+  Mutex mutex;
+  int count = 0;
+  FifoWorkQueue queue(2);
+  for (int i = 0; i < 10; ++i) {
+    queue.add_task( boost::shared_ptr<Task>( new ThrowTask ) );
+    queue.add_task( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+  }
+  EXPECT_THROW( queue.join_all(), IOErr );
+  EXPECT_EQ( 10, count );
+
+  // The error is reported once.
+  queue.add_task( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+  EXPECT_NO_THROW( queue.join_all() );
+  EXPECT_EQ( 11, count );
+
+  // An unfinished error is dropped by the destructor, not thrown.
+  {
+    FifoWorkQueue dropped(1);
+    dropped.add_task( boost::shared_ptr<Task>( new ThrowTask ) );
+  }
+}
+
+TEST(ThreadPool, BlockingTasksGetThreads) {
+  // Three blocking tasks on a one-thread pool must all run at once.
+  WorkStealingPool pool(1);
+  boost::shared_ptr<TestTask> task1 (new TestTask);
+  boost::shared_ptr<TestTask> task2 (new TestTask);
+  boost::shared_ptr<TestTask> task3 (new TestTask);
+  pool.add_blocking_task(task1);
+  pool.add_blocking_task(task2);
+  pool.add_blocking_task(task3);
+
+  Thread::sleep_ms(100);
+  EXPECT_EQ( 1, task1->value() );
+  EXPECT_EQ( 1, task2->value() );
+  EXPECT_EQ( 1, task3->value() );
+  EXPECT_EQ( 3, pool.num_spawned_threads() );
+
+  task1->kill();
+  task2->kill();
+  task3->kill();
+  task1->join();
+  task2->join();
+  task3->join();
+  EXPECT_EQ( 3, task3->value() );
+}
@@ -0,0 +1,136 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file threadpool_perftest.cc
+///
+/// Measures task dispatch throughput of the WorkQueue classes and of
+/// TaskGroups running directly on the work stealing pool.  Use a
+/// small --work value to measure scheduling overhead and a large one
+/// to check that the pool scales.
+///
+#include <vw/Core/ThreadPool.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+// A task that spins for a fixed number of iterations.
+class SpinTask : public Task {
+  int m_work;
+  double m_result;
+public:
+  SpinTask(int work) : m_work(work), m_result(0) {}
+  virtual void operator()() {
+    double x = 0;
+    for (int i = 0; i < m_work; ++i)
+      x += 1.0 / (i + 1);
+    m_result = x;
+  }
+};
+
+// A task that recursively splits itself into two nested subtasks
+// until it reaches a leaf, the way a quadtree or tile split would.
+class SplitTask : public Task {
+  WorkStealingPool &m_pool;
+  int m_num_leaves, m_work;
+public:
+  SplitTask(WorkStealingPool& pool, int num_leaves, int work) :
+    m_pool(pool), m_num_leaves(num_leaves), m_work(work) {}
+  virtual void operator()() {
+    if (m_num_leaves <= 1) {
+      SpinTask leaf(m_work);
+      leaf();
+      return;
+    }
+    TaskGroup group(m_pool);
+    group.add_task( boost::shared_ptr<Task>( new SplitTask(m_pool, m_num_leaves / 2, m_work) ) );
+    group.add_task( boost::shared_ptr<Task>( new SplitTask(m_pool, m_num_leaves - m_num_leaves / 2, m_work) ) );
+    group.join();
+  }
+};
+
+static void report(std::string const& name, int num_tasks, Stopwatch const& sw) {
+  double seconds = sw.elapsed_seconds();
+  std::cout << std::setw(24) << std::left << name
+            << std::setw(10) << std::right << std::fixed << std::setprecision(3) << seconds << " s  "
+            << std::setw(14) << std::setprecision(0) << num_tasks / seconds << " tasks/s\n";
+}
+
+int main(int argc, char** argv) {
+  int num_tasks, num_threads, work;
+
+  po::options_description general_options("Thread Pool Performance Test Program");
+  general_options.add_options()
+    ("tasks,n", po::value<int>(&num_tasks)->default_value(200000), "Number of tasks to dispatch")
+    ("threads,t", po::value<int>(&num_threads)->default_value(vw_settings().default_num_threads()), "Number of worker threads")
+    ("work,w", po::value<int>(&work)->default_value(100), "Inner loop iterations per task")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  std::cout << "Dispatching " << num_tasks << " tasks of " << work
+            << " iterations on " << num_threads << " threads\n\n";
+
+  WorkStealingPool pool(num_threads);
+
+  {
+    Stopwatch sw;
+    sw.start();
+    FifoWorkQueue queue(num_threads, pool);
+    for (int i = 0; i < num_tasks; ++i)
+      queue.add_task( boost::shared_ptr<Task>( new SpinTask(work) ) );
+    queue.join_all();
+    sw.stop();
+    report("FifoWorkQueue", num_tasks, sw);
+  }
+
+  {
+    Stopwatch sw;
+    sw.start();
+    OrderedWorkQueue queue(num_threads, pool);
+    for (int i = 0; i < num_tasks; ++i)
+      queue.add_task( boost::shared_ptr<Task>( new SpinTask(work) ), i );
+    queue.join_all();
+    sw.stop();
+    report("OrderedWorkQueue", num_tasks, sw);
+  }
+
+  {
+    Stopwatch sw;
+    sw.start();
+    TaskGroup group(pool);
+    for (int i = 0; i < num_tasks; ++i)
+      group.add_task( boost::shared_ptr<Task>( new SpinTask(work) ) );
+    group.join();
+    sw.stop();
+    report("TaskGroup (flat)", num_tasks, sw);
+  }
+
+  {
+    Stopwatch sw;
+    sw.start();
+    TaskGroup group(pool);
+    group.add_task( boost::shared_ptr<Task>( new SplitTask(pool, num_tasks, work) ) );
+    group.join();
+    sw.stop();
+    report("TaskGroup (nested)", num_tasks, sw);
+  }
+
+  return 0;
+}
@@ -22,6 +22,7 @@
 #ifdef VW_HAVE_PKG_GDAL
 
 #include <vw/FileIO/DiskImageResourceGDAL.h>
+#include <vw/FileIO/DiskImageResource_internal.h>
 
 // GDAL Headers
 #include "gdal.h"
@@ -36,9 +37,12 @@
 #include <vw/Core/Exception.h>
 #include <vw/Core/Cache.h>
 #include <vw/Core/Thread.h>
+#include <vw/Core/Settings.h>
 #include <vw/Image/PixelTypes.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem/convenience.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
 namespace fs = boost::filesystem;
 
 static void CPL_STDCALL gdal_error_handler(CPLErr eErrClass, int nError, const char *pszErrorMsg) {
@@ -68,20 +72,28 @@ static void CPL_STDCALL gdal_error_handler(CPLErr eErrClass, int nError, const c
 
 // GDAL is not thread-safe, so we keep a global GDAL lock (pointed to
 // by gdal_mutex_ptr, below) that we hold anytime we call into the
-// GDAL library itself.  Note that the mutex, along with the GDAL
-// dataset cache, is created by the init_gdal function, so you need to
-// make sure that gdal_init_once.run(init_gdal) has been called prior
-// to anything else.
+// GDAL library itself.  The one exception is reading pixels: GDAL
+// allows separate datasets to be read by separate threads, so each
+// resource opened for reading keeps a pool of its own read-only
+// datasets (see GdalDatasetPool, below), and reads through them
+// without the lock.  Opening and closing those datasets still takes
+// it.  Note that the mutex, along with the GDAL dataset cache, is
+// created by the init_gdal function, so you need to make sure that
+// gdal_init_once.run(init_gdal) has been called prior to anything
+// else.
 
 // This cache of GDAL file handles allows up to 200 files to be open
-// at a time.
+// at a time.  The read pools of all resources together keep at most
+// another 64 idle datasets open between reads.
 namespace {
   vw::RunOnce gdal_init_once = VW_RUNONCE_INIT;
   vw::Cache *gdal_cache_ptr = 0;
   vw::Mutex *gdal_mutex_ptr = 0;
+  vw::internal::IdleHandleLimit *gdal_idle_limit_ptr = 0;
   void init_gdal() {
     gdal_cache_ptr = new vw::Cache( 200 );
     gdal_mutex_ptr = new vw::Mutex();
+    gdal_idle_limit_ptr = new vw::internal::IdleHandleLimit( 64 );
 
     // Override GDAL's error handler so it doesn't print to stderr.
     CPLSetErrorHandler(gdal_error_handler);
@@ -95,6 +107,7 @@ void vw::UnloadGDAL() {
   if( gdal_cache_ptr || gdal_mutex_ptr ) {
     delete gdal_cache_ptr;
     delete gdal_mutex_ptr;
+    delete gdal_idle_limit_ptr;
     GDALDumpOpenDatasets( stderr );
     GDALDestroyDriverManager();
     CPLDumpSharedList( NULL );
@@ -264,8 +277,65 @@ namespace vw {
     return boost::shared_ptr<GDALDataset>(dataset, GdalCloseDatasetDeleter());
   }
 
+  /// \cond INTERNAL
+  // Opens and closes the read-only datasets in a resource's read pool.
+  // A GDAL dataset may only be used by one thread at a time, but
+  // separate datasets can be read at once, so each read borrows a
+  // dataset of its own.  Opening and closing take the global GDAL lock.
+  struct GdalReadPolicy {
+    typedef GDALDataset handle_type;
+    static GDALDataset* open( std::string const& filename ) {
+      Mutex::Lock lock(*gdal_mutex_ptr);
+      GDALDataset *dataset = (GDALDataset*) GDALOpen( filename.c_str(), GA_ReadOnly );
+      if ( !dataset )
+        vw_throw(IOErr() << "DiskImageResourceGDAL: Could not open \"" << filename << "\"");
+      return dataset;
+    }
+    static void close( GDALDataset *dataset ) {
+      Mutex::Lock lock(*gdal_mutex_ptr);
+      GDALClose( dataset );
+    }
+  };
+
+  // A resource's pool of read-only datasets.
+  class GdalDatasetPool : public internal::ReadHandlePool<GdalReadPolicy> {
+  public:
+    GdalDatasetPool( std::string const& filename, size_t max_idle )
+      : internal::ReadHandlePool<GdalReadPolicy>( filename, max_idle, *gdal_idle_limit_ptr ) {}
+  };
+
+  // Reads a region of a dataset into a buffer in the dataset's own
+  // format, expanding palette indices into RGBA.
+  static void read_dataset( GDALDataset *dataset, ImageBuffer const& dest, BBox2i const& bbox,
+                            int32 channels, std::vector<PixelRGBA<uint8> > const& palette ) {
+    if( palette.empty() ) {
+      GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(dest.format.channel_type);
+      for ( int32 p = 0; p < dest.format.planes; ++p ) {
+        for ( int32 c = 0; c < channels; ++c ) {
+          // Only one of channels or planes will be greater than one.
+          GDALRasterBand  *band = dataset->GetRasterBand(c+p+1);
+          band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                          (uint8*)dest(0,0,p) + channel_size(dest.format.channel_type)*c,
+                          dest.format.cols, dest.format.rows, gdal_pix_fmt, dest.cstride, dest.rstride );
+        }
+      }
+    }
+    else { // palette conversion
+      GDALRasterBand  *band = dataset->GetRasterBand(1);
+      std::vector<uint8> index_data( bbox.width() * bbox.height() );
+      band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
+                      &index_data[0], bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
+      PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) dest.data;
+      for( int i=0; i<bbox.width()*bbox.height(); ++i )
+        rgba_data[i] = palette[index_data[i]];
+    }
+  }
+  /// \endcond
+
   DiskImageResourceGDAL::~DiskImageResourceGDAL() {
     flush();
+    // The pool takes the global lock itself to close its datasets.
+    m_read_pool.reset();
     // Ensure that the read dataset gets destroyed while we're holding
     // the global lock.  (In the unlikely event that the user has
     // retained a reference to it, it's alredy their responsibility to
@@ -314,6 +384,10 @@ namespace vw {
     // needs to be closed due to too many open files.
     m_dataset_cache_handle = gdal_cache().insert(GdalDatasetGenerator(filename));
 
+    // Reads go through their own datasets, keeping about as many open
+    // as there are threads to read them.
+    m_read_pool.reset( new GdalDatasetPool( filename, vw_settings().default_num_threads() ) );
+
     boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
     if( dataset == NULL ) {
       vw_throw( IOErr() << "DiskImageResourceGDAL: Failed to read " << filename << "." );
@@ -500,6 +574,10 @@ namespace vw {
     GDALSetCacheMax(size);
   }
 
+  int DiskImageResourceGDAL::gdal_cache_size() {
+    return GDALGetCacheMax();
+  }
+
   /// Read the disk image into the given buffer.
   void DiskImageResourceGDAL::read( ImageBuffer const& dest, BBox2i const& bbox ) const
   {
@@ -511,41 +589,24 @@ namespace vw {
     src_fmt.rows = bbox.height();
 
     ImageBuffer src(src_fmt, 0);
-    src.data = new uint8[src.pstride * src.format.planes];
+    boost::scoped_array<uint8> src_data( new uint8[src.pstride * src.format.planes] );
+    src.data = src_data.get();
 
-    {
+    if ( m_write_dataset_ptr || !m_read_pool ) {
+      // Reading back a file being written goes through its one
+      // dataset, under the global lock.
       Mutex::Lock lock(*gdal_mutex_ptr);
-
       boost::shared_ptr<GDALDataset> dataset = get_dataset_ptr();
       if (!dataset)
         vw_throw( LogicErr() << "DiskImageResourceGDAL::read() Could not read file. No file has been opened." );
-
-      if( m_palette.empty() ) {
-        for ( int32 p = 0; p < planes(); ++p ) {
-          for ( int32 c = 0; c < channels(); ++c ) {
-            // Only one of channels() or planes() will be nonzero.
-            GDALRasterBand  *band = dataset->GetRasterBand(c+p+1);
-            GDALDataType gdal_pix_fmt = vw_channel_id_to_gdal_pix_fmt::value(channel_type());
-            band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                            (uint8*)src(0,0,p) + channel_size(src.format.channel_type)*c,
-                            src.format.cols, src.format.rows, gdal_pix_fmt, src.cstride, src.rstride );
-          }
-        }
-      }
-      else { // palette conversion
-        GDALRasterBand  *band = dataset->GetRasterBand(1);
-        uint8 *index_data = new uint8[bbox.width() * bbox.height()];
-        band->RasterIO( GF_Read, bbox.min().x(), bbox.min().y(), bbox.width(), bbox.height(),
-                        index_data, bbox.width(), bbox.height(), GDT_Byte, 1, bbox.width() );
-        PixelRGBA<uint8> *rgba_data = (PixelRGBA<uint8>*) src.data;
-        for( int i=0; i<bbox.width()*bbox.height(); ++i )
-          rgba_data[i] = m_palette[index_data[i]];
-        delete [] index_data;
-      }
+      read_dataset( dataset.get(), src, bbox, channels(), m_palette );
+    }
+    else {
+      GdalDatasetPool::Handle dataset( *m_read_pool );
+      read_dataset( dataset.get(), src, bbox, channels(), m_palette );
     }
 
     convert( dest, src, m_rescale );
-    delete [] reinterpret_cast<uint8*>(src.data);
   }
 
 
@@ -593,6 +654,12 @@ namespace vw {
     return m_blocksize;
   }
 
+  bool DiskImageResourceGDAL::has_random_block_write() const {
+    if (!m_write_dataset_ptr) return false;
+    Mutex::Lock lock(*gdal_mutex_ptr);
+    return m_write_dataset_ptr->GetDriver() == GetGDALDriverManager()->GetDriverByName("GTiff");
+  }
+
   void DiskImageResourceGDAL::flush() {
     if (m_write_dataset_ptr) {
       Mutex::Lock lock(*gdal_mutex_ptr);
@@ -62,6 +62,10 @@ namespace vw {
     boost::shared_ptr<GDALDataset> generate() const;
   };
 
+  // GdalDatasetPool keeps a set of independent read-only GDAL Datasets
+  // for one file, so that several threads can read it at once.
+  class GdalDatasetPool;
+
 
   class DiskImageResourceGDAL : public DiskImageResource {
   public:
@@ -96,16 +100,24 @@ namespace vw {
     /// Returns the type of disk image resource.
     static std::string type_static() { return "GDAL"; }
     static void set_gdal_cache_size(int size);  // Set GDAL cache size in bytes
+    static int gdal_cache_size();                // Get GDAL cache size in bytes
 
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
 
+    /// Reads may be made from several threads at once.  Each one
+    /// borrows its own read-only dataset from a pool, so reads of a
+    /// file opened for reading do not wait on each other, or on the
+    /// global GDAL lock except to open a new dataset.
     virtual void read( ImageBuffer const& dest, BBox2i const& bbox ) const;
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
     virtual Vector2i block_size() const;
     virtual void set_block_size(Vector2i const&);
 
+    /// GeoTIFF files can be written one block at a time in any order.
+    virtual bool has_random_block_write() const;
+
     virtual void flush();
 
     // Ask GDAL if it's compiled with support for this file
@@ -149,7 +161,8 @@ namespace vw {
     // you use them you must be sure to acquire the global GDAL lock
     // (accessed via the global_lock() function) for the duration of
     // your use, up to and including the release of your shared
-    // pointer to the dataset.
+    // pointer to the dataset.  The dataset returned is never one of
+    // those used by read().
     boost::shared_ptr<GDALDataset> get_dataset_ptr() const;
     char **get_metadata() const;
 
@@ -168,6 +181,7 @@ namespace vw {
     Vector2i m_blocksize;
     Options m_options;
     Cache::Handle<GdalDatasetGenerator> m_dataset_cache_handle;
+    boost::shared_ptr<GdalDatasetPool> m_read_pool;
   };
 
   void UnloadGDAL();
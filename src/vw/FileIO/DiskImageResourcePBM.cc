@@ -19,6 +19,7 @@
 #include <vector>
 #include <fstream>
 #include <cstdio>
+#include <algorithm>
 
 #include <boost/scoped_array.hpp>
 #include <boost/algorithm/string.hpp>
@@ -27,6 +28,7 @@ using namespace boost;
 #include <vw/Core/Exception.h>
 #include <vw/Core/Debugging.h>
 #include <vw/FileIO/DiskImageResourcePBM.h>
+#include <vw/FileIO/DiskImageResource_internal.h>
 
 using namespace vw;
 using std::fstream;
@@ -49,9 +51,9 @@ void skip_any_comments( std::istream& f ) {
 }
 
 // Used to normalize an array of uint8s
-void normalize( scoped_array<uint8>& data, uint32 count, uint8 max_value ) {
-  uint8* pointer = data.get();
-  for ( uint32 i = 0; i < count; i++ ) {
+void normalize( uint8* data, size_t count, uint8 max_value ) {
+  uint8* pointer = data;
+  for ( size_t i = 0; i < count; i++ ) {
     if ( *pointer > max_value )
       *pointer = 255;
     else {
@@ -64,6 +66,9 @@ void normalize( scoped_array<uint8>& data, uint32 count, uint8 max_value ) {
 
 static bool default_ascii = false;
 
+// The size in bytes of the bands of rows that binary files are read in.
+static const size_t block_bytes = 1024*1024;
+
 } // end anonymous
 
 void DiskImageResourcePBM::default_to_ascii(bool ascii) {
@@ -138,50 +143,71 @@ void DiskImageResourcePBM::open( std::string const& filename ) {
   } else
     vw_throw( IOErr() << "DiskImageResourcePBM: how'd you get here? Invalid magic number." );
 
+  m_file.reset( new internal::MappedFile( filename ) );
+  m_block_rows = m_format.rows;
+  if ( m_magic == "P5" || m_magic == "P6" ) {
+    size_t row_bytes = size_t(m_format.cols) * num_channels(m_format.pixel_format);
+    if ( row_bytes > 0 )
+      m_block_rows = std::max( 1, std::min( m_format.rows, int32( block_bytes / row_bytes ) ) );
+  }
+}
+
+Vector2i DiskImageResourcePBM::block_size() const {
+  return Vector2i( cols(), m_block_rows );
 }
 
-// Read the disk image into the given buffer.
+// Read the disk image into the given buffer.  Binary data is used in
+// place in the mapped file, reading only the rows in the bounding box.
 void DiskImageResourcePBM::read( ImageBuffer const& dest, BBox2i const& bbox )  const {
 
-  VW_ASSERT( bbox.width()==int(cols()) && bbox.height()==int(rows()),
-             NoImplErr() << "DiskImageResourcePBM does not support partial reads." );
-  VW_ASSERT( dest.format.cols==cols() && dest.format.rows==rows(),
+  VW_ASSERT( dest.format.cols==bbox.width() && dest.format.rows==bbox.height(),
              IOErr() << "Buffer has wrong dimensions in PBM read." );
-
-  ifstream input(m_filename.c_str(), fstream::in|fstream::binary);
-
-  if (!input.is_open())
-    vw_throw( IOErr() << "DiskImageResourcePBM: Failed to open \""
-              << m_filename << "\"." );
-  input.seekg(m_image_data_position);
-
-  // Reading image data
-  ImageBuffer src(m_format, 0);
-  size_t data_size = src.pstride * src.format.planes;
-  scoped_array<uint8> image_data(new uint8[data_size]);
+  VW_ASSERT( BBox2i(0,0,cols(),rows()).contains(bbox),
+             ArgumentErr() << "DiskImageResourcePBM: Bounding box " << bbox << " is outside the image." );
 
   // TODO: P4 is broken; binary bool is packed, and we're not doing that yet
   if ( m_magic == "P4" )
     vw_throw( NoImplErr() << "P4 (PBM Binary) is not currently implemented" );
 
+  ImageBuffer src(m_format, 0);
+  std::vector<uint8> image_data, scratch;
+
   if ( m_magic == "P1" || m_magic == "P2" || m_magic == "P3" ) {
-    // Bool/Grey/RGB (respectively) stored as ASCII
+    // Bool/Grey/RGB (respectively) stored as ASCII, which has to be
+    // parsed from the start.
+    ifstream input(m_filename.c_str(), fstream::in|fstream::binary);
+
+    if (!input.is_open())
+      vw_throw( IOErr() << "DiskImageResourcePBM: Failed to open \""
+                << m_filename << "\"." );
+    input.seekg(m_image_data_position);
+
+    image_data.resize( src.pstride * src.format.planes );
     uint32 buf;
-    for ( size_t i = 0; i < data_size; ++i ) {
+    for ( size_t i = 0; i < image_data.size(); ++i ) {
       input >> buf;
       image_data[i] = buf;
     }
-  } else if ( m_magic == "P4" || m_magic == "P5" || m_magic == "P6" ) {
-    // Bool/Grey/RGB (respectively) stored as Binary
-    input.read( reinterpret_cast<char*>(image_data.get()), data_size );
+    if ( m_magic != "P1" )
+      normalize( &image_data[0], image_data.size(), m_max_value );
+    src.data = &image_data[0] + bbox.min().y()*src.rstride + bbox.min().x()*src.cstride;
+  } else if ( m_magic == "P5" || m_magic == "P6" ) {
+    // Grey/RGB (respectively) stored as Binary
+    size_t size = size_t(bbox.height()) * src.rstride;
+    uint8 const* data = m_file->region( std::streamoff(m_image_data_position) + uint64(bbox.min().y())*src.rstride,
+                                        size, scratch );
+    if ( m_max_value != 255 ) {
+      image_data.assign( data, data + size );
+      normalize( &image_data[0], size, m_max_value );
+      data = &image_data[0];
+    }
+    src.data = (uint8*)data + bbox.min().x()*src.cstride;
   } else {
     vw_throw( NoImplErr() << "Unknown input channel type." );
   }
 
-  if ( m_magic != "P1" && m_magic != "P4" )
-    normalize( image_data, data_size, m_max_value );
-
-  src.data = image_data.get();
+  src.format.cols = bbox.width();
+  src.format.rows = bbox.height();
   convert( dest, src, m_rescale );
 }
 
@@ -260,6 +286,10 @@ void DiskImageResourcePBM::create( std::string const& filename,
     output << m_max_value << "\n";
 
   m_image_data_position = output.tellp();
+
+  // The image is written all at once.
+  m_file.reset( new internal::MappedFile( filename ) );
+  m_block_rows = m_format.rows;
 }
 
 // Write the given buffer into the disk image.
@@ -13,6 +13,8 @@
 /// PBM - Monochrome - P1 (means in ASCII) - P4 (means in Binary)
 /// PGM - Grayscale  - P2 (ASCII) - P5 (Binary)
 /// PPM - RGB Color  - P3 (ASCII) - P5 (Binary)
+///
+/// Binary files are memory mapped and read a band of rows at a time.
 #ifndef __VW_FILEIO_DISKIMAGERESOURCEPBM_H__
 #define __VW_FILEIO_DISKIMAGERESOURCEPBM_H__
 
@@ -24,6 +26,10 @@
 
 namespace vw {
 
+  namespace internal {
+    class MappedFile;
+  }
+
   class DiskImageResourcePBM : public DiskImageResource {
   public:
 
@@ -42,6 +48,9 @@ namespace vw {
     // Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
 
+    // Binary files are read in bands of rows; ASCII files all at once.
+    virtual Vector2i block_size() const;
+
     virtual void read(ImageBuffer const& buf, BBox2i const& bbox ) const;
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
     virtual void flush() {}
@@ -63,6 +72,8 @@ namespace vw {
     std::streampos m_image_data_position;
     std::string m_magic;
     int32 m_max_value;
+    boost::shared_ptr<internal::MappedFile> m_file;
+    int32 m_block_rows;
   };
 
 } // namespace VW
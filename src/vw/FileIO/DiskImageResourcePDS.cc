@@ -16,7 +16,8 @@
 #include <vector>
 #include <string>
 
-#include <cstring> // For memset()
+#include <cstring> // For memset() and memcpy()
+#include <algorithm>
 
 #include <boost/algorithm/string.hpp>
 using namespace boost;
@@ -24,6 +25,11 @@ using namespace boost;
 #include <vw/Core/Exception.h>
 #include <vw/Core/Debugging.h>
 #include <vw/FileIO/DiskImageResourcePDS.h>
+#include <vw/FileIO/DiskImageResource_internal.h>
+
+// The size in bytes of the bands of rows that we report as our block
+// size, so that a DiskImageView caches only the rows it touches.
+static const size_t pds_block_bytes = 1024*1024;
 
 
 static bool cpu_is_big_endian() {
@@ -34,6 +40,21 @@ static bool cpu_is_big_endian() {
 #endif
 }
 
+// Copies count pixels of pixel_bytes each between strided buffers,
+// reversing the bytes of each two-byte sample if swap is set.
+static void copy_pixels( vw::uint8 const* src, ptrdiff_t src_stride, vw::uint8 *dst, ptrdiff_t dst_stride,
+                         vw::int32 count, vw::int32 pixel_bytes, bool swap ) {
+  for( vw::int32 i = 0; i < count; ++i, src += src_stride, dst += dst_stride ) {
+    if( swap ) {
+      for( vw::int32 b = 0; b < pixel_bytes; b += 2 ) {
+        dst[b] = src[b+1];
+        dst[b+1] = src[b];
+      }
+    }
+    else std::memcpy( dst, src, pixel_bytes );
+  }
+}
+
 void vw::DiskImageResourcePDS::treat_invalid_data_as_alpha() {
   // We currently only support this feature under very specific circumstances
   std::string format_str, sample_bits_str, valid_minimum_str;
@@ -233,6 +254,30 @@ void vw::DiskImageResourcePDS::open( std::string const& filename ) {
   // Match buffer format to band storage type
   m_format.pixel_format = planes_to_pixel_format(m_format.planes);
   if (m_format.pixel_format != VW_PIXEL_SCALAR) m_format.planes = 1;
+
+  // Some PDS files have the actual data in a seperate file that is
+  // pointed to by the PDS image header.  The filename encoded in the
+  // ^IMAGE tag seems to sometimes differ in case from the actual data
+  // file, so we try a few different combinations here.
+  if( m_pds_data_filename.empty() )
+    m_pds_data_filename = DiskImageResource::m_filename;
+  std::string candidates[] = { m_pds_data_filename,
+                               boost::to_lower_copy(m_pds_data_filename),
+                               boost::to_upper_copy(m_pds_data_filename) };
+  for( int c = 0; c < 3; ++c ) {
+    if( std::ifstream( candidates[c].c_str() ).is_open() ) {
+      m_pds_data_filename = candidates[c];
+      break;
+    }
+  }
+  m_data_file.reset( new internal::MappedFile( m_pds_data_filename ) );
+
+  m_block_rows = m_format.rows;
+  if( m_format.channel_type != VW_CHANNEL_UNKNOWN ) {
+    size_t row_bytes = size_t(m_format.cols) * num_channels(m_format.pixel_format) * channel_size(m_format.channel_type);
+    if( row_bytes > 0 )
+      m_block_rows = std::max( 1, std::min( m_format.rows, int32( pds_block_bytes / row_bytes ) ) );
+  }
   
   vw_out(DebugMessage, "fileio")
     << "Opening PDS Image\n"
@@ -247,94 +292,93 @@ void vw::DiskImageResourcePDS::create( std::string const& /*filename*/,
   vw_throw( NoImplErr() << "The PDS driver does not yet support creation of PDS files." );
 }
 
-/// Read the disk image into the given buffer.
+vw::Vector2i vw::DiskImageResourcePDS::block_size() const {
+  return Vector2i( cols(), m_block_rows );
+}
+
+/// Read the disk image into the given buffer.  The pixels are used in
+/// place in the mapped file when they are already interleaved and in
+/// native byte order; otherwise just the requested window is gathered
+/// into a temporary buffer first.
 void vw::DiskImageResourcePDS::read( ImageBuffer const& dest, BBox2i const& bbox ) const 
 {
-  VW_ASSERT( bbox.width()==int(cols()) && bbox.height()==int(rows()),
-             NoImplErr() << "DiskImageResourcePDS does not support partial reads." );
-  VW_ASSERT( dest.format.cols==cols() && dest.format.rows==rows(),
+  VW_ASSERT( dest.format.cols==bbox.width() && dest.format.rows==bbox.height(),
              IOErr() << "Buffer has wrong dimensions in PDS read." );
-  
-  // Re-open the file, and shift the file offset to the position of
-  // the first image byte (as indicated by the PDS header).  Some PDS
-  // files will have the actual data in a seperate file that is
-  // pointed to by the PDS image header, so we may actually be opening
-  // that file here instead of the original file that the user
-  // specified.  
-  //
-  // NOTE: The filename encoded in the ^IMAGE tag seems to sometimes
-  // differ in case from the actual data file, so we try a few
-  // different combinations here.  
-  std::ifstream image_file(m_pds_data_filename.c_str(), std::ios::in | std::ios::binary);
-  if (image_file.bad()) {
-    image_file.open(boost::to_lower_copy(m_pds_data_filename).c_str(), std::ios::in | std::ios::binary);
-    if (image_file.bad()) {
-      image_file.open(boost::to_upper_copy(m_pds_data_filename).c_str(), std::ios::in | std::ios::binary); 
-      if (image_file.bad()) {
-        vw_throw( vw::ArgumentErr() << "DiskImageResourcePDS: Failed to open \""
-                  << DiskImageResource::m_filename << "\"." );
-      } 
-    }
-  }
-  image_file.seekg(m_image_data_offset, std::ios::beg);
-
-  // Grab the pixel data from the file.
-  unsigned total_pixels = (unsigned)( m_format.cols * m_format.rows * m_format.planes );
-  unsigned bytes_per_pixel = 1;
-  if ( m_format.channel_type == VW_CHANNEL_UINT16 ||
-       m_format.channel_type == VW_CHANNEL_INT16 ) {
-    bytes_per_pixel = 2;
-  }
-  else if ( ! ( m_format.channel_type == VW_CHANNEL_UINT8 ||
-                m_format.channel_type == VW_CHANNEL_INT8 ) ) {
+  VW_ASSERT( BBox2i(0,0,cols(),rows()).contains(bbox),
+             ArgumentErr() << "DiskImageResourcePDS: Bounding box " << bbox << " is outside the image." );
+
+  if ( ! ( m_format.channel_type == VW_CHANNEL_UINT8  || m_format.channel_type == VW_CHANNEL_INT8 ||
+           m_format.channel_type == VW_CHANNEL_UINT16 || m_format.channel_type == VW_CHANNEL_INT16 ) ) {
     vw_throw( IOErr() << "DiskImageResourcePDS: Unsupported channel type (" << m_format.channel_type << ")." );
   }
-  bytes_per_pixel *= num_channels(m_format.pixel_format);
-  uint8* image_data = new uint8[total_pixels * bytes_per_pixel];
-  image_file.read((char*)image_data, bytes_per_pixel*total_pixels);
-    
-  if (image_file.bad())
-    vw_throw(IOErr() << "DiskImageResourcePDS: an unrecoverable error occured while reading the image data.");
+  int32 sample_bytes = channel_size(m_format.channel_type);
+  int32 channels = num_channels(m_format.pixel_format);
+  int32 pixel_bytes = sample_bytes * channels;
 
   // Convert the endian-ness of the data if the architecture of the
   // machine and the endianness of the file do not match.
-  if (m_format.channel_type == VW_CHANNEL_INT16 ||
-      m_format.channel_type == VW_CHANNEL_UINT16) {
-    if ((cpu_is_big_endian() && !m_file_is_msb_first) || 
-        (!cpu_is_big_endian() && m_file_is_msb_first) ) {
-      for ( unsigned i=0; i<total_pixels*bytes_per_pixel; i+=2 ) {
-        uint8 temp = image_data[i+1];
-        image_data[i+1] = image_data[i];
-        image_data[i] = temp;
+  bool swap = ( sample_bytes == 2 ) && ( cpu_is_big_endian() != m_file_is_msb_first );
+
+  // The data is stored in bands of whole rows: one per channel for band
+  // sequential images, one per plane for multi-plane images, or else a
+  // single band of interleaved pixels.
+  bool band_sequential = ( m_band_storage == BAND_SEQUENTIAL && m_format.pixel_format != VW_PIXEL_SCALAR );
+  int32 bands = band_sequential ? channels : m_format.planes;
+  int32 band_pixel_bytes = band_sequential ? sample_bytes : pixel_bytes;
+  uint64 band_row_bytes = uint64(cols()) * band_pixel_bytes;
+  uint64 band_bytes = band_row_bytes * rows();
+
+  // Pixels that can't be used in place are gathered here, interleaved
+  // and in native byte order.
+  bool in_place = !swap && !band_sequential;
+  std::vector<uint8> window, scratch;
+  if( !in_place )
+    window.resize( size_t(bbox.width()) * bbox.height() * m_format.planes * pixel_bytes );
+
+  ImageBuffer src;
+  src.format = m_format;
+  src.format.cols = bbox.width();
+  src.format.rows = bbox.height();
+
+  for( int32 b = 0; b < bands; ++b ) {
+    uint8 const* band_data = m_data_file->region( m_image_data_offset + b*band_bytes + bbox.min().y()*band_row_bytes,
+                                                  size_t(bbox.height()) * band_row_bytes, scratch );
+    band_data += bbox.min().x() * band_pixel_bytes;
+
+    if( in_place ) {
+      // Convert each plane straight out of the file.
+      src.data = (void*)band_data;
+      src.format.planes = 1;
+      src.cstride = pixel_bytes;
+      src.rstride = band_row_bytes;
+      src.pstride = band_bytes;
+      ImageBuffer dest_plane = dest;
+      dest_plane.data = (uint8*)dest.data + b*dest.pstride;
+      dest_plane.format.planes = 1;
+      convert( dest_plane, src, m_rescale );
+    }
+    else {
+      // Band sequential channels go to their place in each pixel;
+      // planes go one after another.
+      uint8 *out = &window[0];
+      ptrdiff_t out_stride = pixel_bytes;
+      if( band_sequential ) out += b * sample_bytes;
+      else out += b * size_t(bbox.width()) * bbox.height() * pixel_bytes;
+      for( int32 y = 0; y < bbox.height(); ++y ) {
+        copy_pixels( band_data + y*band_row_bytes, band_pixel_bytes, out + size_t(y)*bbox.width()*out_stride,
+                     out_stride, bbox.width(), band_pixel_bytes, swap );
       }
     }
   }
 
-  // For band sequential images, we must copy the data over into
-  // interleaved format.
-  if ( m_band_storage == BAND_SEQUENTIAL && m_format.pixel_format != VW_PIXEL_SCALAR) {
-    uint8* intermediate_data = new uint8[total_pixels * bytes_per_pixel];
-    int n_channels = num_channels(m_format.pixel_format);
-    int n_pixels = m_format.cols * m_format.rows;
-    for (int n = 0; n < n_channels; ++n) {
-      for (int p = 0; p < n_pixels; ++p) {
-        intermediate_data[n_channels*p+n] = image_data[n_pixels*n+p];
-      }
-    }
-    // Swap over to the new image buffer
-    uint8* temporary_ptr = image_data;
-    image_data = intermediate_data;
-    delete[] temporary_ptr;
+  if( !in_place ) {
+    src.data = &window[0];
+    src.format.planes = m_format.planes;
+    src.cstride = pixel_bytes;
+    src.rstride = pixel_bytes * bbox.width();
+    src.pstride = src.rstride * bbox.height();
+    convert( dest, src, m_rescale );
   }
-  
-  // set up an image buffer around the PDS data.
-  ImageBuffer src;
-  src.data = image_data;
-  src.format = m_format;
-  src.cstride = bytes_per_pixel;
-  src.rstride = bytes_per_pixel * m_format.cols;
-  src.pstride = bytes_per_pixel * m_format.cols * m_format.rows;
-  convert( dest, src, m_rescale );
 
   if ( m_invalid_as_alpha ) {
     // We checked earlier that the source format is as we 
@@ -346,13 +390,15 @@ void vw::DiskImageResourcePDS::read( ImageBuffer const& dest, BBox2i const& bbox
       std::string valid_minimum_str;
       if ( query( "VALID_MINIMUM", valid_minimum_str ) ) {
         int16 valid_minimum = atoi(valid_minimum_str.c_str());
-        uint8* src_row = (uint8*)src.data;
+        uint8 const* src_row = (uint8 const*)src.data;
         uint8* dst_row = (uint8*)dest.data;
-        for( int32 y=0; y<m_format.rows; ++y ) {
-          uint8* src_data = src_row;
+        for( int32 y=0; y<bbox.height(); ++y ) {
+          uint8 const* src_data = src_row;
           uint8* dst_data = dst_row;
-          for( int32 x=0; x<m_format.cols; ++x ) {
-            if( *((int16*)src_data) < valid_minimum ) {
+          for( int32 x=0; x<bbox.width(); ++x ) {
+            int16 value;
+            std::memcpy( &value, src_data, sizeof(value) );
+            if( value < valid_minimum ) {
               std::memset( dst_data, 0, dst_bpp );
             }
             src_data += src.cstride;
@@ -364,9 +410,6 @@ void vw::DiskImageResourcePDS::read( ImageBuffer const& dest, BBox2i const& bbox
       }
     }
   }
-
-  delete[] image_data;
-  image_file.close();
 }
 
 // Write the given buffer into the disk image.
@@ -10,17 +10,25 @@
 /// Provides support for some NASA mission data from the Planetary
 /// Data System (PDS).
 ///
+/// The image data is memory mapped, and reads copy out only the
+/// requested window, so the block size is a band of whole rows.
+///
 #ifndef __VW_FILEIO_DISKIMAGERESOUCEPDS_H__
 #define __VW_FILEIO_DISKIMAGERESOUCEPDS_H__
 
 #include <map>
 #include <string>
 #include <fstream>
+#include <boost/shared_ptr.hpp>
 
 #include <vw/FileIO/DiskImageResource.h>
 
 namespace vw {
 
+  namespace internal {
+    class MappedFile;
+  }
+
   class DiskImageResourcePDS : public DiskImageResource {
   public:
 
@@ -48,6 +56,8 @@ namespace vw {
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
     
+    virtual Vector2i block_size() const;
+
     virtual void read( ImageBuffer const& dest, BBox2i const& bbox ) const;
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
     virtual void flush() {}
@@ -130,6 +140,8 @@ namespace vw {
     bool m_invalid_as_alpha;
     bool m_file_is_msb_first;
     std::string m_pds_data_filename;
+    boost::shared_ptr<internal::MappedFile> m_data_file;
+    int32 m_block_rows;
     enum { BAND_SEQUENTIAL, SAMPLE_INTERLEAVED, LINE_INTERLEAVED } m_band_storage;
   };
 
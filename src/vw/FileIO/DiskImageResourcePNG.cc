@@ -276,7 +276,8 @@ struct DiskImageResourcePNG::vw_png_read_context:
     cstride = bytes_per_channel * channels;
     scanline = boost::shared_array<uint8>(new uint8[cstride * cols]);
 
-    png_start_read_image(ctx.ptr);
+    // png_read_update_info() has already started the read; newer
+    // versions of libpng reject a second start with png_start_read_image().
   }
 
   void readline()
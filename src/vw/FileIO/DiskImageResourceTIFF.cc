@@ -17,12 +17,20 @@
 #endif
 
 #include <vector>
+#include <cstdlib>
 
 #include <tiffio.h>
 
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
+
 #include <vw/Core/Exception.h>
 #include <vw/Core/Debugging.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Thread.h>
 #include <vw/FileIO/DiskImageResourceTIFF.h>
+#include <vw/FileIO/DiskImageResource_internal.h>
 
 #ifndef VW_ERROR_BUFFER_SIZE
 #define VW_ERROR_BUFFER_SIZE 2048
@@ -32,28 +40,62 @@
 #define snprintf _snprintf
 #endif
 
+// The read pools of all TIFF resources together keep at most 64 idle
+// handles open between reads.
+namespace {
+  vw::RunOnce tiff_idle_once = VW_RUNONCE_INIT;
+  vw::internal::IdleHandleLimit *tiff_idle_limit_ptr = 0;
+  void init_tiff_idle() {
+    tiff_idle_limit_ptr = new vw::internal::IdleHandleLimit( 64 );
+  }
+
+  struct TiffReadPolicy {
+    typedef TIFF handle_type;
+    static TIFF* open( std::string const& filename ) {
+      TIFF *handle = TIFFOpen( filename.c_str(), "r" );
+      if( !handle ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to open \"" << filename << "\" for reading!" );
+      return handle;
+    }
+    static void close( TIFF *handle ) { TIFFClose( handle ); }
+  };
+  typedef vw::internal::ReadHandlePool<TiffReadPolicy> TiffReadPool;
+}
+
 namespace vw {
-  class DiskImageResourceInfoTIFF {
+
+  // The layout of the file and the libTIFF handles that read and
+  // write it.  Reads borrow a handle from a pool of open ones, so that
+  // several threads can decode blocks at once; a libTIFF handle holds
+  // its own decoder state and must not be shared between threads.
+  // Each pool keeps up to one idle handle per thread.
+  class DiskImageResourceInfoTIFF : private boost::noncopyable {
+    Mutex m_mutex;
+
   public:
-    TIFF *tif;
-    Vector2i block_size;
-    std::string filename;
-    int current_line;
-    bool striped;
+    TIFF *tif;              // The handle being written, if any
+    boost::scoped_ptr<TiffReadPool> read_pool;
+    Vector2i block_size;    // Tile size, or image width by rows per strip
+    bool tiled;
+    uint16 config, bpsample, nsamples, photometric;
+    int32 block_bytes;      // Bytes in one decoded tile or strip
+    std::vector<uint16> red_table, green_table, blue_table;
+
+    DiskImageResourceInfoTIFF()
+      : tif(0), block_size(), tiled(false), config(0), bpsample(0), nsamples(0), photometric(0), block_bytes(0) {}
 
-    DiskImageResourceInfoTIFF() : tif(0), block_size(), current_line(0) {}
     ~DiskImageResourceInfoTIFF() {
       close();
     }
 
-    void reopen_read() {
-      close();
-      tif = TIFFOpen(filename.c_str(), "r");
-      if( !tif ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to open \"" << filename << "\" for reading!" );
-      current_line = 0;
+    // Sets up the read pool for the named file.
+    void set_filename( std::string const& filename ) {
+      tiff_idle_once.run( init_tiff_idle );
+      read_pool.reset( new TiffReadPool( filename, vw_settings().default_num_threads(), *tiff_idle_limit_ptr ) );
     }
 
+    // Finishes the file being written, if any, so that it can be read.
     void close() {
+      Mutex::Lock lock(m_mutex);
       if( tif ) {
         TIFFClose(tif);
         tif=NULL;
@@ -80,14 +122,44 @@ static void tiff_warning_handler(const char* module, const char* frmt, va_list a
 */
 
 // Handle libTIFF error conditions by writing the error and hope the calling
-// program checks the return value for the function
-static char tiff_error_msg[VW_ERROR_BUFFER_SIZE];
+// program checks the return value for the function.  The handler is global,
+// but libTIFF calls it on the thread that hit the error, so each thread
+// keeps its own last message.
+static boost::thread_specific_ptr<std::string> tiff_error_msg_ptr;
 static void tiff_error_handler(const char* module, const char* frmt, va_list ap) {
   char msg[VW_ERROR_BUFFER_SIZE];
   vsnprintf( msg, VW_ERROR_BUFFER_SIZE, frmt, ap );
-  snprintf( tiff_error_msg, VW_ERROR_BUFFER_SIZE, 
-    "DiskImageResourceTIFF (%s) Error: %s",
-    (module?module:"none"), msg );
+  if( !tiff_error_msg_ptr.get() ) tiff_error_msg_ptr.reset( new std::string() );
+  *tiff_error_msg_ptr = std::string( "DiskImageResourceTIFF (" ) + (module?module:"none") + ") Error: " + msg;
+}
+
+
+// Maps the COMPRESS creation option to a libTIFF compression scheme.
+static vw::uint16 tiff_compression( std::string const& name ) {
+  if( name == "NONE" ) return COMPRESSION_NONE;
+  if( name == "LZW" ) return COMPRESSION_LZW;
+  if( name == "DEFLATE" ) return COMPRESSION_ADOBE_DEFLATE;
+  if( name == "PACKBITS" ) return COMPRESSION_PACKBITS;
+  vw_throw( vw::ArgumentErr() << "DiskImageResourceTIFF: Unsupported compression \"" << name << "\"." );
+  return COMPRESSION_NONE; // never reached
+}
+
+// Decodes one tile or strip.
+static int read_block( TIFF *tif, bool tiled, vw::uint32 block_id, void *buf ) {
+  if( tiled ) return TIFFReadEncodedTile( tif, block_id, buf, (tsize_t) -1 );
+  return TIFFReadEncodedStrip( tif, block_id, buf, (tsize_t) -1 );
+}
+
+// Copies one separately stored sample of a block into its place among
+// the interleaved samples, over a window of the block.
+template <class T>
+static void interleave_sample( void const* plane_buf, void *buf, int block_cols, int nsamples, int sample,
+                               int left, int top, int right, int bottom ) {
+  for( int y=top; y<bottom; ++y ) {
+    for( int x=left; x<right; ++x ) {
+      ((T*)buf)[(y*block_cols+x)*nsamples+sample] = ((T const*)plane_buf)[y*block_cols+x];
+    }
+  }
 }
 
 
@@ -107,20 +179,36 @@ vw::DiskImageResourceTIFF::DiskImageResourceTIFF( std::string const& filename,
   create( filename, format );
 }
 
+vw::DiskImageResourceTIFF::DiskImageResourceTIFF( std::string const& filename,
+                                                  vw::ImageFormat const& format,
+                                                  Vector2i block_size,
+                                                  Options const& options )
+  : DiskImageResource( filename ), m_info( new DiskImageResourceInfoTIFF() ),
+    m_use_compression( false )
+{
+  create( filename, format, block_size, options );
+}
+
 vw::Vector2i vw::DiskImageResourceTIFF::block_size() const {
   return m_info->block_size;
 }
 
+bool vw::DiskImageResourceTIFF::has_random_block_write() const {
+  return m_info->tif && m_info->tiled;
+}
+
 /// Bind the resource to a file for reading.  Confirm that we can open
 /// the file and that it has a sane pixel format.  
 void vw::DiskImageResourceTIFF::open( std::string const& filename ) {
-  m_info->filename = filename;
-
   TIFFSetWarningHandler( &tiff_warning_handler );
   TIFFSetErrorHandler( &tiff_error_handler );
 
-  TIFF* tif = TIFFOpen( filename.c_str(), "r" );
-  if( !tif ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to open \"" << filename << "\" for reading!" );
+  // The handle goes back to the pool afterward, even if the file turns
+  // out to be unreadable, and is kept for the first read if the pools
+  // have room for it.
+  m_info->set_filename( filename );
+  TiffReadPool::Handle handle( *m_info->read_pool );
+  TIFF* tif = handle.get();
 
   // Read into temp variables first to ensure we are using the right integer type.
   // Otherwise we can run into endianness problems.
@@ -198,57 +286,115 @@ void vw::DiskImageResourceTIFF::open( std::string const& filename ) {
     default: m_format.pixel_format = VW_PIXEL_SCALAR; break;
     }
   }
-  
-  if( TIFFIsTiled(tif) ) {
+
+  // Record the layout, so that reads needn't look it up again.
+  m_info->tiled = TIFFIsTiled(tif);
+  m_info->config = plane_configuration;
+  m_info->bpsample = bits_per_sample;
+  m_info->nsamples = planes_tmp;
+  m_info->photometric = photometric;
+  if( m_info->tiled ) {
     uint32 tile_width, tile_length;
     check_retval(TIFFGetField( tif, TIFFTAG_TILEWIDTH, &tile_width ), 0);
     check_retval(TIFFGetField( tif, TIFFTAG_TILELENGTH, &tile_length ), 0);
     m_info->block_size = Vector2i(tile_width,tile_length);
+    m_info->block_bytes = TIFFTileSize(tif);
   }
   else {
+    // A missing RowsPerStrip means that the image is a single strip.
     uint32 rows_per_strip;
-    check_retval(TIFFGetField( tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip ), 0);
-    m_info->block_size = Vector2i(cols(),rows_per_strip);
+    check_retval(TIFFGetFieldDefaulted( tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip ), 0);
+    m_info->block_size = Vector2i(cols(),(std::min)(rows_per_strip,rows_tmp));
+    m_info->block_bytes = TIFFStripSize(tif);
   }
 
-  TIFFClose(tif);
+  if( photometric == PHOTOMETRIC_PALETTE ) {
+    uint16 *red_table, *green_table, *blue_table;
+    check_retval(TIFFGetField( tif, TIFFTAG_COLORMAP, &red_table, &green_table, &blue_table ), 0);
+    size_t entries = size_t(1) << bits_per_sample;
+    m_info->red_table.assign( red_table, red_table + entries );
+    m_info->green_table.assign( green_table, green_table + entries );
+    m_info->blue_table.assign( blue_table, blue_table + entries );
+  }
 }
 
 /// Bind the resource to a file for writing.
 void vw::DiskImageResourceTIFF::create( std::string const& filename, 
                                         ImageFormat const& format )
+{
+  Options options;
+  if( m_use_compression ) options["COMPRESS"] = "LZW";
+  create( filename, format, Vector2i(-1,-1), options );
+}
+
+/// Bind the resource to a file for writing, in tiles of the given size
+/// unless it is (-1,-1).
+void vw::DiskImageResourceTIFF::create( std::string const& /*filename*/,
+                                        ImageFormat const& format,
+                                        Vector2i block_size,
+                                        Options const& options )
 {
   if( format.planes!=1 && format.pixel_format!=VW_PIXEL_SCALAR )
     vw_throw( NoImplErr() << "TIFF doesn't support multi-plane images with compound pixel types." );
 
+  // libTIFF requires tile dimensions to be multiples of 16.
+  bool tiled = ( block_size != Vector2i(-1,-1) );
+  if( tiled && ( block_size.x() <= 0 || block_size.y() <= 0 || block_size.x() % 16 || block_size.y() % 16 ) )
+    vw_throw( ArgumentErr() << "DiskImageResourceTIFF: Tile dimensions must be positive multiples of 16." );
+
+  uint16 compression = COMPRESSION_NONE, predictor = 1;
+  std::string bigtiff = "IF_NEEDED";
+  for( Options::const_iterator i = options.begin(); i != options.end(); ++i ) {
+    if( i->first == "COMPRESS" ) compression = tiff_compression( i->second );
+    else if( i->first == "PREDICTOR" ) predictor = atoi( i->second.c_str() );
+    else if( i->first == "BIGTIFF" ) bigtiff = i->second;
+    else vw_throw( ArgumentErr() << "DiskImageResourceTIFF: Unknown option \"" << i->first << "\"." );
+  }
+  if( predictor < 1 || predictor > 3 )
+    vw_throw( ArgumentErr() << "DiskImageResourceTIFF: Unsupported predictor " << predictor << "." );
+
+  bool use_bigtiff = false;
+  if( bigtiff == "YES" ) use_bigtiff = true;
+  else if( bigtiff == "IF_NEEDED" ) {
+    // Leave room below 4 GB for the directory and block offsets.
+    uint64 bytes = uint64(format.cols) * format.rows * format.planes *
+      num_channels(format.pixel_format) * channel_size(format.channel_type);
+    use_bigtiff = bytes > (uint64(1) << 32) - (uint64(1) << 28);
+  }
+  else if( bigtiff != "NO" )
+    vw_throw( ArgumentErr() << "DiskImageResourceTIFF: BIGTIFF must be YES, NO, or IF_NEEDED." );
+
   // Set the TIFF warning and error handlers to Vision Workbench
   // functions, so that we can handle them ourselves.
   TIFFSetWarningHandler(&tiff_warning_handler);
   TIFFSetErrorHandler(&tiff_error_handler);
 
   m_format = format;
+  m_info->set_filename( m_filename );
 
-  TIFF* tif = TIFFOpen(m_filename.c_str(), "w");
+  TIFF* tif = TIFFOpen(m_filename.c_str(), use_bigtiff ? "w8" : "w");
   if( !tif  ) vw_throw( vw::IOErr() << "Failed to create \"" << m_filename << "\" using libTIFF." );
 
   check_retval(TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32)m_format.cols), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32)m_format.rows), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16)(8*channel_size(m_format.channel_type))), 0);
 
+  uint16 photometric = PHOTOMETRIC_MINISBLACK;
   if (m_format.pixel_format == VW_PIXEL_RGB ||
       m_format.pixel_format == VW_PIXEL_RGBA) {
-    check_retval(TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB), 0);
-  } else {
-    check_retval(TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK), 0);
+    photometric = PHOTOMETRIC_RGB;
   }
+  check_retval(TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, photometric), 0);
 
-  check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 1), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_XRESOLUTION, 70.0), 0);
   check_retval(TIFFSetField(tif, TIFFTAG_YRESOLUTION, 70.0), 0);
 
-  if (m_use_compression) {
-    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION,COMPRESSION_LZW), 0);
+  if (compression != COMPRESSION_NONE) {
+    check_retval(TIFFSetField(tif, TIFFTAG_COMPRESSION, compression), 0);
+  }
+  if (predictor != 1) {
+    check_retval(TIFFSetField(tif, TIFFTAG_PREDICTOR, predictor), 0);
   }
 
   switch (m_format.channel_type) {
@@ -273,92 +419,98 @@ void vw::DiskImageResourceTIFF::create( std::string const& filename,
     vw_throw( IOErr() << "DiskImageResourceTIFF: Unsupported VW channel type." );
   }
 
+  uint16 config, nsamples;
   if (m_format.pixel_format == VW_PIXEL_SCALAR) {
     // Multi-plane images with simple pixel types are stored in seperate
     // planes in the TIFF image.
-    check_retval(TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_SEPARATE), 0);
-    check_retval(
-      TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16)m_format.planes), 0);
+    config = PLANARCONFIG_SEPARATE;
+    nsamples = m_format.planes;
   } else {
     // Compound pixel types are stored contiguously in TIFF files
-    check_retval(TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG), 0);
-    check_retval(TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16)num_channels(m_format.pixel_format)), 0);
+    config = PLANARCONFIG_CONTIG;
+    nsamples = num_channels(m_format.pixel_format);
+  }
+  check_retval(TIFFSetField(tif, TIFFTAG_PLANARCONFIG, config), 0);
+  check_retval(TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, nsamples), 0);
+
+  if( tiled ) {
+    check_retval(TIFFSetField(tif, TIFFTAG_TILEWIDTH, (uint32)block_size.x()), 0);
+    check_retval(TIFFSetField(tif, TIFFTAG_TILELENGTH, (uint32)block_size.y()), 0);
+    m_info->block_size = block_size;
+    m_info->block_bytes = TIFFTileSize( tif );
+  }
+  else {
+    uint32 rows_per_strip = TIFFDefaultStripSize( tif, 0 );
+    check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip), 0);
+    m_info->block_size = Vector2i(cols(),rows_per_strip);
+    m_info->block_bytes = TIFFStripSize( tif );
   }
 
-  uint32 rows_per_strip = TIFFDefaultStripSize( tif, 0 );
-  check_retval(TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip), 0);
-  m_info->block_size = Vector2i(cols(),rows_per_strip);
-    
+  m_info->tiled = tiled;
+  m_info->config = config;
+  m_info->bpsample = 8*channel_size(m_format.channel_type);
+  m_info->nsamples = nsamples;
+  m_info->photometric = photometric;
   m_info->tif = tif;
 }
 
-/// Read the disk image into the given buffer.
+/// Read the disk image into the given buffer, decoding only the tiles
+/// or strips that intersect the bounding box.
 void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbox ) const
 {
   VW_ASSERT( int(dest.format.cols)==bbox.width() && int(dest.format.rows)==bbox.height(),
              ArgumentErr() << "DiskImageResourceTIFF (read) Error: Destination buffer has wrong dimensions!" );
 
-  // Only support sequential reading on striped TIFFs right now.
-  if( !m_info || !(m_info->tif) || !(m_info->striped) || (m_info->striped && m_info->current_line > bbox.min().y()) )
-    m_info->reopen_read();
+  // A file that is being written has to be finished before it can be read.
+  m_info->close();
 
-  uint16 config = 0, bpsample = 0, nsamples = 0, photometric = 0;
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PLANARCONFIG, &config), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_BITSPERSAMPLE, &bpsample), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_SAMPLESPERPIXEL, &nsamples), 0);
-  check_retval(TIFFGetField(m_info->tif, TIFFTAG_PHOTOMETRIC, &photometric), 0);
+  TiffReadPool::Handle handle( *m_info->read_pool );
+  TIFF *tif = handle.get();
+  DiskImageResourceInfoTIFF const& info = *m_info;
 
-  bool is_planar = (config == PLANARCONFIG_SEPARATE) && (m_format.pixel_format != VW_PIXEL_SCALAR);
-  bool is_tiled = TIFFIsTiled(m_info->tif);
-  m_info->striped = !is_tiled;
+  int nsamples = info.nsamples;
+  int sample_bytes = info.bpsample / 8;
+  bool is_palette = ( info.photometric == PHOTOMETRIC_PALETTE );
+  // Compound pixels stored as separate samples, which we interleave.
+  bool is_planar = ( info.config == PLANARCONFIG_SEPARATE ) && !is_palette &&
+    ( m_format.pixel_format != VW_PIXEL_SCALAR );
+  // Multi-plane images stored as separate samples, which we read a plane at a time.
+  bool by_plane = ( info.config == PLANARCONFIG_SEPARATE ) && ( m_format.pixel_format == VW_PIXEL_SCALAR );
 
   // Compute the tile or strip geometry
-  uint32 block_cols, block_rows, block_size, blocks_per_row, blocks_per_plane;
-  if( is_tiled ) {
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILEWIDTH, &block_cols), 0);
-    check_retval(TIFFGetField(m_info->tif, TIFFTAG_TILELENGTH, &block_rows), 0);
-    block_size = TIFFTileSize(m_info->tif);
-    blocks_per_row = (cols()-1) / block_cols + 1;
-    blocks_per_plane = blocks_per_row * ( (rows()-1) / block_rows + 1 );
-  }
-  else {
-    block_cols = cols();
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_ROWSPERSTRIP, &block_rows ), 0);
-    block_size = TIFFStripSize(m_info->tif);
-    blocks_per_row = 1;
-    blocks_per_plane = (rows()-1) / block_rows + 1;
-  }
+  uint32 block_cols = info.block_size.x(), block_rows = info.block_size.y();
+  uint32 blocks_per_row = (cols()-1) / block_cols + 1;
+  uint32 blocks_per_plane = blocks_per_row * ( (rows()-1) / block_rows + 1 );
 
-  tdata_t buf = _TIFFmalloc( block_size );
-  if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
-
-  // Allocate a buffer interleave planar data
-  tdata_t plane_buf = 0;
+  // Blocks are decoded into buf, by way of plane_buf for samples we
+  // interleave or palette_buf for palette indices.
+  std::vector<uint8> buf, plane_buf, palette_buf;
   if( is_planar ) {
-    plane_buf = buf;
-    buf = _TIFFmalloc( block_size * nsamples );
-    if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
+    plane_buf.resize( info.block_bytes );
+    buf.resize( size_t(info.block_bytes) * nsamples );
   }
-
-  // Palettized TIFFs are always uint16 RGB
-  tdata_t palette_buf = 0;
-  uint16 *red_table, *green_table, *blue_table;
-  if( photometric == PHOTOMETRIC_PALETTE ) {
-    palette_buf = buf;
-    buf = _TIFFmalloc( block_cols*block_rows*6 );
-    if( !buf ) vw_throw( vw::IOErr() << "DiskImageResourceTIFF: Failed to malloc!" );
-
-    check_retval(TIFFGetField( m_info->tif, TIFFTAG_COLORMAP, &red_table, &green_table, &blue_table ), 0);
+  else if( is_palette ) {
+    palette_buf.resize( info.block_bytes );
+    buf.resize( size_t(block_cols) * block_rows * 6 );
+  }
+  else {
+    buf.resize( info.block_bytes );
   }
 
   // Set up the source and destination image buffers
   ImageBuffer src_buf, dest_buf=dest;
   src_buf.format = m_format;
-  if( photometric == PHOTOMETRIC_PALETTE ) src_buf.cstride = 6;
-  else src_buf.cstride = bpsample * nsamples / 8;
+  if( is_palette ) src_buf.cstride = 6;
+  else if( by_plane ) src_buf.cstride = sample_bytes;
+  else src_buf.cstride = sample_bytes * nsamples;
   src_buf.rstride = block_cols*src_buf.cstride;
-  src_buf.pstride = block_rows*src_buf.rstride;
-    
+  src_buf.pstride = sample_bytes;
+  int32 block_planes = 1;
+  if( by_plane ) {
+    block_planes = m_format.planes;
+    src_buf.format.planes = dest_buf.format.planes = 1;
+  }
+
   for( int block_y = bbox.min().y()/block_rows; block_y <= int((bbox.max().y()-1)/block_rows); ++block_y ) {
     for( int block_x = bbox.min().x()/block_cols; block_x <= int((bbox.max().x()-1)/block_cols); ++block_x ) {
       int block_id = block_y * blocks_per_row + block_x;
@@ -367,84 +519,58 @@ void vw::DiskImageResourceTIFF::read( ImageBuffer const& dest, BBox2i const& bbo
       int data_right = (std::min)((block_x+1)*block_cols,uint32(bbox.max().x()))-block_x*block_cols;
       int data_bottom = (std::min)((block_y+1)*block_rows,uint32(bbox.max().y()))-block_y*block_rows;
 
-      // Read the block into the buffer, converting planar or palettized data as needed.
-      if( is_planar ) {
-        // At the moment we make an extra copy here to spoof plane contiguity
-        for( int i=0; i<nsamples; ++i ) {
-          if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), -1);
-          else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id+i*blocks_per_plane, plane_buf, (tsize_t) -1 ), 0);
-          // Oh man, this is horrible!
-          switch(bpsample/8) {
-          case 1:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint8*)buf)[(y*block_cols+x)*nsamples+i] = ((uint8*)plane_buf)[y*block_cols+x];
-              }
+      for( int32 p = 0; p < block_planes; ++p ) {
+        // Read the block into the buffer, converting planar or palettized data as needed.
+        if( is_planar ) {
+          for( int i=0; i<nsamples; ++i ) {
+            check_retval(read_block( tif, info.tiled, block_id+i*blocks_per_plane, &plane_buf[0] ), -1);
+            switch( sample_bytes ) {
+            case 1: interleave_sample<uint8>( &plane_buf[0], &buf[0], block_cols, nsamples, i, data_left, data_top, data_right, data_bottom ); break;
+            case 2: interleave_sample<uint16>( &plane_buf[0], &buf[0], block_cols, nsamples, i, data_left, data_top, data_right, data_bottom ); break;
+            case 4: interleave_sample<uint32>( &plane_buf[0], &buf[0], block_cols, nsamples, i, data_left, data_top, data_right, data_bottom ); break;
+            case 8: interleave_sample<uint64>( &plane_buf[0], &buf[0], block_cols, nsamples, i, data_left, data_top, data_right, data_bottom ); break;
+            default:
+              vw_throw( NoImplErr() << "Unsupported bit depth in separate-plane TIFF!" );
             }
-            break;
-          case 2:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint16*)buf)[(y*block_cols+x)*nsamples+i] = ((uint16*)plane_buf)[y*block_cols+x];
-              }
-            }
-            break;
-          case 4:
-            for( int y=data_top; y<data_bottom; ++y ) {
-              for( int x=data_left; x<data_right; ++x ) {
-                ((uint32*)buf)[(y*block_cols+x)*nsamples+i] = ((uint32*)plane_buf)[y*block_cols+x];
-              }
-            }
-            break;
-          default:
-            vw_throw( NoImplErr() << "Unsupported bit depth in separate-plane TIFF!" );
           }
         }
-      }
-      else if( photometric == PHOTOMETRIC_PALETTE ) {
-        if( is_tiled ) check_retval(TIFFReadEncodedTile( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), -1);
-        else check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, palette_buf, (tsize_t) -1 ), 0);
-        if( photometric == PHOTOMETRIC_PALETTE ) {
+        else if( is_palette ) {
+          check_retval(read_block( tif, info.tiled, block_id, &palette_buf[0] ), -1);
           for( int y=data_top; y<data_bottom; ++y ) {
             for( int x=data_left; x<data_right; ++x ) {
               int i = y*block_cols + x;
-              int p = ((uint8*)palette_buf)[i];
-              ((uint16*)buf)[3*i+0] = red_table[p];
-              ((uint16*)buf)[3*i+1] = green_table[p];
-              ((uint16*)buf)[3*i+2] = blue_table[p];
+              int index = palette_buf[i];
+              ((uint16*)&buf[0])[3*i+0] = info.red_table[index];
+              ((uint16*)&buf[0])[3*i+1] = info.green_table[index];
+              ((uint16*)&buf[0])[3*i+2] = info.blue_table[index];
             }
           }
         }
-      }
-      else {
-        if( is_tiled )  {
-          check_retval(TIFFReadEncodedTile( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
-        } else {
-          check_retval(TIFFReadEncodedStrip( m_info->tif, block_id, buf, (tsize_t) -1 ), -1);
-          m_info->current_line++;
+        else {
+          check_retval(read_block( tif, info.tiled, block_id+p*blocks_per_plane, &buf[0] ), -1);
         }
+
+        src_buf.data = &buf[0] + data_left*src_buf.cstride + data_top*src_buf.rstride;
+        dest_buf.data = (uint8*)dest.data + p*dest.pstride + (data_left+block_x*block_cols-bbox.min().x())*dest.cstride + (data_top+block_y*block_rows-bbox.min().y())*dest.rstride;
+        src_buf.format.cols = dest_buf.format.cols = data_right-data_left;
+        src_buf.format.rows = dest_buf.format.rows = data_bottom-data_top;
+
+        convert( dest_buf, src_buf, m_rescale );
       }
-      
-      src_buf.data = (uint8*)buf + data_left*src_buf.cstride + data_top*src_buf.rstride;
-      dest_buf.data = (uint8*)dest.data + (data_left+block_x*block_cols-bbox.min().x())*dest.cstride + (data_top+block_y*block_rows-bbox.min().y())*dest.rstride;
-      src_buf.format.cols = dest_buf.format.cols = data_right-data_left;
-      src_buf.format.rows = dest_buf.format.rows = data_bottom-data_top;
-      
-      convert( dest_buf, src_buf, m_rescale );
     }
-  
   }
-
-  _TIFFfree(buf);
-  if( plane_buf ) _TIFFfree(plane_buf);
-  if( palette_buf ) _TIFFfree(palette_buf);
-  // Sorry .. this keeps us from incrementally reading
-  m_info->close();
 }
 
 // Write the given buffer into the disk image.
 void vw::DiskImageResourceTIFF::write( ImageBuffer const& src, BBox2i const& bbox )
 {
+  VW_ASSERT( m_info->tif, IOErr() << "DiskImageResourceTIFF: File is not open for writing.\n" );
+
+  if( m_info->tiled ) {
+    write_tiles( src, bbox );
+    return;
+  }
+
   VW_ASSERT(bbox.width() == m_format.cols, 
             ArgumentErr() << "DiskImageResourceTIFF: bounding box must be the same width as image.\n");
 
@@ -477,6 +603,42 @@ void vw::DiskImageResourceTIFF::write( ImageBuffer const& src, BBox2i const& bbo
   _TIFFfree(buf);
 }
 
+// Write whole tiles, in any order.  Tiles that overhang the right or
+// bottom of the image are padded with zeros.
+void vw::DiskImageResourceTIFF::write_tiles( ImageBuffer const& src, BBox2i const& bbox )
+{
+  Vector2i block_size = m_info->block_size;
+  VW_ASSERT( bbox.min().x() % block_size.x() == 0 && bbox.min().y() % block_size.y() == 0 &&
+             ( bbox.max().x() % block_size.x() == 0 || bbox.max().x() == cols() ) &&
+             ( bbox.max().y() % block_size.y() == 0 || bbox.max().y() == rows() ),
+             ArgumentErr() << "DiskImageResourceTIFF: bounding box must cover whole tiles.\n" );
+
+  std::vector<uint8> buf( m_info->block_bytes );
+  ImageBuffer src_tile = src, dst;
+  src_tile.format.planes = 1;
+  dst.format = m_format;
+  dst.format.planes = 1;
+  dst.data = &buf[0];
+  dst.cstride = num_channels(m_format.pixel_format) * channel_size(m_format.channel_type);
+  dst.rstride = block_size.x() * dst.cstride;
+  dst.pstride = block_size.y() * dst.rstride;
+
+  for( int32 p = 0; p < m_format.planes; ++p ) {
+    for( int32 y = bbox.min().y(); y < bbox.max().y(); y += block_size.y() ) {
+      for( int32 x = bbox.min().x(); x < bbox.max().x(); x += block_size.x() ) {
+        src_tile.format.cols = dst.format.cols = (std::min)( block_size.x(), bbox.max().x() - x );
+        src_tile.format.rows = dst.format.rows = (std::min)( block_size.y(), bbox.max().y() - y );
+        if( dst.format.cols < block_size.x() || dst.format.rows < block_size.y() )
+          std::fill( buf.begin(), buf.end(), 0 );
+        src_tile.data = (uint8*)src.data + p*src.pstride + (y-bbox.min().y())*src.rstride + (x-bbox.min().x())*src.cstride;
+        convert( dst, src_tile, m_rescale );
+        check_retval(TIFFWriteEncodedTile( m_info->tif, TIFFComputeTile( m_info->tif, x, y, 0, p ),
+                                           &buf[0], m_info->block_bytes ), -1);
+      }
+    }
+  }
+}
+
 // A FileIO hook to open a file for reading
 vw::DiskImageResource* vw::DiskImageResourceTIFF::construct_open( std::string const& filename ) {
   return new DiskImageResourceTIFF( filename );
@@ -492,7 +654,7 @@ vw::DiskImageResource* vw::DiskImageResourceTIFF::construct_create( std::string
 // if there was an error.
 void vw::DiskImageResourceTIFF::check_retval(const int retval, const int error_val) const {
   if (retval == error_val) {
-    vw_throw( vw::IOErr() << "check_retval: " << tiff_error_msg );
+    vw_throw( vw::IOErr() << "check_retval: " << ( tiff_error_msg_ptr.get() ? *tiff_error_msg_ptr : std::string() ) );
   }
 }
 
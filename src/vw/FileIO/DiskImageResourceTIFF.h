@@ -6,13 +6,44 @@
 
 
 /// \file FileIO/DiskImageResourceTIFF.h
-/// 
+///
 /// Provides support for TIFF image files.
 ///
+/// Files are read a tile or strip at a time, decoding only those that
+/// intersect the requested region, so sub-windows of very large files
+/// are cheap to read.  The block size of a file opened for reading is
+/// its native tile or strip size.
+///
+/// Files are written in strips, one row at a time and in order, unless
+/// a block size is given when creating them.  They are then tiled, and
+/// blocks may be written in any order.  Options, like those for
+/// DiskImageResourceGDAL, select the compression and whether to write
+/// a BigTIFF.  For example, to write a tiled, compressed BigTIFF:
+///
+///   DiskImageResourceTIFF::Options options;
+///   options["COMPRESS"] = "DEFLATE";
+///   options["BIGTIFF"] = "YES";
+///   DiskImageResourceTIFF resource( "filename.tif",
+///                                   image.format(),
+///                                   Vector2i(256,256),
+///                                   options );
+///   block_write_image( resource, image );
+///
+/// The supported options are:
+///
+///   COMPRESS   NONE (the default), LZW, DEFLATE or PACKBITS.
+///   PREDICTOR  1 (none, the default), 2 (horizontal differencing)
+///              or 3 (floating point).
+///   BIGTIFF    YES, NO, or IF_NEEDED (the default), which writes a
+///              BigTIFF if the uncompressed image would be more than
+///              3.75 GB, leaving room below the 4 GB limit of a plain
+///              TIFF for its directory and block offsets.
+///
 #ifndef __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 #define __VW_FILEIO_DISKIMAGERESOUCETIFF_H__
 
 #include <string>
+#include <map>
 
 #include <vw/FileIO/DiskImageResource.h>
 
@@ -23,31 +54,53 @@ namespace vw {
   class DiskImageResourceTIFF : public DiskImageResource {
   public:
 
+    typedef std::map<std::string,std::string> Options;
+
     DiskImageResourceTIFF( std::string const& filename );
 
-    DiskImageResourceTIFF( std::string const& filename, 
+    DiskImageResourceTIFF( std::string const& filename,
                            ImageFormat const& format,
                            bool use_compression = false );
-    
+
+    /// Creates a file with the given options.  A block size of
+    /// (-1,-1) writes strips; any other writes tiles of that size,
+    /// which must be a multiple of 16 in each dimension.
+    DiskImageResourceTIFF( std::string const& filename,
+                           ImageFormat const& format,
+                           Vector2i block_size,
+                           Options const& options = Options() );
+
     virtual ~DiskImageResourceTIFF() {}
-    
+
     /// Returns the type of disk image resource.
     static std::string type_static() { return "TIFF"; }
 
     /// Returns the type of disk image resource.
     virtual std::string type() { return type_static(); }
-    
+
     virtual Vector2i block_size() const;
 
+    /// Reads may be made from several threads at once; each one uses
+    /// its own libTIFF handle.
     virtual void read( ImageBuffer const& buf, BBox2i const& bbox ) const;
 
+    /// Writes to a striped file must be whole rows, in order.  Writes
+    /// to a tiled file must cover whole tiles, in any order.
     virtual void write( ImageBuffer const& dest, BBox2i const& bbox );
 
+    /// Tiled files can be written one block at a time in any order.
+    virtual bool has_random_block_write() const;
+
     void open( std::string const& filename );
 
     void create( std::string const& filename,
                  ImageFormat const& format );
 
+    void create( std::string const& filename,
+                 ImageFormat const& format,
+                 Vector2i block_size,
+                 Options const& options );
+
     static DiskImageResource* construct_open( std::string const& filename );
 
     static DiskImageResource* construct_create( std::string const& filename,
@@ -59,6 +112,8 @@ namespace vw {
     void check_retval(const int retval, const int error_val) const;
 
   private:
+    void write_tiles( ImageBuffer const& src, BBox2i const& bbox );
+
     boost::shared_ptr<DiskImageResourceInfoTIFF> m_info;
     bool m_use_compression;
   };
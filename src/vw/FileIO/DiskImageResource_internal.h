@@ -7,20 +7,145 @@
 
 /// \file FileIO/DiskImageResource_internal.h
 ///
-/// A header for internal use only that allows access to the extension list
+/// A header for internal use only that allows access to the extension
+/// list, to the memory-mapped files behind the raw-format readers, and
+/// to the pools of read handles shared by the library-backed drivers.
 ///
 #ifndef __VW_FILEIO_DISKIMAGERESOURCE_INTERNAL_H__
 #define __VW_FILEIO_DISKIMAGERESOURCE_INTERNAL_H__
 
 #include <string>
 #include <set>
+#include <vector>
+#include <fstream>
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Core/Thread.h>
 
 namespace vw {
 namespace internal {
   typedef boost::function<void (std::string const&)> ExtTestFunction;
   void foreach_ext(std::string const& prefix, ExtTestFunction const& callback,
                   std::set<std::string> const& exclude = std::set<std::string>() );
+
+  /// Read-only access to the bytes of a file, for drivers whose pixels
+  /// sit in the file in a fixed layout.  The file is memory mapped
+  /// where possible, so that reading a window only touches the pages
+  /// under it; otherwise regions are read with ordinary file I/O.  The
+  /// file is opened on first use, and may be read from several threads.
+  class MappedFile : private boost::noncopyable {
+    std::string m_filename;
+    mutable Mutex m_mutex;
+    mutable bool m_opened;
+    mutable uint64 m_size;
+    mutable void *m_addr;
+    mutable std::ifstream m_stream;
+
+    void open() const;
+
+  public:
+    MappedFile( std::string const& filename );
+    ~MappedFile();
+
+    std::string const& filename() const { return m_filename; }
+
+    /// Returns a pointer to size bytes at the given offset, which
+    /// stays valid for the life of this object and of scratch.  The
+    /// bytes are either mapped in place or read into scratch.
+    uint8 const* region( uint64 offset, size_t size, std::vector<uint8> &scratch ) const;
+  };
+
+  /// The number of idle read handles that the ReadHandlePools of one
+  /// driver hold open between them, and the most they may.
+  class IdleHandleLimit : private boost::noncopyable {
+    Mutex m_mutex;
+    size_t m_max, m_count;
+  public:
+    IdleHandleLimit( size_t max ) : m_max( max ), m_count( 0 ) {}
+
+    /// Counts one more idle handle, if there is room for it.
+    bool take() {
+      Mutex::Lock lock(m_mutex);
+      if( m_count >= m_max ) return false;
+      ++m_count;
+      return true;
+    }
+
+    void give_back( size_t count ) {
+      Mutex::Lock lock(m_mutex);
+      m_count -= count;
+    }
+  };
+
+  /// A pool of read handles to one file, for libraries whose handles
+  /// may only be used by one thread at a time.  Each read borrows a
+  /// handle of its own, opening a new one if none is idle.  Up to
+  /// max_idle handles are kept open between reads, as long as the
+  /// driver's IdleHandleLimit allows; any more are closed when they
+  /// are returned.  PolicyT supplies the handle type, and static
+  /// open(filename) and close(handle) functions; open() throws if the
+  /// file can't be opened.  Neither is called with the pool's mutex
+  /// held.
+  template <class PolicyT>
+  class ReadHandlePool : private boost::noncopyable {
+  public:
+    typedef typename PolicyT::handle_type handle_type;
+
+  private:
+    std::string m_filename;
+    size_t m_max_idle;
+    IdleHandleLimit &m_limit;
+    Mutex m_mutex;
+    std::vector<handle_type*> m_idle;
+
+  public:
+    ReadHandlePool( std::string const& filename, size_t max_idle, IdleHandleLimit &limit )
+      : m_filename( filename ), m_max_idle( max_idle ), m_limit( limit ) {}
+
+    ~ReadHandlePool() {
+      if( m_idle.empty() ) return;
+      m_limit.give_back( m_idle.size() );
+      for( size_t i = 0; i < m_idle.size(); ++i )
+        PolicyT::close( m_idle[i] );
+    }
+
+    handle_type* acquire() {
+      {
+        Mutex::Lock lock(m_mutex);
+        if( !m_idle.empty() ) {
+          handle_type *handle = m_idle.back();
+          m_idle.pop_back();
+          m_limit.give_back( 1 );
+          return handle;
+        }
+      }
+      return PolicyT::open( m_filename );
+    }
+
+    void release( handle_type *handle ) {
+      {
+        Mutex::Lock lock(m_mutex);
+        if( m_idle.size() < m_max_idle && m_limit.take() ) {
+          m_idle.push_back( handle );
+          return;
+        }
+      }
+      PolicyT::close( handle );
+    }
+
+    /// Borrows a handle for the lifetime of the object.
+    class Handle : private boost::noncopyable {
+      ReadHandlePool &m_pool;
+      handle_type *m_handle;
+    public:
+      Handle( ReadHandlePool &pool ) : m_pool( pool ), m_handle( pool.acquire() ) {}
+      ~Handle() { m_pool.release( m_handle ); }
+      handle_type* get() const { return m_handle; }
+    };
+  };
+
 }} // namespace vw::internal
 
 #endif // __VW_FILEIO_DISKIMAGERESOURCE_INTERNAL__
@@ -92,6 +92,14 @@ namespace vw {
 
     std::string filename() const { return m_rsrc->filename(); }
 
+    /// Read blocks ahead in the background; see
+    /// BlockRasterizeView::set_prefetch().
+    void set_prefetch( int max_in_flight ) const { m_impl.set_prefetch( max_in_flight ); }
+
+    /// Start reading the blocks that overlap the given bbox in the
+    /// background; see BlockRasterizeView::prefetch().
+    void prefetch( BBox2i const& bbox ) const { m_impl.prefetch( bbox ); }
+
   };
 
 
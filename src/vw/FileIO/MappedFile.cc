@@ -0,0 +1,87 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file MappedFile.cc
+///
+/// Read-only, memory-mapped access to the raw pixel data of PDS and
+/// PBM files.
+///
+#include <cstring>
+#include <cerrno>
+
+#include <vw/Core/Exception.h>
+#include <vw/Core/Debugging.h>
+#include <vw/FileIO/DiskImageResource_internal.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+vw::internal::MappedFile::MappedFile( std::string const& filename )
+  : m_filename( filename ), m_opened( false ), m_size( 0 ), m_addr( 0 ) {}
+
+vw::internal::MappedFile::~MappedFile() {
+#ifndef WIN32
+  if( m_addr ) munmap( m_addr, m_size );
+#endif
+}
+
+// Maps the whole file, or failing that opens it for ordinary reads.
+void vw::internal::MappedFile::open() const {
+#ifndef WIN32
+  int fd = ::open( m_filename.c_str(), O_RDONLY );
+  if( fd < 0 )
+    vw_throw( IOErr() << "Failed to open \"" << m_filename << "\": " << strerror(errno) );
+  struct stat st;
+  if( fstat( fd, &st ) != 0 ) {
+    close( fd );
+    vw_throw( IOErr() << "Failed to stat \"" << m_filename << "\": " << strerror(errno) );
+  }
+  m_size = st.st_size;
+  if( m_size > 0 && uint64(size_t(m_size)) == m_size ) {
+    void *addr = mmap( 0, m_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( addr != MAP_FAILED ) m_addr = addr;
+    else vw_out(DebugMessage, "fileio") << "Could not map \"" << m_filename << "\" (" << strerror(errno)
+                                        << "); reading it instead.\n";
+  }
+  close( fd );
+  if( m_addr || m_size == 0 ) {
+    m_opened = true;
+    return;
+  }
+#endif
+
+  m_stream.open( m_filename.c_str(), std::ios::in | std::ios::binary );
+  if( !m_stream.is_open() )
+    vw_throw( IOErr() << "Failed to open \"" << m_filename << "\"." );
+  m_stream.seekg( 0, std::ios::end );
+  m_size = m_stream.tellg();
+  m_opened = true;
+}
+
+vw::uint8 const* vw::internal::MappedFile::region( uint64 offset, size_t size, std::vector<uint8> &scratch ) const {
+  Mutex::Lock lock( m_mutex );
+  if( !m_opened ) open();
+
+  if( offset + size > m_size )
+    vw_throw( IOErr() << "Read of " << size << " bytes at offset " << offset << " is past the end of \""
+              << m_filename << "\" (" << m_size << " bytes).  The file may be truncated." );
+  if( m_addr ) return (uint8 const*)m_addr + offset;
+
+  scratch.resize( size );
+  if( size == 0 ) return 0;
+  m_stream.seekg( offset, std::ios::beg );
+  m_stream.read( (char*)&scratch[0], size );
+  if( m_stream.fail() ) {
+    m_stream.clear();
+    vw_throw( IOErr() << "An error occurred while reading \"" << m_filename << "\"." );
+  }
+  return &scratch[0];
+}
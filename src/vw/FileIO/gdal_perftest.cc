@@ -0,0 +1,134 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file gdal_perftest.cc
+///
+/// Times block reads from a tiled, compressed GeoTIFF through
+/// DiskImageResourceGDAL with increasing numbers of threads, all
+/// reading the same resource.  Reports the read rate in megabytes per
+/// second, and the speedup over a single thread.
+///
+#include <vw/FileIO/DiskImageResourceGDAL.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/ImageIO.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Core/Thread.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem/operations.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+typedef PixelRGB<uint8> pixel_type;
+
+// Reads blocks, taking the next unread one from a shared counter,
+// until there are none left.
+class ReadBlocksTask {
+  DiskImageResourceGDAL const& m_resource;
+  std::vector<BBox2i> const& m_blocks;
+  size_t &m_next;
+  Mutex &m_mutex;
+public:
+  ReadBlocksTask( DiskImageResourceGDAL const& resource, std::vector<BBox2i> const& blocks,
+                  size_t &next, Mutex &mutex )
+    : m_resource( resource ), m_blocks( blocks ), m_next( next ), m_mutex( mutex ) {}
+
+  void operator()() {
+    ImageView<pixel_type> block;
+    while( true ) {
+      size_t i;
+      {
+        Mutex::Lock lock( m_mutex );
+        if( m_next == m_blocks.size() ) return;
+        i = m_next++;
+      }
+      read_image( block, m_resource, m_blocks[i] );
+    }
+  }
+};
+
+double time_reads( DiskImageResourceGDAL const& resource, std::vector<BBox2i> const& blocks,
+                   int32 num_threads, int32 repeat ) {
+  Stopwatch sw;
+  sw.start();
+  for( int32 r = 0; r < repeat; ++r ) {
+    size_t next = 0;
+    Mutex mutex;
+    ReadBlocksTask task( resource, blocks, next, mutex );
+    std::vector<boost::shared_ptr<Thread> > threads;
+    for( int32 t = 0; t < num_threads; ++t )
+      threads.push_back( boost::shared_ptr<Thread>( new Thread( task ) ) );
+    for( int32 t = 0; t < num_threads; ++t )
+      threads[t]->join();
+  }
+  sw.stop();
+  return sw.elapsed_seconds();
+}
+
+int main( int argc, char** argv ) {
+  std::string filename;
+  int32 size, block_size, max_threads, repeat;
+
+  po::options_description general_options("GDAL Block Read Performance Test Program");
+  general_options.add_options()
+    ("file,f", po::value<std::string>(&filename)->default_value("gdal_perftest.tif"), "Scratch GeoTIFF to write and then read")
+    ("size,s", po::value<int32>(&size)->default_value(4096), "Width and height of the test image")
+    ("block-size,b", po::value<int32>(&block_size)->default_value(256), "Tile size of the test image")
+    ("threads,t", po::value<int32>(&max_threads)->default_value(8), "Largest number of threads to read with")
+    ("repeat,r", po::value<int32>(&repeat)->default_value(3), "Number of times to read the image")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  // Write a tiled, LZW-compressed test image with some texture, so
+  // that decompression costs about what it does for real imagery.
+  {
+    ImageView<pixel_type> image( size, size );
+    for( int32 j = 0; j < size; ++j )
+      for( int32 i = 0; i < size; ++i )
+        image(i,j) = pixel_type( uint8(i ^ j), uint8((i * j) >> 4), uint8((i + 3*j) % 251) );
+    DiskImageResourceGDAL resource( filename, image.format(), Vector2i( block_size, block_size ) );
+    write_image( resource, image );
+  }
+
+  // Keep GDAL's own block cache small, so that every pass decodes.
+  DiskImageResourceGDAL::set_gdal_cache_size( 1024*1024 );
+
+  DiskImageResourceGDAL resource( filename );
+  std::vector<BBox2i> blocks;
+  for( int32 y = 0; y < size; y += block_size )
+    for( int32 x = 0; x < size; x += block_size )
+      blocks.push_back( BBox2i( x, y, std::min( block_size, size - x ), std::min( block_size, size - y ) ) );
+
+  double mbytes = double(size) * size * sizeof(pixel_type) * repeat / (1024*1024);
+  std::cout << size << "x" << size << " RGB image, " << block_size << "x" << block_size
+            << " tiles, " << repeat << " passes\n";
+  double single = 0;
+  for( int32 threads = 1; threads <= max_threads; threads *= 2 ) {
+    double seconds = time_reads( resource, blocks, threads, repeat );
+    if( threads == 1 ) single = seconds;
+    std::cout << "  " << std::setw(3) << threads << " threads " << std::fixed
+              << std::setprecision(1) << std::setw(8) << mbytes / seconds << " MB/s  "
+              << std::setprecision(2) << std::setw(5) << single / seconds << "x\n";
+  }
+
+  boost::filesystem::remove( filename );
+  return 0;
+}
@@ -11,6 +11,7 @@
 #include <vw/FileIO/DiskImageResource_internal.h>
 #include <vw/Image/PixelTypes.h>
 #include <vw/Image/ImageView.h>
+#include <vw/Core/Thread.h>
 #include <vw/config.h>
 #include <test/Helpers.h>
 
@@ -293,6 +294,234 @@ TEST( DiskImageResource, PBM_Case_Insentive ) {
 
 #undef WF
 
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+TEST( DiskImageResource, TIFF_Tiled ) {
+  UnlinkName fn("tiled.tif");
+  ImageView<PixelRGB<uint8> > img(100,70);
+  for( int32 j = 0; j < img.rows(); ++j )
+    for( int32 i = 0; i < img.cols(); ++i )
+      img(i,j) = PixelRGB<uint8>( i, j, i^j );
+
+  {
+    DiskImageResourceTIFF::Options options;
+    options["COMPRESS"] = "LZW";
+    options["BIGTIFF"] = "YES";
+    DiskImageResourceTIFF resource( fn, img.format(), Vector2i(32,32), options );
+    EXPECT_TRUE( resource.has_random_block_write() );
+    block_write_image( resource, img );
+  }
+
+  DiskImageResourceTIFF resource( fn );
+  EXPECT_EQ( 32, resource.block_size().x() );
+  EXPECT_EQ( 32, resource.block_size().y() );
+
+  ImageView<PixelRGB<uint8> > full;
+  read_image( full, resource );
+  ASSERT_EQ( img.cols(), full.cols() );
+  ASSERT_EQ( img.rows(), full.rows() );
+  for( int32 j = 0; j < img.rows(); ++j )
+    for( int32 i = 0; i < img.cols(); ++i )
+      EXPECT_PIXEL_EQ( img(i,j), full(i,j) );
+
+  // A window straddling several tiles, including the padded edge ones.
+  BBox2i bbox( 20, 25, 75, 40 );
+  ImageView<PixelRGB<uint8> > window( bbox.width(), bbox.height() );
+  read_image( window, resource, bbox );
+  for( int32 j = 0; j < window.rows(); ++j )
+    for( int32 i = 0; i < window.cols(); ++i )
+      EXPECT_PIXEL_EQ( img(i+bbox.min().x(),j+bbox.min().y()), window(i,j) );
+
+  DiskImageResourceTIFF::Options bad;
+  bad["COMPRESS"] = "JPEG2000";
+  EXPECT_THROW( DiskImageResourceTIFF( fn, img.format(), Vector2i(32,32), bad ), ArgumentErr );
+  EXPECT_THROW( DiskImageResourceTIFF( fn, img.format(), Vector2i(30,30) ), ArgumentErr );
+}
+#endif
+
+#if (defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1) || (defined(VW_HAVE_PKG_GDAL) && VW_HAVE_PKG_GDAL==1)
+// Reads every block of a resource, starting at a different block in
+// each thread, and counts the pixels that differ from the image.
+class ReadBlocksTask {
+  DiskImageResource const& m_resource;
+  ImageView<PixelRGB<uint8> > const& m_image;
+  int m_start;
+  int &m_errors;
+public:
+  ReadBlocksTask( DiskImageResource const& resource, ImageView<PixelRGB<uint8> > const& image,
+                  int start, int &errors )
+    : m_resource(resource), m_image(image), m_start(start), m_errors(errors) {}
+
+  void operator()() {
+    m_errors = 0;
+    Vector2i block = m_resource.block_size();
+    int bcols = m_image.cols() / block.x(), brows = m_image.rows() / block.y();
+    for( int pass = 0; pass < 8; ++pass ) {
+      for( int n = 0; n < bcols*brows; ++n ) {
+        int b = (m_start + 7*n) % (bcols*brows);
+        BBox2i bbox( block.x()*(b % bcols), block.y()*(b / bcols), block.x(), block.y() );
+        ImageView<PixelRGB<uint8> > tile( bbox.width(), bbox.height() );
+        read_image( tile, m_resource, bbox );
+        for( int32 j = 0; j < tile.rows(); ++j )
+          for( int32 i = 0; i < tile.cols(); ++i )
+            if( tile(i,j) != m_image(i+bbox.min().x(),j+bbox.min().y()) )
+              ++m_errors;
+      }
+    }
+  }
+};
+
+// Reads two resources on the same file, each from several threads at
+// once, with more threads than either keeps idle handles for.
+static void test_threaded_read( DiskImageResource const& resource1, DiskImageResource const& resource2,
+                                ImageView<PixelRGB<uint8> > const& img ) {
+  const int num_threads = 12;
+  std::vector<int> errors( num_threads, -1 );
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for( int t = 0; t < num_threads; ++t ) {
+    DiskImageResource const& resource = (t % 2) ? resource1 : resource2;
+    threads.push_back( boost::shared_ptr<Thread>( new Thread( ReadBlocksTask( resource, img, t, errors[t] ) ) ) );
+  }
+  for( int t = 0; t < num_threads; ++t ) {
+    threads[t]->join();
+    EXPECT_EQ( 0, errors[t] ) << "thread " << t;
+  }
+}
+
+static ImageView<PixelRGB<uint8> > threaded_read_image() {
+  ImageView<PixelRGB<uint8> > img(512,256);
+  for( int32 j = 0; j < img.rows(); ++j )
+    for( int32 i = 0; i < img.cols(); ++i )
+      img(i,j) = PixelRGB<uint8>( i, j, (i*j) ^ (i+j) );
+  return img;
+}
+#endif
+
+#if defined(VW_HAVE_PKG_TIFF) && VW_HAVE_PKG_TIFF==1
+TEST( DiskImageResource, TIFF_ThreadedRead ) {
+  UnlinkName fn("threaded.tif");
+  ImageView<PixelRGB<uint8> > img = threaded_read_image();
+  {
+    DiskImageResourceTIFF::Options options;
+    options["COMPRESS"] = "LZW";
+    DiskImageResourceTIFF resource( fn, img.format(), Vector2i(64,64), options );
+    block_write_image( resource, img );
+  }
+
+  DiskImageResourceTIFF resource1( fn ), resource2( fn );
+  ASSERT_EQ( 64, resource1.block_size().x() );
+  test_threaded_read( resource1, resource2, img );
+}
+#endif
+
+#if defined(VW_HAVE_PKG_GDAL) && VW_HAVE_PKG_GDAL==1
+// Sets the size of GDAL's block cache, and puts the old size back on
+// the way out.
+class GdalCacheSize {
+  int m_old_size;
+public:
+  GdalCacheSize( int size ) : m_old_size( DiskImageResourceGDAL::gdal_cache_size() ) {
+    DiskImageResourceGDAL::set_gdal_cache_size( size );
+  }
+  ~GdalCacheSize() { DiskImageResourceGDAL::set_gdal_cache_size( m_old_size ); }
+};
+
+TEST( DiskImageResource, GDAL_ThreadedRead ) {
+  UnlinkName fn("threaded.tif");
+  ImageView<PixelRGB<uint8> > img = threaded_read_image();
+  {
+    DiskImageResourceGDAL::Options options;
+    options["COMPRESS"] = "LZW";
+    DiskImageResourceGDAL resource( fn, img.format(), Vector2i(64,64), options );
+    block_write_image( resource, img );
+  }
+
+  // A small GDAL block cache makes most reads decode their block again.
+  GdalCacheSize cache_size( 64*1024 );
+  DiskImageResourceGDAL resource1( fn ), resource2( fn );
+  ASSERT_EQ( 64, resource1.block_size().x() );
+  test_threaded_read( resource1, resource2, img );
+}
+#endif
+
+// Writes a PDS file with the image data in the second 512-byte record.
+static void write_pds( std::string const& filename, std::string const& labels,
+                       std::vector<uint8> const& data ) {
+  std::string header = "RECORD_BYTES = 512\n^IMAGE = 2\n" + labels + "END\n";
+  header.resize( 512, ' ' );
+  std::fstream f(filename.c_str(), std::fstream::out|std::fstream::binary);
+  f.write( header.data(), header.size() );
+  f.write( (const char*)&data[0], data.size() );
+}
+
+TEST( DiskImageResource, PDS_Window ) {
+  const int32 cols = 7, rows = 5;
+  BBox2i bbox( 2, 1, 4, 3 );
+
+  // Band-sequential, big-endian RGB, which has to be swapped and interleaved.
+  {
+    UnlinkName fn("window_rgb.img");
+    std::vector<uint8> data;
+    for( int32 c = 0; c < 3; ++c )
+      for( int32 j = 0; j < rows; ++j )
+        for( int32 i = 0; i < cols; ++i ) {
+          uint16 value = c*1000 + j*10 + i;
+          data.push_back( value >> 8 );
+          data.push_back( value & 0xff );
+        }
+    write_pds( fn, "LINE_SAMPLES = 7\nLINES = 5\nBANDS = 3\nBAND_STORAGE_TYPE = BAND_SEQUENTIAL\n"
+               "SAMPLE_TYPE = MSB_UNSIGNED_INTEGER\nSAMPLE_BITS = 16\n", data );
+
+    DiskImageResourcePDS resource( fn );
+    EXPECT_EQ( cols, resource.block_size().x() );
+    ImageView<PixelRGB<uint16> > window( bbox.width(), bbox.height() );
+    read_image( window, resource, bbox );
+    for( int32 j = 0; j < window.rows(); ++j )
+      for( int32 i = 0; i < window.cols(); ++i ) {
+        uint16 value = (j+bbox.min().y())*10 + i+bbox.min().x();
+        EXPECT_PIXEL_EQ( PixelRGB<uint16>( value, 1000+value, 2000+value ), window(i,j) );
+      }
+  }
+
+  // Little-endian gray, which is read in place on most machines.
+  {
+    UnlinkName fn("window_gray.img");
+    std::vector<uint8> data;
+    for( int32 j = 0; j < rows; ++j )
+      for( int32 i = 0; i < cols; ++i ) {
+        data.push_back( j*10 + i );
+        data.push_back( 1 );
+      }
+    write_pds( fn, "LINE_SAMPLES = 7\nLINES = 5\nSAMPLE_TYPE = LSB_INTEGER\nSAMPLE_BITS = 16\n", data );
+
+    DiskImageResourcePDS resource( fn );
+    ImageView<PixelGray<int16> > window( bbox.width(), bbox.height() );
+    read_image( window, resource, bbox );
+    for( int32 j = 0; j < window.rows(); ++j )
+      for( int32 i = 0; i < window.cols(); ++i )
+        EXPECT_EQ( 256 + (j+bbox.min().y())*10 + i+bbox.min().x(), window(i,j).v() );
+  }
+}
+
+TEST( DiskImageResource, PBM_Window ) {
+  UnlinkName fn("window.pgm");
+  {
+    std::fstream f(fn.c_str(), std::fstream::out|std::fstream::binary);
+    f << "P5 7 5 255\n";
+    for( int32 j = 0; j < 5; ++j )
+      for( int32 i = 0; i < 7; ++i )
+        f.put( char(j*10 + i) );
+  }
+
+  DiskImageResourcePBM resource( fn );
+  EXPECT_EQ( 7, resource.block_size().x() );
+  BBox2i bbox( 2, 1, 4, 3 );
+  ImageView<PixelGray<uint8> > window( bbox.width(), bbox.height() );
+  read_image( window, resource, bbox );
+  for( int32 j = 0; j < window.rows(); ++j )
+    for( int32 i = 0; i < window.cols(); ++i )
+      EXPECT_EQ( (j+bbox.min().y())*10 + i+bbox.min().x(), window(i,j).v() );
+}
+
 
 TEST( DiskImageResource, NonExistentFiles ) {
   boost::scoped_ptr<DiskImageResource> r;
@@ -14,15 +14,22 @@
 /// block at a time can dramatically improve performance by reducing 
 /// memory utilization.
 ///
+/// When block caching is enabled the view can also read ahead: see
+/// BlockRasterizeView::set_prefetch() and BlockRasterizeView::prefetch().
+///
 #ifndef __VW_IMAGE_BLOCKRASTERIZE_H__
 #define __VW_IMAGE_BLOCKRASTERIZE_H__
 
 #include <vw/Core/Cache.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/PixelAccessors.h>
 #include <vw/Image/Manipulation.h>
 #include <vw/Image/BlockProcessor.h>
 
+#include <deque>
+#include <boost/noncopyable.hpp>
+
 namespace vw {
 
   /// A wrapper view that rasterizes its child in blocks.
@@ -87,11 +94,44 @@ namespace vw {
       return CropView<ImageView<pixel_type> >( buf, BBox2i(-bbox.min().x(),-bbox.min().y(),cols(),rows()) );
     }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i bbox ) const {
-      RasterizeFunctor<DestT> rasterizer( *this, dest, bbox.min() );
+      RasterizeFunctor<DestT> rasterizer( *this, dest, bbox );
       BlockProcessor<RasterizeFunctor<DestT> > process( rasterizer, m_block_size, m_num_threads );
       process(bbox);
     }
 
+    /// Enable read-ahead of cache blocks, allowing at most
+    /// max_in_flight blocks to be generated in the background at once
+    /// (zero disables it).  Each block the view rasterizes then
+    /// schedules the blocks that will be needed next, following the
+    /// block traversal order and continuing on to the neighboring
+    /// region in raster order, as block_write_image() would request
+    /// it.  The budget is limited to half of the cache.  This setting
+    /// is shared by all copies of the view, and has no effect unless
+    /// block caching is enabled.
+    void set_prefetch( int max_in_flight ) const {
+      if( ! m_prefetcher ) return;
+      size_t block_bytes = size_t(m_block_size.x()) * m_block_size.y() * planes() * sizeof(pixel_type);
+      size_t limit = m_cache_ptr->max_size() / 2 / std::max( block_bytes, size_t(1) );
+      m_prefetcher->set_max_in_flight( std::max( 0, std::min( max_in_flight, int(std::max( limit, size_t(1) )) ) ) );
+    }
+
+    /// Schedule the cache blocks that overlap the given bbox to be
+    /// generated in the background, in raster order.  Callers that
+    /// know their access pattern in advance can declare it by calling
+    /// this once for each region, in the order they will be read.
+    /// Has no effect unless prefetching is enabled.
+    void prefetch( BBox2i const& bbox ) const {
+      if( ! m_prefetcher || ! m_prefetcher->enabled() ) return;
+      BBox2i region = bbox;
+      region.crop( BBox2i(0,0,cols(),rows()) );
+      if( region.empty() ) return;
+      std::vector<int> indices;
+      for( int32 iy = region.min().y()/m_block_size.y(); iy <= (region.max().y()-1)/m_block_size.y(); ++iy )
+        for( int32 ix = region.min().x()/m_block_size.x(); ix <= (region.max().x()-1)/m_block_size.x(); ++ix )
+          indices.push_back( ix + iy*m_table_width );
+      m_prefetcher->request( indices );
+    }
+
   private:
     // These function objects are spawned to rasterize the child image.
     // One functor is created per child thread, and they are called 
@@ -101,10 +141,11 @@ namespace vw {
     class RasterizeFunctor {
       BlockRasterizeView const& m_view;
       DestT const& m_dest;
+      BBox2i m_total_bbox;
       Vector2i m_offset;
     public:
-      RasterizeFunctor( BlockRasterizeView const& view, DestT const& dest, Vector2i const& offset )
-        : m_view(view), m_dest(dest), m_offset(offset) {}
+      RasterizeFunctor( BlockRasterizeView const& view, DestT const& dest, BBox2i const& total_bbox )
+        : m_view(view), m_dest(dest), m_total_bbox(total_bbox), m_offset(total_bbox.min()) {}
       void operator()( BBox2i const& bbox ) const {
 #if VW_DEBUG_LEVEL > 1
         vw_out(VerboseDebugMessage, "image") << "BlockRasterizeView::RasterizeFunctor( " << bbox << " )" << std::endl;
@@ -117,6 +158,8 @@ namespace vw {
             vw_throw(LogicErr() << "BlockRasterizeView::RasterizeFunctor: bbox spans more than one cache block!");
           }
 #endif
+          if( m_view.m_prefetcher && m_view.m_prefetcher->enabled() )
+            m_view.predict( m_total_bbox, ix, iy );
           m_view.block(ix,iy)->rasterize( crop( m_dest, bbox-m_offset ), bbox-Vector2i(ix*m_view.m_block_size.x(),iy*m_view.m_block_size.y()) );
         }
         else m_view.child().rasterize( crop( m_dest, bbox-m_offset ), bbox );
@@ -148,6 +191,144 @@ namespace vw {
       }
     };
 
+    // Generates cache blocks in the background on the thread pool.
+    // It is shared between copies of the view, like the block table.
+    // Destroying it waits for the blocks in flight, so that they never
+    // outlive the view (or the cache).
+    class Prefetcher : private boost::noncopyable {
+      typedef std::vector<Cache::Handle<BlockGenerator> > table_type;
+      boost::shared_ptr<table_type> m_block_table;
+      Mutex m_mutex;
+      Condition m_idle_event;
+      std::deque<int> m_queue;
+      std::vector<bool> m_requested; // Queued or in flight
+      int m_in_flight;
+      volatile int m_max_in_flight;
+
+      class FetchTask : public Task {
+        Prefetcher *m_prefetcher;
+        int m_index;
+      public:
+        FetchTask( Prefetcher *prefetcher, int index )
+          : m_prefetcher(prefetcher), m_index(index) {}
+        virtual ~FetchTask() {}
+        virtual void operator()() { m_prefetcher->fetch( m_index ); }
+      };
+
+      void fetch( int index ) {
+        try {
+          // Reading the block through the cache is all it takes.  A
+          // block that is already there is left alone, so that a
+          // prediction doesn't count as a cache hit.
+          Cache::Handle<BlockGenerator> const& handle = (*m_block_table)[index];
+          if( ! handle.valid() )
+            boost::shared_ptr<ImageView<pixel_type> > block = handle;
+        } catch( std::exception const& e ) {
+          // The reader will see the same error when it gets here.
+          vw_out(DebugMessage, "image") << "BlockRasterizeView: prefetch failed: " << e.what() << "\n";
+        }
+        Mutex::Lock lock(m_mutex);
+        m_in_flight--;
+        m_requested[index] = false;
+        issue();
+        if( m_in_flight == 0 )
+          m_idle_event.notify_all();
+      }
+
+      // Must be called with the mutex held.
+      void issue() {
+        while( m_in_flight < m_max_in_flight && ! m_queue.empty() ) {
+          int index = m_queue.front();
+          m_queue.pop_front();
+          m_in_flight++;
+          vw_thread_pool().add_blocking_task( boost::shared_ptr<Task>( new FetchTask( this, index ) ) );
+        }
+      }
+
+    public:
+      Prefetcher( boost::shared_ptr<table_type> const& block_table )
+        : m_block_table(block_table), m_requested(block_table->size(), false),
+          m_in_flight(0), m_max_in_flight(0) {}
+
+      ~Prefetcher() {
+        Mutex::Lock lock(m_mutex);
+        m_max_in_flight = 0;
+        m_queue.clear();
+        while( m_in_flight > 0 )
+          m_idle_event.wait(lock);
+      }
+
+      bool enabled() const { return m_max_in_flight > 0; }
+      int max_in_flight() const { return m_max_in_flight; }
+
+      void set_max_in_flight( int max_in_flight ) {
+        Mutex::Lock lock(m_mutex);
+        m_max_in_flight = max_in_flight;
+        if( max_in_flight == 0 ) {
+          for( size_t i = 0; i < m_queue.size(); ++i )
+            m_requested[m_queue[i]] = false;
+          m_queue.clear();
+        }
+        issue();
+      }
+
+      // Queue the given blocks, skipping any that are already queued.
+      // Predictions that the reader has overtaken are dropped from the
+      // front once the queue gets long.
+      void request( std::vector<int> const& indices ) {
+        Mutex::Lock lock(m_mutex);
+        if( ! m_max_in_flight ) return;
+        for( size_t i = 0; i < indices.size(); ++i ) {
+          if( m_requested[indices[i]] ) continue;
+          m_requested[indices[i]] = true;
+          m_queue.push_back( indices[i] );
+        }
+        size_t max_queued = 4 * size_t(m_max_in_flight) + indices.size();
+        while( m_queue.size() > max_queued ) {
+          m_requested[m_queue.front()] = false;
+          m_queue.pop_front();
+        }
+        issue();
+      }
+    };
+
+    // Request the blocks that follow block (ix,iy) when rasterizing
+    // the given bbox.  The BlockProcessor visits blocks in raster order
+    // within the bbox; after that we guess that the caller will move
+    // on to the next region of the same size, in raster order.
+    void predict( BBox2i const& total_bbox, int32 ix, int32 iy ) const {
+      int32 bx0 = total_bbox.min().x()/m_block_size.x(), bx1 = (total_bbox.max().x()-1)/m_block_size.x();
+      int32 by0 = total_bbox.min().y()/m_block_size.y(), by1 = (total_bbox.max().y()-1)/m_block_size.y();
+      int32 region_width = bx1-bx0+1, region_height = by1-by0+1;
+      int count = m_prefetcher->max_in_flight() + m_num_threads;
+
+      std::vector<int> indices;
+      while( count > 0 ) {
+        if( ++ix > bx1 ) {
+          ix = bx0;
+          if( ++iy > by1 ) {
+            // Move on to the next region.
+            if( bx1+1 < m_table_width ) {
+              bx0 = bx1+1;
+              iy = by0;
+            } else {
+              bx0 = 0;
+              by0 = by1+1;
+              by1 = by0+region_height-1;
+              iy = by0;
+            }
+            bx1 = bx0+region_width-1;
+            ix = bx0;
+            if( by0 >= m_table_height ) break;
+          }
+        }
+        if( ix < 0 || iy < 0 || ix >= m_table_width || iy >= m_table_height ) continue;
+        indices.push_back( ix + iy*m_table_width );
+        --count;
+      }
+      m_prefetcher->request( indices );
+    }
+
     void initialize() {
       if( m_block_size.x() <= 0 || m_block_size.y() <= 0 ) {
         const int32 default_blocksize = 2*1024*1024; // 2 megabytes
@@ -172,6 +353,8 @@ namespace vw {
             block(ix,iy) = m_cache_ptr->insert( BlockGenerator( m_child, bbox ) );
           }
         }
+        if( m_block_table->size() > 1 )
+          m_prefetcher.reset( new Prefetcher( m_block_table ) );
       }
     }
 
@@ -192,6 +375,7 @@ namespace vw {
     // We store this by shared pointer so copying a BlockRasterizeView 
     // (i.e. to promote its scope) is not as expensive an operation.
     boost::shared_ptr<std::vector<Cache::Handle<BlockGenerator> > > m_block_table;
+    boost::shared_ptr<Prefetcher> m_prefetcher;
   };
   
   template <class ImageT>
@@ -16,7 +16,9 @@
 
 #include <vector>
 #include <iterator>
+#include <algorithm>
 
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Manipulation.h>
 #include <vw/Image/EdgeExtension.h>
@@ -74,6 +76,92 @@ namespace vw {
     return result;
   }
 
+  // The separable convolution view evaluates each axis a whole row at
+  // a time, rather than one pixel at a time through accessors.  A row
+  // of an ImageView is just an array of channels, so the inner loops
+  // below run over plain arrays and the compiler can vectorize them.
+
+  // A 1D kernel prepared for correlate_rows().  The taps are reversed,
+  // so that correlating with them computes the convolution, and an
+  // empty kernel becomes the identity.
+  template <class KernelT>
+  struct RowCorrelationKernel {
+    std::vector<KernelT> taps;
+    bool symmetric, box;
+
+    RowCorrelationKernel( std::vector<KernelT> const& kernel ) : taps( kernel.rbegin(), kernel.rend() ) {
+      if( taps.empty() ) taps.push_back( KernelT(1) );
+      int32 n = taps.size();
+      symmetric = box = true;
+      for( int32 t=0; t<n; ++t ) {
+        if( taps[t] != taps[n-1-t] ) symmetric = false;
+        if( taps[t] != taps[0] ) box = false;
+      }
+      // Running sums only pay off for wider boxes.
+      if( n < 5 ) box = false;
+    }
+
+    int32 size() const { return taps.size(); }
+  };
+
+  // Sets out[i] to the sum over t of kernel.taps[t]*rows[t][i] for i
+  // in [0,n).  A symmetric kernel takes half as many multiplies.
+  template <class AccumT, class ChannelT, class KernelT>
+  void correlate_rows( AccumT *out, ChannelT const* const* rows, int32 n, RowCorrelationKernel<KernelT> const& kernel ) {
+    int32 taps = kernel.size();
+    std::fill( out, out+n, AccumT() );
+    if( kernel.symmetric ) {
+      for( int32 t=0; t<taps/2; ++t ) {
+        AccumT k = kernel.taps[t];
+        ChannelT const* a = rows[t];
+        ChannelT const* b = rows[taps-1-t];
+        for( int32 i=0; i<n; ++i )
+          out[i] += k * (AccumT(a[i]) + AccumT(b[i]));
+      }
+      if( taps%2 ) {
+        AccumT k = kernel.taps[taps/2];
+        ChannelT const* a = rows[taps/2];
+        for( int32 i=0; i<n; ++i )
+          out[i] += k * AccumT(a[i]);
+      }
+    }
+    else {
+      for( int32 t=0; t<taps; ++t ) {
+        AccumT k = kernel.taps[t];
+        ChannelT const* a = rows[t];
+        for( int32 i=0; i<n; ++i )
+          out[i] += k * AccumT(a[i]);
+      }
+    }
+  }
+
+  // Sets out[i] to the sum of the taps channels src[i], src[i+stride],
+  // ..., for i in [0,n), with a running sum.  This makes the cost of
+  // a box kernel independent of its width.
+  template <class ChannelT>
+  void box_sum_row( double *out, ChannelT const* src, int32 n, int32 stride, int32 taps ) {
+    for( int32 i=0; i<stride && i<n; ++i ) {
+      double sum = 0;
+      for( int32 t=0; t<taps; ++t ) sum += src[i+t*stride];
+      out[i] = sum;
+    }
+    for( int32 i=stride; i<n; ++i )
+      out[i] = out[i-stride] + (double(src[i-stride+taps*stride]) - double(src[i-stride]));
+  }
+
+  // Converts a row of sums back to channels, scaling by k.
+  template <class ChannelT, class AccumT, class ScaleT>
+  inline void cast_row( ChannelT *out, AccumT const* in, int32 n, ScaleT k ) {
+    for( int32 i=0; i<n; ++i )
+      out[i] = channel_cast_clamp_if_int<ChannelT>( k * in[i] );
+  }
+
+  template <class ChannelT, class AccumT>
+  inline void cast_row( ChannelT *out, AccumT const* in, int32 n ) {
+    for( int32 i=0; i<n; ++i )
+      out[i] = channel_cast_clamp_if_int<ChannelT>( in[i] );
+  }
+
   /// \endcond
 
 
@@ -254,12 +342,138 @@ namespace vw {
     // MultiplyAccessible.  In practice that turns out to be a pain to 
     // get right, and convolution is generally a much more expensive 
     // operation than a single extra copy.
+    //
+    // Images of plain (unmasked) pixels are convolved in horizontal
+    // strips, sized so that each strip's source rows and intermediate
+    // results stay in cache, and a row at a time within each strip.
+    // When the destination is in memory and the child may be read from
+    // several threads at once (see IsThreadSafeView), the strips are
+    // convolved in parallel on the thread pool, and the first error
+    // thrown while rasterizing the child is rethrown here by
+    // TaskGroup::join().  Other children are convolved a strip at a
+    // time on the calling thread.
+    // Masked pixels go through the pixel accessors instead.
     template <class DestT>
     void rasterize( DestT const& dest, BBox2i bbox ) const {
-      int32 ni = m_i_kernel.size(), nj = m_j_kernel.size();
-      if( ni==0 && nj==0 ) {
+      if( m_i_kernel.size()==0 && m_j_kernel.size()==0 ) {
         return edge_extend(m_image,m_edge).rasterize(dest,bbox);
       }
+      rasterize_( dest, bbox, boost::mpl::integral_c<bool, IsScalarOrCompound<pixel_type>::value &&
+                                                           !IsMasked<pixel_type>::value>() );
+    }
+
+    // The number of bytes of source and intermediate pixels that each
+    // strip aims to touch: roughly the size of a typical L2 cache.
+    static const size_t strip_bytes = 256*1024;
+
+    template <class DestT>
+    void rasterize_( DestT const& dest, BBox2i const& bbox, true_type ) const {
+      RowCorrelationKernel<KernelT> ik( m_i_kernel ), jk( m_j_kernel );
+
+      // Neighboring strips both read the jk.size()-1 source rows
+      // between them, so the strips are kept tall enough that those
+      // rows are not a large fraction of the work.
+      size_t row_bytes = size_t( 2*bbox.width() + ik.size() ) * sizeof(pixel_type) * planes();
+      int32 strip = int32( strip_bytes / row_bytes ) - (jk.size()-1);
+      strip = std::max( strip, std::max( 16, 2*(jk.size()-1) ) );
+      strip = std::min( strip, bbox.height() );
+
+      if( !IsRowAccessible<DestT>::value || !IsThreadSafeView<ImageT>::value || strip == bbox.height() ) {
+        for( int32 y=0; y<bbox.height(); y+=strip )
+          convolve_strip( dest, bbox, y, std::min( y+strip, bbox.height() ), ik, jk );
+        return;
+      }
+      TaskGroup group;
+      for( int32 y=0; y<bbox.height(); y+=strip )
+        group.add_task( boost::shared_ptr<Task>( new StripTask<DestT>( *this, dest, bbox, y, std::min( y+strip, bbox.height() ), ik, jk ) ) );
+      group.join();
+    }
+
+    // Convolves rows [y0,y1) of the bbox into the same rows of dest,
+    // reading only the part of the source that they need.
+    template <class DestT>
+    void convolve_strip( DestT const& dest, BBox2i const& bbox, int32 y0, int32 y1,
+                         RowCorrelationKernel<KernelT> const& ik, RowCorrelationKernel<KernelT> const& jk ) const {
+      typedef typename CompoundChannelType<pixel_type>::type channel_type;
+      typedef typename ProductType<channel_type, KernelT>::type accum_type;
+      const int32 nc = CompoundNumChannels<pixel_type>::value;
+      int32 ni = m_i_kernel.size(), nj = m_j_kernel.size();
+
+      BBox2i src_bbox( bbox.min().x() - (ni?(ni-m_ci-1):0), bbox.min().y() + y0 - (nj?(nj-m_cj-1):0),
+                       bbox.width() + ik.size() - 1, y1 - y0 + jk.size() - 1 );
+      ImageView<pixel_type> src = edge_extend( m_image, src_bbox, m_edge );
+      ImageView<pixel_type> out( bbox.width(), y1 - y0, src.planes() );
+
+      // Each row is treated as one array of n channels.
+      int32 n = bbox.width() * nc;
+      std::vector<channel_type> work( size_t(n) * src.rows() );
+      std::vector<accum_type> accum( n );
+      std::vector<double> sums( n );
+      std::vector<channel_type const*> rows( std::max( ik.size(), jk.size() ) );
+
+      for( int32 p=0; p<src.planes(); ++p ) {
+        for( int32 y=0; y<src.rows(); ++y ) {
+          channel_type const* s = reinterpret_cast<channel_type const*>( &src(0,y,p) );
+          channel_type *w = &work[size_t(y)*n];
+          if( ik.box ) {
+            box_sum_row( &sums[0], s, n, nc, ik.size() );
+            cast_row( w, &sums[0], n, ik.taps[0] );
+          }
+          else {
+            for( int32 t=0; t<ik.size(); ++t ) rows[t] = s + t*nc;
+            correlate_rows( &accum[0], &rows[0], n, ik );
+            cast_row( w, &accum[0], n );
+          }
+        }
+
+        for( int32 y=0; y<out.rows(); ++y ) {
+          channel_type *o = reinterpret_cast<channel_type*>( &out(0,y,p) );
+          if( jk.box ) {
+            if( y==0 ) {
+              std::fill( sums.begin(), sums.end(), 0.0 );
+              for( int32 t=0; t<jk.size(); ++t ) {
+                channel_type const* w = &work[size_t(t)*n];
+                for( int32 i=0; i<n; ++i ) sums[i] += w[i];
+              }
+            }
+            else {
+              channel_type const* add = &work[size_t(y+jk.size()-1)*n];
+              channel_type const* sub = &work[size_t(y-1)*n];
+              for( int32 i=0; i<n; ++i ) sums[i] += double(add[i]) - double(sub[i]);
+            }
+            cast_row( o, &sums[0], n, jk.taps[0] );
+          }
+          else {
+            for( int32 t=0; t<jk.size(); ++t ) rows[t] = &work[size_t(y+t)*n];
+            correlate_rows( &accum[0], &rows[0], n, jk );
+            cast_row( o, &accum[0], n );
+          }
+        }
+      }
+
+      vw::rasterize( out, crop( dest, 0, y0, out.cols(), out.rows() ), BBox2i( 0, 0, out.cols(), out.rows() ) );
+    }
+
+    template <class DestT>
+    class StripTask : public Task {
+      SeparableConvolutionView const& m_view;
+      DestT const& m_dest;
+      BBox2i m_bbox;
+      int32 m_y0, m_y1;
+      RowCorrelationKernel<KernelT> const& m_ik;
+      RowCorrelationKernel<KernelT> const& m_jk;
+    public:
+      StripTask( SeparableConvolutionView const& view, DestT const& dest, BBox2i const& bbox, int32 y0, int32 y1,
+                 RowCorrelationKernel<KernelT> const& ik, RowCorrelationKernel<KernelT> const& jk )
+        : m_view(view), m_dest(dest), m_bbox(bbox), m_y0(y0), m_y1(y1), m_ik(ik), m_jk(jk) {}
+      virtual ~StripTask() {}
+      virtual void operator()() { m_view.convolve_strip( m_dest, m_bbox, m_y0, m_y1, m_ik, m_jk ); }
+    };
+
+    // The original implementation, one pixel at a time.
+    template <class DestT>
+    void rasterize_( DestT const& dest, BBox2i const& bbox, false_type ) const {
+      int32 ni = m_i_kernel.size(), nj = m_j_kernel.size();
       BBox2i child_bbox = bbox;
       child_bbox.min() -= Vector2i( ni?(ni-m_ci-1):0, nj?(nj-m_cj-1):0 );
       child_bbox.max() += Vector2i( ni?m_ci:0, nj?m_cj:0 );
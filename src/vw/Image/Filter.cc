@@ -22,6 +22,9 @@ namespace vw {
   template void generate_gaussian_kernel<float>( std::vector<float>& kernel, double sigma, int32 size );
   template void generate_gaussian_kernel<double>( std::vector<double>& kernel, double sigma, int32 size );
 
+  template void generate_box_kernel<float>( std::vector<float>& kernel, double sigma, int32 pass, int32 passes );
+  template void generate_box_kernel<double>( std::vector<double>& kernel, double sigma, int32 pass, int32 passes );
+
   template void generate_derivative_kernel<float>( std::vector<float>& kernel, int32 deriv, int32 size );
   template void generate_derivative_kernel<double>( std::vector<double>& kernel, int32 deriv, int32 size );
 
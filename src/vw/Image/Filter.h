@@ -43,6 +43,13 @@ namespace vw {
   template <class KernelT>
   void generate_gaussian_kernel( std::vector<KernelT>& kernel, double sigma, int32 size=0 );
 
+  /// Computes the kernel for one of several box filters whose
+  /// repeated application approximates a Gaussian.  Pass is in the
+  /// range [0,passes).  Instantiated by default only for float and
+  /// double kernels.
+  template <class KernelT>
+  void generate_box_kernel( std::vector<KernelT>& kernel, double sigma, int32 pass, int32 passes );
+
   /// Computes a differentiation kernel.
   /// Instantiated by default only for float and double kernels.
   template <class KernelT>
@@ -121,6 +128,8 @@ namespace vw {
   /// and end() methods, including an std::vector or a vw::ImageView.  
   /// It assumes the origin of the kernel is at the point <CODE>(cx,cy)</CODE> and uses the given 
   /// edge extension mode to extend the source image as needed.
+  /// Large regions are convolved on the thread pool when the source is known to be safe to 
+  /// read from several threads at once; see vw::IsThreadSafeView.
   template <class SrcT, class KRangeT, class EdgeT>
   inline SeparableConvolutionView<SrcT,typename KRangeT::value_type,EdgeT>
   separable_convolution_filter( ImageViewBase<SrcT> const& src, KRangeT const& x_kernel, KRangeT const& y_kernel, int32 cx, int32 cy, EdgeT edge ) {
@@ -218,6 +227,51 @@ namespace vw {
   }
 
 
+  /// The type returned by box_gaussian_filter(): the source image, with
+  /// its channels cast to the kernel type, filtered by three boxes in
+  /// turn.
+  template <class SrcT, class EdgeT>
+  struct BoxGaussianFilterType {
+    typedef typename DefaultKernelT<typename SrcT::pixel_type>::type kernel_type;
+    typedef UnaryPerPixelView<SrcT, PixelChannelCastFunctor<kernel_type> > cast_type;
+    typedef SeparableConvolutionView<cast_type, kernel_type, EdgeT> pass1_type;
+    typedef SeparableConvolutionView<pass1_type, kernel_type, EdgeT> pass2_type;
+    typedef SeparableConvolutionView<pass2_type, kernel_type, EdgeT> type;
+  };
+
+  /// This function approximates a Gaussian smoothing filter with three
+  /// passes of box filters.  A box filter costs the same no matter how
+  /// wide it is, so once sigma is more than about ten pixels this is
+  /// faster than gaussian_filter(), whose kernel grows with sigma.  The
+  /// result is within a few percent of the true Gaussian, except near
+  /// the edges of the image, where each pass extends its input with
+  /// the given edge extension mode.  The result has floating point
+  /// channels, so that the passes do not accumulate rounding errors.
+  template <class SrcT, class EdgeT>
+  typename BoxGaussianFilterType<SrcT,EdgeT>::type
+  inline box_gaussian_filter( ImageViewBase<SrcT> const& src, double x_sigma, double y_sigma, EdgeT edge ) {
+    typedef BoxGaussianFilterType<SrcT,EdgeT> types;
+    typedef typename types::kernel_type kernel_type;
+    std::vector<kernel_type> x_kernel[3], y_kernel[3];
+    for( int32 pass=0; pass<3; ++pass ) {
+      generate_box_kernel( x_kernel[pass], x_sigma, pass, 3 );
+      generate_box_kernel( y_kernel[pass], y_sigma, pass, 3 );
+    }
+    typename types::pass1_type pass1( channel_cast<kernel_type>( src ), x_kernel[0], y_kernel[0], edge );
+    typename types::pass2_type pass2( pass1, x_kernel[1], y_kernel[1], edge );
+    return typename types::type( pass2, x_kernel[2], y_kernel[2], edge );
+  }
+
+  /// This is an overloaded function provided for convenience; see vw::box_gaussian_filter.
+  /// It uses the same standard deviation in both directions and the
+  /// default vw::ConstantEdgeExtension mode.
+  template <class SrcT>
+  typename BoxGaussianFilterType<SrcT,ConstantEdgeExtension>::type
+  inline box_gaussian_filter( ImageViewBase<SrcT> const& src, double sigma ) {
+    return box_gaussian_filter( src, sigma, sigma, ConstantEdgeExtension() );
+  }
+
+
   // Image differentiation functions
 
   /// Applies a differentiation filter to an image.  This function
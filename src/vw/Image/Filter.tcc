@@ -72,6 +72,29 @@ void vw::generate_gaussian_kernel( std::vector<KernelT>& kernel, double sigma, i
 }
 
 
+/// Compute one of the box kernels that approximate a Gaussian.  The
+/// passes use two odd widths, wl and wl+2, and the number of passes of
+/// each is chosen so that the total variance matches sigma^2 as
+/// closely as possible.  See W. Wells, "Efficient synthesis of
+/// Gaussian filters by cascaded uniform filters", PAMI 1986.
+template <class KernelT>
+void vw::generate_box_kernel( std::vector<KernelT>& kernel, double sigma, int32 pass, int32 passes )
+{
+  VW_ASSERT( passes > 0 && pass >= 0 && pass < passes,
+             ArgumentErr() << "generate_box_kernel: invalid pass " << pass << " of " << passes << "." );
+  if( sigma == 0 ) {
+    kernel.clear();
+    return;
+  }
+  double var = 12 * sigma * sigma;
+  int32 wl = (int32) floor( sqrt( var / passes + 1 ) );
+  if( wl%2 == 0 ) wl -= 1;
+  int32 m = (int32) floor( (var - passes*wl*wl - 4*passes*wl - 3*passes) / (-4.0*wl - 4) + 0.5 );
+  int32 width = pass < m ? wl : wl+2;
+  kernel.assign( width, KernelT(1.0/width) );
+}
+
+
 // Compute a differentiation kernel.
 //
 // Assume that only the n lowest-order terms of the Taylor expansion
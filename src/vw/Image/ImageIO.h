@@ -14,6 +14,7 @@
 #define __VW_IMAGE_IMAGEIO_H__
 
 #include <vw/Core/ProgressCallback.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageResource.h>
 #include <vw/Image/ImageView.h>
@@ -160,11 +161,27 @@ namespace vw {
       virtual ~WriteBlockTask() {}
       virtual void operator() () {
         vw_out(DebugMessage, "image") << "Writing block " << m_idx << " at " << m_bbox << "\n";
-        m_resource.write( m_image_block.buffer(), m_bbox );
+        // Later blocks wait for this one, so it counts as written even
+        // if the write fails.
+        try {
+          m_resource.write( m_image_block.buffer(), m_bbox );
+        } catch (...) {
+          m_write_finish_event.notify();
+          throw;
+        }
         m_write_finish_event.notify();
       }
     };
 
+    // Stands in for the write of a block that failed to rasterize, so
+    // that the blocks after it are still written.
+    class SkipBlockTask : public Task {
+      CountingSemaphore& m_write_finish_event;
+    public:
+      SkipBlockTask(CountingSemaphore& write_finish_event) : m_write_finish_event(write_finish_event) {}
+      virtual void operator() () { m_write_finish_event.notify(); }
+    };
+
     // -----------------------------
 
     template <class ViewT>
@@ -194,7 +211,13 @@ namespace vw {
         
         vw_out(DebugMessage, "image") << "Rasterizing block " << m_index << " at " << m_bbox << "\n";
         // Rasterize the block
-        ImageView<typename ViewT::pixel_type> image_block( crop(m_image, m_bbox) );
+        ImageView<typename ViewT::pixel_type> image_block;
+        try {
+          image_block = crop(m_image, m_bbox);
+        } catch (...) {
+          m_parent.add_write_task( boost::shared_ptr<Task>( new SkipBlockTask( m_write_finish_event ) ), m_index );
+          throw;
+        }
 
         // Report progress
         m_progress_callback.report_incremental_progress(1.0);
@@ -227,14 +250,251 @@ namespace vw {
       this->add_rasterize_task(task);
     }
 
+    /// Wait for every block to be written, then rethrow the first
+    /// error from rasterizing or writing any of them.
+    void process_blocks() {
+      try {
+        m_rasterize_work_queue->join_all();
+      } catch (...) {
+        try { m_write_work_queue->join_all(); } catch (...) {}
+        throw;
+      }
+      m_write_work_queue->join_all();
+    }
+  };
+
+
+  /// Timing for one block written by UnorderedBlockWriter, in seconds.
+  struct BlockWriteTiming {
+    int index;
+    BBox2i bbox;
+    double wait;      // Waiting for room under the memory ceiling
+    double rasterize; // Rasterizing the block
+    double queue;     // Waiting for the writer
+    double write;     // Writing the block to the resource
+  };
+
+  // This task generator writes each block as soon as it has been
+  // rasterized, for resources that accept blocks in any order (see
+  // ImageResource::has_random_block_write()).  A slow block then only
+  // holds up itself.
+  //
+  // Rasterized blocks wait in memory for the single writer.  When the
+  // blocks that are being rasterized or waiting to be written add up
+  // to the memory ceiling, rasterization tasks wait for writes to
+  // finish before they start on a new block.
+  //
+  class UnorderedBlockWriter : private boost::noncopyable {
+
+    boost::shared_ptr<FifoWorkQueue> m_rasterize_work_queue;
+    boost::shared_ptr<FifoWorkQueue> m_write_work_queue;
+    size_t m_max_pending_bytes, m_pending_bytes;
+    Mutex m_mutex;
+    Condition m_budget_event;
+    std::vector<BlockWriteTiming> m_timings;
+
+    static double seconds_since( unsigned long long start ) {
+      return (Stopwatch::microtime() - start) / 1.0e6;
+    }
+
+    // Wait until there is room for another block.  A block is always
+    // allowed when nothing else is pending, so one block larger than
+    // the ceiling can't stall the writer forever.
+    void reserve( size_t bytes ) {
+      Mutex::Lock lock(m_mutex);
+      while( m_pending_bytes > 0 && m_pending_bytes + bytes > m_max_pending_bytes )
+        m_budget_event.wait(lock);
+      m_pending_bytes += bytes;
+    }
+
+    void release( size_t bytes ) {
+      {
+        Mutex::Lock lock(m_mutex);
+        m_pending_bytes -= bytes;
+      }
+      m_budget_event.notify_all();
+    }
+
+    void add_timing( BlockWriteTiming const& timing ) {
+      Mutex::Lock lock(m_mutex);
+      m_timings.push_back( timing );
+    }
+
+    // Room for one block under the memory ceiling.  It is given back
+    // when the last owner lets go of it, whether or not the block was
+    // rasterized and written.
+    class Reservation : private boost::noncopyable {
+      UnorderedBlockWriter &m_parent;
+      size_t m_bytes;
+    public:
+      Reservation( UnorderedBlockWriter &parent, size_t bytes ) : m_parent(parent), m_bytes(bytes) {
+        m_parent.reserve( m_bytes );
+      }
+      ~Reservation() { m_parent.release( m_bytes ); }
+    };
+
+    // ----------------------------- TASK TYPES (2) --------------------------
+
+    template <class PixelT>
+    class WriteBlockTask : public Task {
+      UnorderedBlockWriter &m_parent;
+      ImageResource& m_resource;
+      boost::shared_ptr<Reservation> m_reservation;
+      ImageView<PixelT> m_image_block;
+      BlockWriteTiming m_timing;
+      unsigned long long m_queued;
+
+    public:
+      WriteBlockTask(UnorderedBlockWriter &parent, ImageResource& resource,
+                     boost::shared_ptr<Reservation> const& reservation,
+                     ImageView<PixelT> const& image_block, BlockWriteTiming const& timing) :
+        m_parent(parent), m_resource(resource), m_reservation(reservation),
+        m_image_block(image_block), m_timing(timing), m_queued(Stopwatch::microtime()) {}
+
+      virtual ~WriteBlockTask() {}
+      virtual void operator() () {
+        // Take the block and its reservation, so that both are freed
+        // (the block first) as soon as this returns or throws.
+        boost::shared_ptr<Reservation> reservation;
+        reservation.swap( m_reservation );
+        ImageView<PixelT> image_block = m_image_block;
+        m_image_block.reset();
+
+        unsigned long long start = Stopwatch::microtime();
+        m_timing.queue = (start - m_queued) / 1.0e6;
+        vw_out(DebugMessage, "image") << "Writing block " << m_timing.index << " at " << m_timing.bbox << "\n";
+        m_resource.write( image_block.buffer(), m_timing.bbox );
+        m_timing.write = seconds_since(start);
+        m_parent.add_timing( m_timing );
+      }
+    };
+
+    // -----------------------------
+
+    template <class ViewT>
+    class RasterizeBlockTask : public Task {
+      UnorderedBlockWriter &m_parent;
+      ImageResource& m_resource;
+      ViewT const& m_image;
+      BBox2i m_bbox;
+      int m_index;
+      SubProgressCallback m_progress_callback;
+
+    public:
+      RasterizeBlockTask(UnorderedBlockWriter &parent, ImageResource& resource,
+                         ImageViewBase<ViewT> const& image, BBox2i const& bbox,
+                         int index, int total_num_blocks,
+                         const ProgressCallback &progress_callback = ProgressCallback::dummy_instance()) :
+      m_parent(parent), m_resource(resource), m_image(image.impl()), m_bbox(bbox), m_index(index),
+        m_progress_callback(progress_callback,0.0,1.0/float(total_num_blocks)) {}
+
+      virtual ~RasterizeBlockTask() {}
+      virtual void operator()() {
+        typedef typename ViewT::pixel_type pixel_type;
+        BlockWriteTiming timing;
+        timing.index = m_index;
+        timing.bbox = m_bbox;
+        timing.queue = timing.write = 0;
+
+        unsigned long long start = Stopwatch::microtime();
+        boost::shared_ptr<Reservation> reservation(
+          new Reservation( m_parent, m_bbox.width() * m_bbox.height() * m_image.planes() * sizeof(pixel_type) ) );
+        timing.wait = seconds_since(start);
+
+        vw_out(DebugMessage, "image") << "Rasterizing block " << m_index << " at " << m_bbox << "\n";
+        start = Stopwatch::microtime();
+        ImageView<pixel_type> image_block( crop(m_image, m_bbox) );
+        timing.rasterize = seconds_since(start);
+
+        m_progress_callback.report_incremental_progress(1.0);
+
+        boost::shared_ptr<Task> write_task( new WriteBlockTask<pixel_type>( m_parent, m_resource, reservation, image_block, timing ) );
+        m_parent.add_write_task( write_task );
+      }
+    };
+
+    // -----------------------------
+
+    void add_write_task(boost::shared_ptr<Task> task) { m_write_work_queue->add_task(task); }
+
+  public:
+    /// Create a writer that keeps at most max_pending_bytes of
+    /// rasterized blocks in memory.
+    UnorderedBlockWriter( size_t max_pending_bytes ) :
+      m_max_pending_bytes(max_pending_bytes), m_pending_bytes(0) {
+      m_rasterize_work_queue = boost::shared_ptr<FifoWorkQueue>( new FifoWorkQueue() );
+      m_write_work_queue = boost::shared_ptr<FifoWorkQueue>( new FifoWorkQueue(1) );
+    }
+
+    // Add a block to be rasterized and written.  The index is only
+    // used for reporting.
+    template <class ViewT>
+    void add_block(ImageResource& resource, ImageViewBase<ViewT> const& image, BBox2i const& bbox, int index, int total_num_blocks,
+                   const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
+      boost::shared_ptr<Task> task( new RasterizeBlockTask<ViewT>(*this, resource, image, bbox, index, total_num_blocks, progress_callback) );
+      m_rasterize_work_queue->add_task(task);
+    }
+
+    /// Wait for every block to be written, then rethrow the first
+    /// error from rasterizing or writing any of them.
     void process_blocks() {
-      m_rasterize_work_queue->join_all();
+      try {
+        m_rasterize_work_queue->join_all();
+      } catch (...) {
+        try { m_write_work_queue->join_all(); } catch (...) {}
+        throw;
+      }
       m_write_work_queue->join_all();
     }
+
+    /// Timing for every block written so far, in the order in which
+    /// they were written.
+    std::vector<BlockWriteTiming> timings() {
+      Mutex::Lock lock(m_mutex);
+      return m_timings;
+    }
   };
 
+  namespace detail {
+    // Queue every block of the resource with the given block writer,
+    // from left to right, then top to bottom.
+    template <class WriterT, class ImageT>
+    void add_image_blocks( WriterT& block_writer, ImageResource& resource, ImageViewBase<ImageT> const& image,
+                           const ProgressCallback &progress_callback ) {
+      Vector2i block_size = resource.block_size();
+      int total_num_blocks = ((resource.rows()-1)/block_size.y()+1) * ((resource.cols()-1)/block_size.x()+1);
+      vw_out(DebugMessage,"image") << "ThreadedBlockWriter: writing " << total_num_blocks << " blocks.\n";
+
+      for (int32 j = 0; j < (int32)resource.rows(); j+= block_size.y()) {
+        for (int32 i = 0; i < (int32)resource.cols(); i+= block_size.x()) {
+
+          // Rasterize and save this image block
+          BBox2i current_bbox(Vector2i(i,j),
+                              Vector2i(std::min(i+block_size.x(),(int32)(resource.cols())),
+                                       std::min(j+block_size.y(),(int32)(resource.rows()))));
+
+          // Add a task to rasterize this image block.  A seperate task
+          // to write the results to disk is generated automatically
+          // when rasterization is complete.
+          int col_blocks = int( ceil(float(resource.cols())/float(block_size.x())) );
+          int i_block_index = int(i/block_size.x());
+          int j_block_index = int(j/block_size.y());
+          int index = j_block_index*col_blocks+i_block_index;
+
+          vw_out(VerboseDebugMessage,"image") << "ThreadedBlockWriter: Adding block " << index+1 << "/"<< total_num_blocks << " : " << current_bbox << "\n";
+          block_writer.add_block(resource, image, current_bbox, index, total_num_blocks, progress_callback );
+        }
+      }
+    }
+  }
 
   /// Write an image view to a resource.
+  ///
+  /// If the resource can be written in any order, blocks are written
+  /// as soon as they are ready, with at most write_pool_size() blocks'
+  /// worth of memory held for blocks waiting to be written.
+  /// Otherwise blocks are written in order, and rasterization stays
+  /// within write_pool_size() blocks of the last block written.
   template <class ImageT>
   void block_write_image( ImageResource& resource, ImageViewBase<ImageT> const& image,
                           const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
@@ -247,41 +507,22 @@ namespace vw {
     if (progress_callback.abort_requested())
       vw_throw( Aborted() << "Aborted by ProgressCallback" );
 
-    // Set up the threaded block writer object, which will manage
-    // rasterizing and writing images to disk one block (and one
-    // thread) at a time.
-    ThreadedBlockWriter block_writer;
-
-    // Write the image to disk in blocks.  We may need to revisit
-    // the order in which these blocks are rasterized, but for now
-    // it rasterizes blocks from left to right, then top to bottom.
-    Vector2i block_size = resource.block_size();
-    int total_num_blocks = ((resource.rows()-1)/block_size.y()+1) * ((resource.cols()-1)/block_size.x()+1);
-    vw_out(DebugMessage,"image") << "ThreadedBlockWriter: writing " << total_num_blocks << " blocks.\n";
-
-    for (int32 j = 0; j < (int32)resource.rows(); j+= block_size.y()) {
-      for (int32 i = 0; i < (int32)resource.cols(); i+= block_size.x()) {
-
-        // Rasterize and save this image block
-        BBox2i current_bbox(Vector2i(i,j),
-                            Vector2i(std::min(i+block_size.x(),(int32)(resource.cols())),
-                                     std::min(j+block_size.y(),(int32)(resource.rows()))));
-
-        // Add a task to rasterize this image block.  A seperate task
-        // to write the results to disk is generated automatically
-        // when rasterization is complete.
-        int col_blocks = int( ceil(float(resource.cols())/float(block_size.x())) );
-        int i_block_index = int(i/block_size.x());
-        int j_block_index = int(j/block_size.y());
-        int index = j_block_index*col_blocks+i_block_index;
-
-        vw_out(VerboseDebugMessage,"image") << "ThreadedBlockWriter: Adding block " << index+1 << "/"<< total_num_blocks << " : " << current_bbox << "\n";
-        block_writer.add_block(resource, image, current_bbox, index, total_num_blocks, progress_callback );
-      }
+    if (resource.has_random_block_write()) {
+      Vector2i block_size = resource.block_size();
+      size_t block_bytes = size_t(block_size.x()) * block_size.y() * image.impl().planes() * sizeof(typename ImageT::pixel_type);
+      UnorderedBlockWriter block_writer( vw_settings().write_pool_size() * block_bytes );
+      detail::add_image_blocks( block_writer, resource, image, progress_callback );
+      block_writer.process_blocks();
+    } else {
+      // Set up the threaded block writer object, which will manage
+      // rasterizing and writing images to disk one block (and one
+      // thread) at a time.
+      ThreadedBlockWriter block_writer;
+      detail::add_image_blocks( block_writer, resource, image, progress_callback );
+
+      // Start the threaded block writer and wait for all tasks to finish.
+      block_writer.process_blocks();
     }
-
-    // Start the threaded block writer and wait for all tasks to finish.
-    block_writer.process_blocks();
     progress_callback.report_finished();
   }
 
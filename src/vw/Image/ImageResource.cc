@@ -16,9 +16,10 @@
 #include <vector>
 #endif
 
-#include <map>
+#include <vector>
 
 #include <boost/integer_traits.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
 
 #include <vw/Core/Debugging.h>
 #include <vw/Image/PixelTypes.h>
@@ -28,318 +29,214 @@
 
 using namespace vw;
 
-typedef void (*channel_convert_func)(void* src, void* dest);
-
-template <class SrcT, class DestT>
-void channel_convert_cast( SrcT* src, DestT* dest ) {
-  *dest = DestT(*src);
-}
-
-void channel_convert_uint16_to_uint8( uint16* src, uint8* dest ) {
-  *dest = uint8( *src / (65535/255) );
-}
-
-void channel_convert_uint8_to_uint16( uint8* src, uint16* dest ) {
-  *dest = uint16( *src ) * (65535/255);
-}
+// Channel conversions, for each pair of channel types with and
+// without rescaling.  Rescaling maps the full range of an integer
+// type to [0,1] in a floating point type, and between uint8 and
+// uint16; all other conversions are plain casts.
+template <class SrcT, class DestT, bool RescaleV,
+          bool SrcFloatV = boost::is_floating_point<SrcT>::value,
+          bool DestFloatV = boost::is_floating_point<DestT>::value>
+struct ChannelConvert {
+  static inline DestT apply( SrcT src ) { return DestT(src); }
+};
 
 template <class SrcT, class DestT>
-void channel_convert_int_to_float( SrcT* src, DestT* dest ) {
-  *dest = DestT(*src) * (DestT(1.0)/boost::integer_traits<SrcT>::const_max);
-}
+struct ChannelConvert<SrcT,DestT,true,false,true> {
+  static inline DestT apply( SrcT src ) {
+    return DestT(src) * (DestT(1.0)/boost::integer_traits<SrcT>::const_max);
+  }
+};
 
 template <class SrcT, class DestT>
-void channel_convert_float_to_int( SrcT* src, DestT* dest ) {
-  if( *src > SrcT(1.0) ) *dest = boost::integer_traits<DestT>::const_max;
-  else if( *src < SrcT(0.0) ) *dest = DestT(0);
-  else *dest = DestT( *src * boost::integer_traits<DestT>::const_max );
-}
-
-std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func> *channel_convert_map = 0, *channel_convert_rescale_map = 0;
-
-class ChannelConvertMapEntry {
-  void initialize() {
-    if( !channel_convert_map )
-      channel_convert_map = new std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func>();
-    if( !channel_convert_rescale_map )
-      channel_convert_rescale_map = new std::map<std::pair<ChannelTypeEnum,ChannelTypeEnum>,channel_convert_func>();
-  }
-public:
-  template <class SrcT, class DstT>
-  ChannelConvertMapEntry( void (*func)(SrcT*,DstT*) ) {
-    initialize();
-    ChannelTypeEnum src = ChannelTypeID<SrcT>::value;
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_convert_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
-    channel_convert_rescale_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
-  }
-  template <class SrcT, class DstT>
-  ChannelConvertMapEntry( void (*func)(SrcT*,DstT*), void (*rescale_func)(SrcT*,DstT*) ) {
-    initialize();
-    ChannelTypeEnum src = ChannelTypeID<SrcT>::value;
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_convert_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)func;
-    channel_convert_rescale_map->operator[]( std::make_pair(src,dst) ) = (channel_convert_func)rescale_func;
+struct ChannelConvert<SrcT,DestT,true,true,false> {
+  static inline DestT apply( SrcT src ) {
+    return ( src > SrcT(1.0) ) ? DestT( boost::integer_traits<DestT>::const_max )
+         : ( src < SrcT(0.0) ) ? DestT(0)
+         : DestT( src * boost::integer_traits<DestT>::const_max );
   }
 };
 
-ChannelConvertMapEntry _conv_i8i8  ( &channel_convert_cast<int8,int8>   );
-ChannelConvertMapEntry _conv_i8u8  ( &channel_convert_cast<int8,uint8>  );
-ChannelConvertMapEntry _conv_i8i16 ( &channel_convert_cast<int8,int16>  );
-ChannelConvertMapEntry _conv_i8u16 ( &channel_convert_cast<int8,uint16> );
-ChannelConvertMapEntry _conv_i8i32 ( &channel_convert_cast<int8,int32>  );
-ChannelConvertMapEntry _conv_i8u32 ( &channel_convert_cast<int8,uint32> );
-ChannelConvertMapEntry _conv_i8i64 ( &channel_convert_cast<int8,int64>  );
-ChannelConvertMapEntry _conv_i8u64 ( &channel_convert_cast<int8,uint64> );
-ChannelConvertMapEntry _conv_i8f32 ( &channel_convert_cast<int8,float>, &channel_convert_int_to_float<int8,float>  );
-ChannelConvertMapEntry _conv_i8f64 ( &channel_convert_cast<int8,double>, &channel_convert_int_to_float<int8,double> );
-ChannelConvertMapEntry _conv_u8i8  ( &channel_convert_cast<uint8,int8>   );
-ChannelConvertMapEntry _conv_u8u8  ( &channel_convert_cast<uint8,uint8>  );
-ChannelConvertMapEntry _conv_u8i16 ( &channel_convert_cast<uint8,int16>  );
-ChannelConvertMapEntry _conv_u8u16 ( &channel_convert_cast<uint8,uint16>, &channel_convert_uint8_to_uint16 );
-ChannelConvertMapEntry _conv_u8i32 ( &channel_convert_cast<uint8,int32>  );
-ChannelConvertMapEntry _conv_u8u32 ( &channel_convert_cast<uint8,uint32> );
-ChannelConvertMapEntry _conv_u8i64 ( &channel_convert_cast<uint8,int64>  );
-ChannelConvertMapEntry _conv_u8u64 ( &channel_convert_cast<uint8,uint64> );
-ChannelConvertMapEntry _conv_u8f32 ( &channel_convert_cast<uint8,float>, &channel_convert_int_to_float<uint8,float>  );
-ChannelConvertMapEntry _conv_u8f64 ( &channel_convert_cast<uint8,double>, &channel_convert_int_to_float<uint8,double> );
-ChannelConvertMapEntry _conv_i16i8 ( &channel_convert_cast<int16,int8>   );
-ChannelConvertMapEntry _conv_i16u8 ( &channel_convert_cast<int16,uint8>  );
-ChannelConvertMapEntry _conv_i16i16( &channel_convert_cast<int16,int16>  );
-ChannelConvertMapEntry _conv_i16u16( &channel_convert_cast<int16,uint16> );
-ChannelConvertMapEntry _conv_i16i32( &channel_convert_cast<int16,int32>  );
-ChannelConvertMapEntry _conv_i16u32( &channel_convert_cast<int16,uint32> );
-ChannelConvertMapEntry _conv_i16i64( &channel_convert_cast<int16,int64>  );
-ChannelConvertMapEntry _conv_i16u64( &channel_convert_cast<int16,uint64> );
-ChannelConvertMapEntry _conv_i16f32( &channel_convert_cast<int16,float>, &channel_convert_int_to_float<int16,float>  );
-ChannelConvertMapEntry _conv_i16f64( &channel_convert_cast<int16,double>, &channel_convert_int_to_float<int16,double> );
-ChannelConvertMapEntry _conv_u16i8 ( &channel_convert_cast<uint16,int8>   );
-ChannelConvertMapEntry _conv_u16u8 ( &channel_convert_cast<uint16,uint8>, &channel_convert_uint16_to_uint8 );
-ChannelConvertMapEntry _conv_u16i16( &channel_convert_cast<uint16,int16>  );
-ChannelConvertMapEntry _conv_u16u16( &channel_convert_cast<uint16,uint16> );
-ChannelConvertMapEntry _conv_u16i32( &channel_convert_cast<uint16,int32>  );
-ChannelConvertMapEntry _conv_u16u32( &channel_convert_cast<uint16,uint32> );
-ChannelConvertMapEntry _conv_u16i64( &channel_convert_cast<uint16,int64>  );
-ChannelConvertMapEntry _conv_u16u64( &channel_convert_cast<uint16,uint64> );
-ChannelConvertMapEntry _conv_u16f32( &channel_convert_cast<uint16,float>, &channel_convert_int_to_float<uint16,float>  );
-ChannelConvertMapEntry _conv_u16f64( &channel_convert_cast<uint16,double>, &channel_convert_int_to_float<uint16,double> );
-ChannelConvertMapEntry _conv_i32i8 ( &channel_convert_cast<int32,int8>   );
-ChannelConvertMapEntry _conv_i32u8 ( &channel_convert_cast<int32,uint8>  );
-ChannelConvertMapEntry _conv_i32i16( &channel_convert_cast<int32,int16>  );
-ChannelConvertMapEntry _conv_i32u16( &channel_convert_cast<int32,uint16> );
-ChannelConvertMapEntry _conv_i32i32( &channel_convert_cast<int32,int32>  );
-ChannelConvertMapEntry _conv_i32u32( &channel_convert_cast<int32,uint32> );
-ChannelConvertMapEntry _conv_i32i64( &channel_convert_cast<int32,int64>  );
-ChannelConvertMapEntry _conv_i32u64( &channel_convert_cast<int32,uint64> );
-ChannelConvertMapEntry _conv_i32f32( &channel_convert_cast<int32,float>, &channel_convert_int_to_float<int32,float>  );
-ChannelConvertMapEntry _conv_i32f64( &channel_convert_cast<int32,double>, &channel_convert_int_to_float<int32,double> );
-ChannelConvertMapEntry _conv_u32i8 ( &channel_convert_cast<uint32,int8>   );
-ChannelConvertMapEntry _conv_u32u8 ( &channel_convert_cast<uint32,uint8>  );
-ChannelConvertMapEntry _conv_u32i16( &channel_convert_cast<uint32,int16>  );
-ChannelConvertMapEntry _conv_u32u16( &channel_convert_cast<uint32,uint16> );
-ChannelConvertMapEntry _conv_u32i32( &channel_convert_cast<uint32,int32>  );
-ChannelConvertMapEntry _conv_u32u32( &channel_convert_cast<uint32,uint32> );
-ChannelConvertMapEntry _conv_u32i64( &channel_convert_cast<uint32,int64>  );
-ChannelConvertMapEntry _conv_u32u64( &channel_convert_cast<uint32,uint64> );
-ChannelConvertMapEntry _conv_u32f32( &channel_convert_cast<uint32,float>, &channel_convert_int_to_float<uint32,float>  );
-ChannelConvertMapEntry _conv_u32f64( &channel_convert_cast<uint32,double>, &channel_convert_int_to_float<uint32,double> );
-ChannelConvertMapEntry _conv_i64i8 ( &channel_convert_cast<int64,int8>   );
-ChannelConvertMapEntry _conv_i64u8 ( &channel_convert_cast<int64,uint8>  );
-ChannelConvertMapEntry _conv_i64i16( &channel_convert_cast<int64,int16>  );
-ChannelConvertMapEntry _conv_i64u16( &channel_convert_cast<int64,uint16> );
-ChannelConvertMapEntry _conv_i64i32( &channel_convert_cast<int64,int32>  );
-ChannelConvertMapEntry _conv_i64u32( &channel_convert_cast<int64,uint32> );
-ChannelConvertMapEntry _conv_i64i64( &channel_convert_cast<int64,int64>  );
-ChannelConvertMapEntry _conv_i64u64( &channel_convert_cast<int64,uint64> );
-ChannelConvertMapEntry _conv_i64f32( &channel_convert_cast<int64,float>, &channel_convert_int_to_float<int64,float>  );
-ChannelConvertMapEntry _conv_i64f64( &channel_convert_cast<int64,double>, &channel_convert_int_to_float<int64,double> );
-ChannelConvertMapEntry _conv_u64i8 ( &channel_convert_cast<uint64,int8>   );
-ChannelConvertMapEntry _conv_u64u8 ( &channel_convert_cast<uint64,uint8>  );
-ChannelConvertMapEntry _conv_u64i16( &channel_convert_cast<uint64,int16>  );
-ChannelConvertMapEntry _conv_u64u16( &channel_convert_cast<uint64,uint16> );
-ChannelConvertMapEntry _conv_u64i32( &channel_convert_cast<uint64,int32>  );
-ChannelConvertMapEntry _conv_u64u32( &channel_convert_cast<uint64,uint32> );
-ChannelConvertMapEntry _conv_u64i64( &channel_convert_cast<uint64,int64>  );
-ChannelConvertMapEntry _conv_u64u64( &channel_convert_cast<uint64,uint64> );
-ChannelConvertMapEntry _conv_u64f32( &channel_convert_cast<uint64,float>, &channel_convert_int_to_float<uint64,float>  );
-ChannelConvertMapEntry _conv_u64f64( &channel_convert_cast<uint64,double>, &channel_convert_int_to_float<uint64,double> );
-ChannelConvertMapEntry _conv_f32i8 ( &channel_convert_cast<float,int8>, &channel_convert_float_to_int<float,int8>   );
-ChannelConvertMapEntry _conv_f32u8 ( &channel_convert_cast<float,uint8>, &channel_convert_float_to_int<float,uint8>  );
-ChannelConvertMapEntry _conv_f32i16( &channel_convert_cast<float,int16>, &channel_convert_float_to_int<float,int16>  );
-ChannelConvertMapEntry _conv_f32u16( &channel_convert_cast<float,uint16>, &channel_convert_float_to_int<float,uint16> );
-ChannelConvertMapEntry _conv_f32i32( &channel_convert_cast<float,int32>, &channel_convert_float_to_int<float,int32>  );
-ChannelConvertMapEntry _conv_f32u32( &channel_convert_cast<float,uint32>, &channel_convert_float_to_int<float,uint32> );
-ChannelConvertMapEntry _conv_f32i64( &channel_convert_cast<float,int64>, &channel_convert_float_to_int<float,int64>  );
-ChannelConvertMapEntry _conv_f32u64( &channel_convert_cast<float,uint64>, &channel_convert_float_to_int<float,uint64> );
-ChannelConvertMapEntry _conv_f32f32( &channel_convert_cast<float,float>  );
-ChannelConvertMapEntry _conv_f32f64( &channel_convert_cast<float,double> );
-ChannelConvertMapEntry _conv_f64i8 ( &channel_convert_cast<double,int8>, &channel_convert_float_to_int<double,int8>   );
-ChannelConvertMapEntry _conv_f64u8 ( &channel_convert_cast<double,uint8>, &channel_convert_float_to_int<double,uint8>  );
-ChannelConvertMapEntry _conv_f64i16( &channel_convert_cast<double,int16>, &channel_convert_float_to_int<double,int16>  );
-ChannelConvertMapEntry _conv_f64u16( &channel_convert_cast<double,uint16>, &channel_convert_float_to_int<double,uint16> );
-ChannelConvertMapEntry _conv_f64i32( &channel_convert_cast<double,int32>, &channel_convert_float_to_int<double,int32>  );
-ChannelConvertMapEntry _conv_f64u32( &channel_convert_cast<double,uint32>, &channel_convert_float_to_int<double,uint32> );
-ChannelConvertMapEntry _conv_f64i64( &channel_convert_cast<double,int64>, &channel_convert_float_to_int<double,int64>  );
-ChannelConvertMapEntry _conv_f64u64( &channel_convert_cast<double,uint64>, &channel_convert_float_to_int<double,uint64> );
-ChannelConvertMapEntry _conv_f64f32( &channel_convert_cast<double,float>  );
-ChannelConvertMapEntry _conv_f64f64( &channel_convert_cast<double,double> );
-
-// Channel Set Max:
-//   Assigns a channel the maximum value
-typedef void (*channel_set_max_func)(void* dest);
-
-template <class DestT>
-void channel_set_max_int( DestT* dest ) {
-  *dest = boost::integer_traits<DestT>::const_max;
-}
-
-template <class DestT>
-void channel_set_max_float( DestT* dest ) {
-  *dest = DestT(1.0);
-}
-
-std::map<ChannelTypeEnum,channel_set_max_func> *channel_set_max_map = 0;
+template <>
+struct ChannelConvert<uint16,uint8,true,false,false> {
+  static inline uint8 apply( uint16 src ) { return uint8( src / (65535/255) ); }
+};
 
-class ChannelSetMaxMapEntry {
-public:
-  template <class DstT>
-  ChannelSetMaxMapEntry( void (*func)(DstT*) ) {
-    if( !channel_set_max_map )
-      channel_set_max_map = new std::map<ChannelTypeEnum,channel_set_max_func>();
-    ChannelTypeEnum dst = ChannelTypeID<DstT>::value;
-    channel_set_max_map->operator[]( dst ) = (channel_set_max_func)func;
-  }
+template <>
+struct ChannelConvert<uint8,uint16,true,false,false> {
+  static inline uint16 apply( uint8 src ) { return uint16( uint16(src) * (65535/255) ); }
 };
 
-ChannelSetMaxMapEntry _setmax_i8 ( &channel_set_max_int<int8> );
-ChannelSetMaxMapEntry _setmax_u8 ( &channel_set_max_int<uint8> );
-ChannelSetMaxMapEntry _setmax_i16( &channel_set_max_int<int16> );
-ChannelSetMaxMapEntry _setmax_u16( &channel_set_max_int<uint16> );
-ChannelSetMaxMapEntry _setmax_i32( &channel_set_max_int<int32> );
-ChannelSetMaxMapEntry _setmax_u32( &channel_set_max_int<uint32> );
-ChannelSetMaxMapEntry _setmax_i64( &channel_set_max_int<int64> );
-ChannelSetMaxMapEntry _setmax_u64( &channel_set_max_int<uint64> );
-ChannelSetMaxMapEntry _setmax_f32( &channel_set_max_float<float> );
-ChannelSetMaxMapEntry _setmax_f64( &channel_set_max_float<double> );
-
-// Channel Average:
-//   Reduces a number of channels into one by averaging
-typedef void (*channel_average_func)(void* src, void* dest, int32 len);
+// The maximum value of a channel type, used for opaque alpha.
+template <class T, bool FloatV = boost::is_floating_point<T>::value>
+struct ChannelMax {
+  static inline T value() { return boost::integer_traits<T>::const_max; }
+};
 
 template <class T>
-void channel_average( T* src, T* dest, int32 len ) {
-  typename AccumulatorType<T>::type accum = typename AccumulatorType<T>::type();
-  for( int32 i=0; i<len; ++i ) accum += src[i];
-  *dest = accum / len;
-}
+struct ChannelMax<T,true> {
+  static inline T value() { return T(1.0); }
+};
 
-std::map<ChannelTypeEnum,channel_average_func> *channel_average_map = 0;
+// Row conversion kernels.  Each one converts a row of pixels between
+// two channel types, changing the pixel format if the channel counts
+// differ: gray is triplicated into color, color is averaged into
+// gray, and alpha is copied, added as opaque, or dropped.  Rows whose
+// pixels are packed and whose channel counts match are converted as
+// one flat array of channels, which the compiler can vectorize.
+typedef void (*convert_row_func)( uint8 const* src, uint8* dst, int32 cols,
+                                  ptrdiff_t src_cstride, ptrdiff_t dst_cstride,
+                                  int32 src_channels, int32 dst_channels );
+
+template <class SrcT, class DestT, bool RescaleV>
+void convert_row( uint8 const* src, uint8* dst, int32 cols,
+                  ptrdiff_t src_cstride, ptrdiff_t dst_cstride,
+                  int32 src_channels, int32 dst_channels ) {
+  typedef ChannelConvert<SrcT,DestT,RescaleV> conv;
+
+  if( src_channels == dst_channels ) {
+    if( src_cstride == ptrdiff_t(src_channels*sizeof(SrcT)) &&
+        dst_cstride == ptrdiff_t(dst_channels*sizeof(DestT)) ) {
+      SrcT const* s = reinterpret_cast<SrcT const*>( src );
+      DestT* d = reinterpret_cast<DestT*>( dst );
+      int32 n = cols * src_channels;
+      for( int32 i=0; i<n; ++i ) d[i] = conv::apply( s[i] );
+      return;
+    }
+    for( int32 c=0; c<cols; ++c, src+=src_cstride, dst+=dst_cstride ) {
+      SrcT const* s = reinterpret_cast<SrcT const*>( src );
+      DestT* d = reinterpret_cast<DestT*>( dst );
+      for( int32 ch=0; ch<src_channels; ++ch ) d[ch] = conv::apply( s[ch] );
+    }
+    return;
+  }
 
-class ChannelAverageMapEntry {
-public:
-  template <class T>
-  ChannelAverageMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_average_map )
-      channel_average_map = new std::map<ChannelTypeEnum,channel_average_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_average_map->operator[]( ctid ) = (channel_average_func)func;
+  // Otherwise both are gray or color, with or without alpha.
+  bool src_color = src_channels >= 3, dst_color = dst_channels >= 3;
+  bool src_alpha = src_channels%2 == 0, dst_alpha = dst_channels%2 == 0;
+  int32 dst_alpha_ch = dst_channels - 1;
+  for( int32 c=0; c<cols; ++c, src+=src_cstride, dst+=dst_cstride ) {
+    SrcT const* s = reinterpret_cast<SrcT const*>( src );
+    DestT* d = reinterpret_cast<DestT*>( dst );
+    if( src_color == dst_color ) {
+      d[0] = conv::apply( s[0] );
+      if( dst_color ) {
+        d[1] = conv::apply( s[1] );
+        d[2] = conv::apply( s[2] );
+      }
+    }
+    else if( dst_color ) {
+      d[0] = d[1] = d[2] = conv::apply( s[0] );
+    }
+    else {
+      typename AccumulatorType<DestT>::type accum = typename AccumulatorType<DestT>::type();
+      accum += conv::apply( s[0] );
+      accum += conv::apply( s[1] );
+      accum += conv::apply( s[2] );
+      d[0] = DestT( accum / 3 );
+    }
+    if( dst_alpha )
+      d[dst_alpha_ch] = src_alpha ? conv::apply( s[src_channels-1] ) : ChannelMax<DestT>::value();
   }
-};
+}
 
-ChannelAverageMapEntry _average_i8 ( &channel_average<int8> );
-ChannelAverageMapEntry _average_u8 ( &channel_average<uint8> );
-ChannelAverageMapEntry _average_i16( &channel_average<int16> );
-ChannelAverageMapEntry _average_u16( &channel_average<uint16> );
-ChannelAverageMapEntry _average_i32( &channel_average<int32> );
-ChannelAverageMapEntry _average_u32( &channel_average<uint32> );
-ChannelAverageMapEntry _average_i64( &channel_average<int64> );
-ChannelAverageMapEntry _average_u64( &channel_average<uint64> );
-ChannelAverageMapEntry _average_f32( &channel_average<float> );
-ChannelAverageMapEntry _average_f64( &channel_average<double> );
-
-// Channel Premultiply:
-//   Applies the Alpha Channel to the rest of the channels:
-typedef void (*channel_premultiply_func)(void* src, void* dst, int32 len);
+// Alpha row kernels, which premultiply or unpremultiply a row of
+// pixels whose last channel is alpha.  They may work in place.
+typedef void (*alpha_row_func)( uint8 const* src, ptrdiff_t src_cstride,
+                                uint8* dst, ptrdiff_t dst_cstride,
+                                int32 cols, int32 channels );
 
 template <class T>
-void channel_premultiply_int( T* src, T* dst, int32 len ) {
-  double scale = src[len-1] / (double)(boost::integer_traits<T>::const_max);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( round(src[i] * scale) );
-  dst[len-1] = src[len-1];
+inline double alpha_scale( T alpha ) {
+  return boost::is_floating_point<T>::value ? double(alpha)
+    : alpha / (double)(ChannelMax<T>::value());
 }
 
 template <class T>
-void channel_premultiply_float( T* src, T* dst, int32 len ) {
-  double scale = (double)(src[len-1]);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( src[i] * scale );
-  dst[len-1] = src[len-1];
+inline T alpha_round( double value ) {
+  return boost::is_floating_point<T>::value ? T(value) : T( round(value) );
 }
 
-std::map<ChannelTypeEnum,channel_premultiply_func> *channel_premultiply_map = 0;
-
-class ChannelPremultiplyMapEntry {
-public:
-  template <class T>
-  ChannelPremultiplyMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_premultiply_map )
-      channel_premultiply_map = new std::map<ChannelTypeEnum,channel_premultiply_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_premultiply_map->operator[]( ctid ) = (channel_premultiply_func)func;
-  }
-};
-
-ChannelPremultiplyMapEntry _premultiply_i8 ( &channel_premultiply_int<int8> );
-ChannelPremultiplyMapEntry _premultiply_u8 ( &channel_premultiply_int<uint8> );
-ChannelPremultiplyMapEntry _premultiply_i16( &channel_premultiply_int<int16> );
-ChannelPremultiplyMapEntry _premultiply_u16( &channel_premultiply_int<uint16> );
-ChannelPremultiplyMapEntry _premultiply_i32( &channel_premultiply_int<int32> );
-ChannelPremultiplyMapEntry _premultiply_u32( &channel_premultiply_int<uint32> );
-ChannelPremultiplyMapEntry _premultiply_i64( &channel_premultiply_int<int64> );
-ChannelPremultiplyMapEntry _premultiply_u64( &channel_premultiply_int<uint64> );
-ChannelPremultiplyMapEntry _premultiply_f32( &channel_premultiply_float<float> );
-ChannelPremultiplyMapEntry _premultiply_f64( &channel_premultiply_float<double> );
-
-// Channel Unpremultiply:
-//   Removes the premultiply of alpha to other channels:
-typedef void (*channel_unpremultiply_func)(void* src, void* dst, int32 len);
-
 template <class T>
-void channel_unpremultiply_int( T* src, T* dst, int32 len ) {
-  double scale = src[len-1] / (double)(boost::integer_traits<T>::const_max);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( round(src[i] / scale) );
-  dst[len-1] = src[len-1];
+void premultiply_row( uint8 const* src, ptrdiff_t src_cstride, uint8* dst, ptrdiff_t dst_cstride,
+                      int32 cols, int32 channels ) {
+  for( int32 c=0; c<cols; ++c, src+=src_cstride, dst+=dst_cstride ) {
+    T const* s = reinterpret_cast<T const*>( src );
+    T* d = reinterpret_cast<T*>( dst );
+    T alpha = s[channels-1];
+    double scale = alpha_scale( alpha );
+    for( int32 ch=0; ch<channels-1; ++ch ) d[ch] = alpha_round<T>( s[ch] * scale );
+    d[channels-1] = alpha;
+  }
 }
 
 template <class T>
-void channel_unpremultiply_float( T* src, T* dst, int32 len ) {
-  double scale = (double)(src[len-1]);
-  for( int32 i=0; i<len-1; ++i ) dst[i] = T( src[i] / scale );
-  dst[len-1] = src[len-1];
+void unpremultiply_row( uint8 const* src, ptrdiff_t src_cstride, uint8* dst, ptrdiff_t dst_cstride,
+                        int32 cols, int32 channels ) {
+  for( int32 c=0; c<cols; ++c, src+=src_cstride, dst+=dst_cstride ) {
+    T const* s = reinterpret_cast<T const*>( src );
+    T* d = reinterpret_cast<T*>( dst );
+    T alpha = s[channels-1];
+    double scale = alpha_scale( alpha );
+    for( int32 ch=0; ch<channels-1; ++ch ) d[ch] = alpha_round<T>( s[ch] / scale );
+    d[channels-1] = alpha;
+  }
 }
 
-std::map<ChannelTypeEnum,channel_unpremultiply_func> *channel_unpremultiply_map = 0;
+// The kernel tables, indexed by ChannelTypeEnum.  Entries for
+// unsupported channel types are null.
+const int32 num_kernel_channel_types = VW_CHANNEL_FLOAT64 + 1;
 
-class ChannelUnpremultiplyMapEntry {
-public:
-  template <class T>
-  ChannelUnpremultiplyMapEntry( void (*func)(T*,T*,int32) ) {
-    if( !channel_unpremultiply_map )
-      channel_unpremultiply_map = new std::map<ChannelTypeEnum,channel_unpremultiply_func>();
-    ChannelTypeEnum ctid = ChannelTypeID<T>::value;
-    channel_unpremultiply_map->operator[]( ctid ) = (channel_unpremultiply_func)func;
-  }
+inline int32 kernel_index( ChannelTypeEnum type ) {
+  return ( type >= 0 && type < num_kernel_channel_types ) ? int32(type) : 0;
+}
+
+#define VW_CONVERT_ROW_NONE { 0, 0 }
+#define VW_CONVERT_ROW_ENTRY(S,D) { &convert_row<S,D,false>, &convert_row<S,D,true> }
+#define VW_CONVERT_ROW_ENTRIES(S) {                                     \
+    VW_CONVERT_ROW_NONE,                                                \
+    VW_CONVERT_ROW_ENTRY(S,int8),    VW_CONVERT_ROW_ENTRY(S,uint8),     \
+    VW_CONVERT_ROW_ENTRY(S,int16),   VW_CONVERT_ROW_ENTRY(S,uint16),    \
+    VW_CONVERT_ROW_ENTRY(S,int32),   VW_CONVERT_ROW_ENTRY(S,uint32),    \
+    VW_CONVERT_ROW_ENTRY(S,int64),   VW_CONVERT_ROW_ENTRY(S,uint64),    \
+    VW_CONVERT_ROW_NONE,                                                \
+    VW_CONVERT_ROW_ENTRY(S,float32), VW_CONVERT_ROW_ENTRY(S,float64) }
+#define VW_CONVERT_ROW_ENTRIES_NONE {                                   \
+    VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE,      \
+    VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE,      \
+    VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE,      \
+    VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE, VW_CONVERT_ROW_NONE }
+
+// Indexed by source type, destination type, and rescaling.
+const convert_row_func convert_row_table[num_kernel_channel_types][num_kernel_channel_types][2] = {
+  VW_CONVERT_ROW_ENTRIES_NONE,
+  VW_CONVERT_ROW_ENTRIES(int8),    VW_CONVERT_ROW_ENTRIES(uint8),
+  VW_CONVERT_ROW_ENTRIES(int16),   VW_CONVERT_ROW_ENTRIES(uint16),
+  VW_CONVERT_ROW_ENTRIES(int32),   VW_CONVERT_ROW_ENTRIES(uint32),
+  VW_CONVERT_ROW_ENTRIES(int64),   VW_CONVERT_ROW_ENTRIES(uint64),
+  VW_CONVERT_ROW_ENTRIES_NONE,
+  VW_CONVERT_ROW_ENTRIES(float32), VW_CONVERT_ROW_ENTRIES(float64)
 };
 
-ChannelUnpremultiplyMapEntry _unpremultiply_i8 ( &channel_unpremultiply_int<int8> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u8 ( &channel_unpremultiply_int<uint8> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i16( &channel_unpremultiply_int<int16> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u16( &channel_unpremultiply_int<uint16> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i32( &channel_unpremultiply_int<int32> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u32( &channel_unpremultiply_int<uint32> );
-ChannelUnpremultiplyMapEntry _unpremultiply_i64( &channel_unpremultiply_int<int64> );
-ChannelUnpremultiplyMapEntry _unpremultiply_u64( &channel_unpremultiply_int<uint64> );
-ChannelUnpremultiplyMapEntry _unpremultiply_f32( &channel_unpremultiply_float<float> );
-ChannelUnpremultiplyMapEntry _unpremultiply_f64( &channel_unpremultiply_float<double> );
+#undef VW_CONVERT_ROW_NONE
+#undef VW_CONVERT_ROW_ENTRY
+#undef VW_CONVERT_ROW_ENTRIES
+#undef VW_CONVERT_ROW_ENTRIES_NONE
+
+// Indexed by channel type, premultiply then unpremultiply.
+const alpha_row_func alpha_row_table[num_kernel_channel_types][2] = {
+  { 0, 0 },
+  { &premultiply_row<int8>,    &unpremultiply_row<int8>    },
+  { &premultiply_row<uint8>,   &unpremultiply_row<uint8>   },
+  { &premultiply_row<int16>,   &unpremultiply_row<int16>   },
+  { &premultiply_row<uint16>,  &unpremultiply_row<uint16>  },
+  { &premultiply_row<int32>,   &unpremultiply_row<int32>   },
+  { &premultiply_row<uint32>,  &unpremultiply_row<uint32>  },
+  { &premultiply_row<int64>,   &unpremultiply_row<int64>   },
+  { &premultiply_row<uint64>,  &unpremultiply_row<uint64>  },
+  { 0, 0 },
+  { &premultiply_row<float32>, &unpremultiply_row<float32> },
+  { &premultiply_row<float64>, &unpremultiply_row<float64> }
+};
 
 void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale ) {
   VW_ASSERT( dst.format.cols==src.format.cols && dst.format.rows==src.format.rows,
@@ -402,9 +299,6 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
   int32 src_channels = num_channels( src.format.pixel_format );
   int32 dst_channels = num_channels( dst.format.pixel_format );
   ptrdiff_t src_chstride = channel_size( src.format.channel_type );
-  ptrdiff_t dst_chstride = channel_size( dst.format.channel_type );
-
-  int32 copy_length = (src_channels==dst_channels) ? src_channels : (src_channels<3) ? 1 : (dst_channels>=3) ? 3 : 0;
 
   bool unpremultiply_src = (src.format.pixel_format==VW_PIXEL_GRAYA || src.format.pixel_format==VW_PIXEL_RGBA)
     && !src.unpremultiplied && dst.unpremultiplied;
@@ -414,26 +308,19 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     && (src.format.pixel_format==VW_PIXEL_GRAYA || src.format.pixel_format==VW_PIXEL_RGBA)
     && src.unpremultiplied && !dst.unpremultiplied;
 
-  bool triplicate = src_channels<3 && dst_channels>=3;
-  bool average = src_channels >=3 && dst_channels<3;
-  bool add_alpha = src_channels%2==1 && dst_channels%2==0;
-  bool copy_alpha = src_channels!=dst_channels && src_channels%2==0 && dst_channels%2==0;
-
-  channel_convert_func conv_func = rescale
-    ? channel_convert_rescale_map->operator[](std::make_pair(src.format.channel_type,dst.format.channel_type))
-    : channel_convert_map->operator[](std::make_pair(src.format.channel_type,dst.format.channel_type));
-  channel_set_max_func max_func = channel_set_max_map->operator[](dst.format.channel_type);
-  channel_average_func avg_func = channel_average_map->operator[](dst.format.channel_type);
-  channel_unpremultiply_func unpremultiply_src_func = channel_unpremultiply_map->operator[](src.format.channel_type);
-  channel_premultiply_func premultiply_src_func = channel_premultiply_map->operator[](src.format.channel_type);
-  channel_premultiply_func premultiply_dst_func = channel_premultiply_map->operator[](dst.format.channel_type);
-  if( !conv_func || !max_func || !avg_func || !unpremultiply_src_func || !premultiply_dst_func || !premultiply_src_func )
+  int32 src_index = kernel_index( src.format.channel_type );
+  int32 dst_index = kernel_index( dst.format.channel_type );
+  convert_row_func row_func = convert_row_table[src_index][dst_index][rescale ? 1 : 0];
+  alpha_row_func src_alpha_func = unpremultiply_src ? alpha_row_table[src_index][1]
+    : premultiply_src ? alpha_row_table[src_index][0] : 0;
+  alpha_row_func dst_alpha_func = premultiply_dst ? alpha_row_table[dst_index][0] : 0;
+  if( !row_func )
     vw_throw( NoImplErr() << "Unsupported channel type combination in convert (" << src.format.channel_type << ", " << dst.format.channel_type << ")!" );
 
-  int32 max_channels = std::max( src_channels, dst_channels );
-
-  boost::scoped_array<uint8> src_buf(new uint8[max_channels*src_chstride]);
-  boost::scoped_array<uint8> dst_buf(new uint8[max_channels*dst_chstride]);
+  // Source rows whose premultiplication must change are adjusted
+  // into a packed scratch row first.
+  ptrdiff_t scratch_cstride = src_channels * src_chstride;
+  std::vector<uint8> scratch( src_alpha_func ? src.format.cols * scratch_cstride : 0 );
 
   uint8 *src_ptr_p = (uint8*)src.data;
   uint8 *dst_ptr_p = (uint8*)dst.data;
@@ -441,72 +328,16 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
     uint8 *src_ptr_r = src_ptr_p;
     uint8 *dst_ptr_r = dst_ptr_p;
     for( int32 r=0; r<src.format.rows; ++r ) {
-      uint8 *src_ptr_c = src_ptr_r;
-      uint8 *dst_ptr_c = dst_ptr_r;
-      for( int32 c=0; c<src.format.cols; ++c ) {
-
-        // Setup the buffers, adjusting premultiplication if needed
-        uint8 *src_ptr = src_ptr_c;
-        uint8 *dst_ptr = dst_ptr_c;
-        if( unpremultiply_src ) {
-          unpremultiply_src_func( src_ptr, src_buf.get(), src_channels );
-          src_ptr = src_buf.get();
-        }
-        else if( premultiply_src ) {
-          premultiply_src_func( src_ptr, src_buf.get(), src_channels );
-          src_ptr = src_buf.get();
-        }
- 
-        // Copy/convert, unrolling the common multi-channel cases
-        if( copy_length==4 ) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-          conv_func( src_ptr+2*src_chstride, dst_ptr+2*dst_chstride );
-          conv_func( src_ptr+3*src_chstride, dst_ptr+3*dst_chstride );
-        }
-        else if( copy_length==3 ) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-          conv_func( src_ptr+2*src_chstride, dst_ptr+2*dst_chstride );
-        }
-        else if( copy_length==2) {
-          conv_func( src_ptr, dst_ptr );
-          conv_func( src_ptr+src_chstride, dst_ptr+dst_chstride );
-        }
-        else if( copy_length==1 ) {
-          conv_func( src_ptr, dst_ptr );
-        }
-        else {
-          for( int32 ch=0; ch<copy_length; ++ch ) {
-            conv_func( src_ptr+ch*src_chstride, dst_ptr+ch*dst_chstride );
-          }
-        }
-
-        // Handle the special pixel format conversions
-        if( triplicate ) {
-          conv_func( src_ptr, dst_ptr+dst_chstride );
-          conv_func( src_ptr, dst_ptr+2*dst_chstride );
-        }
-        else if( average ) {
-          for( int32 ch=0; ch<3; ++ch ) {
-            conv_func( src_ptr+ch*src_chstride, dst_buf.get()+ch*dst_chstride );
-          }
-          avg_func( dst_buf.get(), dst_ptr, 3 );
-        }
-        if( copy_alpha ) {
-          conv_func( src_ptr+(src_channels-1)*src_chstride, dst_ptr+(dst_channels-1)*dst_chstride );
-        }
-        else if( add_alpha ) {
-          max_func( dst_ptr+(dst_channels-1)*dst_chstride );
-        }
-
-        // Finally, adjust destination premultiplication if needed
-        if( premultiply_dst ) {
-          premultiply_dst_func( dst_ptr, dst_ptr, dst_channels );
-        }
-        src_ptr_c += src.cstride;
-        dst_ptr_c += dst.cstride;
+      uint8 const* row = src_ptr_r;
+      ptrdiff_t row_cstride = src.cstride;
+      if( src_alpha_func && !scratch.empty() ) {
+        src_alpha_func( src_ptr_r, src.cstride, &scratch[0], scratch_cstride, src.format.cols, src_channels );
+        row = &scratch[0];
+        row_cstride = scratch_cstride;
       }
+      row_func( row, dst_ptr_r, src.format.cols, row_cstride, dst.cstride, src_channels, dst_channels );
+      if( dst_alpha_func )
+        dst_alpha_func( dst_ptr_r, dst.cstride, dst_ptr_r, dst.cstride, src.format.cols, dst_channels );
       src_ptr_r += src.rstride;
       dst_ptr_r += dst.rstride;
     }
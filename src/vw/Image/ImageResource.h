@@ -93,6 +93,11 @@ namespace vw {
       vw_throw(NoImplErr() << "This ImageResource does not support set_nodata_value()."); 
     };
 
+    /// Returns true if blocks may be written to the resource in any
+    /// order, which lets block_write_image() write each block as soon
+    /// as it is ready.
+    virtual bool has_random_block_write() const { return false; }
+
     /// Force any changes to be written to the resource.
     virtual void flush() {}
 
@@ -131,6 +136,8 @@ namespace vw {
     Vector2i block_size() const { return m_resource->block_size(); }
     void set_block_size( Vector2i const& size ) { m_resource->set_block_size(size); }
 
+    bool has_random_block_write() const { return m_resource->has_random_block_write(); }
+
     void flush() { m_resource->flush(); }
   };
 
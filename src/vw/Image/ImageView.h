@@ -13,16 +13,34 @@
 #define __VW_IMAGE_IMAGEVIEW_H__
 
 #include <cstring> // For memset()
+#include <new>
 
 #include <boost/smart_ptr.hpp>
 #include <boost/type_traits.hpp>
 
+#include <vw/Core/BufferPool.h>
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/ImageResource.h>
 #include <vw/Image/PixelAccessors.h>
 
 namespace vw {
 
+  /// \cond INTERNAL
+  // Destroys the pixels of an ImageView's buffer and returns the
+  // buffer to the pool.
+  template <class PixelT>
+  class ImageViewBufferDeleter {
+    size_t m_size;
+  public:
+    ImageViewBufferDeleter( size_t size ) : m_size(size) {}
+    void operator()( PixelT *pixels ) const {
+      if( !boost::has_trivial_destructor<PixelT>::value )
+        for( size_t i=0; i<m_size; ++i ) pixels[i].~PixelT();
+      free_buffer( pixels );
+    }
+  };
+  /// \endcond
+
   /// The standard image container for in-memory image data.
   ///
   /// This class represents an image stored in memory or, more
@@ -64,6 +82,9 @@ namespace vw {
     /// The image's %pixel_accessor type.
     typedef MemoryStridingPixelAccessor<PixelT> pixel_accessor;
 
+    /// The image's row accessor type.  See \ref vw::IsRowAccessible.
+    typedef ContiguousRowAccessor<PixelT> row_accessor;
+
     /// Constructs an empty image with zero size.
     ImageView()
       : m_cols(0), m_rows(0), m_planes(0), m_origin(0), m_cstride(0), 
@@ -129,6 +150,12 @@ namespace vw {
 #endif
     }
 
+    /// Returns a row accessor pointing to the start of the first
+    /// row of the first plane.
+    inline row_accessor row_origin() const {
+      return row_accessor( m_origin, m_rstride, m_pstride );
+    }
+
     /// Returns the pixel at the given position in the given plane.
     inline result_type operator()( int32 col, int32 row, int32 plane=0 ) const {
 #if defined(VW_ENABLE_BOUNDS_CHECK) && (VW_ENABLE_BOUNDS_CHECK==1)
@@ -148,7 +175,12 @@ namespace vw {
         m_data.reset();
       }
       else {
-        boost::shared_array<PixelT> data( new PixelT[size] );
+        // The buffer comes from the buffer pool, aligned for vector
+        // loads and recycled by the thread that frees it.
+        PixelT *pixels = static_cast<PixelT*>( allocate_buffer( size_t(size)*sizeof(PixelT) ) );
+        if( !boost::is_fundamental<PixelT>::value )
+          for( int32 i=0; i<size; ++i ) new (pixels+i) PixelT;
+        boost::shared_array<PixelT> data( pixels, ImageViewBufferDeleter<PixelT>( size ) );
         m_data = data;
       }
 
@@ -243,6 +275,14 @@ namespace vw {
   template <class PixelT>
   struct IsMultiplyAccessible<ImageView<PixelT> > : public true_type {};
 
+  /// Specifies that ImageView rows are contiguous in memory.
+  template <class PixelT>
+  struct IsRowAccessible<ImageView<PixelT> > : public true_type {};
+
+  /// Specifies that ImageView objects may be read from several threads.
+  template <class PixelT>
+  struct IsThreadSafeView<ImageView<PixelT> > : public true_type {};
+
 } // namespace vw
 
 #endif // __VW_IMAGE_IMAGEVIEW_H__
@@ -22,6 +22,8 @@
 
 #include <boost/type_traits.hpp>
 #include <boost/utility/enable_if.hpp>
+#include <boost/mpl/eval_if.hpp>
+#include <boost/mpl/identity.hpp>
 
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Image/ImageResource.h>
@@ -112,6 +114,39 @@ namespace vw {
   template <class ImplT>
   struct IsMultiplyAccessible : public false_type {};
 
+  /// Indicates whether a view provides row accessors.  A row
+  /// accessor points at the start of a row, like a pixel accessor,
+  /// but reaches the pixels along the row with operator[] rather than
+  /// next_col(), and has next_row(), next_plane() and advance()
+  /// methods.  Views for which this is true define a row_accessor
+  /// type and a row_origin() method.  When both the source and the
+  /// destination of \ref vw::rasterize are row accessible, each row
+  /// is rasterized in a simple indexed loop, which the compiler can
+  /// vectorize when the pixel math is simple enough.
+  template <class ImplT>
+  struct IsRowAccessible : public false_type {};
+
+  /// Indicates whether a view may be rasterized by several threads at
+  /// once, as in-memory images can.  Views that read from disk or
+  /// keep mutable state are not, so this is false unless a view says
+  /// otherwise.  Views that rasterize their children in parallel,
+  /// such as the separable convolution, only do so when this is true.
+  template <class ImplT>
+  struct IsThreadSafeView : public false_type {};
+
+  /// \cond INTERNAL
+  template <class ImplT>
+  struct RowAccessorTypeImpl { typedef typename ImplT::row_accessor type; };
+  /// \endcond
+
+  /// The row_accessor type of a view, or void if the view is not row
+  /// accessible.  Views that are row accessible only when their
+  /// children are use this to declare their own row_accessor.
+  template <class ImplT>
+  struct RowAccessorType : public boost::mpl::eval_if<IsRowAccessible<ImplT>,
+                                                      RowAccessorTypeImpl<ImplT>,
+                                                      boost::mpl::identity<void> > {};
+
 
   // *******************************************************************
   // Pixel iteration functions
@@ -239,19 +274,36 @@ namespace vw {
   // The master rasterization function
   // *******************************************************************
 
-  /// This function is called by image views that do not have special
-  /// optimized rasterization methods.  The user can also call it 
-  /// explicitly when pixel-by-pixel rasterization is preferred to 
-  /// the default optimized rasterization behavior.  This can be 
-  /// useful in some cases, such as when the views are heavily 
-  /// subsampled.
+  /// \cond INTERNAL
+  // Rasterization a row at a time, through row accessors.
   template <class SrcT, class DestT>
-  inline void rasterize( SrcT const& src, DestT const& dest, BBox2i bbox ) {
+  inline void rasterize_( SrcT const& src, DestT const& dest, BBox2i const& bbox, true_type ) {
+    typedef typename DestT::pixel_type DestPixelT;
+    typedef typename SrcT::row_accessor SrcRowT;
+    typedef typename DestT::row_accessor DestRowT;
+    SrcRowT splane = src.row_origin().advance(bbox.min().x(),bbox.min().y());
+    DestRowT dplane = dest.row_origin();
+    const ptrdiff_t width = bbox.width();
+    for( int32 plane=src.planes(); plane; --plane ) {
+      SrcRowT srow = splane;
+      DestRowT drow = dplane;
+      for( int32 row=bbox.height(); row; --row ) {
+        for( ptrdiff_t col=0; col<width; ++col )
+          drow[col] = DestPixelT(srow[col]);
+        srow.next_row();
+        drow.next_row();
+      }
+      splane.next_plane();
+      dplane.next_plane();
+    }
+  }
+
+  // Rasterization a pixel at a time, through pixel accessors.
+  template <class SrcT, class DestT>
+  inline void rasterize_( SrcT const& src, DestT const& dest, BBox2i const& bbox, false_type ) {
     typedef typename DestT::pixel_type DestPixelT;
     typedef typename SrcT::pixel_accessor SrcAccT;
     typedef typename DestT::pixel_accessor DestAccT;
-    VW_ASSERT( int(dest.cols())==bbox.width() && int(dest.rows())==bbox.height() && dest.planes()==src.planes(),
-               ArgumentErr() << "rasterize: Source and destination must have same dimensions." );
     SrcAccT splane = src.origin().advance(bbox.min().x(),bbox.min().y());
     DestAccT dplane = dest.origin();
     for( int32 plane=src.planes(); plane; --plane ) {
@@ -272,6 +324,28 @@ namespace vw {
       dplane.next_plane();
     }
   }
+  /// \endcond
+
+  /// This function is called by image views that do not have special
+  /// optimized rasterization methods.  The user can also call it 
+  /// explicitly when pixel-by-pixel rasterization is preferred to 
+  /// the default optimized rasterization behavior.  This can be 
+  /// useful in some cases, such as when the views are heavily 
+  /// subsampled.
+  ///
+  /// When both views are row accessible (see \ref vw::IsRowAccessible)
+  /// the pixels are copied a row at a time, except in builds with
+  /// bounds checking, which always go through the pixel accessors.
+  template <class SrcT, class DestT>
+  inline void rasterize( SrcT const& src, DestT const& dest, BBox2i bbox ) {
+    VW_ASSERT( int(dest.cols())==bbox.width() && int(dest.rows())==bbox.height() && dest.planes()==src.planes(),
+               ArgumentErr() << "rasterize: Source and destination must have same dimensions." );
+#if defined(VW_ENABLE_BOUNDS_CHECK) && (VW_ENABLE_BOUNDS_CHECK==1)
+    rasterize_( src, dest, bbox, false_type() );
+#else
+    rasterize_( src, dest, bbox, boost::mpl::integral_c<bool, IsRowAccessible<SrcT>::value && IsRowAccessible<DestT>::value>() );
+#endif
+  }
 
   /// A convenience overload to rasterize the entire source.
   template <class SrcT, class DestT>
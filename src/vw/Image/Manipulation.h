@@ -617,6 +617,7 @@ namespace vw {
     typedef typename ImageT::pixel_type pixel_type;
     typedef typename ImageT::result_type result_type;
     typedef typename ImageT::pixel_accessor pixel_accessor;
+    typedef typename RowAccessorType<ImageT>::type row_accessor;
 
     CropView( ImageT const& image, offset_type const upper_left_i, offset_type const upper_left_j, int32 const width, int32 const height ) : 
       m_child(image), m_ci(upper_left_i), m_cj(upper_left_j), m_di(width), m_dj(height) {}
@@ -634,6 +635,7 @@ namespace vw {
     inline int32 planes() const { return m_child.planes(); }
 
     inline pixel_accessor origin() const { return m_child.origin().advance(m_ci, m_cj); }
+    inline row_accessor row_origin() const { return m_child.row_origin().advance(m_ci, m_cj); }
 
     inline result_type operator()( offset_type i, offset_type j, int32 p=0 ) const { return m_child(m_ci + i, m_cj + j, p); }
 
@@ -671,6 +673,12 @@ namespace vw {
 
   template <class ImageT>
   struct IsMultiplyAccessible<CropView<ImageT> > : public IsMultiplyAccessible<ImageT> {};
+
+  template <class ImageT>
+  struct IsRowAccessible<CropView<ImageT> > : public IsRowAccessible<ImageT> {};
+
+  template <class ImageT>
+  struct IsThreadSafeView<CropView<ImageT> > : public IsThreadSafeView<ImageT> {};
   /// \endcond
 
   /// Crop an image.
@@ -85,6 +85,24 @@ namespace vw {
     inline result_type operator*() const { return m_func(*m_iter); }
   };
 
+  // Specialized Row Accessor.  This keeps its own copy of the functor,
+  // so that the compiler can see that nothing in the rasterization loop
+  // changes it.
+  template <class ImageRowT, class FuncT>
+  class UnaryPerPixelRowAccessor {
+    ImageRowT m_row;
+    FuncT m_func;
+  public:
+    typedef typename boost::result_of<FuncT(typename ImageRowT::pixel_type)>::type result_type;
+    typedef typename boost::remove_cv<typename boost::remove_reference<result_type>::type>::type pixel_type;
+
+    UnaryPerPixelRowAccessor( ImageRowT const& row, FuncT const& func ) : m_row(row), m_func(func) {}
+    inline UnaryPerPixelRowAccessor& next_row() { m_row.next_row(); return *this; }
+    inline UnaryPerPixelRowAccessor& next_plane() { m_row.next_plane(); return *this; }
+    inline UnaryPerPixelRowAccessor& advance( ptrdiff_t di, ptrdiff_t dj, ptrdiff_t dp=0 ) { m_row.advance(di,dj,dp); return *this; }
+    inline result_type operator[]( ptrdiff_t i ) const { return m_func(m_row[i]); }
+  };
+
   // Image View Class Declaration
   template <class ImageT, class FuncT>
   class UnaryPerPixelView : public ImageViewBase<UnaryPerPixelView<ImageT,FuncT> > {
@@ -94,6 +112,7 @@ namespace vw {
     typedef typename boost::result_of<FuncT(typename ImageT::pixel_type)>::type result_type;
     typedef typename boost::remove_cv<typename boost::remove_reference<result_type>::type>::type pixel_type;
     typedef UnaryPerPixelAccessor<typename ImageT::pixel_accessor, FuncT> pixel_accessor;
+    typedef UnaryPerPixelRowAccessor<typename RowAccessorType<ImageT>::type, FuncT> row_accessor;
 
     UnaryPerPixelView( ImageT const& image ) : m_image(image), m_func() {}
     UnaryPerPixelView( ImageT const& image, FuncT const& func ) : m_image(image), m_func(func) {}
@@ -103,6 +122,7 @@ namespace vw {
     inline int32 planes() const { return m_image.planes(); }
 
     inline pixel_accessor origin() const { return pixel_accessor(m_image.origin(),m_func); }
+    inline row_accessor row_origin() const { return row_accessor(m_image.row_origin(),m_func); }
     inline result_type operator()( int32 i, int32 j, int32 p=0 ) const { return m_func(m_image(i,j,p)); }
 
     template <class ViewT>
@@ -123,6 +143,9 @@ namespace vw {
   // be correct in all cases.  Perhaps it should be specialized there instead?
   template <class ImageT, class FuncT>
   struct IsMultiplyAccessible<UnaryPerPixelView<ImageT,FuncT> > : boost::is_reference<typename UnaryPerPixelView<ImageT,FuncT>::result_type>::type {};
+
+  template <class ImageT, class FuncT>
+  struct IsRowAccessible<UnaryPerPixelView<ImageT,FuncT> > : public IsRowAccessible<ImageT> {};
   /// \endcond
 
 
@@ -152,6 +175,24 @@ namespace vw {
     inline result_type operator*() const { return m_func(*m_iter1,*m_iter2); }
   };
 
+  // Specialized Row Accessor
+  template <class Image1RowT, class Image2RowT, class FuncT>
+  class BinaryPerPixelRowAccessor {
+    Image1RowT m_row1;
+    Image2RowT m_row2;
+    FuncT m_func;
+  public:
+    typedef typename boost::result_of<FuncT(typename Image1RowT::pixel_type,typename Image2RowT::pixel_type)>::type result_type;
+    typedef typename boost::remove_cv<typename boost::remove_reference<result_type>::type>::type pixel_type;
+
+    BinaryPerPixelRowAccessor( Image1RowT const& row1, Image2RowT const& row2, FuncT const& func ) : m_row1(row1), m_row2(row2), m_func(func) {}
+    inline BinaryPerPixelRowAccessor& next_row() { m_row1.next_row(); m_row2.next_row(); return *this; }
+    inline BinaryPerPixelRowAccessor& next_plane() { m_row1.next_plane(); m_row2.next_plane(); return *this; }
+    inline BinaryPerPixelRowAccessor& advance( ptrdiff_t di, ptrdiff_t dj, ptrdiff_t dp=0 )
+      { m_row1.advance(di,dj,dp); m_row2.advance(di,dj,dp); return *this; }
+    inline result_type operator[]( ptrdiff_t i ) const { return m_func(m_row1[i],m_row2[i]); }
+  };
+
   // Image View Class Definition
   template <class Image1T, class Image2T, class FuncT>
   class BinaryPerPixelView : public ImageViewBase<BinaryPerPixelView<Image1T,Image2T,FuncT> >
@@ -167,6 +208,9 @@ namespace vw {
     typedef BinaryPerPixelAccessor<typename Image1T::pixel_accessor,
                                    typename Image2T::pixel_accessor,
                                    FuncT> pixel_accessor;
+    typedef BinaryPerPixelRowAccessor<typename RowAccessorType<Image1T>::type,
+                                      typename RowAccessorType<Image2T>::type,
+                                      FuncT> row_accessor;
 
     BinaryPerPixelView( Image1T const& image1, Image2T const& image2 )
       : m_image1(image1), m_image2(image2), m_func()
@@ -191,6 +235,7 @@ namespace vw {
     inline int32 planes() const { return m_image1.planes(); }
 
     inline pixel_accessor origin() const { return pixel_accessor(m_image1.origin(),m_image2.origin(),m_func); }
+    inline row_accessor row_origin() const { return row_accessor(m_image1.row_origin(),m_image2.row_origin(),m_func); }
     inline result_type operator()( int32 i, int32 j, int32 p=0 ) const { return m_func(m_image1(i,j,p),m_image2(i,j,p)); }
 
     /// \cond INTERNAL
@@ -200,6 +245,12 @@ namespace vw {
     /// \endcond
   };
 
+  /// \cond INTERNAL
+  template <class Image1T, class Image2T, class FuncT>
+  struct IsRowAccessible<BinaryPerPixelView<Image1T,Image2T,FuncT> >
+    : public boost::mpl::and_<IsRowAccessible<Image1T>,IsRowAccessible<Image2T> >::type {};
+  /// \endcond
+
   // *******************************************************************
   // TrinaryPerPixelView
   // *******************************************************************
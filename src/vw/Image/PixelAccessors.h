@@ -96,6 +96,37 @@ namespace vw {
   };
 
 
+  /// A row accessor for image data stored in memory with adjacent
+  /// pixels in each row, as in an ImageView.
+  ///
+  /// A row accessor is like a pixel accessor that points at the start
+  /// of a row, except that it reaches the pixels along the row with
+  /// operator[] rather than by stepping between them.  Because the
+  /// column stride is always one, rasterizing a row through operator[]
+  /// turns into a plain loop over raw pointers that the compiler is
+  /// free to vectorize.  See \ref vw::IsRowAccessible.
+  template <class PixelT>
+  class ContiguousRowAccessor {
+    PixelT *m_ptr;
+    ptrdiff_t m_rstride, m_pstride;
+  public:
+    typedef PixelT pixel_type;
+    typedef PixelT& result_type;
+
+    ContiguousRowAccessor( PixelT *ptr, ptrdiff_t rstride, ptrdiff_t pstride )
+      : m_ptr(ptr), m_rstride(rstride), m_pstride(pstride) {}
+
+    inline ContiguousRowAccessor& next_row()   { m_ptr += m_rstride; return *this; }
+    inline ContiguousRowAccessor& next_plane() { m_ptr += m_pstride; return *this; }
+    inline ContiguousRowAccessor& advance( ptrdiff_t dc, ptrdiff_t dr, ptrdiff_t dp=0 ) {
+      m_ptr += dc + dr*m_rstride + dp*m_pstride;
+      return *this;
+    }
+
+    inline result_type operator[]( ptrdiff_t i ) const { return m_ptr[i]; }
+  };
+
+
   /// A generic "procedural" pixel accessor that keeps track of it
   /// position (c,r,p) in the image.
   ///
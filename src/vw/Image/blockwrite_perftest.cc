@@ -0,0 +1,169 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file blockwrite_perftest.cc
+///
+/// Compares the in-order ThreadedBlockWriter against the
+/// UnorderedBlockWriter on a view whose blocks have very uneven costs,
+/// the way a CorrelatorView does where the texture or the search
+/// range varies across the image.  The image is written to memory,
+/// with an optional delay per write to stand in for disk I/O.
+///
+#include <vw/Image/ImageIO.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+// A procedural view that spins for a while per pixel.  Every
+// slow_every'th block costs slow_factor times as much as the others.
+class SkewedCostView : public ImageViewBase<SkewedCostView> {
+  int32 m_cols, m_rows, m_block_size;
+  int m_work, m_slow_every, m_slow_factor;
+public:
+  typedef float pixel_type;
+  typedef float result_type;
+  typedef ProceduralPixelAccessor<SkewedCostView> pixel_accessor;
+
+  SkewedCostView( int32 cols, int32 rows, int32 block_size, int work, int slow_every, int slow_factor ) :
+    m_cols(cols), m_rows(rows), m_block_size(block_size), m_work(work),
+    m_slow_every(slow_every), m_slow_factor(slow_factor) {}
+
+  inline int32 cols() const { return m_cols; }
+  inline int32 rows() const { return m_rows; }
+  inline int32 planes() const { return 1; }
+  inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+  inline result_type operator()( int32 x, int32 y, int32 = 0 ) const { return pixel(x, y, m_work); }
+
+  float pixel( int32 x, int32 y, int work ) const {
+    float value = float(x + y);
+    for( int i = 0; i < work; ++i )
+      value = value * 0.999f + 1.0f;
+    return value;
+  }
+
+  typedef SkewedCostView prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i const& ) const { return *this; }
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    int block = bbox.min().x()/m_block_size + bbox.min().y()/m_block_size * ((m_cols-1)/m_block_size+1);
+    int work = ( m_slow_every > 0 && block % m_slow_every == 0 ) ? m_work * m_slow_factor : m_work;
+    for( int32 y = bbox.min().y(); y < bbox.max().y(); ++y )
+      for( int32 x = bbox.min().x(); x < bbox.max().x(); ++x )
+        dest(x - bbox.min().x(), y - bbox.min().y()) = pixel(x, y, work);
+  }
+};
+
+// An in-memory resource with a fixed delay per write, which can be
+// written in any order.
+class MemoryImageResource : public ImageResource {
+  ImageView<float> m_image;
+  Vector2i m_block_size;
+  int m_write_ms;
+public:
+  MemoryImageResource( ImageView<float> const& image, Vector2i block_size, int write_ms ) :
+    m_image(image), m_block_size(block_size), m_write_ms(write_ms) {}
+
+  int32 cols() const { return m_image.cols(); }
+  int32 rows() const { return m_image.rows(); }
+  int32 planes() const { return 1; }
+  PixelFormatEnum pixel_format() const { return VW_PIXEL_SCALAR; }
+  ChannelTypeEnum channel_type() const { return VW_CHANNEL_FLOAT32; }
+
+  void read( ImageBuffer const& buf, BBox2i const& bbox ) const {
+    ImageView<float> region = crop( m_image, bbox );
+    convert( buf, region.buffer() );
+  }
+  void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+    if( m_write_ms > 0 ) Thread::sleep_ms( m_write_ms );
+    ImageView<float> region( bbox.width(), bbox.height() );
+    convert( region.buffer(), buf );
+    crop( m_image, bbox ) = region;
+  }
+
+  Vector2i block_size() const { return m_block_size; }
+  bool has_random_block_write() const { return true; }
+};
+
+static void report( std::string const& name, Stopwatch const& sw, int32 size ) {
+  std::cout << std::setw(24) << std::left << name << std::right
+            << std::fixed << std::setprecision(3) << std::setw(8) << sw.elapsed_seconds() << " s  "
+            << std::setprecision(2) << std::setw(8) << size * double(size) / 1e6 / sw.elapsed_seconds() << " Mpix/s\n";
+}
+
+int main( int argc, char** argv ) {
+  int32 size, block_size;
+  int work, slow_every, slow_factor, write_ms, num_threads;
+  double pending_blocks;
+
+  po::options_description general_options("Block Writer Performance Test Program");
+  general_options.add_options()
+    ("size", po::value<int32>(&size)->default_value(2048), "Image size in pixels")
+    ("block-size", po::value<int32>(&block_size)->default_value(256), "Block size in pixels")
+    ("work,w", po::value<int>(&work)->default_value(50), "Work per pixel")
+    ("slow-every", po::value<int>(&slow_every)->default_value(7), "Make every Nth block slow")
+    ("slow-factor", po::value<int>(&slow_factor)->default_value(20), "How much slower the slow blocks are")
+    ("write-ms", po::value<int>(&write_ms)->default_value(2), "Delay per block write, in milliseconds")
+    ("threads,t", po::value<int>(&num_threads)->default_value(vw_settings().default_num_threads()), "Number of rasterization threads")
+    ("pending", po::value<double>(&pending_blocks)->default_value(vw_settings().write_pool_size()), "Memory ceiling for the unordered writer, in blocks")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  vw_settings().set_default_num_threads( num_threads );
+  SkewedCostView view( size, size, block_size, work, slow_every, slow_factor );
+  ImageView<float> image( size, size );
+  MemoryImageResource rsrc( image, Vector2i(block_size, block_size), write_ms );
+
+  {
+    Stopwatch sw;
+    sw.start();
+    ThreadedBlockWriter writer;
+    detail::add_image_blocks( writer, rsrc, view, ProgressCallback::dummy_instance() );
+    writer.process_blocks();
+    sw.stop();
+    report( "ThreadedBlockWriter", sw, size );
+  }
+
+  {
+    Stopwatch sw;
+    sw.start();
+    UnorderedBlockWriter writer( size_t(pending_blocks * block_size * block_size * sizeof(float)) );
+    detail::add_image_blocks( writer, rsrc, view, ProgressCallback::dummy_instance() );
+    writer.process_blocks();
+    sw.stop();
+    report( "UnorderedBlockWriter", sw, size );
+
+    std::vector<BlockWriteTiming> timings = writer.timings();
+    double wait = 0, rasterize = 0, queue = 0, write = 0, max_rasterize = 0;
+    for( size_t i = 0; i < timings.size(); ++i ) {
+      wait += timings[i].wait;
+      rasterize += timings[i].rasterize;
+      queue += timings[i].queue;
+      write += timings[i].write;
+      max_rasterize = std::max( max_rasterize, timings[i].rasterize );
+    }
+    double n = double(timings.size());
+    std::cout << "  per block: wait " << std::setprecision(4) << wait/n
+              << " s, rasterize " << rasterize/n << " s (max " << max_rasterize
+              << " s), queue " << queue/n << " s, write " << write/n << " s\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,125 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file convert_perftest.cc
+///
+/// Times vw::convert on the pixel format and channel type conversions
+/// that the DiskImageResource drivers make when reading and writing
+/// files.  Reports the rate of each in megapixels per second.
+///
+#include <vw/Image/ImageResource.h>
+#include <vw/Image/PixelTypeInfo.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+static int32 g_size, g_repeat;
+
+template <class T>
+void fill_channels( T* data, size_t n, T max ) {
+  for( size_t i = 0; i < n; ++i )
+    data[i] = T( double(i * 7919 % 1021) / 1021 * max );
+}
+
+// Fills a buffer with arbitrary data in the channel type's range.
+void fill( ImageBuffer const& buf ) {
+  size_t n = size_t(buf.format.cols) * buf.format.rows * buf.format.planes * num_channels( buf.format.pixel_format );
+  switch( buf.format.channel_type ) {
+  case VW_CHANNEL_UINT8:   fill_channels( (uint8*)buf.data, n, uint8(255) ); break;
+  case VW_CHANNEL_INT16:   fill_channels( (int16*)buf.data, n, int16(32767) ); break;
+  case VW_CHANNEL_UINT16:  fill_channels( (uint16*)buf.data, n, uint16(65535) ); break;
+  case VW_CHANNEL_FLOAT32: fill_channels( (float32*)buf.data, n, float32(1.0) ); break;
+  default: vw_throw( ArgumentErr() << "Unsupported channel type in benchmark." );
+  }
+}
+
+void run( std::string const& name,
+          PixelFormatEnum src_format, ChannelTypeEnum src_type, bool src_unpremultiplied,
+          PixelFormatEnum dst_format, ChannelTypeEnum dst_type, bool dst_unpremultiplied,
+          bool rescale ) {
+  ImageFormat src_fmt, dst_fmt;
+  src_fmt.cols = dst_fmt.cols = g_size;
+  src_fmt.rows = dst_fmt.rows = g_size;
+  src_fmt.planes = dst_fmt.planes = 1;
+  src_fmt.pixel_format = src_format;
+  src_fmt.channel_type = src_type;
+  dst_fmt.pixel_format = dst_format;
+  dst_fmt.channel_type = dst_type;
+
+  std::vector<uint8> src_data( size_t(g_size) * g_size * num_channels( src_format ) * channel_size( src_type ) );
+  std::vector<uint8> dst_data( size_t(g_size) * g_size * num_channels( dst_format ) * channel_size( dst_type ) );
+  ImageBuffer src( src_fmt, &src_data[0], src_unpremultiplied );
+  ImageBuffer dst( dst_fmt, &dst_data[0], dst_unpremultiplied );
+  fill( src );
+
+  Stopwatch sw;
+  sw.start();
+  for( int32 i = 0; i < g_repeat; ++i )
+    convert( dst, src, rescale );
+  sw.stop();
+
+  double mpix = double(g_size) * g_size * g_repeat / 1e6;
+  std::cout << "  " << std::setw(32) << std::left << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(8) << mpix / sw.elapsed_seconds() << " Mpix/s\n";
+}
+
+int main( int argc, char** argv ) {
+  po::options_description general_options("Pixel Conversion Performance Test Program");
+  general_options.add_options()
+    ("size,s", po::value<int32>(&g_size)->default_value(1024), "Width and height of the test images")
+    ("repeat,r", po::value<int32>(&g_repeat)->default_value(20), "Number of times to convert each image")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  std::cout << g_size << "x" << g_size << " images, " << g_repeat << " passes\n";
+
+  // Straight copies, as when the file matches the view.
+  run( "gray uint8 copy",          VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, true );
+  run( "rgb uint8 copy",           VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, true );
+  run( "gray float copy",          VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true );
+
+  // Channel type conversions on read.
+  run( "gray uint8 -> float",      VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true );
+  run( "rgb uint8 -> float",       VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, false, true );
+  run( "gray uint16 -> float",     VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  false, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true );
+  run( "gray uint16 -> uint8",     VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  false, VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, true );
+  run( "gray int16 -> float cast", VW_PIXEL_GRAY, VW_CHANNEL_INT16,   false, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, false );
+
+  // Channel type conversions on write.
+  run( "gray float -> uint8",      VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, true );
+  run( "gray float -> uint16",     VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  false, true );
+  run( "gray uint8 -> uint16",     VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  false, true );
+
+  // Pixel format conversions.
+  run( "rgb -> gray uint8",        VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, true );
+  run( "gray -> rgb uint8",        VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, true );
+  run( "rgb -> rgba uint8",        VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, true );
+  run( "rgba -> rgb uint8",        VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, true );
+  run( "rgb uint8 -> gray float",  VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   false, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true );
+
+  // Alpha premultiplication, as for PNG files.
+  run( "rgba uint8 premultiply",   VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   true,  VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, true );
+  run( "rgba uint8 unpremultiply", VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   true,  true );
+  run( "rgba uint8 -> float",      VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   true,  VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, false, true );
+
+  return 0;
+}
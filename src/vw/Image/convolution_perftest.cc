@@ -0,0 +1,121 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file convolution_perftest.cc
+///
+/// Times separable convolution of float and uint8 images, once with
+/// the original pixel-by-pixel rasterization and once a strip and a
+/// row at a time, and reports the rate of each in megapixels per
+/// second.  Also compares gaussian_filter() with box_gaussian_filter()
+/// at large standard deviations.
+///
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Filter.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Settings.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+static int32 g_size, g_repeat;
+
+template <class ViewT, class BoolT>
+double time_rasterize( ViewT const& view, BoolT strips ) {
+  ImageView<typename ViewT::pixel_type> dest( view.cols(), view.rows(), view.planes() );
+  BBox2i bbox( 0, 0, view.cols(), view.rows() );
+  Stopwatch sw;
+  sw.start();
+  for( int32 i = 0; i < g_repeat; ++i )
+    view.rasterize_( dest, bbox, strips );
+  sw.stop();
+  return sw.elapsed_seconds();
+}
+
+template <class ViewT>
+double time_view( ViewT const& view ) {
+  ImageView<typename ViewT::pixel_type> dest( view.cols(), view.rows(), view.planes() );
+  Stopwatch sw;
+  sw.start();
+  for( int32 i = 0; i < g_repeat; ++i )
+    dest = view;
+  sw.stop();
+  return sw.elapsed_seconds();
+}
+
+static void report( std::string const& name, double first, double second ) {
+  double mpix = double(g_size) * g_size * g_repeat / 1e6;
+  std::cout << "  " << std::setw(24) << std::left << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(8) << mpix / first << " Mpix/s  "
+            << std::setw(8) << mpix / second << " Mpix/s  "
+            << std::setprecision(2) << std::setw(5) << first / second << "x\n";
+}
+
+template <class ViewT>
+void run( std::string const& name, ViewT const& view ) {
+  report( name, time_rasterize( view, false_type() ), time_rasterize( view, true_type() ) );
+}
+
+template <class PixelT>
+void run_all( std::string const& type_name ) {
+  ImageView<PixelT> image( g_size, g_size );
+  for( int32 j = 0; j < g_size; ++j )
+    for( int32 i = 0; i < g_size; ++i )
+      image(i,j) = PixelT( (i*i + 3*j) % 256 );
+
+  std::cout << type_name << ":\n  " << std::setw(24) << std::left << "filter" << std::right
+            << std::setw(16) << "pixels" << std::setw(16) << "strips" << "\n";
+  run( "gaussian sigma=1", gaussian_filter( image, 1.0 ) );
+  run( "gaussian sigma=2", gaussian_filter( image, 2.0 ) );
+  run( "gaussian sigma=4", gaussian_filter( image, 4.0 ) );
+  run( "derivative x", derivative_filter( image, 1, 0 ) );
+  run( "derivative y", derivative_filter( image, 0, 1 ) );
+  std::vector<float> box( 15, 1.0f/15 );
+  run( "box 15x15", separable_convolution_filter( image, box, box ) );
+
+  std::cout << "  " << std::setw(24) << std::left << "" << std::right
+            << std::setw(16) << "gaussian" << std::setw(16) << "box gaussian" << "\n";
+  for( double sigma = 4; sigma <= 16; sigma *= 2 ) {
+    std::ostringstream name;
+    name << "sigma=" << sigma;
+    report( name.str(), time_view( gaussian_filter( image, sigma ) ),
+            time_view( box_gaussian_filter( image, sigma ) ) );
+  }
+}
+
+int main( int argc, char** argv ) {
+  int32 threads;
+
+  po::options_description general_options("Convolution Performance Test Program");
+  general_options.add_options()
+    ("size,s", po::value<int32>(&g_size)->default_value(1024), "Width and height of the test images")
+    ("repeat,r", po::value<int32>(&g_repeat)->default_value(5), "Number of times to run each filter")
+    ("threads,t", po::value<int32>(&threads)->default_value(0), "Number of threads (default: system setting)")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+  if( threads > 0 )
+    vw_settings().set_default_num_threads(threads);
+
+  std::cout << g_size << "x" << g_size << " images, " << g_repeat << " passes, "
+            << vw_settings().default_num_threads() << " threads\n";
+  run_all<float>( "float" );
+  run_all<uint8>( "uint8" );
+  return 0;
+}
@@ -0,0 +1,110 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file rasterize_perftest.cc
+///
+/// Times vw::rasterize on some common per-pixel expressions over
+/// ImageViews, once through the pixel accessors and once through the
+/// row accessors that the default rasterization now uses when both
+/// views support them.  Reports the rate of each in megapixels per
+/// second.
+///
+#include <vw/Image/ImageView.h>
+#include <vw/Image/ImageMath.h>
+#include <vw/Image/PixelMath.h>
+#include <vw/Image/PixelMask.h>
+#include <vw/Image/MaskViews.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+static int32 g_size, g_repeat;
+
+template <class SrcT, class DestT>
+double time_rasterize( SrcT const& src, DestT const& dest, bool rows ) {
+  BBox2i bbox( 0, 0, src.cols(), src.rows() );
+  Stopwatch sw;
+  sw.start();
+  for( int32 i = 0; i < g_repeat; ++i ) {
+    if( rows ) rasterize_( src, dest, bbox, true_type() );
+    else       rasterize_( src, dest, bbox, false_type() );
+  }
+  sw.stop();
+  return sw.elapsed_seconds();
+}
+
+template <class ViewT, class PixelT>
+void run( std::string const& name, ImageViewBase<ViewT> const& view, ImageView<PixelT> const& dest ) {
+  // The row accessor path is timed first, so anything left in the
+  // cache by the first pass favors the pixel accessor path.
+  double rows = time_rasterize( view.impl(), dest, true );
+  double pixels = time_rasterize( view.impl(), dest, false );
+  double mpix = double(view.impl().cols()) * view.impl().rows() * g_repeat / 1e6;
+  std::cout << "  " << std::setw(24) << std::left << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(8) << mpix / pixels << " Mpix/s  "
+            << std::setw(8) << mpix / rows << " Mpix/s  "
+            << std::setprecision(2) << std::setw(5) << pixels / rows << "x\n";
+}
+
+int main( int argc, char** argv ) {
+  po::options_description general_options("Rasterization Performance Test Program");
+  general_options.add_options()
+    ("size,s", po::value<int32>(&g_size)->default_value(1024), "Width and height of the test images")
+    ("repeat,r", po::value<int32>(&g_repeat)->default_value(20), "Number of times to rasterize each expression")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  ImageView<float> a( g_size, g_size ), b( g_size, g_size ), out( g_size, g_size );
+  ImageView<uint8> bytes( g_size, g_size ), out_bytes( g_size, g_size );
+  ImageView<PixelRGB<uint8> > rgb( g_size, g_size );
+  ImageView<PixelRGB<float> > out_rgb( g_size, g_size );
+  ImageView<PixelMask<float> > ma( g_size, g_size ), mb( g_size, g_size ), out_masked( g_size, g_size );
+  for( int32 j = 0; j < g_size; ++j )
+    for( int32 i = 0; i < g_size; ++i ) {
+      a(i,j) = float(i % 251) / 251;
+      b(i,j) = float(j % 241) / 241;
+      bytes(i,j) = uint8(i + j);
+      rgb(i,j) = PixelRGB<uint8>( uint8(i), uint8(j), uint8(i + j) );
+      ma(i,j) = a(i,j);
+      mb(i,j) = b(i,j);
+      if( (i + 3*j) % 7 == 0 ) mb(i,j).invalidate();
+    }
+
+  std::cout << g_size << "x" << g_size << " images, " << g_repeat << " passes\n"
+            << "  " << std::setw(24) << std::left << "expression" << std::right
+            << std::setw(16) << "pixel accessors" << std::setw(16) << "row accessors" << "\n";
+
+  run( "copy", a, out );
+  run( "scale+offset", 2.0f * a + 3.0f, out );
+  run( "a*b+a", a * b + a, out );
+  run( "channel_cast uint8", channel_cast<float>( bytes ), out );
+  run( "channel_cast float", channel_cast<uint8>( 255.0f * a ), out_bytes );
+  run( "channel_cast rgb", channel_cast<float>( rgb ), out_rgb );
+  run( "masked scale", 2.0f * ma, out_masked );
+  run( "masked sum", ma + mb, out_masked );
+  run( "apply_mask", apply_mask( mb, 0.0f ), out );
+  run( "cropped copy", crop( a, 1, 1, g_size - 2, g_size - 2 ),
+       ImageView<float>( g_size - 2, g_size - 2 ) );
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+// TestBlockRasterize.h
+#include <gtest/gtest.h>
+
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Image/ImageView.h>
+
+using namespace vw;
+
+// A procedural view whose pixels are their own raster index, and
+// which takes a while to rasterize, like a block read from disk.
+class SlowIndexView : public ImageViewBase<SlowIndexView> {
+  int32 m_cols, m_rows;
+  int m_delay_ms;
+public:
+  typedef int32 pixel_type;
+  typedef int32 result_type;
+  typedef ProceduralPixelAccessor<SlowIndexView> pixel_accessor;
+
+  SlowIndexView( int32 cols, int32 rows, int delay_ms ) :
+    m_cols(cols), m_rows(rows), m_delay_ms(delay_ms) {}
+
+  inline int32 cols() const { return m_cols; }
+  inline int32 rows() const { return m_rows; }
+  inline int32 planes() const { return 1; }
+  inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+  inline result_type operator()( int32 x, int32 y, int32 = 0 ) const { return x + y*m_cols; }
+
+  typedef SlowIndexView prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i const& ) const { return *this; }
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    Thread::sleep_ms( m_delay_ms );
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+};
+
+static void wait_for_misses( Cache const& cache, uint64 misses ) {
+  for( int i = 0; i < 500 && cache.misses() < misses; ++i )
+    Thread::sleep_ms( 10 );
+}
+
+TEST( BlockRasterize, Prefetch ) {
+  Cache cache( 1024*1024 );
+  SlowIndexView view( 32, 32, 1 );
+  BlockRasterizeView<SlowIndexView> cached( view, Vector2i(8,8), 1, cache );
+  cached.set_prefetch( 4 );
+
+  ImageView<int32> result = cached;
+  ASSERT_EQ( 32, result.cols() );
+  ASSERT_EQ( 32, result.rows() );
+  for( int32 y = 0; y < 32; ++y )
+    for( int32 x = 0; x < 32; ++x )
+      EXPECT_EQ( x + y*32, result(x,y) );
+  EXPECT_EQ( 16u, cache.misses() );
+}
+
+TEST( BlockRasterize, DeclaredPrefetch ) {
+  Cache cache( 1024*1024 );
+  SlowIndexView view( 32, 32, 1 );
+  BlockRasterizeView<SlowIndexView> cached( view, Vector2i(8,8), 1, cache );
+
+  // Nothing happens until prefetching is enabled.
+  cached.prefetch( BBox2i(0,0,32,32) );
+  EXPECT_EQ( 0u, cache.misses() );
+
+  cached.set_prefetch( 2 );
+  cached.prefetch( BBox2i(0,0,32,32) );
+  wait_for_misses( cache, 16 );
+  EXPECT_EQ( 16u, cache.misses() );
+
+  ImageView<int32> result = cached;
+  EXPECT_EQ( 16u, cache.misses() );
+  EXPECT_EQ( 5 + 9*32, result(5,9) );
+}
+
+TEST( BlockRasterize, PredictedPrefetch ) {
+  Cache cache( 1024*1024 );
+  SlowIndexView view( 32, 32, 1 );
+  BlockRasterizeView<SlowIndexView> cached( view, Vector2i(8,8), 1, cache );
+  cached.set_prefetch( 4 );
+
+  // Reading the first row of blocks predicts the next five blocks
+  // from each block read, which reaches block (0,2).
+  ImageView<int32> result( 32, 8 );
+  cached.rasterize( result, BBox2i(0,0,32,8) );
+  EXPECT_EQ( 31 + 7*32, result(31,7) );
+  wait_for_misses( cache, 9 );
+  EXPECT_EQ( 9u, cache.misses() );
+
+  // So the second row is read entirely from the cache, and only the
+  // blocks it predicts in turn, (1,2) through (0,3), are generated.
+  Thread::sleep_ms( 50 );
+  cache.clear_stats();
+  cached.rasterize( result, BBox2i(0,8,32,8) );
+  EXPECT_EQ( 31 + 15*32, result(31,7) );
+  EXPECT_EQ( 4u, cache.hits() );
+  wait_for_misses( cache, 4 );
+  Thread::sleep_ms( 50 );
+  EXPECT_EQ( 4u, cache.hits() );
+  EXPECT_EQ( 4u, cache.misses() );
+}
+
+TEST( BlockRasterize, PredictNegativeOrigin ) {
+  Cache cache( 1024*1024 );
+  SlowIndexView view( 32, 32, 0 );
+  BlockRasterizeView<SlowIndexView> cached( view, Vector2i(8,8), 1, cache );
+  cached.set_prefetch( 4 );
+
+  // Blocks outside the view are an error, but predicting past the
+  // top-left corner must not touch the block table.
+  ImageView<int32> result( 16, 16 );
+  EXPECT_THROW( cached.rasterize( result, BBox2i(-8,-8,16,16) ), ArgumentErr );
+}
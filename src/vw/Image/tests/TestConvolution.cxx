@@ -14,6 +14,7 @@
 #include <vw/Image/Algorithms.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Filter.h>
+#include <vw/Image/PerPixelViews.h>
 
 #include <test/Helpers.h>
 
@@ -208,3 +209,109 @@ TEST( Convolution, Prerasterize ) {
   EXPECT_EQ(right_buf(1000,100), 0.0);
   EXPECT_EQ(right_buf(900,100), 1.0);
 }
+
+// The strip-by-strip rasterization used for unmasked pixels should
+// agree with the original pixel-by-pixel version, both in the
+// interior and along the edges, for each of the kinds of kernel it
+// treats specially.
+template <class PixelT>
+static void test_strips( std::vector<std::vector<float> > const& kernels, double tolerance ) {
+  typedef typename CompoundChannelType<PixelT>::type channel_type;
+  const int32 nc = CompoundNumChannels<PixelT>::value;
+  ImageView<PixelT> src(150,600,2);
+  for( int32 p=0; p<src.planes(); ++p )
+    for( int32 j=0; j<src.rows(); ++j )
+      for( int32 i=0; i<src.cols(); ++i )
+        for( int32 c=0; c<nc; ++c )
+          compound_select_channel<channel_type&>( src(i,j,p), c ) = channel_type( (37*i + 101*j + 53*c + 89*p) % 251 );
+
+  BBox2i bbox( -5, -7, 160, 614 );
+  for( size_t x=0; x<kernels.size(); ++x )
+    for( size_t y=0; y<kernels.size(); ++y ) {
+      if( kernels[x].empty() && kernels[y].empty() ) continue;
+      SeparableConvolutionView<ImageView<PixelT>,float,ConstantEdgeExtension> cnv( src, kernels[x], kernels[y] );
+      ImageView<PixelT> strips( bbox.width(), bbox.height(), 2 ), pixels( bbox.width(), bbox.height(), 2 );
+      cnv.rasterize_( strips, bbox, true_type() );
+      cnv.rasterize_( pixels, bbox, false_type() );
+      for( int32 p=0; p<strips.planes(); ++p )
+        for( int32 j=0; j<strips.rows(); ++j )
+          for( int32 i=0; i<strips.cols(); ++i )
+            for( int32 c=0; c<nc; ++c )
+              ASSERT_NEAR( compound_select_channel<channel_type const&>( pixels(i,j,p), c ),
+                           compound_select_channel<channel_type const&>( strips(i,j,p), c ), tolerance )
+                << "kernels " << x << "," << y << " at " << i << "," << j << "," << p << "," << c;
+    }
+}
+
+// An empty kernel, and one of each of the kinds that the strips treat
+// specially: asymmetric, symmetric and box.
+static std::vector<std::vector<float> > strip_kernels( bool integer ) {
+  std::vector<float> empty, asymmetric, symmetric, box;
+  if( integer ) {
+    asymmetric.push_back(2); asymmetric.push_back(-1); asymmetric.push_back(1);
+    symmetric.push_back(1); symmetric.push_back(2); symmetric.push_back(1);
+    box.resize( 9, 1 );
+  }
+  else {
+    asymmetric.push_back(0.5); asymmetric.push_back(0.75); asymmetric.push_back(-0.25);
+    generate_gaussian_kernel( symmetric, 1.0 );
+    box.resize( 9, 1.0/9 );
+  }
+  std::vector<std::vector<float> > kernels;
+  kernels.push_back( empty );
+  kernels.push_back( asymmetric );
+  kernels.push_back( symmetric );
+  kernels.push_back( box );
+  return kernels;
+}
+
+TEST( Convolution, SeparableView_Strips ) {
+  test_strips<float>( strip_kernels( false ), 1e-3 );
+  test_strips<float>( strip_kernels( true ), 0 );
+  // Summing in a different order can move an intermediate result
+  // across an integer boundary, and the second pass can amplify that.
+  // Integer kernels have no rounding to disagree about.
+  test_strips<PixelRGB<uint8> >( strip_kernels( false ), 2 );
+  test_strips<PixelRGB<uint8> >( strip_kernels( true ), 0 );
+}
+
+// Throws when it sees a pixel of value 255.
+struct ThrowAt255Functor : ReturnFixedType<float> {
+  float operator()( float v ) const {
+    if( v == 255 ) vw_throw( IOErr() << "ThrowAt255Functor" );
+    return v;
+  }
+};
+
+// Reading the view from several threads is safe, so its strips are
+// convolved on the thread pool.
+class ThreadSafeThrowAt255View : public UnaryPerPixelView<ImageView<float>, ThrowAt255Functor> {
+public:
+  ThreadSafeThrowAt255View( ImageView<float> const& image ) :
+    UnaryPerPixelView<ImageView<float>, ThrowAt255Functor>( image, ThrowAt255Functor() ) {}
+};
+namespace vw {
+  template <>
+  struct IsThreadSafeView<ThreadSafeThrowAt255View> : public true_type {};
+}
+
+TEST( Convolution, SeparableView_StripError ) {
+  // The bad pixel is in the last of several strips; the error should
+  // reach the caller unchanged, whether the strips run on the thread
+  // pool or not.
+  ImageView<float> src(150,600);
+  src(75,550) = 255;
+  std::vector<float> kernel;
+  generate_gaussian_kernel( kernel, 1.0 );
+  ImageView<float> dst(150,600);
+  EXPECT_THROW( dst = separable_convolution_filter( ThreadSafeThrowAt255View( src ),
+                                                    kernel, kernel, ZeroEdgeExtension() ), IOErr );
+  EXPECT_THROW( dst = separable_convolution_filter( per_pixel_filter( src, ThrowAt255Functor() ),
+                                                    kernel, kernel, ZeroEdgeExtension() ), IOErr );
+
+  src(75,550) = 0;
+  EXPECT_NO_THROW( dst = separable_convolution_filter( ThreadSafeThrowAt255View( src ),
+                                                       kernel, kernel, ZeroEdgeExtension() ) );
+  EXPECT_NO_THROW( dst = separable_convolution_filter( per_pixel_filter( src, ThrowAt255Functor() ),
+                                                       kernel, kernel, ZeroEdgeExtension() ) );
+}
@@ -245,3 +245,32 @@ TEST( Filter, SepConv22Box ) {
     EXPECT_EQ( dst(1,1), 1 );
   }
 }
+
+TEST( Filter, BoxGaussian ) {
+  // The response to an impulse should have about the requested
+  // standard deviation in each direction and look much like the
+  // Gaussian itself.
+  ImageView<uint8> src(101,101);
+  src(50,50) = 100;
+  ImageView<float> dst = box_gaussian_filter( src, 6.0, 3.0, ZeroEdgeExtension() );
+  ImageView<float> ref = gaussian_filter( channel_cast<float>(src), 6.0, 3.0, 0, 0, ZeroEdgeExtension() );
+  double sum = 0, xvar = 0, yvar = 0;
+  for( int32 j=0; j<dst.rows(); ++j )
+    for( int32 i=0; i<dst.cols(); ++i ) {
+      sum += dst(i,j);
+      xvar += dst(i,j) * (i-50) * (i-50);
+      yvar += dst(i,j) * (j-50) * (j-50);
+      EXPECT_NEAR( ref(i,j), dst(i,j), 0.05 * ref(50,50) );
+    }
+  EXPECT_NEAR( 100, sum, 1e-2 );
+  EXPECT_NEAR( 6, sqrt( xvar / sum ), 0.3 );
+  EXPECT_NEAR( 3, sqrt( yvar / sum ), 0.3 );
+  ASSERT_TRUE( has_pixel_type<float>( box_gaussian_filter( src, 6.0 ) ) );
+
+  std::vector<double> kernel;
+  generate_box_kernel( kernel, 6.0, 0, 3 );
+  EXPECT_EQ( 11u, kernel.size() );
+  generate_box_kernel( kernel, 6.0, 2, 3 );
+  EXPECT_EQ( 13u, kernel.size() );
+  EXPECT_NEAR( 1.0/13, kernel[0], 1e-12 );
+}
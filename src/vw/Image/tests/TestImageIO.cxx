@@ -0,0 +1,183 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+// TestImageIO.h
+#include <gtest/gtest.h>
+
+#include <vw/Image/ImageIO.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/Filter.h>
+
+using namespace vw;
+
+// A procedural view whose pixels are their own raster index.  The
+// block containing the origin takes much longer to rasterize than the
+// others.
+class SkewedIndexView : public ImageViewBase<SkewedIndexView> {
+  int32 m_cols, m_rows;
+  int m_delay_ms;
+public:
+  typedef float pixel_type;
+  typedef float result_type;
+  typedef ProceduralPixelAccessor<SkewedIndexView> pixel_accessor;
+
+  SkewedIndexView( int32 cols, int32 rows, int delay_ms ) :
+    m_cols(cols), m_rows(rows), m_delay_ms(delay_ms) {}
+
+  inline int32 cols() const { return m_cols; }
+  inline int32 rows() const { return m_rows; }
+  inline int32 planes() const { return 1; }
+  inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+  inline result_type operator()( int32 x, int32 y, int32 = 0 ) const { return float(x + y*m_cols); }
+
+  typedef SkewedIndexView prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i const& ) const { return *this; }
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    if( bbox.contains( Vector2i(0,0) ) )
+      Thread::sleep_ms( m_delay_ms );
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+};
+
+// Fails on one pixel value, as a bad read from disk would.
+struct ThrowAtValueFunctor : ReturnFixedType<float> {
+  float m_bad;
+  ThrowAtValueFunctor( float bad ) : m_bad(bad) {}
+  float operator()( float v ) const {
+    if( v == m_bad ) vw_throw( IOErr() << "ThrowAtValueFunctor" );
+    return v;
+  }
+};
+
+// An in-memory resource that can be written in any order, or only in
+// order if random_write is false.  Writes of the block holding the
+// pixel given to fail_writes_at() fail.
+class MemoryImageResource : public ImageResource {
+  ImageView<float> m_image;
+  Vector2i m_block_size;
+  bool m_random_write;
+  BBox2i m_bad_pixel;
+public:
+  MemoryImageResource( ImageView<float> const& image, Vector2i block_size, bool random_write ) :
+    m_image(image), m_block_size(block_size), m_random_write(random_write) {}
+
+  void fail_writes_at( Vector2i const& pixel ) { m_bad_pixel = BBox2i( pixel, pixel + Vector2i(1,1) ); }
+
+  int32 cols() const { return m_image.cols(); }
+  int32 rows() const { return m_image.rows(); }
+  int32 planes() const { return 1; }
+  PixelFormatEnum pixel_format() const { return VW_PIXEL_SCALAR; }
+  ChannelTypeEnum channel_type() const { return VW_CHANNEL_FLOAT32; }
+
+  void read( ImageBuffer const& buf, BBox2i const& bbox ) const {
+    ImageView<float> region = crop( m_image, bbox );
+    convert( buf, region.buffer() );
+  }
+  void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+    if( bbox.intersects( m_bad_pixel ) ) vw_throw( IOErr() << "MemoryImageResource: write failed" );
+    ImageView<float> region( bbox.width(), bbox.height() );
+    convert( region.buffer(), buf );
+    crop( m_image, bbox ) = region;
+  }
+
+  Vector2i block_size() const { return m_block_size; }
+  bool has_random_block_write() const { return m_random_write; }
+};
+
+static void expect_index_image( ImageView<float> const& image ) {
+  for( int32 y = 0; y < image.rows(); ++y )
+    for( int32 x = 0; x < image.cols(); ++x )
+      ASSERT_EQ( float(x + y*image.cols()), image(x,y) );
+}
+
+TEST( ImageIO, BlockWriteImage ) {
+  SkewedIndexView view( 70, 50, 0 );
+
+  ImageView<float> unordered( 70, 50 );
+  MemoryImageResource unordered_rsrc( unordered, Vector2i(16,16), true );
+  ASSERT_TRUE( unordered_rsrc.has_random_block_write() );
+  block_write_image( unordered_rsrc, view );
+  expect_index_image( unordered );
+
+  ImageView<float> ordered( 70, 50 );
+  MemoryImageResource ordered_rsrc( ordered, Vector2i(16,16), false );
+  ASSERT_FALSE( ordered_rsrc.has_random_block_write() );
+  block_write_image( ordered_rsrc, view );
+  expect_index_image( ordered );
+}
+
+TEST( ImageIO, OrderedBlockWriteError ) {
+  // A block that fails to rasterize or to write is reported, and the
+  // blocks after it are still written instead of waiting on it.
+  SkewedIndexView view( 70, 50, 0 );
+  {
+    ImageView<float> image( 70, 50 );
+    MemoryImageResource rsrc( image, Vector2i(16,16), false );
+    EXPECT_THROW( block_write_image( rsrc, per_pixel_filter( view, ThrowAtValueFunctor( 20 + 5*70 ) ) ), IOErr );
+    EXPECT_EQ( 69 + 49*70, image(69,49) );
+  }
+  {
+    ImageView<float> image( 70, 50 );
+    MemoryImageResource rsrc( image, Vector2i(16,16), false );
+    rsrc.fail_writes_at( Vector2i(20,5) );
+    EXPECT_THROW( block_write_image( rsrc, view ), IOErr );
+    EXPECT_EQ( 69 + 49*70, image(69,49) );
+  }
+}
+
+TEST( ImageIO, UnorderedBlockWriter ) {
+  int num_threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads( 4 );
+
+  SkewedIndexView view( 64, 64, 200 );
+  ImageView<float> image( 64, 64 );
+  MemoryImageResource rsrc( image, Vector2i(16,16), true );
+
+  // Room for four 16x16 float blocks.
+  UnorderedBlockWriter writer( 4*16*16*sizeof(float) );
+  detail::add_image_blocks( writer, rsrc, view, ProgressCallback::dummy_instance() );
+  writer.process_blocks();
+  vw_settings().set_default_num_threads( num_threads );
+
+  expect_index_image( image );
+  std::vector<BlockWriteTiming> timings = writer.timings();
+  ASSERT_EQ( 16u, timings.size() );
+
+  // The slow first block doesn't hold up the others.
+  EXPECT_NE( 0, timings.front().index );
+  EXPECT_EQ( 0, timings.back().index );
+  EXPECT_LE( 0.15, timings.back().rasterize );
+  for( size_t i = 0; i < timings.size(); ++i ) {
+    EXPECT_GE( timings[i].wait, 0 );
+    EXPECT_EQ( 16, timings[i].bbox.width() );
+  }
+}
+
+TEST( ImageIO, UnorderedBlockWriteError ) {
+  // Failed blocks give their memory back, so with room for only one
+  // block the rest are still written, and the error is reported.
+  SkewedIndexView view( 64, 64, 0 );
+  {
+    ImageView<float> image( 64, 64 );
+    MemoryImageResource rsrc( image, Vector2i(16,16), true );
+    UnorderedBlockWriter writer( 16*16*sizeof(float) );
+    // The writer keeps a reference to the view until process_blocks().
+    UnaryPerPixelView<SkewedIndexView, ThrowAtValueFunctor> bad_view( view, ThrowAtValueFunctor( 20 + 5*64 ) );
+    detail::add_image_blocks( writer, rsrc, bad_view, ProgressCallback::dummy_instance() );
+    EXPECT_THROW( writer.process_blocks(), IOErr );
+    EXPECT_EQ( 15u, writer.timings().size() );
+  }
+  {
+    ImageView<float> image( 64, 64 );
+    MemoryImageResource rsrc( image, Vector2i(16,16), true );
+    rsrc.fail_writes_at( Vector2i(20,5) );
+    UnorderedBlockWriter writer( 16*16*sizeof(float) );
+    detail::add_image_blocks( writer, rsrc, view, ProgressCallback::dummy_instance() );
+    EXPECT_THROW( writer.process_blocks(), IOErr );
+    EXPECT_EQ( 15u, writer.timings().size() );
+  }
+}
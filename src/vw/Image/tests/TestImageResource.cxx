@@ -49,6 +49,90 @@ TEST( ImageResource, PreMultiply ) {
     EXPECT_PIXEL_EQ( buf3_data[i], buf1_data[i] );
 }
 
+template <class SrcPxT, class DstPxT>
+void convert_pixels( DstPxT* dst, SrcPxT* src, int32 cols, bool rescale ) {
+  ImageFormat src_fmt, dst_fmt;
+  src_fmt.cols = dst_fmt.cols = cols;
+  src_fmt.rows = dst_fmt.rows = 1;
+  src_fmt.planes = dst_fmt.planes = 1;
+  src_fmt.pixel_format = PixelFormatID<SrcPxT>::value;
+  src_fmt.channel_type = ChannelTypeID<typename PixelChannelType<SrcPxT>::type>::value;
+  dst_fmt.pixel_format = PixelFormatID<DstPxT>::value;
+  dst_fmt.channel_type = ChannelTypeID<typename PixelChannelType<DstPxT>::type>::value;
+  convert( ImageBuffer(dst_fmt, dst), ImageBuffer(src_fmt, src), rescale );
+}
+
+TEST( ImageResource, Convert ) {
+  uint8 u8[3] = { 0, 51, 255 };
+  float f32[3];
+  convert_pixels( f32, u8, 3, true );
+  EXPECT_FLOAT_EQ( 0.0f, f32[0] );
+  EXPECT_FLOAT_EQ( 0.2f, f32[1] );
+  EXPECT_FLOAT_EQ( 1.0f, f32[2] );
+  convert_pixels( f32, u8, 3, false );
+  EXPECT_FLOAT_EQ( 51.0f, f32[1] );
+
+  // Out of range values are clamped when rescaling to an integer type.
+  float in[4] = { -0.5f, 0.5f, 1.0f, 2.0f };
+  uint8 out[4];
+  convert_pixels( out, in, 4, true );
+  EXPECT_EQ( 0, out[0] );
+  EXPECT_EQ( 127, out[1] );
+  EXPECT_EQ( 255, out[2] );
+  EXPECT_EQ( 255, out[3] );
+
+  uint16 u16[2] = { 65535, 514 };
+  convert_pixels( u8, u16, 2, true );
+  EXPECT_EQ( 255, u8[0] );
+  EXPECT_EQ( 2, u8[1] );
+  convert_pixels( u16, u8, 2, true );
+  EXPECT_EQ( 65535, u16[0] );
+  EXPECT_EQ( 514, u16[1] );
+
+  // Color is averaged into gray, and alpha is kept, added or dropped.
+  PixelRGBA<uint8> rgba[2] = { PixelRGBA<uint8>(10,20,60,255), PixelRGBA<uint8>(0,0,3,255) };
+  PixelGrayA<float> graya[2];
+  convert_pixels( graya, rgba, 2, true );
+  EXPECT_PIXEL_NEAR( PixelGrayA<float>(30/255.0f,1), graya[0], 1e-6 );
+  EXPECT_PIXEL_NEAR( PixelGrayA<float>(1/255.0f,1), graya[1], 1e-6 );
+
+  PixelGray<uint8> gray[2] = { PixelGray<uint8>(7), PixelGray<uint8>(9) };
+  convert_pixels( rgba, gray, 2, true );
+  EXPECT_PIXEL_EQ( PixelRGBA<uint8>(7,7,7,255), rgba[0] );
+  EXPECT_PIXEL_EQ( PixelRGBA<uint8>(9,9,9,255), rgba[1] );
+
+  PixelRGB<uint8> rgb[2];
+  convert_pixels( rgb, rgba, 2, true );
+  EXPECT_PIXEL_EQ( PixelRGB<uint8>(7,7,7), rgb[0] );
+  EXPECT_PIXEL_EQ( PixelRGB<uint8>(9,9,9), rgb[1] );
+}
+
+// Converting into every other pixel of a buffer exercises the
+// kernels for rows that are not packed.
+TEST( ImageResource, ConvertStrided ) {
+  ImageFormat src_fmt, dst_fmt;
+  src_fmt.cols = dst_fmt.cols = 3;
+  src_fmt.rows = dst_fmt.rows = 2;
+  src_fmt.planes = dst_fmt.planes = 1;
+  src_fmt.pixel_format = dst_fmt.pixel_format = VW_PIXEL_RGB;
+  src_fmt.channel_type = VW_CHANNEL_UINT8;
+  dst_fmt.channel_type = VW_CHANNEL_UINT16;
+
+  PixelRGB<uint8> src_data[6];
+  for( int i = 0; i < 6; ++i )
+    src_data[i] = PixelRGB<uint8>( i, 2*i, 3*i );
+  PixelRGB<uint16> dst_data[12];
+  ImageBuffer src( src_fmt, src_data );
+  ImageBuffer dst( dst_fmt, dst_data );
+  dst.cstride *= 2;
+  dst.rstride *= 2;
+  convert( dst, src, true );
+  for( int i = 0; i < 6; ++i ) {
+    EXPECT_PIXEL_EQ( PixelRGB<uint16>( 257*i, 514*i, 771*i ), dst_data[2*i] );
+    EXPECT_PIXEL_EQ( PixelRGB<uint16>(), dst_data[2*i+1] );
+  }
+}
+
 #if defined(VW_HAVE_PKG_OPENCV) && VW_HAVE_PKG_OPENCV == 1
 
 struct ImageResourceOpenCVTest : public ::testing::Test, private boost::noncopyable {
@@ -125,6 +125,25 @@ TEST( ImageView, Reset ) {
   ASSERT_EQ(test_rgba.data(), (PixelRGBA<vw::uint8>*)0);
 }
 
+TEST( ImageView, Buffer ) {
+  // Pixel buffers are aligned, and pixels are constructed even when
+  // the buffer is reused from the pool.
+  BufferPoolStats before = buffer_pool_stats();
+  for( int i = 0; i < 2; ++i ) {
+    ImageView<PixelRGB<float> > image( 17, 5, 3 );
+    EXPECT_EQ( 0u, size_t(image.data()) % buffer_alignment );
+    EXPECT_EQ( PixelRGB<float>(), image(16,4,2) );
+    image(16,4,2) = PixelRGB<float>(1,2,3);
+    ImageView<uint8> bytes( 3, 3 );
+    EXPECT_EQ( 0u, size_t(bytes.data()) % buffer_alignment );
+    EXPECT_EQ( 0, bytes(2,2) );
+    bytes(2,2) = 7;
+  }
+  BufferPoolStats after = buffer_pool_stats();
+  EXPECT_EQ( before.live_bytes, after.live_bytes );
+  EXPECT_EQ( before.allocations + 4, after.allocations );
+}
+
 TEST( ImageView, Rasterization ) {
   ImageView<double> im1(2,2); im1(0,0)=1; im1(1,0)=2; im1(0,1)=3; im1(1,1)=4;
   ImageView<double> im2(2,2);
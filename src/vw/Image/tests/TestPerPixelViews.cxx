@@ -10,6 +10,7 @@
 
 #include <vw/Image/PerPixelViews.h>
 #include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
 #include <vw/Core/Functors.h>
 
 using namespace vw;
@@ -259,3 +260,44 @@ TEST( PerPixelView, Binary2 ) {
   ASSERT_FALSE( bool_trait<IsMultiplyAccessible>(ppv) );
   ASSERT_TRUE( bool_trait<IsImageView>(ppv) );
 }
+
+TEST( PerPixelView, RowRasterization ) {
+  ImageView<float> im1(7,5,2), im2(9,6,2);
+  for( int p=0; p<2; ++p )
+    for( int j=0; j<6; ++j )
+      for( int i=0; i<9; ++i ) {
+        if( i < 7 && j < 5 ) im1(i,j,p) = float(i + 10*j + 100*p);
+        im2(i,j,p) = float(3*i - j + p);
+      }
+
+  // Per-pixel views over ImageViews and crops of them are row
+  // accessible; views of anything else are not.
+  typedef BinaryPerPixelView<ImageView<float>, CropView<ImageView<float> >, ArgArgSumFunctor> sum_type;
+  typedef UnaryPerPixelView<sum_type, float(*)(float)> view_type;
+  view_type ppv( sum_type( im1, crop( im2, 2, 1, 7, 5 ) ), square );
+  ASSERT_TRUE( bool_trait<IsRowAccessible>(im1) );
+  ASSERT_TRUE( bool_trait<IsRowAccessible>(crop(im1,1,1,2,2)) );
+  ASSERT_TRUE( bool_trait<IsRowAccessible>(ppv) );
+  ASSERT_FALSE( bool_trait<IsRowAccessible>(transpose(im1)) );
+  typedef CropView<ImageView<float> > crop_type;
+  ASSERT_FALSE( bool_trait<IsRowAccessible>(BinaryPerPixelView<TransposeView<crop_type>, crop_type, ArgArgSumFunctor>(
+                  transpose( crop( im1, 0, 0, 5, 5 ) ), crop( im1, 0, 0, 5, 5 ) )) );
+
+  // Rasterize part of the view into part of a larger image, a row at
+  // a time and a pixel at a time.
+  ImageView<float> rows(8,8,2), pixels(8,8,2);
+  std::fill( rows.begin(), rows.end(), -1.0f );
+  std::fill( pixels.begin(), pixels.end(), -1.0f );
+  BBox2i bbox(1,2,5,3);
+  vw::rasterize( ppv, crop( rows, 2, 3, 5, 3 ), bbox );
+  vw::rasterize_( ppv, crop( pixels, 2, 3, 5, 3 ), bbox, false_type() );
+  for( int p=0; p<2; ++p )
+    for( int j=0; j<8; ++j )
+      for( int i=0; i<8; ++i ) {
+        EXPECT_EQ( pixels(i,j,p), rows(i,j,p) ) << i << " " << j << " " << p;
+        if( i >= 2 && i < 7 && j >= 3 && j < 6 )
+          EXPECT_EQ( ppv(i-1,j-1,p), rows(i,j,p) ) << i << " " << j << " " << p;
+        else
+          EXPECT_EQ( -1.0f, rows(i,j,p) ) << i << " " << j << " " << p;
+      }
+}
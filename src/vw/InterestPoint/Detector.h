@@ -79,65 +79,103 @@ namespace ip {
   };
 
 
+  /// The number of pixels by which each tile is grown on every side
+  /// before detection by detect_interest_points().  It covers the
+  /// filter and orientation windows of the built-in detectors up to
+  /// their coarsest default octave, and is a multiple of their largest
+  /// subsampling factor so that every tile's octaves sample the same
+  /// pixels as the whole image's would.
+  static const int32 IP_DEFAULT_TILE_MARGIN = 64;
+
+  /// Detects the interest points in one tile of an image.  The tile
+  /// is read with a margin around it, so that points near its edges
+  /// see the same neighborhood as they would in the whole image, and
+  /// only the points that lie in the tile itself are kept.  Every
+  /// point thus belongs to exactly one tile.
   template <class ViewT, class DetectorT>
   class InterestPointDetectionTask : public Task, private boost::noncopyable {
 
     ViewT m_view;
     DetectorT& m_detector;
-    BBox2i m_bbox;
-    InterestPointList& m_interest_point_list;
-    Mutex& m_mutex;
+    BBox2i m_bbox, m_read_bbox;
+    InterestPointList& m_interest_points;
     int m_id, m_max_id;
 
   public:
-    InterestPointDetectionTask(ViewT const& view, DetectorT& detector, BBox2i bbox,
-                               InterestPointList& ip_list, Mutex &mutex, int id, int max_id ) :
-      m_view(view), m_detector(detector), m_bbox(bbox),
-      m_interest_point_list(ip_list), m_mutex(mutex), m_id(id), m_max_id(max_id) {}
+    InterestPointDetectionTask(ViewT const& view, DetectorT& detector, BBox2i const& bbox, int32 margin,
+                               InterestPointList& interest_points, int id, int max_id ) :
+      m_view(view), m_detector(detector), m_bbox(bbox), m_read_bbox(bbox),
+      m_interest_points(interest_points), m_id(id), m_max_id(max_id) {
+      m_read_bbox.expand(margin);
+      m_read_bbox.crop(bounding_box(m_view));
+    }
 
     void operator()() {
       vw_out(InfoMessage, "interest_point") << "Locating interest points in block " << m_id << "/" << m_max_id << "   [ " << m_bbox << " ]\n";
-      InterestPointList new_ip_list = m_detector(crop(pixel_cast<PixelGray<float> >(channel_cast_rescale<float>(m_view.impl())), m_bbox),0);
-      for (InterestPointList::iterator pt = new_ip_list.begin(); pt != new_ip_list.end(); ++pt) {
-        (*pt).x +=  m_bbox.min().x();
-        (*pt).ix += m_bbox.min().x();
-        (*pt).y +=  m_bbox.min().y();
-        (*pt).iy += m_bbox.min().y();
-      }
 
-      // Append these interest points to the master list owned by the
-      // detect_interest_points() function.
-      {
-        Mutex::Lock lock(m_mutex);
-        m_interest_point_list.splice(m_interest_point_list.end(), new_ip_list);
+      // Only this tile and its margin are read, so a DiskImageView
+      // is streamed from disk a tile at a time.
+      ImageView<PixelGray<float> > tile = crop(pixel_cast<PixelGray<float> >(channel_cast_rescale<float>(m_view)), m_read_bbox);
+      InterestPointList points = m_detector(tile, 0);
+
+      // Points that fall in the margin belong to a neighboring tile.
+      // Along the image's own edges a tile also keeps any points that
+      // localization moved slightly outside of the image.
+      BBox2i image_bbox = bounding_box(m_view);
+      InterestPointList::iterator pt = points.begin();
+      while (pt != points.end()) {
+        pt->x  += m_read_bbox.min().x();
+        pt->ix += m_read_bbox.min().x();
+        pt->y  += m_read_bbox.min().y();
+        pt->iy += m_read_bbox.min().y();
+        int32 x = std::min(std::max(int32(floorf(pt->x)), image_bbox.min().x()), image_bbox.max().x()-1);
+        int32 y = std::min(std::max(int32(floorf(pt->y)), image_bbox.min().y()), image_bbox.max().y()-1);
+        if (m_bbox.contains(Vector2i(x, y)))
+          ++pt;
+        else
+          pt = points.erase(pt);
       }
+      m_interest_points.swap(points);
     }
-    InterestPointList interest_point_list() { return m_interest_point_list; }
   };
 
   /// This free function implements a multithreaded interest point
-  /// detector.  Threads are spun off to process the image in
-  /// 2048x2048 pixel blocks.
+  /// detector.  The image is divided into tiles of the default tile
+  /// size, which are processed in parallel on the given thread pool
+  /// (by default the shared one).  Each tile is read with a margin of
+  /// the given number of pixels around it, so that points near the
+  /// seams between tiles are neither lost nor found twice.  Only the
+  /// tiles being processed are held in memory at once.  Each tile's
+  /// points are kept separately and concatenated in tile order at the
+  /// end, so the result does not depend on the number of threads.  If
+  /// any tile fails, its exception is rethrown once all tiles are done.
+  ///
+  /// Note that the detector's limit on the number of points applies
+  /// to each tile, including its margin, rather than to the image.
   template <class ViewT, class DetectorT>
-  InterestPointList detect_interest_points (ViewT const& view, DetectorT& detector) {
+  InterestPointList detect_interest_points (ViewT const& view, DetectorT& detector,
+                                            int32 margin = IP_DEFAULT_TILE_MARGIN,
+                                            WorkStealingPool& pool = vw_thread_pool()) {
     typedef InterestPointDetectionTask<ViewT, DetectorT> task_type;
 
-    FifoWorkQueue queue(vw_settings().default_num_threads());
-    InterestPointList ip_list;
-    Mutex mutex;     // Used to lock access to ip_list by the child threads.
-
     vw_out(DebugMessage, "interest_point") << "Running MT interest point detector.  Input image: [ " << view.impl().cols() << " x " << view.impl().rows() << " ]\n";
 
-    // Process the image in 1024x1024 pixel blocks.
     std::vector<BBox2i> bboxes = image_blocks(view.impl(),
                                               vw_settings().default_tile_size(),
                                               vw_settings().default_tile_size());
-    for (unsigned i = 0; i < bboxes.size(); ++i) {
-      boost::shared_ptr<task_type> task (new task_type(view, detector, bboxes[i], ip_list, mutex, i+1, bboxes.size() ) );
-      queue.add_task(task);
+    std::vector<InterestPointList> tile_points(bboxes.size());
+    {
+      TaskGroup group(pool);
+      for (unsigned i = 0; i < bboxes.size(); ++i)
+        group.add_task( boost::shared_ptr<Task>( new task_type(view, detector, bboxes[i], margin, tile_points[i],
+                                                               i+1, bboxes.size()) ) );
+      vw_out(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
+      group.join();
     }
-    vw_out(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
-    queue.join_all();
+
+    InterestPointList ip_list;
+    for (unsigned i = 0; i < tile_points.size(); ++i)
+      ip_list.splice(ip_list.end(), tile_points[i]);
 
     vw_out(DebugMessage, "interest_point") << "MT interest point detection complete.  " << ip_list.size() << " interest point detected.\n";
     return ip_list;
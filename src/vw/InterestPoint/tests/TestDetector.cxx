@@ -0,0 +1,138 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+// TestDetector.h
+#include <gtest/gtest.h>
+
+#include <vw/Image.h>
+#include <vw/InterestPoint.h>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace vw;
+using namespace vw::ip;
+
+// Orders points by position, so that lists found in different orders
+// can be compared.
+static bool position_less( InterestPoint const& a, InterestPoint const& b ) {
+  if ( a.y != b.y ) return a.y < b.y;
+  return a.x < b.x;
+}
+
+// Expects two lists to hold identical points in the same order.
+static void expect_same_points( InterestPointList const& a, InterestPointList const& b ) {
+  ASSERT_EQ( a.size(), b.size() );
+  for ( InterestPointList::const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j ) {
+    EXPECT_EQ( i->x, j->x );
+    EXPECT_EQ( i->y, j->y );
+    EXPECT_EQ( i->ix, j->ix );
+    EXPECT_EQ( i->iy, j->iy );
+    EXPECT_EQ( i->scale, j->scale );
+    EXPECT_EQ( i->orientation, j->orientation );
+    EXPECT_EQ( i->interest, j->interest );
+    EXPECT_EQ( i->polarity, j->polarity );
+  }
+}
+
+// A field of bright spots, several of which sit right on the seams
+// between 64 pixel tiles.
+static ImageView<PixelGray<float> > spots_image() {
+  ImageView<PixelGray<float> > image( 200, 170 );
+  std::vector<Vector2> spots;
+  for ( int j = 0; j < 5; j++ )
+    for ( int i = 0; i < 6; i++ )
+      spots.push_back( Vector2( 12 + 33*i + (j%2)*7, 10 + 33*j + (i%3)*5 ) );
+  spots.push_back( Vector2( 64, 64 ) );
+  spots.push_back( Vector2( 63.5, 128 ) );
+  spots.push_back( Vector2( 128, 30 ) );
+  for ( int y = 0; y < image.rows(); y++ )
+    for ( int x = 0; x < image.cols(); x++ ) {
+      float value = 0;
+      for ( unsigned s = 0; s < spots.size(); s++ ) {
+        double dx = x - spots[s].x(), dy = y - spots[s].y();
+        value += float( exp( -(dx*dx + dy*dy) / 8.0 ) );
+      }
+      image(x,y) = value;
+    }
+  return image;
+}
+
+// Runs each test with 64 pixel tiles, and puts the default tile size
+// back however the test ends.
+class DetectorTest : public ::testing::Test {
+  int m_tile_size;
+protected:
+  DetectorTest() : m_tile_size( vw_settings().default_tile_size() ) {
+    vw_settings().set_default_tile_size( 64 );
+  }
+  ~DetectorTest() { vw_settings().set_default_tile_size( m_tile_size ); }
+};
+
+TEST_F( DetectorTest, TiledMatchesWholeImage ) {
+  ImageView<PixelGray<float> > image = spots_image();
+  InterestPointDetector<HarrisInterestOperator> detector( 0 );
+  InterestPointList whole = detector( image );
+  WorkStealingPool one_thread( 1 ), eight_threads( 8 );
+  InterestPointList tiled = detect_interest_points( image, detector, IP_DEFAULT_TILE_MARGIN, one_thread );
+  InterestPointList threaded = detect_interest_points( image, detector, IP_DEFAULT_TILE_MARGIN, eight_threads );
+
+  // Tiles are merged in order, so any number of threads finds the
+  // same list.
+  expect_same_points( tiled, threaded );
+
+  // No point near a seam is lost or found twice.
+  ASSERT_LT( 0u, whole.size() );
+  whole.sort( position_less );
+  tiled.sort( position_less );
+  ASSERT_EQ( whole.size(), tiled.size() );
+  for ( InterestPointList::iterator a = whole.begin(), b = tiled.begin(); a != whole.end(); ++a, ++b ) {
+    EXPECT_NEAR( a->x, b->x, 1e-3 );
+    EXPECT_NEAR( a->y, b->y, 1e-3 );
+    EXPECT_EQ( a->ix, b->ix );
+    EXPECT_EQ( a->iy, b->iy );
+  }
+}
+
+TEST_F( DetectorTest, ScaledTiledMatchesWholeImage ) {
+  ImageView<PixelGray<float> > image = spots_image();
+  ScaledInterestPointDetector<LogInterestOperator> detector( LogInterestOperator(0.01), 0 );
+  InterestPointList whole = detector( image );
+  WorkStealingPool one_thread( 1 ), eight_threads( 8 );
+  InterestPointList tiled = detect_interest_points( image, detector, IP_DEFAULT_TILE_MARGIN, one_thread );
+  InterestPointList threaded = detect_interest_points( image, detector, IP_DEFAULT_TILE_MARGIN, eight_threads );
+
+  expect_same_points( tiled, threaded );
+
+  ASSERT_LT( 0u, whole.size() );
+  whole.sort( position_less );
+  tiled.sort( position_less );
+  ASSERT_EQ( whole.size(), tiled.size() );
+  for ( InterestPointList::iterator a = whole.begin(), b = tiled.begin(); a != whole.end(); ++a, ++b ) {
+    EXPECT_NEAR( a->x, b->x, 1e-3 );
+    EXPECT_NEAR( a->y, b->y, 1e-3 );
+    EXPECT_NEAR( a->scale, b->scale, 1e-3 );
+  }
+}
+
+// Fails on negative pixels, as a bad read from disk would.
+struct ThrowIfNegativeFunctor : public ReturnFixedType<PixelGray<float> > {
+  PixelGray<float> operator()( PixelGray<float> const& pixel ) const {
+    if ( pixel.v() < 0 )
+      vw_throw( IOErr() << "ThrowIfNegativeFunctor: bad pixel" );
+    return pixel;
+  }
+};
+
+TEST_F( DetectorTest, TileErrorKeepsItsType ) {
+  // The bad pixel is in one of several tiles, which run on the thread
+  // pool; the error should reach the caller unchanged.
+  ImageView<PixelGray<float> > image = spots_image();
+  image(150,100) = -1;
+  InterestPointDetector<HarrisInterestOperator> detector( 0 );
+  EXPECT_THROW( detect_interest_points( per_pixel_filter( image, ThrowIfNegativeFunctor() ), detector ), IOErr );
+}
@@ -16,7 +16,15 @@
 
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <cerrno>
 #include <boost/shared_array.hpp>
+#include <boost/checked_delete.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace vw;
 
@@ -26,25 +34,91 @@ using namespace vw;
 //                                 BLOB
 // -------------------------------------------------------------------
 
+// -------------------------------------------------------------------
+//                               MAPPING
+// -------------------------------------------------------------------
+
+// A read-only mapping of (a prefix of) a blob file.  When the file
+// grows, the blob maps it again rather than extending this mapping,
+// so references into an older mapping remain valid until the last of
+// them goes away.
+class vw::platefile::Blob::Mapping : boost::noncopyable {
+  void *m_addr;
+  uint64 m_size;
+public:
+  Mapping(int fd, uint64 size, std::string const& filename) : m_addr(0), m_size(size) {
+    if (size == 0)
+      return;
+    m_addr = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m_addr == MAP_FAILED)
+      vw_throw(BlobIoErr() << "Could not map blob file \"" << filename << "\": "
+                           << strerror(errno));
+  }
+  ~Mapping() {
+    if (m_size)
+      munmap(m_addr, m_size);
+  }
+  const uint8* data() const { return static_cast<const uint8*>(m_addr); }
+  uint64 size() const { return m_size; }
+};
+
+boost::shared_ptr<vw::platefile::Blob::Mapping>
+vw::platefile::Blob::mapping(uint64 offset, uint64 size) const {
+  Mutex::Lock lock(m_mapping_mutex);
+  if (!m_mapping || offset + size > m_mapping->size()) {
+    // The blob has grown (or this is the first read).  Map the whole
+    // file as it is now.
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+      vw_throw(BlobIoErr() << "Could not stat blob file \"" << m_blob_filename << "\".");
+    if (offset + size > uint64(st.st_size))
+      vw_throw(BlobIoErr() << "Read of " << size << " bytes at offset " << offset
+                           << " is past the end of blob file " << m_blob_filename << ".");
+    m_mapping.reset(new Mapping(m_fd, st.st_size, m_blob_filename));
+    WHEREAMI << "mapped " << st.st_size << " bytes of " << m_blob_filename << "\n";
+  }
+  return m_mapping;
+}
+
+/// read_ref()
+vw::platefile::BlobDataRef vw::platefile::Blob::read_ref(uint64 offset, uint64 size) const {
+  if (this->mapped()) {
+    boost::shared_ptr<Mapping> map = this->mapping(offset, size);
+    return BlobDataRef(map, map->data() + offset, size);
+  }
+
+  boost::shared_ptr<uint8> data(new uint8[size], boost::checked_array_deleter<uint8>());
+  m_fstream->seekg(offset, std::ios_base::beg);
+  m_fstream->read((char*)(data.get()), size);
+
+  // Throw an exception if the read operation failed (after clearing the error bit)
+  if (m_fstream->fail()) {
+    m_fstream->clear();
+    vw_throw(IOErr() << "Blob::read() -- an error occurred while reading " 
+             << "data from the blob file.\n");
+  }
+  return BlobDataRef(data, data.get(), size);
+}
+
 /// read_blob_record()
-vw::platefile::BlobRecord vw::platefile::Blob::read_blob_record(uint16 &blob_record_size) const {
+vw::platefile::BlobRecord vw::platefile::Blob::read_blob_record(uint64 base_offset, uint16 &blob_record_size) const {
 
   WHEREAMI << "[Filename: " << m_blob_filename
-           << " Offset: " << m_fstream->tellg() << "]\n";
+           << " Offset: " << base_offset << "]\n";
 
   // Read the blob record
-  m_fstream->read((char*)(&blob_record_size), sizeof(blob_record_size));
+  BlobDataRef size_data = this->read_ref(base_offset, sizeof(blob_record_size));
+  memcpy(&blob_record_size, size_data.data(), sizeof(blob_record_size));
   WHEREAMI << "[blob_record_size: " << blob_record_size << "]\n";
 
-  boost::shared_array<uint8> blob_rec_data(new uint8[blob_record_size]);
-  m_fstream->read((char*)(blob_rec_data.get()), blob_record_size);
+  BlobDataRef blob_rec_data = this->read_ref(base_offset + sizeof(blob_record_size), blob_record_size);
   WHEREAMI << "read complete.\n";
 
   BlobRecord blob_record;
-  bool worked = blob_record.ParseFromArray(blob_rec_data.get(),  blob_record_size);
+  bool worked = blob_record.ParseFromArray(blob_rec_data.data(),  blob_record_size);
   if (!worked)
     vw_throw(BlobIoErr() << "read_blob_record() failed in " << m_blob_filename 
-                         << " at offset " << m_fstream->tellg() << "\n");
+                         << " at offset " << base_offset << "\n");
   return blob_record;
 }
 
@@ -59,14 +133,19 @@ boost::shared_array<uint8> vw::platefile::Blob::read_data(vw::uint64 base_offset
   // Allocate an array of the appropriate size to read the data.
   boost::shared_array<uint8> data(new uint8[data_size]);
 
-  m_fstream->seekg(offset, std::ios_base::beg);
-  m_fstream->read((char*)(data.get()), data_size);
-
-  // Throw an exception if the read operation failed (after clearing the error bit)
-  if (m_fstream->fail()) {
-    m_fstream->clear();
-    vw_throw(IOErr() << "Blob::read() -- an error occurred while reading " 
-             << "data from the blob file.\n");
+  if (this->mapped()) {
+    BlobDataRef ref = this->read_ref(offset, data_size);
+    memcpy(data.get(), ref.data(), data_size);
+  } else {
+    m_fstream->seekg(offset, std::ios_base::beg);
+    m_fstream->read((char*)(data.get()), data_size);
+
+    // Throw an exception if the read operation failed (after clearing the error bit)
+    if (m_fstream->fail()) {
+      m_fstream->clear();
+      vw_throw(IOErr() << "Blob::read() -- an error occurred while reading " 
+               << "data from the blob file.\n");
+    }
   }
 
   WHEREAMI << "read " << data_size << " bytes at " << offset
@@ -74,16 +153,21 @@ boost::shared_array<uint8> vw::platefile::Blob::read_data(vw::uint64 base_offset
   return data;
 }
 
+/// read_data_ref()
+vw::platefile::BlobDataRef vw::platefile::Blob::read_data_ref(vw::uint64 base_offset) {
+  vw::uint64 offset, size;
+  std::string dontcare;
+  read_sendfile(base_offset, dontcare, offset, size);
+  return this->read_ref(offset, size);
+}
+
 vw::uint64 vw::platefile::Blob::next_base_offset(uint64 current_base_offset) {
 
   WHEREAMI << "[current_base_offset: " <<  current_base_offset << "]\n";
 
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(current_base_offset, std::ios_base::beg);
-  
   // Read the blob record
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record = this->read_blob_record(current_base_offset, blob_record_size);
   
   uint32 blob_offset_metadata = sizeof(blob_record_size) + blob_record_size;
   uint64 next_offset = current_base_offset + blob_offset_metadata + blob_record.data_offset() + blob_record.data_size();
@@ -98,12 +182,9 @@ vw::uint32 vw::platefile::Blob::data_size(uint64 base_offset) const {
 
   WHEREAMI << "[base_offset: " <<  base_offset << "]\n";
 
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(base_offset, std::ios_base::beg);
-  
   // Read the blob record
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record = this->read_blob_record(base_offset, blob_record_size);
 
   WHEREAMI << "[result size: " <<  blob_record.data_size() << "]\n";
 
@@ -112,10 +193,20 @@ vw::uint32 vw::platefile::Blob::data_size(uint64 base_offset) const {
 
 
 // Constructor stores the blob filename for reading & writing
-vw::platefile::Blob::Blob(std::string filename, bool readonly) : 
-  m_blob_filename(filename), m_write_count(0) {
+vw::platefile::Blob::Blob(std::string filename, bool readonly, bool mapped) : 
+  m_blob_filename(filename), m_write_count(0), m_readonly(readonly), m_fd(-1) {
+
+  if (readonly && mapped) {
+    m_fd = open(m_blob_filename.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        vw_throw(BlobIoErr() << "Could not open blob file \"" << m_blob_filename << "\".");      
 
-  if (readonly) {
+    // Set the cached copy of the end_of_file_ptr.  This also creates
+    // the initial mapping.
+    m_end_of_file_ptr = read_end_of_file_ptr();
+    WHEREAMI << filename << " (READONLY, MAPPED)\n";
+    return;
+  } else if (readonly) {
     m_fstream.reset(new std::fstream(m_blob_filename.c_str(), 
                                      std::ios::in | std::ios::binary));
     if (!m_fstream->is_open()) 
@@ -156,18 +247,18 @@ vw::platefile::Blob::Blob(std::string filename, bool readonly) :
 
 /// Destructor: make sure that we have written the end of file ptr.
 vw::platefile::Blob::~Blob() {
-  this->write_end_of_file_ptr(m_end_of_file_ptr);
+  if (!m_readonly)
+    this->write_end_of_file_ptr(m_end_of_file_ptr);
+  if (m_fd >= 0)
+    close(m_fd);
   WHEREAMI << m_blob_filename << "\n";
 }
 
 void vw::platefile::Blob::read_sendfile(vw::uint64 base_offset, std::string& filename, 
                                         vw::uint64& offset, vw::uint64& size) {
-  // Seek to the requested offset and read the header and data offset
-  m_fstream->seekg(base_offset, std::ios_base::beg);
-
   // Read the blob record
   uint16 blob_record_size;
-  BlobRecord blob_record = this->read_blob_record(blob_record_size);
+  BlobRecord blob_record = this->read_blob_record(base_offset, blob_record_size);
 
   // The overall blob metadata includes the uint16 of the
   // blob_record_size in addition to the size of the blob_record
@@ -180,6 +271,24 @@ void vw::platefile::Blob::read_sendfile(vw::uint64 base_offset, std::string& fil
   filename = m_blob_filename;
 }
 
+void vw::platefile::Blob::commit(bool sync) {
+  this->write_end_of_file_ptr(m_end_of_file_ptr);
+  m_fstream->flush();
+
+  // There is no portable way to get at the fstream's descriptor, but
+  // fsync() on any descriptor for the file flushes all of its data.
+  if (sync) {
+    int fd = open(m_blob_filename.c_str(), O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+      if (fd >= 0)
+        close(fd);
+      vw_throw(BlobIoErr() << "Could not sync blob file \"" << m_blob_filename << "\".");
+    }
+    close(fd);
+  }
+  WHEREAMI << m_blob_filename << " [end_of_file_ptr: " << m_end_of_file_ptr << "]\n";
+}
+
 void vw::platefile::Blob::write_end_of_file_ptr(uint64 ptr) {
   
   // We write the end of file pointer three times, because that
@@ -202,8 +311,8 @@ uint64 vw::platefile::Blob::read_end_of_file_ptr() const {
   
   // The end of file ptr is stored at the beginning of the blob
   // file.
-  m_fstream->seekg(0, std::ios_base::beg);
-  m_fstream->read((char*)(data), 3*sizeof(uint64));
+  BlobDataRef ref = this->read_ref(0, 3*sizeof(uint64));
+  memcpy(data, ref.data(), 3*sizeof(uint64));
 
   // Make sure the read ptr is valid by comparing the three
   // entries.  
@@ -224,6 +333,8 @@ uint64 vw::platefile::Blob::read_end_of_file_ptr() const {
   else {
     vw_out(ErrorMessage) << "\nWARNING: end of file ptr in blobfile " << m_blob_filename
                          << " is inconsistent.  This file may be corrupt.  Proceed with caution.\n";
+    if (this->mapped())
+      return this->mapping(0, 0)->size();
     m_fstream->seekg(0, std::ios_base::end);
     return m_fstream->tellg();
   }
@@ -231,8 +342,7 @@ uint64 vw::platefile::Blob::read_end_of_file_ptr() const {
 
 /// Read data out of the blob and save it as its own file on disk.
 void vw::platefile::Blob::read_to_file(std::string dest_file, uint64 offset) {
-  uint64 size;
-  boost::shared_array<uint8> data = this->read_data(offset, size);
+  BlobDataRef data = this->read_data_ref(offset);
 
   // Open the dest_file and write to it.
   std::ofstream ostr(dest_file.c_str(), std::ios::binary);
@@ -241,7 +351,7 @@ void vw::platefile::Blob::read_to_file(std::string dest_file, uint64 offset) {
     vw_throw(IOErr() << "Blob::read_as_file() -- could not open destination " 
              << "file for writing..");
 
-  ostr.write((char*)(data.get()), size);
+  ostr.write((const char*)(data.data()), data.size());
   ostr.close();
 }
 
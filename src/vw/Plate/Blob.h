@@ -32,7 +32,11 @@
 ///
 ///   [ DATA ]              [ uint8 - N raw bytes of data ]
 ///
-/// 
+/// Blobs that are opened read-only can also be memory-mapped, in which
+/// case headers are parsed directly from the mapping and tile data can
+/// be read as a BlobDataRef that points into the mapping, without any
+/// seeks or copies.
+///
 
 #include <fstream>
 #include <string>
@@ -42,7 +46,9 @@
 #include <vw/Core/Exception.h>
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Thread.h>
 
+#include <vw/Plate/Exception.h>
 #include <vw/Plate/ProtoBuffers.pb.h>
 
 namespace fs = boost::filesystem;
@@ -50,19 +56,55 @@ namespace fs = boost::filesystem;
 namespace vw {
 namespace platefile {
 
+  // -------------------------------------------------------------------
+  //                            BLOB DATA REF
+  // -------------------------------------------------------------------
+
+  /// A read-only reference to a range of bytes in a blob.  For a
+  /// memory-mapped blob it points straight into the mapping, which
+  /// stays mapped for as long as any reference to it exists (even if
+  /// the blob is closed or remapped).  Otherwise it owns a copy.
+  class BlobDataRef {
+    boost::shared_ptr<const void> m_owner;
+    const uint8* m_data;
+    uint64 m_size;
+  public:
+    BlobDataRef() : m_data(0), m_size(0) {}
+    BlobDataRef(boost::shared_ptr<const void> owner, const uint8* data, uint64 size) :
+      m_owner(owner), m_data(data), m_size(size) {}
+
+    const uint8* data() const { return m_data; }
+    uint64 size() const { return m_size; }
+  };
+
   // -------------------------------------------------------------------
   //                                 BLOB
   // -------------------------------------------------------------------
 
   class Blob : boost::noncopyable {
 
+    class Mapping;
+
     std::string m_blob_filename;
     boost::shared_ptr<std::fstream> m_fstream;
     uint64 m_end_of_file_ptr;
     uint64 m_write_count;
+    bool m_readonly;
+
+    // Used instead of m_fstream for memory-mapped blobs.
+    int m_fd;
+    mutable boost::shared_ptr<Mapping> m_mapping;
+    mutable Mutex m_mapping_mutex;
 
     /// Returns the metadata (i.e. BlobRecord) for a blob entry.
-    BlobRecord read_blob_record(uint16 &blob_record_size) const;
+    BlobRecord read_blob_record(uint64 base_offset, uint16 &blob_record_size) const;
+
+    /// Returns a reference to the given range of the blob file.
+    BlobDataRef read_ref(uint64 offset, uint64 size) const;
+
+    /// Makes sure the given range of the blob file is mapped, and
+    /// returns the mapping that covers it.
+    boost::shared_ptr<Mapping> mapping(uint64 offset, uint64 size) const;
 
     // End-of-file point manipulation.
     void write_end_of_file_ptr(uint64 ptr);
@@ -113,8 +155,10 @@ namespace platefile {
     
     // -----------------------------------------------------------------------
 
-    /// Constructor
-    Blob(std::string filename, bool readonly = false);
+    /// Constructor.  A readonly blob may also be memory-mapped.  The
+    /// mapping grows as needed if the blob is being appended to by
+    /// someone else.
+    Blob(std::string filename, bool readonly = false, bool mapped = false);
 
     /// The destructor flushes any unwritten journal entries and
     /// closes the blob and journal files.
@@ -125,6 +169,9 @@ namespace platefile {
     /// end_of_file_ptr)
     uint64 size() const { return m_end_of_file_ptr; }
 
+    /// Returns true if the blob is memory-mapped.
+    bool mapped() const { return m_fd >= 0; }
+
     /// Returns an iterator pointing to the first TileHeader in the blob.
     ///
     /// 3*sizeof(uint64) is the very first byte in the file after the
@@ -147,13 +194,10 @@ namespace platefile {
                                                      <<" base_offset: " 
                                                      <<  base_offset << "\n";
 
-      // Seek to the requested offset and read the header and data offset
-      m_fstream->seekg(base_offset, std::ios_base::beg);
-
       // Read the blob record
       uint16 blob_record_size;
-      BlobRecord blob_record = this->read_blob_record(blob_record_size);
-      
+      BlobRecord blob_record = this->read_blob_record(base_offset, blob_record_size);
+
       // The overall blob metadata includes the uint16 of the
       // blob_record_size in addition to the size of the blob_record
       // itself.  The offsets stored in the blob_record are relative to
@@ -162,26 +206,14 @@ namespace platefile {
       int32 size = blob_record.header_size();
       uint64 offset = base_offset + blob_offset_metadata + blob_record.header_offset();
       
-      // Allocate an array of the appropriate size to read the data.
-      boost::shared_array<uint8> data(new uint8[size]);
-
       vw_out(VerboseDebugMessage, "platefile::blob") << "         read_header() -- "
                                                      << " data offset: " << offset 
                                                      << " size: " << size << "\n";
-      
-      m_fstream->seekg(offset, std::ios_base::beg);
-      m_fstream->read((char*)(data.get()), size);
-  
-      // Throw an exception if the read operation failed (after clearing the error bit)
-      if (m_fstream->fail()) {
-        m_fstream->clear();
-        vw_throw(IOErr() << "Blob::read() -- an error occurred while reading " 
-                 << "data from the blob file.\n");
-      }
 
       // Deserialize the header
+      BlobDataRef data = this->read_ref(offset, size);
       ProtoBufT header;
-      bool worked = header.ParseFromArray(data.get(),  size);
+      bool worked = header.ParseFromArray(data.data(),  size);
       if (!worked)
         vw_throw(IOErr() << "Blob::read() -- an error occurred while deserializing the header "
                  << "from the blob file.\n");
@@ -195,6 +227,11 @@ namespace platefile {
     /// Returns the binary data for an entry starting at base_offset.
     boost::shared_array<uint8> read_data(vw::uint64 base_offset, vw::uint64& data_size);
 
+    /// Returns the binary data for an entry starting at base_offset.
+    /// If the blob is memory-mapped, this points into the mapping
+    /// rather than copying the data.
+    BlobDataRef read_data_ref(vw::uint64 base_offset);
+
     /// Returns the parameters necessary to call sendfile(2)
     void read_sendfile(vw::uint64 base_offset, std::string& filename, vw::uint64& offset, vw::uint64& size);
 
@@ -207,6 +244,28 @@ namespace platefile {
     /// written to the blob file.
     template <class ProtoBufT>
     vw::uint64 write(ProtoBufT const& header, boost::shared_array<uint8> data, uint64 data_size) {
+      vw::uint64 base_offset = this->append(header, data, data_size);
+
+      // The write_count is used to keep track of when we last wrote
+      // the end_of_file_ptr to disk.  We don't want to write this too
+      // often since this will slow down IO, so we only write it every
+      // 10 writes (or when the blob is deconstructed...).
+      ++m_write_count;
+      if (m_write_count % 10 == 0) {
+        this->write_end_of_file_ptr(m_end_of_file_ptr); 
+      }
+
+      return base_offset;
+    }
+
+    /// Write a tile to the blob file without ever updating the end of
+    /// file pointer on disk.  This is for writing tiles in batches:
+    /// call commit() once the whole batch has been appended.  Until
+    /// then, a reader that opens the blob will not see the batch.
+    template <class ProtoBufT>
+    vw::uint64 append(ProtoBufT const& header, boost::shared_array<uint8> data, uint64 data_size) {
+      if (m_readonly)
+        vw_throw(BlobIoErr() << "Blob::append() -- " << m_blob_filename << " is read-only.");
 
       // Store the current offset of the end of the file.  We'll
       // return that at the end of this function.
@@ -242,19 +301,15 @@ namespace platefile {
       // Update the in-memory copy of the end-of-file pointer
       m_end_of_file_ptr = m_fstream->tellg();
 
-      // The write_count is used to keep track of when we last wrote
-      // the end_of_file_ptr to disk.  We don't want to write this too
-      // often since this will slow down IO, so we only write it every
-      // 10 writes (or when the blob is deconstructed...).
-      ++m_write_count;
-      if (m_write_count % 10 == 0) {
-        this->write_end_of_file_ptr(m_end_of_file_ptr); 
-      }
-
       // Return the base_offset
       return base_offset;
     }
 
+    /// Write the end of file pointer to disk and flush the blob file,
+    /// making everything written so far visible to readers.  If sync
+    /// is true, this also waits for the data to reach the disk.
+    void commit(bool sync = false);
+
 
     /// Read data out of the blob and save it as its own file on disk.
     void read_to_file(std::string dest_file, vw::uint64 offset);
@@ -42,3 +42,10 @@ boost::shared_ptr<Index> Index::construct_open(std::string url) {
 
 }
 
+void Index::write_update(std::vector<TileHeader> const& headers,
+                         std::vector<IndexRecord> const& records) {
+  VW_ASSERT(headers.size() == records.size(),
+            ArgumentErr() << "Index::write_update(): headers and records differ in size.");
+  for (size_t i = 0; i < headers.size(); ++i)
+    this->write_update(headers[i], records[i]);
+}
@@ -16,6 +16,7 @@
 #include <vw/Plate/IndexPage.h>
 
 #include <list>
+#include <vector>
 
 #define VW_PLATE_INDEX_VERSION 3
 
@@ -81,6 +82,12 @@ namespace platefile {
     /// unlock the blob id.
     virtual void write_update(TileHeader const& header, IndexRecord const& record) = 0;
 
+    /// Writing, pt. 2, batched: Update the index for many tiles at
+    /// once.  headers[i] goes with records[i].  The default
+    /// implementation simply issues one write_update() per tile.
+    virtual void write_update(std::vector<TileHeader> const& headers,
+                              std::vector<IndexRecord> const& records);
+
     /// Writing, pt. 3: Signal the completion of the write operation.
     virtual void write_complete(int blob_id, uint64 blob_offset) = 0;
     
@@ -9,6 +9,8 @@
 #include <vw/Core/Debugging.h>
 
 #include <boost/shared_array.hpp>
+#include <algorithm>
+#include <cstring>
 
 #define WHEREAMI (vw::vw_out(VerboseDebugMessage, "platefile.index") << VW_CURRENT_FUNCTION << ": ")
 
@@ -16,13 +18,51 @@
 //                            INDEX PAGE
 // ----------------------------------------------------------------------
 
+namespace {
+
+  // Packed pages start with this in place of the page width, which is
+  // always positive in the older format.
+  const vw::int32 PACKED_PAGE_MAGIC = -0x56574950;
+
+  // Bump this whenever the packed layout changes.  Readers refuse
+  // pages with a version newer than their own.
+  const vw::int32 PACKED_PAGE_VERSION = 1;
+
+  // Sizes of the packed fields, in bytes.  The header is eight int32s
+  // (magic, version, page width and height, and the tile, record,
+  // filetype and filetype byte counts); a tile is its position and
+  // first record; a record is its transaction id, blob id, 64-bit
+  // blob offset, filetype index and next record.
+  const size_t PACKED_HEADER_SIZE = 8 * 4;
+  const size_t PACKED_TILE_SIZE = 2 * 4;
+  const size_t PACKED_RECORD_SIZE = 4 + 4 + 8 + 4 + 4;
+
+  // Packed pages are little-endian, with every field written
+  // separately, so they do not depend on the host's byte order or on
+  // how it pads structs.
+  void put_uint(std::string& buf, vw::uint64 value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+      buf.push_back(char((value >> (8*i)) & 0xff));
+  }
+  void put_int32(std::string& buf, vw::int32 value) { put_uint(buf, vw::uint32(value), 4); }
+
+  vw::uint64 get_uint(const char*& pos, int bytes) {
+    vw::uint64 value = 0;
+    for (int i = 0; i < bytes; ++i)
+      value |= vw::uint64(vw::uint8(*pos++)) << (8*i);
+    return value;
+  }
+  vw::int32 get_int32(const char*& pos) { return vw::int32(vw::uint32(get_uint(pos, 4))); }
+
+}
+
 vw::platefile::IndexPage::IndexPage(int level, int base_col, int base_row, 
                                     int page_width, int page_height) : 
   m_level(level), m_base_col(base_col), m_base_row(base_row),
   m_page_width(page_width), m_page_height(page_height) {
 
   // Set the size of the sparse table.
-  m_sparse_table.resize(page_width*page_height);
+  m_heads.resize(page_width*page_height);
 
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
@@ -31,71 +71,192 @@ vw::platefile::IndexPage::~IndexPage() {
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
 
+vw::int32 vw::platefile::IndexPage::filetype_index(std::string const& filetype) {
+  for (size_t i = 0; i < m_filetypes.size(); ++i)
+    if (m_filetypes[i] == filetype)
+      return i;
+  m_filetypes.push_back(filetype);
+  return m_filetypes.size() - 1;
+}
+
+vw::platefile::IndexRecord vw::platefile::IndexPage::unpack(PackedRecord const& packed) const {
+  IndexRecord record;
+  record.set_blob_id(packed.blob_id);
+  record.set_blob_offset(packed.blob_offset);
+  record.set_filetype(m_filetypes[packed.filetype]);
+  return record;
+}
+
+// Rewrite m_records so that each tile's chain is a contiguous run,
+// with the tiles in page order.
+void vw::platefile::IndexPage::compact() {
+  std::vector<PackedRecord> records;
+  records.reserve(m_records.size());
+  for (google::sparsetable<int32>::nonempty_iterator it = m_heads.nonempty_begin();
+       it != m_heads.nonempty_end(); ++it) {
+    int32 start = records.size();
+    for (int32 i = *it; i != -1; i = m_records[i].next) {
+      records.push_back(m_records[i]);
+      records.back().next = records.size();
+    }
+    records.back().next = -1;
+    *it = start;
+  }
+  m_records.swap(records);
+}
+
+size_t vw::platefile::IndexPage::memory_usage() const {
+  size_t bytes = sizeof(*this) + m_records.capacity() * sizeof(PackedRecord) 
+    + m_heads.num_nonempty() * sizeof(int32) + m_heads.size() / 8;
+  for (size_t i = 0; i < m_filetypes.size(); ++i)
+    bytes += sizeof(std::string) + m_filetypes[i].capacity();
+  return bytes;
+}
+
 void vw::platefile::IndexPage::serialize(std::ostream& ostr) {
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 
-  // Part 1: Write out the page size
-  ostr.write((char*)(&m_page_width), sizeof(m_page_width));
-  ostr.write((char*)(&m_page_height), sizeof(m_page_height));
-
-  // Part 2: Write the sparsetable metadata
-  m_sparse_table.write_metadata(&ostr);
-
-  // Part 3: Write sparse entries
-  for (google::sparsetable<multi_value_type>::nonempty_iterator it = m_sparse_table.nonempty_begin();
-       it != m_sparse_table.nonempty_end(); ++it) {
-
-    // Iterate over transaction_id list.
-    int32 transaction_list_size = (*it).size();
-    ostr.write((char*)(&transaction_list_size), sizeof(transaction_list_size));
-    
-    multi_value_type::iterator transaction_iter = (*it).begin();
-    while (transaction_iter != (*it).end()) {
-      
-      // Save the transaction id
-      int32 t_id = (*transaction_iter).first;
-      ostr.write((char*)(&t_id), sizeof(t_id));
-      
-      // Save the size of each protobuf, and then serialize it to disk.
-      uint16 protobuf_size = (*transaction_iter).second.ByteSize();
-      boost::shared_array<uint8> protobuf_bytes( new uint8[protobuf_size] );
-      (*transaction_iter).second.SerializeToArray(protobuf_bytes.get(), protobuf_size);
-      ostr.write((char*)(&protobuf_size), sizeof(protobuf_size));
-      ostr.write((char*)(protobuf_bytes.get()), protobuf_size);
-    
-      ++transaction_iter;
+  this->compact();
+
+  size_t filetype_bytes = 0;
+  for (size_t i = 0; i < m_filetypes.size(); ++i)
+    filetype_bytes += m_filetypes[i].size() + 1;
+
+  std::string buf;
+  buf.reserve(PACKED_HEADER_SIZE + m_heads.num_nonempty() * PACKED_TILE_SIZE
+              + m_records.size() * PACKED_RECORD_SIZE + filetype_bytes);
+
+  put_int32(buf, PACKED_PAGE_MAGIC);
+  put_int32(buf, PACKED_PAGE_VERSION);
+  put_int32(buf, m_page_width);
+  put_int32(buf, m_page_height);
+  put_int32(buf, m_heads.num_nonempty());
+  put_int32(buf, m_records.size());
+  put_int32(buf, m_filetypes.size());
+  put_int32(buf, filetype_bytes);
+
+  for (int32 i = 0; i < int32(m_heads.size()); ++i) {
+    if (m_heads.test(i)) {
+      put_int32(buf, i);
+      put_int32(buf, m_heads.get(i));
     }
   }
+
+  for (size_t i = 0; i < m_records.size(); ++i) {
+    PackedRecord const& record = m_records[i];
+    put_int32(buf, record.transaction_id);
+    put_int32(buf, record.blob_id);
+    put_uint(buf, record.blob_offset, 8);
+    put_int32(buf, record.filetype);
+    put_int32(buf, record.next);
+  }
+
+  for (size_t i = 0; i < m_filetypes.size(); ++i)
+    buf.append(m_filetypes[i].c_str(), m_filetypes[i].size() + 1);
+
+  ostr.write(buf.data(), buf.size());
 }
 
 void vw::platefile::IndexPage::deserialize(std::istream& istr) {
 
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 
-  // Part 1: Read the page size
-  istr.read((char*)(&m_page_width), sizeof(m_page_width));
+  char header[PACKED_HEADER_SIZE];
+  istr.read(header, 4);
+  const char* pos = header;
+  if (get_int32(pos) != PACKED_PAGE_MAGIC) {
+    // Older pages start with the page width, in host byte order.
+    int32 page_width;
+    memcpy(&page_width, header, sizeof(page_width));
+    this->deserialize_legacy(istr, page_width);
+    return;
+  }
+  istr.read(header + 4, PACKED_HEADER_SIZE - 4);
+  if (istr.fail())
+    vw_throw(IOErr() << "An error occurred while reading an IndexPage header."); 
+
+  int32 version = get_int32(pos);
+  if (version < 1 || version > PACKED_PAGE_VERSION)
+    vw_throw(IOErr() << "IndexPage: unsupported page format version " << version 
+             << " (this reader supports up to version " << PACKED_PAGE_VERSION << ").");
+  int32 page_width = get_int32(pos), page_height = get_int32(pos);
+  int32 num_tiles = get_int32(pos), num_records = get_int32(pos);
+  int32 num_filetypes = get_int32(pos), filetype_bytes = get_int32(pos);
+  if (page_width <= 0 || page_height <= 0 || num_tiles < 0 || num_records < num_tiles ||
+      num_filetypes < 0 || filetype_bytes < num_filetypes)
+    vw_throw(IOErr() << "IndexPage: corrupt page header.");
+
+  // Read the rest of the page in one go.
+  std::vector<char> body(num_tiles * PACKED_TILE_SIZE + num_records * PACKED_RECORD_SIZE 
+                         + filetype_bytes);
+  if (!body.empty())
+    istr.read(&body[0], body.size());
+  if (istr.fail())
+    vw_throw(IOErr() << "An error occurred while reading an IndexPage."); 
+  pos = body.empty() ? 0 : &body[0];
+
+  m_page_width = page_width;
+  m_page_height = page_height;
+  m_heads.clear();
+  m_heads.resize(m_page_width*m_page_height);
+  for (int32 i = 0; i < num_tiles; ++i) {
+    int32 position = get_int32(pos), head = get_int32(pos);
+    if (position < 0 || position >= int32(m_heads.size()) || head < 0 || head >= num_records)
+      vw_throw(IOErr() << "IndexPage: corrupt tile table.");
+    m_heads.set(position, head);
+  }
+
+  m_records.resize(num_records);
+  for (int32 i = 0; i < num_records; ++i) {
+    PackedRecord& record = m_records[i];
+    record.transaction_id = get_int32(pos);
+    record.blob_id = get_int32(pos);
+    record.blob_offset = get_uint(pos, 8);
+    record.filetype = get_int32(pos);
+    record.next = get_int32(pos);
+    if (record.filetype < 0 || record.filetype >= num_filetypes ||
+        record.next < -1 || record.next >= num_records)
+      vw_throw(IOErr() << "IndexPage: corrupt index record.");
+  }
+
+  m_filetypes.clear();
+  const char* end = pos + filetype_bytes;
+  for (int32 i = 0; i < num_filetypes; ++i) {
+    const char* nul = std::find(pos, end, '\0');
+    if (nul == end)
+      vw_throw(IOErr() << "IndexPage: corrupt filetype table.");
+    m_filetypes.push_back(std::string(pos, nul));
+    pos = nul + 1;
+  }
+}
+
+// Reads a page in the format used before pages were packed: the page
+// size, the sparsetable metadata, and then a list of (transaction id,
+// serialized IndexRecord) pairs for each nonempty tile.
+void vw::platefile::IndexPage::deserialize_legacy(std::istream& istr, int32 page_width) {
+  m_page_width = page_width;
   istr.read((char*)(&m_page_height), sizeof(m_page_height));
 
-  // Part 2: Read the sparsetable metadata
-  m_sparse_table.read_metadata(&istr);
+  m_heads.read_metadata(&istr);
+  m_records.clear();
+  m_filetypes.clear();
 
-  // Part 3: Read sparse entries
-  for (google::sparsetable<multi_value_type>::nonempty_iterator it = m_sparse_table.nonempty_begin();
-       it != m_sparse_table.nonempty_end(); ++it) {
+  for (int32 elmnt = 0; elmnt < int32(m_heads.size()); ++elmnt) {
+    if (!m_heads.test(elmnt))
+      continue;
 
-    // Iterate over transaction_id list.
     int32 transaction_list_size;
     istr.read((char*)(&transaction_list_size), sizeof(transaction_list_size));
-    
-    new (&(*it)) multi_value_type();
-    for (int tid = 0; tid < transaction_list_size; ++tid) {
+    if (transaction_list_size == 0) {
+      m_heads.erase(elmnt);
+      continue;
+    }
 
-      // Read the transaction id
+    m_heads.set(elmnt, m_records.size());
+    for (int tid = 0; tid < transaction_list_size; ++tid) {
       int32 t_id;
       istr.read((char*)(&t_id), sizeof(t_id));
 
-      // Read the size (in bytes) of this protobuffer and then read
-      // the protobuffer and deserialize it.
       uint16 protobuf_size;
       istr.read((char*)(&protobuf_size), sizeof(protobuf_size));
       boost::shared_array<uint8> protobuf_bytes( new uint8[protobuf_size] );
@@ -103,8 +264,14 @@ void vw::platefile::IndexPage::deserialize(std::istream& istr) {
       IndexRecord rec;
       if (!rec.ParseFromArray(protobuf_bytes.get(), protobuf_size))
         vw_throw(IOErr() << "An error occurred while parsing an IndexEntry."); 
-      
-      (*it).push_back(std::pair<int32, IndexRecord>(t_id, rec));
+
+      PackedRecord packed;
+      packed.transaction_id = t_id;
+      packed.blob_id = rec.blob_id();
+      packed.blob_offset = rec.blob_offset();
+      packed.filetype = this->filetype_index(rec.filetype());
+      packed.next = (tid + 1 < transaction_list_size) ? int32(m_records.size() + 1) : -1;
+      m_records.push_back(packed);
     }
   }
 }
@@ -118,42 +285,38 @@ void vw::platefile::IndexPage::set(TileHeader const& header, IndexRecord const&
 
   int32 page_col = header.col() % m_page_width;
   int32 page_row = header.row() % m_page_height;
-
-  std::pair<int32, IndexRecord> p(header.transaction_id(), record);
   int elmnt = page_row*m_page_width + page_col;
-  if (m_sparse_table.test(elmnt)) {
-
-    // Add to existing entry.
-    multi_value_type *entries = m_sparse_table[page_row*m_page_width + page_col].operator&();
-
-    // We need to keep this list sorted in decreasing order of
-    // transaction ID, do a simple insertion sort here.
-    multi_value_type::iterator it = entries->begin();
-    while (it != entries->end() && (*it).first >= int64(header.transaction_id()) ) {
 
-      // Handle the case where we replace an entry
-      if ( (*it).first == int64(header.transaction_id()) ) {
-        (*it).second = record;
-        return;
-      }
-
-      // Otherwise, we search forward in the list.
-      ++it;
+  PackedRecord packed;
+  packed.transaction_id = header.transaction_id();
+  packed.blob_id = record.blob_id();
+  packed.blob_offset = record.blob_offset();
+  packed.filetype = this->filetype_index(record.filetype());
+  packed.next = -1;
+
+  // We need to keep each chain sorted in decreasing order of
+  // transaction ID, so do a simple insertion sort here.
+  int32 prev = -1;
+  int32 cur = m_heads.test(elmnt) ? m_heads.get(elmnt) : -1;
+  while (cur != -1 && m_records[cur].transaction_id >= packed.transaction_id) {
+
+    // Handle the case where we replace an entry
+    if (m_records[cur].transaction_id == packed.transaction_id) {
+      packed.next = m_records[cur].next;
+      m_records[cur] = packed;
+      return;
     }
-    
-    // If we reach this point, we are either at the end of the list,
-    // or we have found the correct position.  Either way, we call
-    // insert().
-    entries->insert(it, p);
-
-  } else {
-    
-    // Create a new entry
-    multi_value_type l;
-    l.push_front(p);
-    m_sparse_table[elmnt] = l;
-    
+
+    prev = cur;
+    cur = m_records[cur].next;
   }
+
+  packed.next = cur;
+  m_records.push_back(packed);
+  if (prev == -1)
+    m_heads.set(elmnt, m_records.size() - 1);
+  else
+    m_records[prev].next = m_records.size() - 1;
 }
 
 /// Return the IndexRecord for a the given transaction_id at
@@ -179,36 +342,33 @@ vw::platefile::IndexRecord vw::platefile::IndexPage::get(int col, int row,
   // Compute page_col and row
   int32 page_col = col % m_page_width;
   int32 page_row = row % m_page_height;
+  int elmnt = page_row*m_page_width + page_col;
 
-  // Interate over entries.
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
-
-  if ( entries.begin() == entries.end() )
+  if ( !m_heads.test(elmnt) )
     vw_throw(TileNotFoundErr() << "No Tiles exist at this location.\n");
 
   // A transaction ID of -1 indicates that we should return the most
-  // recent tile (which is the first entry in the list, since it is
+  // recent tile (which is the first entry in the chain, since it is
   // sorted from most recent to least recent), regardless of its
   // transaction id.
+  int32 i = m_heads.get(elmnt);
   if (transaction_id == -1)
-    return (*it).second;
-
-  // Otherwise, we search through the entries in the list, looking for
-  // the requested t_id.  Note: this search is O(n), so it can be slow
-  // if there are a lot of entries and the entry you are looking for
-  // is near the end.  However, most pages will contain very few
-  // entries, and for those with many entries (i.e. tiles near the
-  // root of the mosaic), you will rarely search for old tiles.
-  while (it != entries.end()) {
+    return this->unpack(m_records[i]);
+
+  // Otherwise, we search through the chain, looking for the requested
+  // t_id.  Chains are short for most tiles, and for those with many
+  // entries (i.e. tiles near the root of the mosaic), you will rarely
+  // search for old tiles.
+  for (; i != -1; i = m_records[i].next) {
     if (exact_match) {
-      if ((*it).first == transaction_id)
-        return (*it).second;
+      if (m_records[i].transaction_id == transaction_id)
+        return this->unpack(m_records[i]);
+      if (m_records[i].transaction_id < transaction_id)
+        break;
     } else {
-      if ((*it).first <= transaction_id)
-        return (*it).second;
+      if (m_records[i].transaction_id <= transaction_id)
+        return this->unpack(m_records[i]);
     }
-    ++it;
   }
 
   // If we reach this point, then there are no entries before
@@ -218,22 +378,45 @@ vw::platefile::IndexRecord vw::platefile::IndexPage::get(int col, int row,
   return IndexRecord(); // never reached
 }
 
+/// Return multiple index entries that match the specified
+/// transaction id range.
+vw::platefile::IndexPage::multi_value_type 
+vw::platefile::IndexPage::multi_get(int col, int row, 
+                                    int begin_transaction_id, int end_transaction_id) const {
+
+  VW_ASSERT( col >= 0 && row >= 0,
+             TileNotFoundErr() << "IndexPage::multi_get() failed.  Column and row indices must be positive.");
+
+  int32 page_col = col % m_page_width;
+  int32 page_row = row % m_page_height;
+  int elmnt = page_row*m_page_width + page_col;
+
+  multi_value_type results;
+  if ( !m_heads.test(elmnt) )
+    return results;
+
+  for (int32 i = m_heads.get(elmnt); 
+       i != -1 && m_records[i].transaction_id >= begin_transaction_id; i = m_records[i].next)
+    if (m_records[i].transaction_id <= end_transaction_id)
+      results.push_back(std::make_pair(m_records[i].transaction_id, this->unpack(m_records[i])));
+  return results;
+}
 
 void vw::platefile::IndexPage::append_if_in_region( std::list<vw::platefile::TileHeader> &results, 
-                                                    multi_value_type const& candidates,
+                                                    int32 transaction_id, int num_candidates,
                                                     int col, int row, BBox2i const& region, 
                                                     int min_num_matches) const {
 
   // Check to see if the tile is in the specified region.
   Vector2i loc( m_base_col + col, m_base_row + row);
-  if ( region.contains( loc ) && int(candidates.size()) >= min_num_matches ) {
+  if ( region.contains( loc ) && num_candidates > 0 && num_candidates >= min_num_matches ) {
     TileHeader hdr;
     hdr.set_col( m_base_col + col );
     hdr.set_row( m_base_row + row );
     hdr.set_level(m_level);
 
-    // Return the transaction ID of the first result in the list.
-    hdr.set_transaction_id(candidates.begin()->first);
+    // Return the transaction ID of the first result.
+    hdr.set_transaction_id(transaction_id);
     results.push_back(hdr);
   }
 }
@@ -253,59 +436,46 @@ vw::platefile::IndexPage::search_by_region(vw::BBox2i const& region,
 
   for (int row = 0; row < m_page_height; ++row) {
     for (int col = 0; col < m_page_width; ++col) {
-      if (m_sparse_table.test(row*m_page_width + col)) {
+      if (m_heads.test(row*m_page_width + col)) {
 
-        // Iterate over entries.
-        multi_value_type const& entries = m_sparse_table[row*m_page_width + col];
-        multi_value_type::const_iterator it = entries.begin();
-        multi_value_type candidates;
+        int32 i = m_heads.get(row*m_page_width + col);
+        int32 first_transaction_id = 0;
+        int num_candidates = 0;
 
         if (start_transaction_id == -1 && end_transaction_id == -1) {
           
           // If the user has specified a transaction range of [-1, -1],
           // then we only return the last valid tile.
-          if (entries.size() > 0)
-            candidates.push_back( *(entries.begin()) );
+          first_transaction_id = m_records[i].transaction_id;
+          num_candidates = 1;
 
         } else {
 
-          // std::ostringstream ostr;
-          // ostr << "Accumulating entries for tile ["
-          //      << (m_base_col + col) << " " << (m_base_row + row) <<  " @ " 
-          //      << m_level << "] with " << entries.size() << " entries -- ";
-
-          // Search through the entries in the list, looking entries
-          // that match the requested transaction_id range.  Note: this
-          // search is O(n), so it can be slow if there are a lot of
-          // entries and the entry you are looking for is near the end.
-          // However, most pages will contain very few entries, and for
+          // Count the entries in the chain that match the requested
+          // transaction_id range.  Most chains are short, and for
           // those with many entries (i.e. tiles near the root of the
           // mosaic), you will most likely be searching for recently
           // added tiles, which are sorted to the beginning.
-          while (it != entries.end() && it->first >= start_transaction_id) {
-            if ( it->first >= start_transaction_id && it->first <= end_transaction_id ) {
-              //              ostr << it->first << " ";
-              candidates.push_back(*it);
+          for (; i != -1 && m_records[i].transaction_id >= start_transaction_id; i = m_records[i].next) {
+            if ( m_records[i].transaction_id <= end_transaction_id ) {
+              if (num_candidates++ == 0)
+                first_transaction_id = m_records[i].transaction_id;
             }
-            ++it;
           }
 
           // For snapshotting, we need to fetch one additional entry
           // outside of the specified range.  This next tile
           // represents the "top" tile in the mosaic for entries that
           // may not have been part of the last snapshot.  
-          if (fetch_one_additional_entry && it != entries.end()) {
-            //ostr << it->first << " ";
-            candidates.push_back(*it);
+          if (fetch_one_additional_entry && i != -1) {
+            if (num_candidates++ == 0)
+              first_transaction_id = m_records[i].transaction_id;
           }
-          
-          // For debugging
-          // if (candidates.size() != 0)// && m_level == 10)
-          //   std::cout << ostr.str() << "   ( " << candidates.size() << " )\n";
         }
         
         // Do the region check.
-        append_if_in_region( results, candidates, col, row, region, min_num_matches );
+        append_if_in_region( results, first_transaction_id, num_candidates, 
+                             col, row, region, min_num_matches );
       }
     }
   }
@@ -328,35 +498,30 @@ vw::platefile::IndexPage::search_by_location(int col, int row,
             << page_col << " " << page_row << "]");
 
   // Check first to make sure that there are actually tiles at this location.
-  if (!m_sparse_table.test(page_row*m_page_width + page_col))
+  if (!m_heads.test(page_row*m_page_width + page_col))
     return std::list<TileHeader>();
 
   // If there are, then we apply the transaction_id filters to select the requested ones.
   std::list<vw::platefile::TileHeader> results;
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
-  while (it != entries.end() && it->first >= start_transaction_id) {
-    if (it->first >= start_transaction_id && it->first <= end_transaction_id) {
-      TileHeader hdr;
-      hdr.set_col( m_base_col + page_col );
-      hdr.set_row( m_base_row + page_row );
-      hdr.set_level(m_level);
-      hdr.set_transaction_id(it->first);
+  TileHeader hdr;
+  hdr.set_col( m_base_col + page_col );
+  hdr.set_row( m_base_row + page_row );
+  hdr.set_level(m_level);
+
+  int32 i = m_heads.get(page_row*m_page_width + page_col);
+  for (; i != -1 && m_records[i].transaction_id >= start_transaction_id; i = m_records[i].next) {
+    if (m_records[i].transaction_id <= end_transaction_id) {
+      hdr.set_transaction_id(m_records[i].transaction_id);
       results.push_back(hdr);
     }
-    ++it;
   }
   
   // For snapshotting, we need to fetch one additional entry
   // outside of the specified range.  This next tile
   // represents the "top" tile in the mosaic for entries that
   // may not have been part of the last snapshot.  
-  if (fetch_one_additional_entry && it != entries.end()) {
-    TileHeader hdr;
-    hdr.set_col( m_base_col + page_col );
-    hdr.set_row( m_base_row + page_row );
-    hdr.set_level(m_level);
-    hdr.set_transaction_id(it->first);
+  if (fetch_one_additional_entry && i != -1) {
+    hdr.set_transaction_id(m_records[i].transaction_id);
     results.push_back(hdr);
   }
   
@@ -17,6 +17,7 @@
 #include <vw/Plate/google/sparsetable>
 #include <string>
 #include <list>
+#include <vector>
 
 namespace vw {
 namespace platefile {
@@ -29,15 +30,35 @@ namespace platefile {
 
   public:
     typedef std::list<std::pair<int32,IndexRecord> > multi_value_type;
-    typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
 
   protected:
+    /// An IndexRecord packed into a fixed-size POD.  The records for
+    /// each tile form a chain, sorted in decreasing order of
+    /// transaction id and linked through 'next'.  New records are
+    /// appended to the end of m_records; compact() lays each chain
+    /// out contiguously again, so that a freshly loaded or saved page
+    /// has one sorted run of records per tile.
+    struct PackedRecord {
+      int32 transaction_id;
+      int32 blob_id;
+      uint64 blob_offset;
+      int32 filetype;    // Index into m_filetypes
+      int32 next;        // Next (older) record for this tile, or -1
+    };
+
     int m_level, m_base_col, m_base_row;
     int m_page_width, m_page_height;
-    google::sparsetable<multi_value_type> m_sparse_table;
+    google::sparsetable<int32> m_heads;     // First record for each tile
+    std::vector<PackedRecord> m_records;
+    std::vector<std::string> m_filetypes;
+
+    int32 filetype_index(std::string const& filetype);
+    IndexRecord unpack(PackedRecord const& packed) const;
+    void compact();
+    void deserialize_legacy(std::istream& istr, int32 page_width);
 
     void append_if_in_region( std::list<vw::platefile::TileHeader> &results, 
-                              multi_value_type const& candidates,
+                              int32 transaction_id, int num_candidates,
                               int col, int row, BBox2i const& region, int min_num_matches) const;
 
 
@@ -53,14 +74,12 @@ namespace platefile {
     virtual void sync() = 0;
 
     // For reading/writing to/from disk or a network byte stream.
+    // Pages are written in a versioned, little-endian packed format
+    // that is read back with a single read; pages in the older
+    // per-record format can still be read.
     void serialize(std::ostream& ostr);
     void deserialize(std::istream& istr);
 
-    // ----------------------- ITERATORS  ----------------------
-
-    nonempty_iterator begin() { return m_sparse_table.nonempty_begin(); }
-    nonempty_iterator end() { return m_sparse_table.nonempty_end(); }
-
     // ----------------------- ACCESSORS  ----------------------
 
     /// Set the value of an entry in the IndexPage.
@@ -95,7 +114,14 @@ namespace platefile {
 
     /// Return the number of valid entries in this page.  (Remember
     /// that this is a sparse store of IndexRecords.)
-    int sparse_size() { return m_sparse_table.num_nonempty(); }
+    int sparse_size() const { return m_heads.num_nonempty(); }
+
+    /// Return the number of IndexRecords stored in this page.
+    int num_records() const { return m_records.size(); }
+
+    /// Return the (approximate) number of bytes of memory used by
+    /// this page.
+    size_t memory_usage() const;
 
     /// Returns a list of valid tiles in this IndexPage.  
     ///
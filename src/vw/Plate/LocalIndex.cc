@@ -382,7 +382,7 @@ int32 vw::platefile::LocalIndex::transaction_request(std::string transaction_des
      std::string blob_id_str(matches[2].first, matches[2].second);
      int current_blob_id = atoi(blob_id_str.c_str());
 
-     Blob blob(this->platefile_name() + "/" + blob_files[i], true);
+     Blob blob(this->platefile_name() + "/" + blob_files[i], true, true);
      Blob::iterator iter = blob.begin();
      while (iter != blob.end()) {
        TileHeader hdr = *iter;
@@ -422,6 +422,22 @@ void vw::platefile::LocalIndex::write_update(TileHeader const& header, IndexReco
   }
 }
 
+/// Writing, pt. 2, batched
+void vw::platefile::LocalIndex::write_update(std::vector<TileHeader> const& headers,
+                                             std::vector<IndexRecord> const& records) {
+  VW_ASSERT(headers.size() == records.size(),
+            ArgumentErr() << "LocalIndex::write_update(): headers and records differ in size.");
+
+  int starting_size = m_levels.size();
+  for (size_t i = 0; i < headers.size(); ++i)
+    PagedIndex::write_update(headers[i], records[i]);
+
+  if (int(m_levels.size()) != starting_size) {
+    m_header.set_num_levels(m_levels.size());
+    this->save_index_file();
+  }
+}
+
 /// Writing, pt. 3: Signal the completion 
 void vw::platefile::LocalIndex::write_complete(int blob_id, uint64 blob_offset) {  
   m_blob_manager->release_lock(blob_id, blob_offset);
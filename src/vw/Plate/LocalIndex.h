@@ -133,6 +133,11 @@ namespace platefile {
     // unlock the blob id.
     virtual void write_update(TileHeader const& header, IndexRecord const& record);
 
+    // Writing, pt. 2, batched: Update the index for many tiles,
+    // saving the index header at most once.
+    virtual void write_update(std::vector<TileHeader> const& headers,
+                              std::vector<IndexRecord> const& records);
+
     /// Writing, pt. 3: Signal the completion 
     virtual void write_complete(int blob_id, uint64 blob_offset);
 
@@ -39,23 +39,31 @@ vw::platefile::IndexLevel::IndexLevel(boost::shared_ptr<PageGeneratorFactory> pa
 }
 
 boost::shared_ptr<vw::platefile::IndexPage> vw::platefile::IndexLevel::fetch_page(int i, int j) const {
-  Mutex::Lock lock(m_cache_mutex);
+  handle_t handle;
+  {
+    Mutex::Lock lock(m_cache_mutex);
 
-  size_t idx = j*m_horizontal_pages + i;
+    size_t idx = j*m_horizontal_pages + i;
 
-  // We may need to actually create the page's cache handle if it
-  // hasn't been created already.
-  if ( !m_cache_handles[idx].attached() ) {
+    // We may need to actually create the page's cache handle if it
+    // hasn't been created already.
+    if ( !m_cache_handles[idx].attached() ) {
 
-    WHEREAMI << "Creating cache generator for page " << i << " " << j << " @ " << m_level << "\n";
+      WHEREAMI << "Creating cache generator for page " << i << " " << j << " @ " << m_level << "\n";
 
-    boost::shared_ptr<PageGeneratorBase> generator =
-      m_page_gen_factory->create(m_level, i * m_page_width, j * m_page_height,
-                                 m_page_width, m_page_height);
-      m_cache_handles[idx] = m_cache.insert( generator );
+      boost::shared_ptr<PageGeneratorBase> generator =
+        m_page_gen_factory->create(m_level, i * m_page_width, j * m_page_height,
+                                   m_page_width, m_page_height);
+        m_cache_handles[idx] = m_cache.insert( generator );
+    }
+    handle = m_cache_handles[idx];
   }
 
-  return m_cache_handles[idx];
+  // Loading the page may take a round trip to an index server, so we
+  // don't hold up requests for other pages while we do it.  The cache
+  // line has a lock of its own, so threads that want the same page
+  // all wait for (and share) a single load.
+  return handle;
 }
 
 
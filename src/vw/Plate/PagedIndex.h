@@ -139,6 +139,7 @@ namespace platefile {
 
     // Writing, pt. 2: Supply information to update the index and
     // unlock the blob id.
+    using Index::write_update;
     virtual void write_update(TileHeader const& header, IndexRecord const& record);
   
     /// Writing, pt. 3: Signal the completion 
@@ -219,7 +219,7 @@ namespace platefile {
 
     /// This function generates a specific mipmap tile at the given
     /// col, row, and level, and transaction_id.
-    void generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const {
+    bool generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const {
 
       // Create an image large enough to store all of the child nodes
       int tile_size = m_platefile->default_tile_size();
@@ -264,7 +264,9 @@ namespace platefile {
         vw_out(VerboseDebugMessage, "platefile") << "Writing " << col << " " << row
           << " @ " << level << "\n";
         m_platefile->write_update(new_tile, col, row, level, transaction_id);
+        return true;
       }
+      return false;
     }
   };
 
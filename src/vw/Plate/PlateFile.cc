@@ -119,18 +119,22 @@ std::string vw::platefile::PlateFile::read_to_file(std::string const& base_name,
 
   TileHeader result;
   std::string filename = base_name;
+  Mutex::Lock lock(m_io_mutex);
   
   // 1. Call index read_request(col,row,level).  Returns IndexRecord.
   IndexRecord record = m_index->read_request(col, row, level, transaction_id);
   
-  // 2. Open the blob file and read the header
+  // 2. Open the blob file and read the header.  Only the write blob
+  // is shared with other threads; any other blob is opened just for
+  // this read, so it is read without holding the lock.
   boost::shared_ptr<Blob> read_blob;
   if (m_write_blob && record.blob_id() == m_write_blob_id) {
     read_blob = m_write_blob;
   } else {
     std::ostringstream blob_filename;
     blob_filename << this->name() << "/plate_" << record.blob_id() << ".blob";
-    read_blob.reset(new Blob(blob_filename.str(), true));
+    lock.unlock();
+    read_blob.reset(new Blob(blob_filename.str(), true, true));
   }
   
   // 3. Choose a temporary filename and call BlobIO
@@ -172,6 +176,58 @@ void vw::platefile::PlateFile::write_request() {
   m_index->log(ostr.str());
 }
 
+/// Writing, pt. 2, batched: Write many raw tiles in one go.
+void vw::platefile::PlateFile::write_batch(std::vector<RawTile> const& tiles,
+                                           WriteDurability durability) {
+  if (this->default_file_type() == "auto")
+    vw_throw(NoImplErr() << "write_batch() does not support writing un-typed " 
+             << "data arrays for filetype \'auto\'.\n");
+
+  bool locked_here = !m_write_blob;
+  if (locked_here)
+    this->write_request();
+
+  try {
+    std::vector<TileHeader> headers(tiles.size());
+    std::vector<IndexRecord> records(tiles.size());
+    Mutex::Lock lock(m_io_mutex);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+      headers[i].set_col(tiles[i].col);
+      headers[i].set_row(tiles[i].row);
+      headers[i].set_level(tiles[i].level);
+      headers[i].set_transaction_id(tiles[i].transaction_id);
+      headers[i].set_filetype(this->default_file_type());
+
+      records[i].set_blob_id(m_write_blob_id);
+      records[i].set_blob_offset(m_write_blob->append(headers[i], tiles[i].data, tiles[i].data_size));
+      records[i].set_filetype(headers[i].filetype());
+    }
+
+    // The tiles must be committed to the blob before the index can
+    // point at them.
+    if (durability != WRITE_DURABILITY_NONE)
+      m_write_blob->commit(durability == WRITE_DURABILITY_SYNC);
+
+    m_index->write_update(headers, records);
+  } catch (...) {
+    // Give back a blob lock that we took, or every later write to
+    // this plate would wait for it.  None of this batch made it into
+    // the index, so whatever was appended is simply unreferenced.
+    if (locked_here) {
+      try {
+        this->write_complete();
+      } catch (std::exception const& e) {
+        vw_out(ErrorMessage, "platefile") << "PlateFile: could not release blob "
+                                          << m_write_blob_id << ": " << e.what() << "\n";
+      }
+    }
+    throw;
+  }
+
+  if (locked_here)
+    this->write_complete();
+}
+
 /// Writing, pt. 3: Signal the completion of the write operation.
 void vw::platefile::PlateFile::write_complete() { 
   
@@ -166,6 +166,39 @@ namespace platefile {
   };
 
 
+  // -------------------------------------------------------------------------
+  //                            BATCHED WRITES
+  // -------------------------------------------------------------------------
+
+  /// One tile of raw (already encoded) data, for PlateFile::write_batch().
+  struct RawTile {
+    boost::shared_array<uint8> data;
+    uint64 data_size;
+    int col, row, level, transaction_id;
+
+    RawTile() : data_size(0), col(0), row(0), level(0), transaction_id(0) {}
+    RawTile(boost::shared_array<uint8> data, uint64 data_size,
+            int col, int row, int level, int transaction_id) :
+      data(data), data_size(data_size), col(col), row(row), level(level),
+      transaction_id(transaction_id) {}
+  };
+
+  /// How much work PlateFile::write_batch() does to make a batch
+  /// durable before it returns.
+  enum WriteDurability {
+    /// The blob's end of file pointer is only written when the blob
+    /// is closed.  A crash loses everything written since it was
+    /// opened.
+    WRITE_DURABILITY_NONE,
+    /// The end of file pointer is written and the blob flushed once
+    /// per batch (a group commit).  A crash of this process does not
+    /// lose committed batches.
+    WRITE_DURABILITY_BATCH,
+    /// As above, and the blob is also synced to disk, so committed
+    /// batches survive a crash of the machine.
+    WRITE_DURABILITY_SYNC
+  };
+
   // -------------------------------------------------------------------------
   //                            PLATE FILE
   // -------------------------------------------------------------------------
@@ -177,6 +210,12 @@ namespace platefile {
     boost::shared_ptr<Blob> m_write_blob;
     int m_write_blob_id;
 
+    // Serializes access to the index and the write blob, so that
+    // tiles can be read and written from several threads at once.
+    // Tiles are encoded and decoded outside of this lock, and tiles
+    // in any other blob are read outside of it too.
+    mutable Mutex m_io_mutex;
+
   public:
     PlateFile(std::string url);
 
@@ -230,21 +269,26 @@ namespace platefile {
     TileHeader read(ViewT &view, int col, int row, int level, 
                     int transaction_id, bool exact_transaction_match = false) const {
 
+      Mutex::Lock lock(m_io_mutex);
+
       // 1. Call index read_request(col,row,level).  Returns IndexRecord.
       IndexRecord record = m_index->read_request(col, row, level, 
                                                  transaction_id, exact_transaction_match);
 
       // 2. Open the blob file and read the header.  If we are reading
       // from the same blob as we already have open for writing, we go
-      // ahead and use that already-open file pointer.  Otherwise, we
-      // open the new blob for reading.
+      // ahead and use that already-open file pointer, under the lock.
+      // Otherwise, we open the new blob for reading; nobody else sees
+      // it, so the lock is released first.
       boost::shared_ptr<Blob> read_blob;
-      if (m_write_blob && record.blob_id() == m_write_blob_id) {
+      bool locked = m_write_blob && record.blob_id() == m_write_blob_id;
+      if (locked) {
         read_blob = m_write_blob;
       } else {
         std::ostringstream blob_filename;
         blob_filename << this->name() << "/plate_" << record.blob_id() << ".blob";
-        read_blob.reset(new Blob(blob_filename.str(), true));
+        lock.unlock();
+        read_blob.reset(new Blob(blob_filename.str(), true, true));
       }
 
       // 3. Choose a temporary filename and call BlobIO
@@ -253,12 +297,15 @@ namespace platefile {
       std::string tempfile = TemporaryTileFile::unique_tempfile_name(record.filetype());
       read_blob->read_to_file(tempfile, record.blob_offset());
       TemporaryTileFile tile(tempfile);
+      TileHeader header = read_blob->read_header<TileHeader>(record.blob_offset());
+      if (locked)
+        lock.unlock();
       
       // 4. Read data from temporary file.
       view = tile.read<typename ViewT::pixel_type>();
       
       // 5. Return the tile header.
-      return read_blob->read_header<TileHeader>(record.blob_offset());
+      return header;
     }
     
     /// Writing, pt. 1: Locks a blob and returns the blob id that can
@@ -301,6 +348,8 @@ namespace platefile {
       TemporaryTileFile tile(view, write_header.filetype());
       std::string tile_filename = tile.file_name();
 
+      Mutex::Lock lock(m_io_mutex);
+
       // 3. Create a blob and call write_from_file(filename).  Returns
       // offset, size.  
       int64 blob_offset;
@@ -340,6 +389,8 @@ namespace platefile {
       write_header.set_transaction_id(transaction_id);
       write_header.set_filetype(this->default_file_type());
 
+      Mutex::Lock lock(m_io_mutex);
+
       // 1. Write the data into the blob
       int64 blob_offset = m_write_blob->write(write_header, data, data_size);
 
@@ -352,6 +403,16 @@ namespace platefile {
       m_index->write_update(write_header, write_record);
     }
 
+    /// Writing, pt. 2, batched: Write many raw tiles (see
+    /// write_update() above) in one go.  The tiles are appended to
+    /// the blob back to back, the blob's end of file pointer is
+    /// committed once for the whole batch according to durability,
+    /// and then the index is updated with a single batched
+    /// write_update().  If no blob is open for writing, this takes a
+    /// blob lock for the duration of the batch.
+    void write_batch(std::vector<RawTile> const& tiles,
+                     WriteDurability durability = WRITE_DURABILITY_BATCH);
+
     /// Writing, pt. 3: Signal the completion of the write operation.
     void write_complete();
 
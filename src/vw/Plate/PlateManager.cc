@@ -7,112 +7,269 @@
 
 #include <vw/Plate/PlateManager.h>
 #include <vw/Image/Transform.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace {
+
+  // A tile to be generated (or, at the starting level, one that was
+  // written by the transaction being mipmapped).  Parents are the
+  // tiles one level up that read this one.
+  struct MipmapNode {
+    int col, row, level;
+    vw::uint64 order;
+    int pending_children;
+    bool children_wrote;
+    std::vector<MipmapNode*> parents;
+  };
+
+  // Interleaves the bits of col and row.  Running ready tiles in this
+  // order finishes each quadtree subtree before moving on, which lets
+  // parents become ready sooner and keeps tile reads localized.
+  vw::uint64 morton_order(int col, int row) {
+    vw::uint64 result = 0;
+    for (int b = 0; b < 32; ++b) {
+      result |= vw::uint64((col >> b) & 1) << (2*b);
+      result |= vw::uint64((row >> b) & 1) << (2*b+1);
+    }
+    return result;
+  }
+
+  vw::uint64 tile_key(int col, int row) {
+    return (vw::uint64(vw::uint32(row)) << 32) | vw::uint32(col);
+  }
+
+  // Ready tiles nearest the root go first, so that a parent is built
+  // as soon as it can be rather than after the rest of its level.
+  struct MipmapNodeOrder {
+    bool operator()(MipmapNode const* a, MipmapNode const* b) const {
+      if (a->level != b->level)
+        return a->level < b->level;
+      return a->order < b->order;
+    }
+  };
+
+  class MipmapScheduler;
+
+  class MipmapTileTask : public vw::Task {
+    vw::platefile::PlateManager const& m_manager;
+    MipmapScheduler &m_scheduler;
+    MipmapNode *m_node;
+    int m_transaction_id;
+    bool m_preblur;
+  public:
+    MipmapTileTask(vw::platefile::PlateManager const& manager, MipmapScheduler &scheduler,
+                   MipmapNode *node, int transaction_id, bool preblur) :
+      m_manager(manager), m_scheduler(scheduler), m_node(node),
+      m_transaction_id(transaction_id), m_preblur(preblur) {}
+    virtual ~MipmapTileTask() {}
+    virtual void operator()();
+  };
+
+  // Tracks which tiles are ready to be generated, and runs at most
+  // max_in_flight of them at a time so that the tiles being composited
+  // do not pile up in memory.
+  class MipmapScheduler {
+    typedef std::set<MipmapNode*, MipmapNodeOrder> ready_set_t;
+
+    vw::Mutex m_mutex;
+    vw::Condition m_event;
+    ready_set_t m_ready;
+    size_t m_num_finished;
+    int m_num_in_flight;
+    boost::exception_ptr m_error;
+
+    // Marks node done, and passes that on to its parents.  A parent
+    // whose children all came out empty is skipped (and passes that
+    // on in turn) rather than being generated.  Must hold m_mutex.
+    void finish(MipmapNode *node, bool wrote) {
+      std::vector<std::pair<MipmapNode*, bool> > stack(1, std::make_pair(node, wrote));
+      while (!stack.empty()) {
+        MipmapNode *n = stack.back().first;
+        bool w = stack.back().second;
+        stack.pop_back();
+        ++m_num_finished;
+        for (size_t i = 0; i < n->parents.size(); ++i) {
+          MipmapNode *parent = n->parents[i];
+          if (w)
+            parent->children_wrote = true;
+          if (--parent->pending_children == 0) {
+            if (parent->children_wrote)
+              m_ready.insert(parent);
+            else
+              stack.push_back(std::make_pair(parent, false));
+          }
+        }
+      }
+    }
+
+  public:
+    MipmapScheduler() : m_num_finished(0), m_num_in_flight(0) {}
+
+    void run(vw::platefile::PlateManager const& manager,
+             std::list<MipmapNode> &nodes, std::vector<MipmapNode*> const& written,
+             int transaction_id, bool preblur, int max_in_flight,
+             vw::ProgressCallback const& progress_callback) {
+      vw::TaskGroup group;
+      {
+        vw::Mutex::Lock lock(m_mutex);
+        for (size_t i = 0; i < written.size(); ++i)
+          this->finish(written[i], true);
+
+        size_t num_to_generate = nodes.size() - written.size();
+        while (m_num_finished < nodes.size() && !m_error) {
+          while (!m_ready.empty() && m_num_in_flight < max_in_flight) {
+            MipmapNode *node = *m_ready.begin();
+            m_ready.erase(m_ready.begin());
+            ++m_num_in_flight;
+            group.add_task( boost::shared_ptr<vw::Task>(
+              new MipmapTileTask(manager, *this, node, transaction_id, preblur) ) );
+          }
+          if (num_to_generate > 0)
+            progress_callback.report_progress( double(m_num_finished - written.size()) /
+                                               double(num_to_generate) );
+          m_event.wait(lock);
+        }
+      }
+
+      // Let any tiles still being generated finish before we return,
+      // since they refer to the nodes.
+      group.join();
+      if (m_error)
+        boost::rethrow_exception(m_error);
+    }
+
+    void tile_complete(MipmapNode *node, bool wrote) {
+      vw::Mutex::Lock lock(m_mutex);
+      --m_num_in_flight;
+      this->finish(node, wrote);
+      m_event.notify_all();
+    }
+
+    void tile_failed(MipmapNode *node, boost::exception_ptr const& error) {
+      vw::Mutex::Lock lock(m_mutex);
+      --m_num_in_flight;
+      if (!m_error)
+        m_error = error;
+      m_event.notify_all();
+    }
+  };
+
+  void MipmapTileTask::operator()() {
+    bool wrote;
+    try {
+      wrote = m_manager.generate_mipmap_tile(m_node->col, m_node->row, m_node->level,
+                                             m_transaction_id, m_preblur);
+    } catch (...) {
+      // Whatever went wrong, the scheduler must hear about it, or
+      // run() would wait for this tile forever.
+      m_scheduler.tile_failed(m_node, boost::current_exception());
+      return;
+    }
+    m_scheduler.tile_complete(m_node, wrote);
+  }
+
+} // namespace
 
 // mipmap() generates mipmapped (i.e. low resolution) tiles in the mosaic.
-void vw::platefile::PlateManager::mipmap(int starting_level, vw::BBox2i const& bbox, 
-                                         int transaction_id, bool preblur, 
+void vw::platefile::PlateManager::mipmap(int starting_level, vw::BBox2i const& bbox,
+                                         int transaction_id, bool preblur,
                                          const ProgressCallback &progress_callback,
                                          int stopping_level) const {
 
+  typedef std::map<uint64, MipmapNode*> level_map_t;
+  std::list<MipmapNode> nodes;
+  std::vector<MipmapNode*> written;
 
-  // Adjust the size of the bbox for the first mipmapping level, which
-  // is one level up from the starting_level.  We also pad it
-  // slightly here, since we want to make sure we don't trucate at
-  // tiles when we divide by 2.
-  BBox2i level_bbox = bbox;
-  level_bbox.min().x() = floor( float(level_bbox.min().x()) / 2.0 );
-  level_bbox.min().y() = floor( float(level_bbox.min().y()) / 2.0 );
-  level_bbox.max().x() = ceil( float(level_bbox.max().x()+1) / 2.0 );
-  level_bbox.max().y() = ceil( float(level_bbox.max().y()+1) / 2.0 );
-    
-  // Compute the range of progress for this SubProgressCallback.  The
-  // geometric sum below probably could be computed more easily, but
-  // I'm tired and a little lazy at the moment.
-  float total_num_tiles = 0.0;
-  float sum_denom = 4.0;
-  for ( int level = starting_level-1; level >= 0; --level) {
-    total_num_tiles += (bbox.width() * bbox.height()) / sum_denom;
-    sum_denom *= 4.0;
+  // The bbox passed into the mipmap function only serves as a hint to
+  // where we might find tiles.  Some tiles will be missing due to
+  // transparency, and it's also possible that a very large number of
+  // tiles might be missing if the bounding box happens to cross one
+  // edge of the mosaic.  We ask the index which tiles this
+  // transaction actually wrote, a workunit at a time, and only
+  // mipmap those.
+  level_map_t children;
+  BBox2i search_bbox = bbox;
+  search_bbox.max() += Vector2i(1,1);
+  search_bbox.crop(BBox2i(0, 0, 1 << starting_level, 1 << starting_level));
+  std::list<BBox2i> workunits = bbox_tiles(search_bbox, 32, 32);
+  for (std::list<BBox2i>::iterator iter = workunits.begin(); iter != workunits.end(); ++iter) {
+    std::list<TileHeader> valid_tile_records =
+      m_platefile->search_by_region(starting_level, *iter, transaction_id, transaction_id, 1);
+    for (std::list<TileHeader>::iterator tile = valid_tile_records.begin();
+         tile != valid_tile_records.end(); ++tile) {
+      MipmapNode node = { int(tile->col()), int(tile->row()), starting_level,
+                          morton_order(tile->col(), tile->row()), 0, true };
+      nodes.push_back(node);
+      written.push_back(&nodes.back());
+      children[tile_key(node.col, node.row)] = &nodes.back();
+    }
   }
-  
-  float current_num_tiles = 0;
-  sum_denom = 4.0;
-  float prev_num_tiles = 0;
+
+  // Working up the pyramid, a tile needs to be generated if any of
+  // the tiles it reads from at the level below does.  Those must be
+  // within a tile of the level below's footprint.
+  std::vector<Vector2i> child_tiles;
   for ( int level = starting_level-1;
-        level >= (stopping_level >= 0 ? stopping_level : 0); --level) {
-
-    // Do a little progress callback math.
-    current_num_tiles += (bbox.width() * bbox.height()) / sum_denom;
-    sum_denom *= 4.0;
-    SubProgressCallback sub_progress(progress_callback, 
-                                     prev_num_tiles / total_num_tiles,
-                                     current_num_tiles / total_num_tiles);
-    prev_num_tiles = current_num_tiles;
-
-    // Subdivide the bbox into smaller workunits if necessary.
-    // This helps to keep operations efficient.
-    std::list<BBox2i> tile_workunits = bbox_tiles(level_bbox, 16, 16);
-    int prog_counter = 0;
-    for ( std::list<BBox2i>::iterator iter = tile_workunits.begin(); iter != tile_workunits.end(); ++iter) {
-      SubProgressCallback sub_sub_progress(sub_progress, 
-                                           float(prog_counter)/float(tile_workunits.size()),
-                                           float(prog_counter+1)/float(tile_workunits.size()));
-      prog_counter++;
-
-      // The original bbox passed into the mipmap function only serves
-      // as a hint to where we might find tiles.  Some tiles will be
-      // missing due to transparency, and it's also possible that a
-      // very large number of tiles might be missing if the bounding
-      // box happens to cross one edge of the mosaic.  In both cases,
-      // the call to valid_tiles() here fetches the tiles that
-      // actually contain good data.
-      BBox2i parent_region = *iter;
-      parent_region.min() *= 2;
-      parent_region.max() *= 2;
-      std::list<TileHeader> valid_tile_records =
-        m_platefile->search_by_region(level+1, parent_region,
-                                      transaction_id, transaction_id, 1);
-
-      // Debugging:
-      // std::cout << "Queried for valid_tiles in " << parent_region << " @ " << (level+1) 
-      //           << "   found " << valid_tile_records.size() << "\n";
-
-      if (!valid_tile_records.empty()) {
-
-        // Once we compute the valid tiles at the parent level, we
-        // translate that back down into valid tiles at this level.
-        BBox2i trimmed_region;
-        for (std::list<TileHeader>::iterator trim_iter = valid_tile_records.begin(); 
-             trim_iter != valid_tile_records.end(); ++trim_iter) {
-          trimmed_region.grow(Vector2i(trim_iter->col()/2, trim_iter->row()/2));
-        }
+        level >= (stopping_level >= 0 ? stopping_level : 0) && !children.empty(); --level) {
+    BBox2i candidates;
+    for (level_map_t::iterator iter = children.begin(); iter != children.end(); ++iter)
+      candidates.grow(Vector2i(iter->second->col/2, iter->second->row/2));
+    candidates.min() -= Vector2i(1,1);
+    candidates.max() += Vector2i(2,2);
+    candidates.crop(BBox2i(0, 0, 1 << level, 1 << level));
+
+    level_map_t parents;
+    for (int j = candidates.min().y(); j < candidates.max().y(); ++j) {
+      for (int i = candidates.min().x(); i < candidates.max().x(); ++i) {
+        child_tiles.clear();
+        this->mipmap_children(i, j, level, child_tiles);
+
+        std::vector<uint64> keys;
+        for (size_t c = 0; c < child_tiles.size(); ++c)
+          keys.push_back(tile_key(child_tiles[c].x(), child_tiles[c].y()));
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
 
-        // Pad the bottom right edge of the bbox to make sure we get
-        // tiles from the parent that only hald overlapped with the
-        // child.
-        trimmed_region.max().x() += 1;
-        trimmed_region.max().y() += 1;
-        
-        // Debugging:
-        //        vw_out() << "Generating mipmap tiles for " << trimmed_region << " @ " << level << "\n";
-
-        float inc_amt = 1.0/(trimmed_region.width() * trimmed_region.height());
-        for (int j = trimmed_region.min().y(); j < trimmed_region.max().y(); ++j) {
-          for (int i = trimmed_region.min().x(); i < trimmed_region.max().x(); ++i) {
-            this->generate_mipmap_tile(i,j,level,transaction_id, preblur);
-            sub_sub_progress.report_incremental_progress(inc_amt);
+        MipmapNode *parent = 0;
+        for (size_t c = 0; c < keys.size(); ++c) {
+          level_map_t::iterator child = children.find(keys[c]);
+          if (child == children.end())
+            continue;
+          if (!parent) {
+            MipmapNode node = { i, j, level, morton_order(i, j), 0, false };
+            nodes.push_back(node);
+            parent = &nodes.back();
+            parents[tile_key(i, j)] = parent;
           }
+          child->second->parents.push_back(parent);
+          ++parent->pending_children;
         }
       }
-      sub_sub_progress.report_finished();
     }
-    sub_progress.report_finished();
-    
-    // Adjust the size of the bbox for this level
-    level_bbox.min().x() = floor( float(level_bbox.min().x()) / 2 );
-    level_bbox.min().y() = floor( float(level_bbox.min().y()) / 2 );
-    level_bbox.max().x() = ceil( float(level_bbox.max().x()) / 2 );
-    level_bbox.max().y() = ceil( float(level_bbox.max().y()) / 2 );
+    children.swap(parents);
   }
+
+  vw_out(DebugMessage, "platefile") << "Mipmapping " << (nodes.size() - written.size())
+                                    << " tiles from " << written.size() << " tiles at level "
+                                    << starting_level << "\n";
+
+  // Allow a couple of tiles per thread so that the workers are not
+  // left idle while the next ready tile is handed out.
+  int max_in_flight = 2 * vw_thread_pool().num_threads();
+
+  MipmapScheduler scheduler;
+  scheduler.run(*this, nodes, written, transaction_id, preblur,
+                max_in_flight, progress_callback);
   progress_callback.report_finished();
 }
+
+void vw::platefile::PlateManager::mipmap_children(int col, int row, int /*level*/,
+                                                  std::vector<Vector2i> &children) const {
+  for (int j = 0; j < 2; ++j)
+    for (int i = 0; i < 2; ++i)
+      children.push_back(Vector2i(2*col+i, 2*row+j));
+}
@@ -13,6 +13,7 @@
 #include <vw/Plate/ProtoBuffers.pb.h>
 
 #include <list>
+#include <vector>
 
 namespace vw {
 namespace platefile {
@@ -49,6 +50,13 @@ namespace platefile {
     //           to be mipmapped at starting_level.  Use to specify affected tiles.
     //   transaction_id -- transaction id to use when reading/writing tiles
     //
+    // Rather than finishing one level before starting the next, each
+    // mipmap tile is generated on vw_thread_pool() as soon as all of
+    // the tiles it reads from (see mipmap_children()) are done, so
+    // several levels are usually in flight at once.  Only tiles whose
+    // children were written in this transaction are generated, and a
+    // tile whose children all came out empty is skipped along with
+    // everything above it that depends on nothing else.
     void mipmap(int starting_level, BBox2i const& bbox, int transaction_id, bool preblur,
                 const ProgressCallback &progress_callback = ProgressCallback::dummy_instance(),
                 int stopping_level = -1) const;
@@ -60,7 +68,20 @@ namespace platefile {
     /// Set preblur to false if you want straight decimation during
     /// mipmapping. Otherwise you will get a nice, low-pass filtered
     /// version in the mipmap.
-    virtual void generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const = 0;
+    ///
+    /// Returns true if a tile was written, or false if the result was
+    /// empty (i.e. fully transparent) and nothing was written.
+    ///
+    /// mipmap() calls this from several threads at once.
+    virtual bool generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const = 0;
+
+    /// Appends to children the tiles at level+1 that
+    /// generate_mipmap_tile() reads when it builds the tile at col,
+    /// row, and level.  The default is the four tiles directly below
+    /// it; subclasses that read a wider neighborhood must override
+    /// this so that mipmap() orders tile generation correctly.
+    virtual void mipmap_children(int col, int row, int level,
+                                 std::vector<Vector2i> &children) const;
 
   };    
 
@@ -10,8 +10,14 @@
 
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/ImageViewRef.h>
+#include <vw/Image/Transform.h>
+#include <vw/Image/Interpolation.h>
 #include <vw/Plate/PlateFile.h>
 #include <vw/Core/Cache.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <list>
+#include <map>
 
 #include <boost/foreach.hpp>
 
@@ -19,11 +25,98 @@ namespace vw {
 namespace platefile {
 
   /// An image view for accessing tiles from a plate file.  Tiles are
-  /// cached by this view to increase read speeds.
+  /// read and decoded in parallel on the thread pool, and the decoded
+  /// tiles are kept in the system cache, so that neighboring or
+  /// repeated requests do not read them again.
   template <class PixelT>
   class PlateView : public ImageViewBase<PlateView<PixelT> > {
+
+    // Reads and decodes a single tile for the cache.
+    class TileGenerator {
+      boost::shared_ptr<PlateFile> m_platefile;
+      int m_col, m_row, m_level, m_transaction_id;
+    public:
+      typedef ImageView<PixelT> value_type;
+
+      TileGenerator( boost::shared_ptr<PlateFile> const& platefile,
+                     int col, int row, int level, int transaction_id )
+        : m_platefile( platefile ), m_col( col ), m_row( row ),
+          m_level( level ), m_transaction_id( transaction_id ) {}
+
+      size_t size() const {
+        return m_platefile->default_tile_size() * m_platefile->default_tile_size() * sizeof(PixelT);
+      }
+
+      boost::shared_ptr<ImageView<PixelT> > generate() const {
+        boost::shared_ptr<ImageView<PixelT> > tile( new ImageView<PixelT> );
+        m_platefile->read( *tile, m_col, m_row, m_level, m_transaction_id, true );
+        return tile;
+      }
+    };
+
+    struct TileKey {
+      int col, row, level, transaction_id;
+      TileKey( TileHeader const& header )
+        : col( header.col() ), row( header.row() ), level( header.level() ),
+          transaction_id( header.transaction_id() ) {}
+      bool operator<( TileKey const& other ) const {
+        if ( level != other.level ) return level < other.level;
+        if ( row != other.row ) return row < other.row;
+        if ( col != other.col ) return col < other.col;
+        return transaction_id < other.transaction_id;
+      }
+    };
+
+    // The cache handles of the tiles read most recently, newest first.
+    // It holds no more handles than the system cache has room for
+    // tiles, since the cache will have let go of the older ones'
+    // pixels anyway.  It is shared between copies of the view.
+    struct TileTable {
+      typedef std::list<std::pair<TileKey, Cache::Handle<TileGenerator> > > list_type;
+      Mutex mutex;
+      list_type handles;
+      std::map<TileKey, typename list_type::iterator> index;
+    };
+
+    // Copies one tile into place in the level image.
+    class FetchTileTask : public Task {
+      Cache::Handle<TileGenerator> m_handle;
+      CropView<ImageView<PixelT> > m_dest;
+    public:
+      FetchTileTask( Cache::Handle<TileGenerator> const& handle, CropView<ImageView<PixelT> > const& dest )
+        : m_handle( handle ), m_dest( dest ) {}
+
+      virtual void operator()() {
+        boost::shared_ptr<ImageView<PixelT> > tile = m_handle;
+        m_dest = *tile;
+      }
+    };
+
     boost::shared_ptr<PlateFile> m_platefile;
     int m_current_level;
+    boost::shared_ptr<TileTable> m_tile_table;
+
+    Cache::Handle<TileGenerator> tile_handle( TileHeader const& header ) const {
+      TileKey key( header );
+      TileTable &table = *m_tile_table;
+      Mutex::Lock lock( table.mutex );
+      typename std::map<TileKey, typename TileTable::list_type::iterator>::iterator it = table.index.find( key );
+      if ( it != table.index.end() ) {
+        table.handles.splice( table.handles.begin(), table.handles, it->second );
+        return it->second->second;
+      }
+      TileGenerator generator( m_platefile, key.col, key.row, key.level, key.transaction_id );
+      Cache::Handle<TileGenerator> handle = vw_system_cache().insert( generator );
+      table.handles.push_front( std::make_pair( key, handle ) );
+      table.index[key] = table.handles.begin();
+
+      size_t max_handles = std::max( size_t(16), vw_system_cache().max_size() / std::max( size_t(1), generator.size() ) );
+      while ( table.handles.size() > max_handles ) {
+        table.index.erase( table.handles.back().first );
+        table.handles.pop_back();
+      }
+      return handle;
+    }
 
   public:
     typedef PixelT pixel_type;
@@ -32,12 +125,14 @@ namespace platefile {
 
     PlateView(std::string url)
       : m_platefile( new PlateFile(url) ),
-        m_current_level(m_platefile->num_levels()-1)
+        m_current_level(m_platefile->num_levels()-1),
+        m_tile_table( new TileTable )
     { }
 
     PlateView(boost::shared_ptr<PlateFile> plate)
       : m_platefile( plate ),
-        m_current_level(m_platefile->num_levels()-1)
+        m_current_level(m_platefile->num_levels()-1),
+        m_tile_table( new TileTable )
     { }
 
     // Standard ImageView interface methods
@@ -101,7 +196,7 @@ namespace platefile {
     }
 
     /// \cond INTERNAL
-    typedef CropView<TransformView<InterpolationView<EdgeExtensionView<CropView<ImageView<pixel_type> >, ConstantEdgeExtension>, BilinearInterpolation>, ResampleTransform> > prerasterize_type;
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
     inline prerasterize_type prerasterize(BBox2i bbox) const {
 
       // Compute the bounding box at the current level.
@@ -114,28 +209,40 @@ namespace platefile {
       // Create an image of the appropriate size to rasterize tiles into.
       ImageView<pixel_type> level_image(aligned_level_bbox.width(), aligned_level_bbox.height());
 
-      // Access the tiles needed for this level and copy them into place
-      BOOST_FOREACH( TileHeader const& theader, tileheaders ) {
-        ImageView<PixelT> tile;
-        m_platefile->read( tile, theader.col(), theader.row(), theader.level(),
-                           theader.transaction_id(), true );
-        BBox2i tile_bbox( m_platefile->default_tile_size()*theader.col()-aligned_level_bbox.min().x(),
-                          m_platefile->default_tile_size()*theader.row()-aligned_level_bbox.min().y(),
-                          m_platefile->default_tile_size(),
-                          m_platefile->default_tile_size() );
-        crop( level_image, tile_bbox ) = tile;
+      // Fetch the tiles needed for this level in parallel, each one
+      // from the cache if it has been read before, and copy them into
+      // place.
+      {
+        TaskGroup group;
+        BOOST_FOREACH( TileHeader const& theader, tileheaders ) {
+          BBox2i tile_bbox( m_platefile->default_tile_size()*theader.col()-aligned_level_bbox.min().x(),
+                            m_platefile->default_tile_size()*theader.row()-aligned_level_bbox.min().y(),
+                            m_platefile->default_tile_size(),
+                            m_platefile->default_tile_size() );
+          group.add_task( boost::shared_ptr<Task>( new FetchTileTask( tile_handle( theader ),
+                                                                      crop( level_image, tile_bbox ) ) ) );
+        }
+        group.join();
       }
 
-      // Crop the output to the original requested bbox, resample it, and return.
+      // Crop the output to the original requested bbox.
       BBox2i output_bbox( level_bbox.min().x() - aligned_level_bbox.min().x(),
                           level_bbox.min().y() - aligned_level_bbox.min().y(),
                           level_bbox.width(), level_bbox.height() );
 
-      return crop(transform( crop(level_image, output_bbox),
-                             ResampleTransform( pow(2, level_difference),
-                                                pow(2, level_difference) ),
-                             ConstantEdgeExtension(), BilinearInterpolation() ),
-                  BBox2i(-bbox.min().x(), -bbox.min().y(), this->cols(), this->rows()));
+      // At the native resolution the level image is already the answer.
+      if ( level_difference == 0 )
+        return crop( level_image, BBox2i( output_bbox.min().x() - bbox.min().x(),
+                                          output_bbox.min().y() - bbox.min().y(),
+                                          this->cols(), this->rows() ) );
+
+      // Otherwise resample it up to full resolution.
+      double scale = pow(2, level_difference);
+      ImageView<pixel_type> output = crop( transform( crop(level_image, output_bbox),
+                                                      ResampleTransform( scale, scale ),
+                                                      ConstantEdgeExtension(), BilinearInterpolation() ),
+                                           BBox2i(0, 0, bbox.width(), bbox.height()) );
+      return crop( output, BBox2i(-bbox.min().x(), -bbox.min().y(), this->cols(), this->rows()) );
     }
 
     template <class DestT> inline void rasterize(DestT const& dest, BBox2i bbox) const {
@@ -6,6 +6,7 @@
 
 
 #include <vw/Core/Exception.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Plate/RemoteIndex.h>
 #include <vw/Plate/common.h>
 #include <vw/Plate/ProtoBuffers.pb.h>
@@ -73,18 +74,163 @@ void parse_url(std::string const& url, std::string &hostname, int &port,
   exchange = std::string(PLATE_EXCHANGE_NAMESPACE) + "." + bare_exchange;
 }
 
+// ----------------------------------------------------------------------
+//                         REMOTE WRITE QUEUE
+// ----------------------------------------------------------------------
+
+class vw::platefile::RemoteWriteQueue::FlushTask : public Task {
+  RemoteWriteQueue &m_queue;
+public:
+  FlushTask(RemoteWriteQueue& queue) : m_queue(queue) {}
+  virtual ~FlushTask() {}
+  virtual void operator()() { m_queue.send_batches(false); }
+};
+
+vw::platefile::RemoteWriteQueue::RemoteWriteQueue(boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
+                                                  boost::shared_ptr<IndexService> index_service,
+                                                  bool async, int batch_size) :
+  m_rpc_controller(rpc_controller), m_index_service(index_service), m_async(async),
+  m_batch_size(batch_size), m_max_queued(100 * batch_size), m_in_flight(false) {
+  VW_ASSERT(batch_size > 0, ArgumentErr() << "RemoteWriteQueue: batch_size must be positive.");
+}
+
+vw::platefile::RemoteWriteQueue::~RemoteWriteQueue() {
+  // A FlushTask may still be running, and it refers to us.
+  Mutex::Lock lock(m_mutex);
+  while (m_in_flight)
+    m_event.wait(lock);
+}
+
+// Sends one batch.  Must be called without m_mutex held.
+void vw::platefile::RemoteWriteQueue::send(IndexMultiWriteUpdate& request) {
+  // For debugging:
+  //    std::cout << "Sending a MultiWriteUpdate with " 
+  //              << request.write_updates_size() << " entries.\n";
+  RpcNullMessage response;
+  m_index_service->MultiWriteUpdate(m_rpc_controller.get(), &request, &response, 
+                                    google::protobuf::NewCallback(&null_closure));
+}
+
+// Sends everything in the queue, including anything that is queued
+// while we are sending.  The caller must have set m_in_flight.  When
+// called from a FlushTask there is nobody to throw to, so errors are
+// saved for the next sync() instead.
+void vw::platefile::RemoteWriteQueue::send_batches(bool rethrow) {
+  Mutex::Lock lock(m_mutex);
+  while (m_queue.write_updates_size() > 0) {
+    IndexMultiWriteUpdate request;
+    request.Swap(&m_queue);
+    m_event.notify_all();
+    lock.unlock();
+
+    try {
+      this->send(request);
+      lock.lock();
+    } catch (vw::Exception &e) {
+      lock.lock();
+      if (rethrow) {
+        m_in_flight = false;
+        m_event.notify_all();
+        throw;
+      }
+      if (m_error.empty())
+        m_error = e.what();
+    }
+  }
+  m_in_flight = false;
+  m_event.notify_all();
+}
+
+void vw::platefile::RemoteWriteQueue::push(IndexWriteUpdate const& update) {
+  Mutex::Lock lock(m_mutex);
+
+  // Don't let the queue grow without bound if the server can't keep up.
+  while (m_in_flight && m_queue.write_updates_size() >= m_max_queued)
+    m_event.wait(lock);
+
+  *(m_queue.mutable_write_updates()->Add()) = update;
+  if (m_in_flight || m_queue.write_updates_size() < m_batch_size)
+    return;
+
+  m_in_flight = true;
+  if (m_async) {
+    // Sending blocks on the index server, so we make sure it gets a
+    // thread of its own rather than tying up a compute thread.
+    vw_thread_pool().add_blocking_task( boost::shared_ptr<Task>( new FlushTask(*this) ) );
+  } else {
+    lock.unlock();
+    this->send_batches(true);
+  }
+}
+
+void vw::platefile::RemoteWriteQueue::sync() {
+  Mutex::Lock lock(m_mutex);
+  while (m_in_flight)
+    m_event.wait(lock);
+
+  if (m_queue.write_updates_size() > 0) {
+    m_in_flight = true;
+    lock.unlock();
+    this->send_batches(true);
+    lock.lock();
+  }
+
+  if (!m_error.empty()) {
+    std::string error = m_error;
+    m_error.clear();
+    vw_throw(RpcErr() << "RemoteWriteQueue: an index write update failed: " << error);
+  }
+}
+
+void vw::platefile::RemoteWriteQueue::flush(int level, BBox2i const& tiles) {
+  Mutex::Lock lock(m_mutex);
+  // The batch in flight may hold some of these updates.
+  while (m_in_flight)
+    m_event.wait(lock);
+
+  IndexMultiWriteUpdate request, rest;
+  for (int i = 0; i < m_queue.write_updates_size(); ++i) {
+    IndexWriteUpdate *update = m_queue.mutable_write_updates(i);
+    TileHeader const& header = update->header();
+    if (header.level() == level && tiles.contains( Vector2i(header.col(), header.row()) ))
+      request.add_write_updates()->Swap(update);
+    else
+      rest.add_write_updates()->Swap(update);
+  }
+  m_queue.Swap(&rest);
+  if (request.write_updates_size() == 0)
+    return;
+
+  m_in_flight = true;
+  m_event.notify_all();
+  lock.unlock();
+
+  try {
+    this->send(request);
+  } catch (...) {
+    lock.lock();
+    m_in_flight = false;
+    m_event.notify_all();
+    throw;
+  }
+  lock.lock();
+  m_in_flight = false;
+  m_event.notify_all();
+}
+
 // ----------------------------------------------------------------------
 //                         REMOTE INDEX PAGE
 // ----------------------------------------------------------------------
 
 vw::platefile::RemoteIndexPage::RemoteIndexPage(int platefile_id, 
-                                                boost::shared_ptr<AmqpRpcClient> rpc_controller,
+                                                boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
                                                 boost::shared_ptr<IndexService> index_service,
+                                                boost::shared_ptr<RemoteWriteQueue> write_queue,
                                                 int level, int base_col, int base_row, 
                                                 int page_width, int page_height) :
   IndexPage(level, base_col, base_row, page_width, page_height),
   m_platefile_id(platefile_id), m_rpc_controller(rpc_controller),
-  m_index_service(index_service) {
+  m_index_service(index_service), m_write_queue(write_queue) {
 
   // Use the PageRequest RPC to fetch the remote page from the index
   // server.
@@ -106,12 +252,22 @@ vw::platefile::RemoteIndexPage::RemoteIndexPage(int platefile_id,
   }
 
   // Deserialize the data from the message to populate this index page.
-  std::istringstream istr(response.page_bytes(), std::ios::binary);
-  this->deserialize(istr);
+  if (response.page_bytes().size() > 0) {
+    std::istringstream istr(response.page_bytes(), std::ios::binary);
+    this->deserialize(istr);
+  }
 }
 
 vw::platefile::RemoteIndexPage::~RemoteIndexPage() {
-  this->sync();
+  // Our updates must reach the server before this page can be
+  // evicted, or a fresh copy fetched from the server would miss them.
+  try {
+    m_write_queue->flush( m_level, BBox2i(m_base_col, m_base_row, m_page_width, m_page_height) );
+  } catch (std::exception const& e) {
+    vw_out(ErrorMessage, "plate") << "RemoteIndexPage: failed to send the updates for page ["
+                                  << m_base_col << " " << m_base_row << " @ " << m_level << "]: "
+                                  << e.what() << "\n";
+  }
 }
 
 // Hijack this method momentartarily to mark the page as "dirty" by
@@ -120,40 +276,17 @@ void vw::platefile::RemoteIndexPage::set(TileHeader const& header, IndexRecord c
   // First call up to the parent class and let the original code run.
   IndexPage::set(header, record);
 
-  // Save this write request to the queue, and flush the queue if it
-  // has gotten too full.  (We send an update to the index_server
-  // every 50 writes!)
+  // Save this write request to the queue, which sends an update to
+  // the index_server every 50 writes (or more, if it is asynchronous).
   IndexWriteUpdate request;
   request.set_platefile_id(m_platefile_id);
   *(request.mutable_header()) = header;
   *(request.mutable_record()) = record;
-  m_write_queue.push(request);
-  static const unsigned write_queue_size = 50; // arbitrary, but probably good.
-  if (m_write_queue.size() >= write_queue_size)
-    this->flush_write_queue();
-}
-
-void vw::platefile::RemoteIndexPage::flush_write_queue() {
-  if (m_write_queue.size() > 0) {
-
-    // For debugging:
-    //    std::cout << "Call to the new flush_write_queue() with " 
-    //              << m_write_queue.size() << " entries.\n";
-
-    IndexMultiWriteUpdate request;
-    while (m_write_queue.size() > 0) {
-      *(request.mutable_write_updates()->Add()) = m_write_queue.front();
-      m_write_queue.pop();
-    }
-    RpcNullMessage response;
-    m_index_service->MultiWriteUpdate(m_rpc_controller.get(), &request, &response, 
-                                      google::protobuf::NewCallback(&null_closure));
-
-  }
+  m_write_queue->push(request);
 }
 
 void vw::platefile::RemoteIndexPage::sync() {
-  this->flush_write_queue();
+  m_write_queue->sync();
 }
 
 // ----------------------------------------------------------------------
@@ -161,19 +294,20 @@ void vw::platefile::RemoteIndexPage::sync() {
 // ----------------------------------------------------------------------
 
 vw::platefile::RemotePageGenerator::RemotePageGenerator( int platefile_id, 
-                                                         boost::shared_ptr<AmqpRpcClient> rpc_controller,
+                                                         boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
                                                          boost::shared_ptr<IndexService> index_service,
+                                                         boost::shared_ptr<RemoteWriteQueue> write_queue,
                                                          int level, int base_col, int base_row, 
                                                          int page_width, int page_height) : 
   m_platefile_id(platefile_id), m_rpc_controller(rpc_controller), 
-  m_index_service(index_service), m_level(level), 
+  m_index_service(index_service), m_write_queue(write_queue), m_level(level), 
   m_base_col(base_col), m_base_row(base_row),
   m_page_width(page_width), m_page_height(page_height) {}  
 
 boost::shared_ptr<vw::platefile::IndexPage> 
 vw::platefile::RemotePageGenerator::generate() const {
   return boost::shared_ptr<IndexPage>(new RemoteIndexPage(m_platefile_id, m_rpc_controller,
-                                                          m_index_service, 
+                                                          m_index_service, m_write_queue,
                                                           m_level, m_base_col, m_base_row,
                                                           m_page_width, m_page_height) );
 }
@@ -183,13 +317,13 @@ boost::shared_ptr<PageGeneratorBase> RemotePageGeneratorFactory::create(int leve
                                                                         int base_row,
                                                                         int page_width,
                                                                         int page_height) {
-  VW_ASSERT(m_platefile_id != -1 && m_rpc_controller && m_index_service,
+  VW_ASSERT(m_platefile_id != -1 && m_index_service && m_write_queue,
             LogicErr() << "Error: RemotePageGeneratorFactory has not yet been initialized.");
 
   // Create the proper type of page generator.
   boost::shared_ptr<PageGeneratorBase> page_gen(
     new RemotePageGenerator(m_platefile_id, m_rpc_controller,
-                            m_index_service,
+                            m_index_service, m_write_queue,
                             level, base_col, base_row,
                             page_width, page_height) );
 
@@ -207,44 +341,60 @@ std::string RemotePageGeneratorFactory::who() const {
 // ----------------------------------------------------------------------
 
 
-/// Constructor (for opening an existing Index)
-vw::platefile::RemoteIndex::RemoteIndex(std::string const& url) :
-  PagedIndex(boost::shared_ptr<PageGeneratorFactory>( new RemotePageGeneratorFactory() ))  {
+// Parse the URL and connect to the index server's exchange.
+void vw::platefile::RemoteIndex::connect(std::string const& url, std::string& platefile_name,
+                                         QueryMap& params) {
 
   // Parse the URL string into a separate 'exchange' and 'platefile_name' field.
   std::string hostname;
   int port;
   std::string exchange;
-  std::string platefile_name;
-  QueryMap params;
   parse_url(url, hostname, port, exchange, platefile_name, params);
 
   std::string queue_name = AmqpRpcClient::UniqueQueueName(std::string("remote_index_") + platefile_name);
 
   // Set up the connection to the AmqpRpcService
   boost::shared_ptr<AmqpConnection> conn(new AmqpConnection(hostname, port));
-  m_rpc_controller.reset( new AmqpRpcClient(conn, exchange, queue_name, "index") );
-  m_index_service.reset ( new IndexService::Stub(m_rpc_controller.get() ) );
-  m_rpc_controller->bind_service(m_index_service, queue_name);
-
-  // Send an IndexOpenRequest to the AMQP index server.
-  IndexOpenRequest request;
-  request.set_plate_name(platefile_name);
-
-  IndexOpenReply response;
-  m_index_service->OpenRequest(m_rpc_controller.get(), &request, &response,
-                               google::protobuf::NewCallback(&null_closure));
+  boost::shared_ptr<AmqpRpcClient> client( new AmqpRpcClient(conn, exchange, queue_name, "index") );
+  m_rpc_controller = client;
+  m_index_service.reset ( new IndexService::Stub(client.get() ) );
+  client->bind_service(m_index_service, queue_name);
+}
 
+// Finish setting up once the index server has opened (or created)
+// the platefile for us.
+void vw::platefile::RemoteIndex::opened(IndexOpenReply const& response, bool async) {
   m_index_header = response.index_header();
   m_platefile_id = m_index_header.platefile_id();
   m_short_plate_filename = response.short_plate_filename();
   m_full_plate_filename = response.full_plate_filename();
 
   // Properly initialize the PageGenFactory and set it.
+  m_write_queue.reset( new RemoteWriteQueue(m_rpc_controller, m_index_service, async) );
   boost::shared_ptr<PageGeneratorFactory> factory( new RemotePageGeneratorFactory(m_platefile_id,
                                                                                   m_rpc_controller, 
-                                                                                  m_index_service));
+                                                                                  m_index_service,
+                                                                                  m_write_queue));
   this->set_page_generator_factory(factory);
+}
+
+/// Constructor (for opening an existing Index)
+vw::platefile::RemoteIndex::RemoteIndex(std::string const& url) :
+  PagedIndex(boost::shared_ptr<PageGeneratorFactory>( new RemotePageGeneratorFactory() ))  {
+
+  std::string platefile_name;
+  QueryMap params;
+  this->connect(url, platefile_name, params);
+
+  // Send an IndexOpenRequest to the AMQP index server.
+  IndexOpenRequest request;
+  request.set_plate_name(platefile_name);
+
+  IndexOpenReply response;
+  m_index_service->OpenRequest(m_rpc_controller.get(), &request, &response,
+                               google::protobuf::NewCallback(&null_closure));
+
+  this->opened(response, params.get("async", false));
   this->set_default_cache_size(params.get("cache_size", 100u));
 
   // Every time you run num_levels, it synchronizes the number of
@@ -261,21 +411,9 @@ vw::platefile::RemoteIndex::RemoteIndex(std::string const& url, IndexHeader inde
   PagedIndex(boost::shared_ptr<PageGeneratorFactory>( new RemotePageGeneratorFactory() )),
   m_index_header(index_header_info) {
 
-  // Parse the URL string into a separate 'exchange' and 'platefile_name' field.
-  std::string hostname;
-  int port;
-  std::string exchange;
   std::string platefile_name;
   QueryMap params;
-  parse_url(url, hostname, port, exchange, platefile_name, params);
-
-  std::string queue_name = AmqpRpcClient::UniqueQueueName(std::string("remote_index_") + platefile_name);
-
-  // Set up the connection to the AmqpRpcService
-  boost::shared_ptr<AmqpConnection> conn(new AmqpConnection(hostname, port));
-  m_rpc_controller.reset( new AmqpRpcClient(conn, exchange, queue_name, "index") );
-  m_index_service.reset ( new IndexService::Stub(m_rpc_controller.get() ) );
-  m_rpc_controller->bind_service(m_index_service, queue_name);
+  this->connect(url, platefile_name, params);
 
   // Send an IndexCreateRequest to the AMQP index server.
   IndexCreateRequest request;
@@ -288,17 +426,7 @@ vw::platefile::RemoteIndex::RemoteIndex(std::string const& url, IndexHeader inde
   m_index_service->CreateRequest(m_rpc_controller.get(), &request, &response, 
                                  google::protobuf::NewCallback(&null_closure));
 
-  m_index_header = response.index_header();
-  m_platefile_id = m_index_header.platefile_id();
-  m_short_plate_filename = response.short_plate_filename();
-  m_full_plate_filename = response.full_plate_filename();
-
-  // Properly initialize the PageGenFactory and set it.
-  boost::shared_ptr<PageGeneratorFactory> factory( new RemotePageGeneratorFactory(m_platefile_id,
-                                                                                  m_rpc_controller, 
-                                                                                  m_index_service));
-  this->set_page_generator_factory(factory);
-  this->set_default_cache_size(params.get("cache_size", 100u));
+  this->opened(response, params.get("async", false));
 
   // Every time you run num_levels, it synchronizes the number of
   // local (cached) levels with the number of levels on the index
@@ -312,9 +440,50 @@ vw::platefile::RemoteIndex::RemoteIndex(std::string const& url, IndexHeader inde
 
 }
 
+/// Constructor (for opening an existing Index on a connected service)
+vw::platefile::RemoteIndex::RemoteIndex(boost::shared_ptr<IndexService> index_service,
+                                        std::string const& platefile_name, bool async) :
+  PagedIndex(boost::shared_ptr<PageGeneratorFactory>( new RemotePageGeneratorFactory() )),
+  m_index_service(index_service) {
+
+  IndexOpenRequest request;
+  request.set_plate_name(platefile_name);
+
+  IndexOpenReply response;
+  m_index_service->OpenRequest(m_rpc_controller.get(), &request, &response,
+                               google::protobuf::NewCallback(&null_closure));
+
+  this->opened(response, async);
+  this->num_levels();
+}
+
+/// Constructor (for creating a new Index on a connected service)
+vw::platefile::RemoteIndex::RemoteIndex(boost::shared_ptr<IndexService> index_service,
+                                        std::string const& platefile_name,
+                                        IndexHeader index_header_info, bool async) :
+  PagedIndex(boost::shared_ptr<PageGeneratorFactory>( new RemotePageGeneratorFactory() )),
+  m_index_header(index_header_info), m_index_service(index_service) {
+
+  IndexCreateRequest request;
+  request.set_plate_name(platefile_name);
+  index_header_info.set_platefile_id(0);
+  *(request.mutable_index_header()) = index_header_info;
+
+  IndexOpenReply response;
+  m_index_service->CreateRequest(m_rpc_controller.get(), &request, &response, 
+                                 google::protobuf::NewCallback(&null_closure));
+
+  this->opened(response, async);
+  this->num_levels();
+}
 
 /// Destructor
 vw::platefile::RemoteIndex::~RemoteIndex() {}
+
+void vw::platefile::RemoteIndex::sync() {
+  PagedIndex::sync();
+  m_write_queue->sync();
+}
   
 // Writing, pt. 1: Locks a blob and returns the blob id that can
 // be used to write a tile.
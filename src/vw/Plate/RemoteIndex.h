@@ -12,31 +12,84 @@
 #include <vw/Plate/IndexPage.h>
 #include <vw/Plate/AmqpConnection.h>
 #include <vw/Plate/RpcServices.h>
+#include <vw/Plate/HTTPUtils.h>
 
 namespace vw {
 namespace platefile {
 
   // ----------------------------------------------------------------------
-  //                         LOCAL INDEX PAGE
+  //                         REMOTE WRITE QUEUE
+  // ----------------------------------------------------------------------
+
+  /// Collects the index write updates made to every page of a
+  /// RemoteIndex and sends them to the index server in
+  /// MultiWriteUpdate batches.  At most one batch is in flight at a
+  /// time, so updates reach the server in the order they were made.
+  ///
+  /// In synchronous mode a full batch is sent by the thread that
+  /// filled it, as before.  In asynchronous mode it is sent from the
+  /// thread pool while writers carry on queueing updates, and those
+  /// all go out together in the next batch.  Errors from asynchronous
+  /// batches are reported by the next call to sync().
+  class RemoteWriteQueue {
+    boost::shared_ptr<google::protobuf::RpcController> m_rpc_controller;
+    boost::shared_ptr<IndexService> m_index_service;
+    bool m_async;
+    int m_batch_size, m_max_queued;
+
+    IndexMultiWriteUpdate m_queue;
+    bool m_in_flight;
+    std::string m_error;
+    Mutex m_mutex;
+    Condition m_event;
+
+    class FlushTask;
+    void send(IndexMultiWriteUpdate& request);
+    void send_batches(bool rethrow);
+
+  public:
+    RemoteWriteQueue(boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
+                     boost::shared_ptr<IndexService> index_service,
+                     bool async, int batch_size = 50);
+    ~RemoteWriteQueue();
+
+    /// Queue an update, sending a batch if enough have built up.  In
+    /// asynchronous mode this only blocks if the server is falling
+    /// far behind.
+    void push(IndexWriteUpdate const& update);
+
+    /// Wait until every queued update has reached the index server.
+    void sync();
+
+    /// Send the queued updates for the given tiles of one level right
+    /// away, leaving the rest queued.  Errors from earlier batches are
+    /// still left for sync().
+    void flush(int level, BBox2i const& tiles);
+  };
+
+  // ----------------------------------------------------------------------
+  //                         REMOTE INDEX PAGE
   // ----------------------------------------------------------------------
 
   class RemoteIndexPage : public IndexPage {
     int m_platefile_id;
-    boost::shared_ptr<AmqpRpcClient> m_rpc_controller;
+    boost::shared_ptr<google::protobuf::RpcController> m_rpc_controller;
     boost::shared_ptr<IndexService> m_index_service;
 
     // For packetizing write requests.
-    std::queue<IndexWriteUpdate> m_write_queue;
-    void flush_write_queue();
+    boost::shared_ptr<RemoteWriteQueue> m_write_queue;
 
   public:
     
     RemoteIndexPage(int platefile_id, 
-                    boost::shared_ptr<AmqpRpcClient> rpc_controller,
+                    boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
                     boost::shared_ptr<IndexService> index_service,
+                    boost::shared_ptr<RemoteWriteQueue> write_queue,
                     int level, int base_col, int base_row, 
                     int page_width, int page_height);
 
+    /// Sends this page's queued updates before it goes.  A failure is
+    /// logged, since pages are evicted from inside unrelated calls.
     virtual ~RemoteIndexPage();
 
     /// Set the value of an entry in the RemoteIndexPage.
@@ -52,15 +105,17 @@ namespace platefile {
 
   class RemotePageGenerator : public PageGeneratorBase {
     int m_platefile_id;
-    boost::shared_ptr<AmqpRpcClient> m_rpc_controller;
+    boost::shared_ptr<google::protobuf::RpcController> m_rpc_controller;
     boost::shared_ptr<IndexService> m_index_service;
+    boost::shared_ptr<RemoteWriteQueue> m_write_queue;
     int m_level, m_base_col, m_base_row;
     int m_page_width, m_page_height;
 
   public:
     RemotePageGenerator( int platefile_id, 
-                         boost::shared_ptr<AmqpRpcClient> rpc_controller,
+                         boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
                          boost::shared_ptr<IndexService> index_service,
+                         boost::shared_ptr<RemoteWriteQueue> write_queue,
                          int level, int base_col, int base_row, 
                          int page_width, int page_height );
     virtual ~RemotePageGenerator() {}
@@ -74,16 +129,18 @@ namespace platefile {
   /// produce pages from a file on disk.
   class RemotePageGeneratorFactory : public PageGeneratorFactory {
     int m_platefile_id;
-    boost::shared_ptr<AmqpRpcClient> m_rpc_controller;
+    boost::shared_ptr<google::protobuf::RpcController> m_rpc_controller;
     boost::shared_ptr<IndexService> m_index_service;
+    boost::shared_ptr<RemoteWriteQueue> m_write_queue;
 
   public:
     RemotePageGeneratorFactory() : m_platefile_id(-1) {}
     RemotePageGeneratorFactory(int platefile_id, 
-                               boost::shared_ptr<AmqpRpcClient> rpc_controller,
-                               boost::shared_ptr<IndexService> index_service) : 
+                               boost::shared_ptr<google::protobuf::RpcController> rpc_controller,
+                               boost::shared_ptr<IndexService> index_service,
+                               boost::shared_ptr<RemoteWriteQueue> write_queue) : 
       m_platefile_id(platefile_id), m_rpc_controller(rpc_controller),
-      m_index_service(index_service) {}
+      m_index_service(index_service), m_write_queue(write_queue) {}
     virtual ~RemotePageGeneratorFactory() {}
     virtual boost::shared_ptr<PageGeneratorBase> create(int level, int base_col, int base_row,
                                                         int page_width, int page_height);
@@ -102,16 +159,35 @@ namespace platefile {
     std::string m_full_plate_filename;
 
     // Remote connection
-    boost::shared_ptr<AmqpRpcClient> m_rpc_controller;
+    boost::shared_ptr<google::protobuf::RpcController> m_rpc_controller;
     boost::shared_ptr<IndexService> m_index_service;
+    boost::shared_ptr<RemoteWriteQueue> m_write_queue;
+
+    void connect(std::string const& url, std::string& platefile_name, QueryMap& params);
+    void opened(IndexOpenReply const& response, bool async);
   
   public:
     /// Constructor (for opening an existing index)
+    ///
+    /// Adding "?async=1" to the URL turns on asynchronous mode.  In
+    /// that mode index write updates are batched and sent in the
+    /// background, and many threads can use the index at once: their
+    /// page requests are pipelined on the one connection, and threads
+    /// that need the same page share a single request for it.
     RemoteIndex(std::string const& url);
 
     /// Constructor (for creating a new index)
     RemoteIndex(std::string const& url, IndexHeader new_index_info);
 
+    /// Constructors that talk to an index service which is already
+    /// connected, such as an IndexServiceImpl in this process behind
+    /// a LoopbackRpcChannel.  These are mostly useful for testing.
+    RemoteIndex(boost::shared_ptr<IndexService> index_service,
+                std::string const& platefile_name, bool async = false);
+    RemoteIndex(boost::shared_ptr<IndexService> index_service,
+                std::string const& platefile_name, IndexHeader new_index_info,
+                bool async = false);
+
     /// destructor
     virtual ~RemoteIndex();
 
@@ -122,6 +198,9 @@ namespace platefile {
     /// Writing, pt. 3: Signal the completion 
     virtual void write_complete(int blob_id, uint64 blob_offset);
 
+    /// Sync any unsaved data in the index to the index server.
+    virtual void sync();
+
     /// Log a message to the platefile log.
     virtual void log(std::string message);
 
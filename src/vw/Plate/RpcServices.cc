@@ -140,11 +140,17 @@ void vw::platefile::AmqpRpcClient::CallMethod(const google::protobuf::MethodDesc
   unsigned ntries = 0;
   bool success = false;
 
-  unsigned request_seq;
   while (!success && ntries < m_max_tries) {
 
-    // Set the sequence number and send the message.
-    request_seq = ++m_sequence_number;
+    // Register the call under a fresh sequence number before sending
+    // it, so that whichever thread reads the reply knows who it is for.
+    boost::shared_ptr<PendingCall> call( new PendingCall );
+    vw::uint32 request_seq;
+    {
+      Mutex::Lock lock(m_call_mutex);
+      request_seq = ++m_sequence_number;
+      m_pending_calls[request_seq] = call;
+    }
     request_wrapper.set_sequence_number(request_seq);
 
     // For debugging:
@@ -153,30 +159,15 @@ void vw::platefile::AmqpRpcClient::CallMethod(const google::protobuf::MethodDesc
                                            << "  SEQ: " << request_wrapper.sequence_number() << " ]\n";
 
     // Send the message
-    real_controller->send_message(request_wrapper, m_request_routing_key);
-
-    // Try to get the message.  If we succeed, check the sequence number.
-    try {
-        real_controller->get_message(response_wrapper, m_timeout);
-
-      while (response_wrapper.sequence_number() != request_seq) {
-        vw_out(WarningMessage)
-          << "CallMethod() sequence number did not match.  ("
-          << request_seq << " != " << response_wrapper.sequence_number()
-          << ").  Retrying...\n";
-
-        if (++ntries >= m_max_tries)
-          break;
-
-        real_controller->get_message(response_wrapper, m_timeout);
-      }
-
-      // If the sequence number does appear, then we declare victory
-      // and continue onward to parse the result.
-      if (response_wrapper.sequence_number() == request_seq)
-        success = true;
+    {
+      Mutex::Lock lock(m_send_mutex);
+      real_controller->send_message(request_wrapper, m_request_routing_key);
+    }
 
-    } catch (AMQPTimeout &e) {
+    if (wait_for_reply(real_controller, request_seq, call)) {
+      response_wrapper.Swap(&call->reply);
+      success = true;
+    } else {
       // If we timed out, increment the number of tries and loop back
       // to the beginning.
       ++ntries;
@@ -235,6 +226,81 @@ void vw::platefile::AmqpRpcClient::CallMethod(const google::protobuf::MethodDesc
   done->Run();
 }
 
+// Waits for the reply to the call with the given sequence number.
+// Returns false if the call timed out.  Only one thread reads the
+// incoming queue at a time; it delivers every reply it receives to
+// the matching pending call, and the other waiting threads sleep
+// until their reply shows up or it is their turn to read.
+bool vw::platefile::AmqpRpcClient::wait_for_reply(AmqpRpcEndpoint* endpoint,
+                                                  vw::uint32 sequence_number,
+                                                  boost::shared_ptr<PendingCall> const& call) {
+  unsigned long long deadline = 0;
+  if (m_timeout >= 0)
+    deadline = Stopwatch::microtime() + (unsigned long long)(m_timeout) * 1000;
+
+  Mutex::Lock lock(m_call_mutex);
+  while (!call->arrived) {
+    int32 remaining = -1;
+    if (m_timeout >= 0) {
+      unsigned long long now = Stopwatch::microtime();
+      if (now >= deadline)
+        break;
+      remaining = int32((deadline - now + 999) / 1000);
+    }
+
+    if (m_receiving) {
+      if (remaining < 0)
+        m_call_event.wait(lock);
+      else
+        m_call_event.timed_wait(lock, remaining);
+      continue;
+    }
+
+    // Nobody is reading the incoming queue, so it is our turn.
+    m_receiving = true;
+    lock.unlock();
+    RpcResponseWrapper reply;
+    bool received = false;
+    try {
+      endpoint->get_message(reply, remaining);
+      received = true;
+    } catch (AMQPTimeout &e) {
+      // Loop around and check our own deadline.
+    } catch (...) {
+      lock.lock();
+      m_receiving = false;
+      m_pending_calls.erase(sequence_number);
+      m_call_event.notify_all();
+      throw;
+    }
+    lock.lock();
+    m_receiving = false;
+
+    if (received) {
+      std::map<vw::uint32, boost::shared_ptr<PendingCall> >::iterator pending =
+        m_pending_calls.find(reply.sequence_number());
+      if (pending != m_pending_calls.end()) {
+        pending->second->reply.Swap(&reply);
+        pending->second->arrived = true;
+        m_pending_calls.erase(pending);
+      } else {
+        // Most likely the answer to a call that has since timed out
+        // and been retried.
+        vw_out(WarningMessage)
+          << "CallMethod() received a reply with an unknown sequence number ("
+          << reply.sequence_number() << ").  Ignoring it.\n";
+      }
+    }
+
+    // Wake the other waiters, either because their reply is in or so
+    // that one of them can take over reading the queue.
+    m_call_event.notify_all();
+  }
+
+  m_pending_calls.erase(sequence_number);
+  return call->arrived;
+}
+
 std::string vw::platefile::AmqpRpcClient::UniqueQueueName(const std::string identifier) {
   // Start by generating a unique queue name based on our hostname, PID, and thread ID.
   char hostname[255];
@@ -244,6 +310,47 @@ std::string vw::platefile::AmqpRpcClient::UniqueQueueName(const std::string iden
   return requestor.str();
 }
 
+// -----------------------------------------------------------------------------
+//                              LoopbackRpcChannel
+// -----------------------------------------------------------------------------
+
+void vw::platefile::LoopbackRpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
+                                                   google::protobuf::RpcController* controller,
+                                                   const google::protobuf::Message* request,
+                                                   google::protobuf::Message* response,
+                                                   google::protobuf::Closure* done) {
+
+  // Make copies of the messages the same way the wire would, so that
+  // the client and service never share a message.
+  std::string request_bytes = request->SerializeAsString();
+  boost::shared_ptr<google::protobuf::Message>
+    server_request(m_service->GetRequestPrototype(method).New());
+  boost::shared_ptr<google::protobuf::Message>
+    server_response(m_service->GetResponsePrototype(method).New());
+  if (!server_request->ParseFromString(request_bytes))
+    vw_throw(RpcErr() << "LoopbackRpcChannel: could not parse request for " << method->name());
+
+  // Half of the round trip on the way there...
+  if (m_latency > 0)
+    Thread::sleep_ms(m_latency / 2);
+
+  std::string response_bytes;
+  {
+    Mutex::Lock lock(m_mutex);
+    m_stats.record_query(request_bytes.size());
+    m_service->CallMethod(method, controller, server_request.get(), server_response.get(),
+                          google::protobuf::NewCallback(&null_closure));
+    response_bytes = server_response->SerializeAsString();
+  }
+
+  // ...and the other half on the way back.
+  if (m_latency > 0)
+    Thread::sleep_ms(m_latency - m_latency / 2);
+
+  response->ParseFromString(response_bytes);
+  done->Run();
+}
+
 AmqpRpcEndpoint::AmqpRpcEndpoint(boost::shared_ptr<AmqpConnection> conn, std::string exchange, std::string queue, uint32 exchange_count)
   : m_channel(new AmqpChannel(conn)), m_exchange(exchange), m_queue(queue), m_exchange_count(exchange_count), m_next_exchange(0) {
 
@@ -22,6 +22,8 @@
 
 #include <boost/shared_array.hpp>
 
+#include <map>
+
 namespace vw {
 namespace platefile {
 
@@ -177,8 +179,8 @@ namespace platefile {
     // is the routing key to address message to the server.
     std::string m_request_routing_key;
 
-    // This sequence number is used to make sure that we receive
-    // packets back in the order that we send them!
+    // This sequence number is used to match each reply with the call
+    // that is waiting for it.
     vw::uint32 m_sequence_number;
 
     // CallMethod retry count
@@ -186,13 +188,30 @@ namespace platefile {
     // CallMethod timeout
     int m_timeout;
 
+    // Calls that have been sent but not yet answered, by sequence
+    // number.  Any number of threads may have a call outstanding at
+    // once; whichever of them is currently reading the incoming queue
+    // hands each reply to the thread that is waiting for it.
+    struct PendingCall {
+      RpcResponseWrapper reply;
+      bool arrived;
+      PendingCall() : arrived(false) {}
+    };
+    std::map<vw::uint32, boost::shared_ptr<PendingCall> > m_pending_calls;
+    bool m_receiving;
+    vw::Mutex m_call_mutex, m_send_mutex;
+    vw::Condition m_call_event;
+
+    bool wait_for_reply(AmqpRpcEndpoint* endpoint, vw::uint32 sequence_number,
+                        boost::shared_ptr<PendingCall> const& call);
+
 
   public:
     AmqpRpcClient(boost::shared_ptr<AmqpConnection> conn, std::string exchange,
                   std::string queue, std::string request_routing_key, uint32 exchange_count = 1) :
       AmqpRpcEndpoint(conn, exchange, queue, exchange_count), 
       m_request_routing_key(request_routing_key),
-      m_sequence_number(0), m_max_tries(10), m_timeout(15000) {}
+      m_sequence_number(0), m_max_tries(10), m_timeout(15000), m_receiving(false) {}
 
     virtual ~AmqpRpcClient() {}
 
@@ -208,6 +227,10 @@ namespace platefile {
         m_max_tries = new_tries;
     }
 
+    /// Sends a request and waits for its reply.  CallMethod() may be
+    /// called from many threads at once, in which case their requests
+    /// are pipelined on this client's connection rather than being
+    /// sent one round trip at a time.
     virtual void CallMethod(const google::protobuf::MethodDescriptor* method,
                             google::protobuf::RpcController* controller,
                             const google::protobuf::Message* request,
@@ -220,6 +243,46 @@ namespace platefile {
   };
 
 
+  /// An RpcChannel that hands requests straight to a service in this
+  /// process.  Requests and replies are still serialized, and each
+  /// call can be delayed to stand in for a network round trip, so it
+  /// can be used to test and benchmark RPC clients without an AMQP
+  /// server.  Like AmqpRpcServer, the service handles one request at a
+  /// time.
+  class LoopbackRpcChannel : public google::protobuf::RpcChannel {
+    boost::shared_ptr<google::protobuf::Service> m_service;
+    int m_latency;
+    NetworkMonitor m_stats;
+    vw::Mutex m_mutex;
+
+  public:
+    /// The latency is the simulated round trip time, in milliseconds.
+    LoopbackRpcChannel(boost::shared_ptr<google::protobuf::Service> service, int latency = 0) :
+      m_service(service), m_latency(latency) {}
+
+    virtual ~LoopbackRpcChannel() {}
+
+    virtual void CallMethod(const google::protobuf::MethodDescriptor* method,
+                            google::protobuf::RpcController* controller,
+                            const google::protobuf::Message* request,
+                            google::protobuf::Message* response,
+                            google::protobuf::Closure* done);
+
+    /// Return statistics about the number of requests handled.
+    int queries_processed() {
+      return m_stats.queries_processed();
+    }
+
+    /// Return statistics about the number of request bytes handled.
+    size_t bytes_processed() {
+      return m_stats.bytes_processed();
+    }
+
+    void reset_stats() {
+      m_stats.reset();
+    }
+  };
+
   class AmqpRpcServer : public AmqpRpcEndpoint {
     NetworkMonitor m_stats;
     std::string m_request_routing_key;
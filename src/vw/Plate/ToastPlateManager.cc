@@ -119,15 +119,18 @@ ImageView<PixelT> ToastPlateManager<PixelT>::fetch_child_tile(int x, int y, int
   // localized, so it speeds things up considerably to cache the tiles
   // as we access them. We check the cache for this tile here.
   //
-  for( typename cache_t::iterator i=m_cache.begin(); i!=m_cache.end(); ++i ) {
-    if( i->level==level && i->x==x && i->y==y ) {
-      CacheEntry e = *i;
-      m_cache.erase(i);
-      m_cache.push_front(e);
-      vw_out(VerboseDebugMessage, "platefile") << "Found cached tile at "
-                                               << x << " " << y << " " << level << "\n";
-      return e.tile;
-    } 
+  {
+    Mutex::Lock lock(m_cache_mutex);
+    for( typename cache_t::iterator i=m_cache.begin(); i!=m_cache.end(); ++i ) {
+      if( i->level==level && i->x==x && i->y==y && i->transaction_id==transaction_id ) {
+        CacheEntry e = *i;
+        m_cache.erase(i);
+        m_cache.push_front(e);
+        vw_out(VerboseDebugMessage, "platefile") << "Found cached tile at "
+                                                 << x << " " << y << " " << level << "\n";
+        return e.tile;
+      } 
+    }
   }
 
   ImageView<PixelT> tile;
@@ -144,6 +147,7 @@ ImageView<PixelT> ToastPlateManager<PixelT>::fetch_child_tile(int x, int y, int
   // Save the tile in the cache.  The cache size of 1024 tiles was chosen
   // somewhat arbitrarily.
   //
+  Mutex::Lock lock(m_cache_mutex);
   if( m_cache.size() >= 1024 )
     m_cache.pop_back();
   CacheEntry e;
@@ -161,7 +165,33 @@ ImageView<PixelT> ToastPlateManager<PixelT>::fetch_child_tile(int x, int y, int
 
 
 template <class PixelT>
-void vw::platefile::ToastPlateManager<PixelT>::generate_mipmap_tile(int col, int row, 
+void vw::platefile::ToastPlateManager<PixelT>::mipmap_children(int col, int row, int level,
+                                                               std::vector<Vector2i> &children) const {
+  int32 num_tiles = 1 << (level+1);
+  for( int j=-1; j<3; ++j ) {
+    for( int i=-1; i<3; ++i ) {
+      int x = 2*col+i, y = 2*row+j;
+      if( x==-1 ) {
+        if( y==-1 )             children.push_back(Vector2i(num_tiles-1, num_tiles-1));
+        else if( y==num_tiles ) children.push_back(Vector2i(num_tiles-1, 0));
+        else                    children.push_back(Vector2i(0, num_tiles-1-y));
+      } else if( x==num_tiles ) {
+        if( y==-1 )             children.push_back(Vector2i(0, num_tiles-1));
+        else if( y==num_tiles ) children.push_back(Vector2i(0, 0));
+        else                    children.push_back(Vector2i(num_tiles-1, num_tiles-1-y));
+      } else if( y==-1 ) {
+        children.push_back(Vector2i(num_tiles-1-x, 0));
+      } else if( y==num_tiles ) {
+        children.push_back(Vector2i(num_tiles-1-x, num_tiles-1));
+      } else {
+        children.push_back(Vector2i(x, y));
+      }
+    }
+  }
+}
+
+template <class PixelT>
+bool vw::platefile::ToastPlateManager<PixelT>::generate_mipmap_tile(int col, int row, 
                                                                     int level, 
                                                                     int transaction_id, 
                                                                     bool preblur) const {
@@ -216,7 +246,9 @@ void vw::platefile::ToastPlateManager<PixelT>::generate_mipmap_tile(int col, int
                                      // the BlobManager...
     m_platefile->write_update(new_tile, col, row, level, transaction_id);
     //m_platefile->write_complete();
+    return true;
   }
+  return false;
 }
 
 
@@ -225,7 +257,7 @@ namespace vw {
 namespace platefile {
 
 #define VW_INSTANTIATE_TOAST_PLATEMANAGER_TYPES(PIXELT)                 \
-  template void                                                         \
+  template bool                                                         \
   ToastPlateManager<PIXELT >::generate_mipmap_tile(int col,             \
                                                    int row,             \
                                                    int level,           \
@@ -236,6 +268,11 @@ namespace platefile {
                                                int row,                 \
                                                int level,               \
                                                int transaction_id) const; \
+  template void                                                         \
+  ToastPlateManager<PIXELT >::mipmap_children(int col,                  \
+                                              int row,                  \
+                                              int level,                \
+                                              std::vector<Vector2i> &children) const; \
 
   VW_INSTANTIATE_TOAST_PLATEMANAGER_TYPES(PixelGrayA<uint8>)
   VW_INSTANTIATE_TOAST_PLATEMANAGER_TYPES(PixelGrayA<int16>)
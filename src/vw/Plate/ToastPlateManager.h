@@ -71,9 +71,11 @@ namespace platefile {
     };
 
     // The cache is declared mutable because it is modified by the
-    // otherwise const fetch_child_tile() method.
+    // otherwise const fetch_child_tile() method, which mipmap() calls
+    // from several threads at once.
     typedef std::list<CacheEntry> cache_t;
     mutable cache_t m_cache;  
+    mutable Mutex m_cache_mutex;
 
  public:
   
@@ -215,7 +217,13 @@ namespace platefile {
 
     /// This function generates a specific mipmap tile at the given
     /// col, row, and level, and transaction_id.  
-    virtual void generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const;
+    virtual bool generate_mipmap_tile(int col, int row, int level, int transaction_id, bool preblur) const;
+
+    /// TOAST mipmap tiles are built from a 4x4 neighborhood of
+    /// children, which wraps around the edges of the mosaic the same
+    /// way that fetch_child_tile() does.
+    virtual void mipmap_children(int col, int row, int level,
+                                 std::vector<Vector2i> &children) const;
 
     ImageView<PixelT> fetch_child_tile(int x, int y, int level, int transaction_id) const;
   };
@@ -0,0 +1,135 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file blob_perftest.cc
+///
+/// Writes a blob full of synthetic tiles and then measures the
+/// latency of random tile fetches, the way a tile server would issue
+/// them, through a regular read-only blob and through a memory-mapped
+/// one.
+///
+#include <vw/Plate/Blob.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+using namespace vw::platefile;
+
+static void report(std::string const& name, std::vector<uint64>& latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  double total = 0;
+  for (size_t i = 0; i < latencies.size(); ++i)
+    total += double(latencies[i]);
+  std::cout << std::setw(24) << std::left << name << std::right << std::fixed << std::setprecision(2)
+            << "  mean " << std::setw(8) << total / latencies.size() << " us"
+            << "  p50 " << std::setw(6) << latencies[latencies.size() / 2] << " us"
+            << "  p99 " << std::setw(6) << latencies[latencies.size() * 99 / 100] << " us\n";
+}
+
+// Reads each tile (header and data) and touches every byte of the
+// data, so that the mapped case pays for its page faults.
+template <class ReadT>
+static void run(std::string const& name, Blob& blob, std::vector<uint64> const& offsets,
+                std::vector<size_t> const& order, ReadT read) {
+  std::vector<uint64> latencies;
+  latencies.reserve(order.size());
+  uint64 checksum = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    unsigned long long start = Stopwatch::microtime();
+    checksum += read(blob, offsets[order[i]]);
+    latencies.push_back(Stopwatch::microtime() - start);
+  }
+  report(name, latencies);
+  if (checksum == 0)
+    std::cout << "  (checksum is zero)\n";
+}
+
+static uint64 read_copy(Blob& blob, uint64 offset) {
+  uint64 size, sum = blob.read_header<TileHeader>(offset).col();
+  boost::shared_array<uint8> data = blob.read_data(offset, size);
+  for (uint64 i = 0; i < size; ++i)
+    sum += data[i];
+  return sum;
+}
+
+static uint64 read_ref(Blob& blob, uint64 offset) {
+  uint64 sum = blob.read_header<TileHeader>(offset).col();
+  BlobDataRef data = blob.read_data_ref(offset);
+  for (uint64 i = 0; i < data.size(); ++i)
+    sum += data.data()[i];
+  return sum;
+}
+
+int main(int argc, char** argv) {
+  std::string filename;
+  int num_tiles, num_reads;
+  size_t tile_size;
+
+  po::options_description general_options("Blob Read Performance Test Program");
+  general_options.add_options()
+    ("blob", po::value<std::string>(&filename)->default_value("blob_perftest.blob"), "Blob file to create")
+    ("tiles,t", po::value<int>(&num_tiles)->default_value(4096), "Number of tiles to write")
+    ("tile-size", po::value<size_t>(&tile_size)->default_value(32*1024), "Size of each tile in bytes")
+    ("reads,n", po::value<int>(&num_reads)->default_value(100000), "Number of random tile reads")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  std::remove(filename.c_str());
+  std::vector<uint64> offsets;
+  {
+    Blob blob(filename);
+    boost::shared_array<uint8> data(new uint8[tile_size]);
+    for (size_t i = 0; i < tile_size; ++i)
+      data[i] = uint8(i);
+    TileHeader header;
+    header.set_filetype("dat");
+    header.set_row(0);
+    header.set_level(0);
+    for (int i = 0; i < num_tiles; ++i) {
+      header.set_col(i);
+      offsets.push_back(blob.write(header, data, tile_size));
+    }
+  }
+
+  std::vector<size_t> order;
+  unsigned state = 1;
+  for (int i = 0; i < num_reads; ++i) {
+    state = state * 1103515245 + 12345;
+    order.push_back((state >> 8) % offsets.size());
+  }
+
+  std::cout << "Reading " << num_reads << " random tiles of " << tile_size
+            << " bytes from " << num_tiles << " tiles\n";
+
+  {
+    Blob blob(filename, true);
+    run("fstream read_data", blob, offsets, order, read_copy);
+  }
+  {
+    Blob blob(filename, true, true);
+    run("mapped read_data", blob, offsets, order, read_copy);
+    run("mapped read_data_ref", blob, offsets, order, read_ref);
+  }
+
+  std::remove(filename.c_str());
+  return 0;
+}
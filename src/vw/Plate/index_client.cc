@@ -36,7 +36,7 @@ const boost::shared_ptr<Blob> PlateModule::get_blob(const std::string& plate_fil
   if (blob != blob_cache.end())
     return blob->second;
 
-  boost::shared_ptr<Blob> ret( new Blob(filename, true) );
+  boost::shared_ptr<Blob> ret( new Blob(filename, true, true) );
   blob_cache[filename] = ret;
   return ret;
 }
@@ -11,27 +11,249 @@
 #include <vw/Plate/common.h>
 #include <vw/Core/Stopwatch.h>
 #include <vw/Core/ThreadQueue.h>
+#include <vw/Plate/IndexPage.h>
+#include <vw/Plate/RemoteIndex.h>
 #include <csignal>
+#include <sstream>
+#include <iomanip>
 
 using namespace vw;
 
 #include <boost/shared_ptr.hpp>
 #include <boost/program_options.hpp>
 namespace po = boost::program_options;
+#include <boost/filesystem/operations.hpp>
+namespace fs = boost::filesystem;
 using namespace vw::platefile;
 using namespace vw;
 
 // A dummy method for passing to the RPC calls below.
 static void null_closure() {}
 
+// -----------------------------------------------------------------------------
+//                               PAGE TEST
+// -----------------------------------------------------------------------------
+
+// An index page that lives only in memory.
+class MemoryIndexPage : public IndexPage {
+public:
+  MemoryIndexPage(int page_size) : IndexPage(0, 0, 0, page_size, page_size) {}
+  virtual void sync() {}
+};
+
+// Fills pages with tiles and measures their memory use, how long
+// they take to save and load, and the latency of lookups.
+static void page_test(int num_pages, int page_size, double fill, int num_transactions,
+                      int num_lookups) {
+  std::vector<boost::shared_ptr<IndexPage> > pages;
+  unsigned state = 1;
+  int num_tiles = int(page_size * page_size * fill);
+
+  Stopwatch sw;
+  sw.start();
+  for (int p = 0; p < num_pages; ++p) {
+    boost::shared_ptr<IndexPage> page(new MemoryIndexPage(page_size));
+    for (int t = 1; t <= num_transactions; ++t) {
+      for (int i = 0; i < num_tiles; ++i) {
+        state = state * 1103515245 + 12345;
+        TileHeader header;
+        header.set_col((state >> 8) % page_size);
+        header.set_row((state >> 16) % page_size);
+        header.set_transaction_id(t);
+        IndexRecord record;
+        record.set_blob_id(p);
+        record.set_blob_offset(i);
+        record.set_filetype("png");
+        page->set(header, record);
+      }
+    }
+    pages.push_back(page);
+  }
+  sw.stop();
+
+  size_t bytes = 0, records = 0;
+  for (int p = 0; p < num_pages; ++p) {
+    bytes += pages[p]->memory_usage();
+    records += pages[p]->num_records();
+  }
+  std::cout << num_pages << " pages of " << page_size << "x" << page_size << ", "
+            << records / num_pages << " records per page\n"
+            << "  fill:        " << sw.elapsed_seconds() << " s\n"
+            << "  memory:      " << bytes / num_pages << " bytes per page, "
+            << double(bytes) / records << " bytes per record\n";
+
+  std::ostringstream ostr;
+  sw = Stopwatch();
+  sw.start();
+  for (int p = 0; p < num_pages; ++p)
+    pages[p]->serialize(ostr);
+  sw.stop();
+  std::cout << "  serialize:   " << sw.elapsed_seconds() / num_pages * 1e3 << " ms per page, "
+            << ostr.str().size() / num_pages << " bytes per page\n";
+
+  std::istringstream istr(ostr.str());
+  sw = Stopwatch();
+  sw.start();
+  for (int p = 0; p < num_pages; ++p)
+    pages[p]->deserialize(istr);
+  sw.stop();
+  std::cout << "  deserialize: " << sw.elapsed_seconds() / num_pages * 1e3 << " ms per page\n";
+
+  int found = 0;
+  sw = Stopwatch();
+  sw.start();
+  for (int i = 0; i < num_lookups; ++i) {
+    state = state * 1103515245 + 12345;
+    IndexPage const& page = *pages[(state >> 4) % num_pages];
+    try {
+      page.get((state >> 8) % page_size, (state >> 16) % page_size,
+               1 + int(state % num_transactions));
+      ++found;
+    } catch (TileNotFoundErr const&) {}
+  }
+  sw.stop();
+  std::cout << "  get:         " << sw.elapsed_seconds() / num_lookups * 1e9 << " ns per lookup ("
+            << found << " of " << num_lookups << " found)\n";
+
+  sw = Stopwatch();
+  sw.start();
+  size_t num_found = 0;
+  for (int p = 0; p < num_pages; ++p)
+    num_found += pages[p]->search_by_region(BBox2i(0, 0, page_size, page_size), 
+                                            1, num_transactions, 0, false).size();
+  sw.stop();
+  std::cout << "  region:      " << sw.elapsed_seconds() / num_pages * 1e3 << " ms per page ("
+            << num_found << " tiles)\n";
+}
+
+// -----------------------------------------------------------------------------
+//                              REMOTE TEST
+// -----------------------------------------------------------------------------
+
+// Reads random tiles at one level of an index.
+class RemoteReader {
+  Index &m_index;
+  int m_level, m_num_reads;
+  unsigned m_seed;
+public:
+  RemoteReader(Index& index, int level, int num_reads, unsigned seed) :
+    m_index(index), m_level(level), m_num_reads(num_reads), m_seed(seed) {}
+  void operator()() {
+    unsigned state = m_seed;
+    int tiles = 1 << m_level;
+    for (int i = 0; i < m_num_reads; ++i) {
+      state = state * 1103515245 + 12345;
+      try {
+        m_index.read_request((state >> 8) % tiles, (state >> 20) % tiles, m_level, -1);
+      } catch (TileNotFoundErr const&) {}
+    }
+  }
+};
+
+static void remote_write(boost::shared_ptr<IndexService> stub, LoopbackRpcChannel& channel,
+                         std::string const& name, bool async, int level, int num_writes) {
+  IndexHeader hdr;
+  hdr.set_tile_size(256);
+  hdr.set_tile_filetype("png");
+  hdr.set_pixel_format(VW_PIXEL_RGBA);
+  hdr.set_channel_type(VW_CHANNEL_UINT8);
+  hdr.set_type("toast");
+
+  RemoteIndex index(stub, name, hdr, async);
+  channel.reset_stats();
+
+  unsigned state = 1;
+  int tiles = 1 << level;
+  Stopwatch sw;
+  sw.start();
+  for (int i = 0; i < num_writes; ++i) {
+    state = state * 1103515245 + 12345;
+    TileHeader header;
+    header.set_col((state >> 8) % tiles);
+    header.set_row((state >> 20) % tiles);
+    header.set_level(level);
+    header.set_transaction_id(1);
+    IndexRecord record;
+    record.set_blob_id(0);
+    record.set_blob_offset(i);
+    index.write_update(header, record);
+  }
+  index.sync();
+  sw.stop();
+
+  std::cout << "  " << (async ? "async" : "sync ") << " writes: "
+            << std::setprecision(3) << sw.elapsed_seconds() << " s, "
+            << std::setprecision(0) << num_writes / sw.elapsed_seconds() << " writes/s, "
+            << channel.queries_processed() << " round trips\n";
+}
+
+// Runs an index server in this process, behind a channel that adds a
+// simulated round trip time to every request, and measures index
+// write throughput with and without asynchronous mode, then read
+// throughput with a cold page cache as the number of reader threads
+// goes up.
+static void remote_test(std::string const& root, int latency, int max_threads,
+                        int level, int num_writes, int num_reads) {
+  fs::create_directories(root);
+  boost::shared_ptr<IndexServiceImpl> service( new IndexServiceImpl(root) );
+  LoopbackRpcChannel channel(service, latency);
+  boost::shared_ptr<IndexService> stub( new IndexService::Stub(&channel) );
+
+  std::cout << std::fixed << "Index server with a " << latency << " ms round trip, "
+            << num_writes << " tiles on level " << level << "\n";
+  remote_write(stub, channel, "remote_test_sync.plate", false, level, num_writes);
+  remote_write(stub, channel, "remote_test_async.plate", true, level, num_writes);
+
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    RemoteIndex index(stub, "remote_test_async.plate", true);
+    channel.reset_stats();
+
+    Stopwatch sw;
+    sw.start();
+    std::vector<boost::shared_ptr<Thread> > threads;
+    for (int i = 0; i < num_threads; ++i)
+      threads.push_back( boost::shared_ptr<Thread>(
+        new Thread( RemoteReader(index, level, num_reads / num_threads, i+1) ) ) );
+    for (int i = 0; i < num_threads; ++i)
+      threads[i]->join();
+    sw.stop();
+
+    std::cout << "  " << std::setw(3) << num_threads << " readers: "
+              << std::setprecision(3) << sw.elapsed_seconds() << " s, "
+              << std::setprecision(0) << num_reads / sw.elapsed_seconds() << " reads/s, "
+              << channel.queries_processed() << " round trips\n";
+  }
+
+  fs::remove_all(root + "/remote_test_sync.plate");
+  fs::remove_all(root + "/remote_test_async.plate");
+}
+
 // -----------------------------------------------------------------------------
 //                                  MAIN
 // -----------------------------------------------------------------------------
 
 int main(int argc, char** argv) {
 
+  int num_pages, page_size, num_transactions, num_lookups;
+  int latency, max_threads, level, num_writes, num_reads;
+  double fill;
+  std::string root;
+
   po::options_description general_options("AMQP Performance Test Program");
   general_options.add_options()
+    ("page-test", "Measure index page memory use and lookup latency instead of the index server")
+    ("pages", po::value<int>(&num_pages)->default_value(16), "Number of pages for --page-test")
+    ("page-size", po::value<int>(&page_size)->default_value(256), "Page width and height for --page-test")
+    ("fill", po::value<double>(&fill)->default_value(0.5), "Fraction of tiles written per transaction for --page-test")
+    ("transactions", po::value<int>(&num_transactions)->default_value(4), "Transactions per page for --page-test")
+    ("lookups", po::value<int>(&num_lookups)->default_value(1000000), "Lookups for --page-test")
+    ("remote-test", "Measure RemoteIndex throughput against an index server in this process")
+    ("root", po::value<std::string>(&root)->default_value("index_perftest.tmp"), "Platefile directory for --remote-test")
+    ("latency", po::value<int>(&latency)->default_value(5), "Simulated round trip time in ms for --remote-test")
+    ("max-threads", po::value<int>(&max_threads)->default_value(16), "Largest number of reader threads for --remote-test")
+    ("level", po::value<int>(&level)->default_value(11), "Tile level for --remote-test")
+    ("writes", po::value<int>(&num_writes)->default_value(20000), "Tiles written for --remote-test")
+    ("reads", po::value<int>(&num_reads)->default_value(20000), "Tiles read for --remote-test")
     ("help", "Display this help message");
 
   po::variables_map vm;
@@ -47,6 +269,16 @@ int main(int argc, char** argv) {
     return 0;
   }
 
+  if( vm.count("page-test") ) {
+    page_test(num_pages, page_size, fill, num_transactions, num_lookups);
+    return 0;
+  }
+
+  if( vm.count("remote-test") ) {
+    remote_test(root, latency, max_threads, level, num_writes, num_reads);
+    return 0;
+  }
+
   std::string queue_name = "index_perftest_queue";
 
   boost::shared_ptr<AmqpConnection> conn(new AmqpConnection());
@@ -205,7 +205,7 @@ const boost::shared_ptr<Blob> PlateModule::get_blob(int platefile_id, const stri
       return blob->second.blob;
   }
 
-  boost::shared_ptr<Blob> ret( new Blob(filename, true) );
+  boost::shared_ptr<Blob> ret( new Blob(filename, true, true) );
 
   if (m_conf->use_blob_cache)
     blob_cache.insert(std::make_pair(filename, BlobCacheEntry(ret, platefile_id)));
@@ -102,6 +102,52 @@ TEST_F(BlobIOTest, WriteThenRead) {
   }
 }
 
+TEST_F(BlobIOTest, MappedRead) {
+  std::vector<uint64> offsets;
+  {
+    Blob blob(blob_path);
+    for (int i = 0; i < 3; ++i) {
+      hdr.set_col(i);
+      offsets.push_back(blob.write(hdr, test_data, data_size));
+    }
+  }
+
+  Blob mapped(blob_path, true, true);
+  ASSERT_TRUE(mapped.mapped());
+
+  BlobDataRef ref = mapped.read_data_ref(offsets[1]);
+  ASSERT_EQ(data_size, ref.size());
+  for (uint64 i = 0; i < data_size; ++i)
+    EXPECT_EQ( test_data[i], ref.data()[i] );
+
+  uint64 read_size;
+  boost::shared_array<uint8> verify_data = mapped.read_data(offsets[2], read_size);
+  ASSERT_EQ(data_size, read_size);
+  for (uint64 i = 0; i < data_size; ++i)
+    EXPECT_EQ( test_data[i], verify_data[i] );
+
+  EXPECT_EQ( 2, mapped.read_header<TileHeader>(offsets[2]).col() );
+
+  int count = 0;
+  for (Blob::iterator iter = mapped.begin(); iter != mapped.end(); ++iter)
+    EXPECT_EQ( count++, (*iter).col() );
+  EXPECT_EQ( 3, count );
+
+  // Append to the blob while it is mapped.  The new tiles should be
+  // readable, and the old reference should still be valid.
+  {
+    Blob blob(blob_path);
+    hdr.set_col(3);
+    offsets.push_back(blob.write(hdr, test_data, data_size));
+  }
+  EXPECT_EQ( 3, mapped.read_header<TileHeader>(offsets[3]).col() );
+  EXPECT_EQ( data_size, mapped.data_size(offsets[3]) );
+  for (uint64 i = 0; i < data_size; ++i)
+    EXPECT_EQ( test_data[i], ref.data()[i] );
+
+  EXPECT_THROW( mapped.write(hdr, test_data, data_size), BlobIoErr );
+}
+
 // This test needs to be updated with some test material (and it should use the
 // fixture, and not use hard-coded paths)
 TEST_F(BlobIOTest, DISABLED_WriteFromFile) {
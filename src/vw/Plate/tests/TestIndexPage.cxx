@@ -157,3 +157,149 @@ TEST_F(IndexPageTest, Serialization) {
   EXPECT_EQ( rec[2].blob_id(),     out_rec.blob_id() );
   EXPECT_EQ( rec[2].blob_offset(), out_rec.blob_offset() );
 }
+
+TEST_F(IndexPageTest, Searches) {
+  TileHeader hdr;
+  IndexRecord rec;
+  hdr.set_col(7);
+  hdr.set_row(9);
+
+  // Insert out of order, so that the chain is not in insertion order.
+  int tids[] = { 5, 1, 9, 3, 7 };
+  for (int i = 0; i < 5; ++i) {
+    hdr.set_transaction_id(tids[i]);
+    rec.set_blob_id(tids[i]);
+    rec.set_filetype(i % 2 ? "png" : "jpg");
+    page->set(hdr, rec);
+  }
+  hdr.set_col(8);
+  page->set(hdr, rec);
+
+  EXPECT_EQ(2, page->sparse_size());
+  EXPECT_EQ(6, page->num_records());
+
+  IndexPage::multi_value_type entries = page->multi_get(7, 9, 3, 7);
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ(7, entries.front().first);
+  EXPECT_EQ(3, entries.back().first);
+  EXPECT_EQ(3, entries.back().second.blob_id());
+  EXPECT_EQ("png", entries.back().second.filetype());
+
+  std::list<TileHeader> headers = page->search_by_location(7, 9, 2, 6, true);
+  ASSERT_EQ(3u, headers.size());
+  EXPECT_EQ(5, headers.front().transaction_id());
+  EXPECT_EQ(1, headers.back().transaction_id());
+
+  headers = page->search_by_region(BBox2i(0,0,1024,1024), 2, 6, 2, false);
+  ASSERT_EQ(1u, headers.size());
+  EXPECT_EQ(7, headers.front().col());
+  EXPECT_EQ(5, headers.front().transaction_id());
+
+  headers = page->search_by_region(BBox2i(0,0,1024,1024), -1, -1, 0, false);
+  EXPECT_EQ(2u, headers.size());
+
+  EXPECT_EQ(5, page->get(7, 9, 6).blob_id());
+  EXPECT_THROW( page->get(7, 9, 6, true), TileNotFoundErr );
+  EXPECT_THROW( page->get(7, 9, 0), TileNotFoundErr );
+
+  // The same queries work on a page that has been saved and reloaded.
+  page->sync();
+  LocalIndexPage page2(page_path,0,0,0,1024,1024);
+  EXPECT_EQ(6, page2.num_records());
+  entries = page2.multi_get(7, 9, 0, 100);
+  ASSERT_EQ(5u, entries.size());
+  int expected = 9;
+  for (IndexPage::multi_value_type::iterator it = entries.begin(); it != entries.end(); ++it) {
+    EXPECT_EQ(expected, it->first);
+    expected -= 2;
+  }
+  EXPECT_EQ("jpg", page2.get(7, 9, 9, true).filetype());
+}
+
+TEST_F(IndexPageTest, LegacyFormat) {
+  page.reset();
+
+  // Write a page in the old format by hand: page size, sparsetable
+  // metadata, then (transaction id, IndexRecord) lists.
+  {
+    std::ofstream ostr(page_path.c_str(), std::ios::binary);
+    int32 width = 1024, height = 1024;
+    ostr.write((char*)(&width), sizeof(width));
+    ostr.write((char*)(&height), sizeof(height));
+    google::sparsetable<int32> table(width*height);
+    table.set(5*1024 + 3, 0);
+    table.set(6*1024 + 3, 0);
+    table.write_metadata(&ostr);
+    for (int tile = 0; tile < 2; ++tile) {
+      int32 list_size = 2;
+      ostr.write((char*)(&list_size), sizeof(list_size));
+      for (int32 tid = 2; tid > 0; --tid) {
+        IndexRecord rec;
+        rec.set_blob_id(100*tile + tid);
+        rec.set_blob_offset(10);
+        uint16 size = rec.ByteSize();
+        std::string bytes = rec.SerializeAsString();
+        ostr.write((char*)(&tid), sizeof(tid));
+        ostr.write((char*)(&size), sizeof(size));
+        ostr.write(bytes.data(), size);
+      }
+    }
+  }
+
+  LocalIndexPage old_page(page_path,0,0,0,1024,1024);
+  EXPECT_EQ(2, old_page.sparse_size());
+  EXPECT_EQ(4, old_page.num_records());
+  EXPECT_EQ(2,   old_page.get(3, 5, -1).blob_id());
+  EXPECT_EQ(1,   old_page.get(3, 5, 1).blob_id());
+  EXPECT_EQ(101, old_page.get(3, 6, 1).blob_id());
+  EXPECT_EQ("default_to_index", old_page.get(3, 6, 1).filetype());
+  EXPECT_THROW( old_page.get(4, 5, -1), TileNotFoundErr );
+}
+
+TEST_F(IndexPageTest, PackedFormat) {
+  TileHeader hdr;
+  hdr.set_col(3);
+  hdr.set_row(5);
+  hdr.set_transaction_id(7);
+  IndexRecord rec;
+  rec.set_blob_id(9);
+  rec.set_blob_offset(0x0102030405060708ULL);
+  rec.set_filetype("png");
+  page->set(hdr, rec);
+  page->sync();
+
+  std::ifstream istr(page_path.c_str(), std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+
+  // Every field is little-endian and unpadded: an eight field header,
+  // one tile, one 24 byte record and "png\0".
+  ASSERT_EQ(32u + 8u + 24u + 4u, bytes.size());
+  const unsigned char magic_version[] = { 0xb0, 0xb6, 0xa8, 0xa9, 1, 0, 0, 0 };
+  EXPECT_EQ(std::string((const char*)magic_version, 8), bytes.substr(0, 8));
+  const unsigned char offset[] = { 8, 7, 6, 5, 4, 3, 2, 1 };
+  EXPECT_EQ(std::string((const char*)offset, 8), bytes.substr(32 + 8 + 8, 8));
+  EXPECT_EQ(std::string("png", 4), bytes.substr(bytes.size() - 4));
+
+  page.reset();
+  LocalIndexPage page2(page_path,0,0,0,1024,1024);
+  EXPECT_EQ(0x0102030405060708ULL, page2.get(3, 5, 7).blob_offset());
+  EXPECT_EQ("png", page2.get(3, 5, 7).filetype());
+}
+
+TEST_F(IndexPageTest, NewerFormatVersion) {
+  TileHeader hdr;
+  hdr.set_col(3);
+  hdr.set_row(5);
+  hdr.set_transaction_id(7);
+  page->set(hdr, IndexRecord());
+  page.reset();
+
+  // Bump the version field; this reader must refuse the page rather
+  // than guess at its layout.
+  {
+    std::fstream file(page_path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(4);
+    file.put(char(2));
+  }
+  EXPECT_THROW( LocalIndexPage(page_path,0,0,0,1024,1024), IOErr );
+}
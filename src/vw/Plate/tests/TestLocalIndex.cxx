@@ -286,6 +286,36 @@ TEST_F(LocalIndexTiles, Simple) {
   EXPECT_THROW(index->read_request(0, 0, 2, -1), TileNotFoundErr);
 }
 
+TEST_F(LocalIndexTiles, BatchWrite) {
+  uint64 old_offset;
+  int blob_id = index->write_request(old_offset);
+
+  std::vector<TileHeader> batch_hdrs(hdrs.get(), hdrs.get()+5);
+  std::vector<IndexRecord> batch_recs(5);
+  for (size_t i = 0; i < batch_hdrs.size(); ++i) {
+    batch_recs[i].set_blob_id(blob_id);
+    batch_recs[i].set_blob_offset(blob->append(batch_hdrs[i], test_data, test_size));
+    batch_recs[i].set_filetype(batch_hdrs[i].filetype());
+  }
+  blob->commit();
+  index->write_update(batch_hdrs, batch_recs);
+  index->write_complete(blob_id, blob->size());
+
+  EXPECT_EQ( 2, index->num_levels() );
+  for (size_t i = 0; i < batch_hdrs.size(); ++i) {
+    IndexRecord result = index->read_request(batch_hdrs[i].col(), batch_hdrs[i].row(),
+                                             batch_hdrs[i].level(), -1);
+    EXPECT_EQ( batch_recs[i].blob_offset(), result.blob_offset() );
+  }
+
+  // The committed end of file pointer is visible to a new reader.
+  Blob reader(blob_path, true);
+  EXPECT_EQ( blob->size(), reader.size() );
+
+  batch_recs.pop_back();
+  EXPECT_THROW( index->write_update(batch_hdrs, batch_recs), ArgumentErr );
+}
+
 TEST_F(LocalIndexTiles, ReadWrite) {
 
   {
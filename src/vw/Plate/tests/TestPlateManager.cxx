@@ -0,0 +1,146 @@
+// __BEGIN_LICENSE__
+//
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+
+#include <vw/Plate/PlateManager.h>
+#include <vw/Plate/PlateFile.h>
+
+#include <map>
+#include <set>
+
+using namespace std;
+using namespace vw;
+using namespace vw::platefile;
+using namespace vw::test;
+
+typedef std::pair<int, std::pair<int,int> > tile_id;
+
+tile_id make_tile_id(int col, int row, int level) {
+  return std::make_pair(level, std::make_pair(col, row));
+}
+
+// Records the order in which mipmap tiles are generated instead of
+// actually building them.  Tiles listed in empty come out empty.
+class RecordingPlateManager : public PlateManager {
+  mutable Mutex m_mutex;
+  mutable int m_sequence;
+
+public:
+  mutable std::map<tile_id, int> started, finished;
+  std::set<tile_id> empty;
+
+  RecordingPlateManager(boost::shared_ptr<PlateFile> platefile) :
+    PlateManager(platefile), m_sequence(0) {}
+
+  virtual bool generate_mipmap_tile(int col, int row, int level,
+                                    int /*transaction_id*/, bool /*preblur*/) const {
+    tile_id id = make_tile_id(col, row, level);
+    {
+      Mutex::Lock lock(m_mutex);
+      started[id] = m_sequence++;
+    }
+    Thread::sleep_ms(1);
+    Mutex::Lock lock(m_mutex);
+    finished[id] = m_sequence++;
+    return empty.find(id) == empty.end();
+  }
+};
+
+class PlateManagerTest : public ::testing::Test {
+  protected:
+
+  virtual void SetUp() {
+    plate_path = UnlinkName("PlateManager.plate");
+    platefile.reset( new PlateFile(plate_path, "equi", "", 256, "tif",
+                                   VW_PIXEL_RGBA, VW_CHANNEL_UINT8) );
+    transaction_id = platefile->transaction_request("test", -1);
+
+    // Write an 8x8 block of tiles at level 5.
+    boost::shared_array<uint8> data(new uint8[16]);
+    platefile->write_request();
+    for (int row = 8; row < 16; ++row)
+      for (int col = 4; col < 12; ++col)
+        platefile->write_update(data, 16, col, row, 5, transaction_id);
+    platefile->sync();
+  }
+
+  virtual void TearDown() {
+    platefile->write_complete();
+    platefile.reset();
+  }
+
+  // Checks that every tile was generated after all of the tiles it
+  // reads from that were generated (or written) before it.
+  void expect_children_first(RecordingPlateManager const& manager) {
+    for (std::map<tile_id,int>::const_iterator iter = manager.started.begin();
+         iter != manager.started.end(); ++iter) {
+      int level = iter->first.first;
+      int col = iter->first.second.first, row = iter->first.second.second;
+      std::vector<Vector2i> children;
+      manager.mipmap_children(col, row, level, children);
+      for (size_t i = 0; i < children.size(); ++i) {
+        std::map<tile_id,int>::const_iterator child =
+          manager.finished.find(make_tile_id(children[i].x(), children[i].y(), level+1));
+        if (child != manager.finished.end())
+          EXPECT_LT(child->second, iter->second);
+      }
+    }
+  }
+
+  UnlinkName plate_path;
+  boost::shared_ptr<PlateFile> platefile;
+  int transaction_id;
+};
+
+TEST_F(PlateManagerTest, Mipmap) {
+  RecordingPlateManager manager(platefile);
+  manager.mipmap(5, BBox2i(4, 8, 7, 7), transaction_id, false);
+
+  // 16 + 4 + 2 + 1 + 1 tiles from level 4 up to the root.
+  EXPECT_EQ(24u, manager.finished.size());
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(2, 4, 4)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(5, 7, 4)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(0, 1, 2)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(1, 1, 2)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(0, 0, 0)));
+  expect_children_first(manager);
+}
+
+TEST_F(PlateManagerTest, StoppingLevel) {
+  RecordingPlateManager manager(platefile);
+  manager.mipmap(5, BBox2i(4, 8, 7, 7), transaction_id, false,
+                 ProgressCallback::dummy_instance(), 3);
+  EXPECT_EQ(20u, manager.finished.size());
+  EXPECT_EQ(0u, manager.finished.count(make_tile_id(1, 1, 2)));
+}
+
+TEST_F(PlateManagerTest, SkipsEmptySubtrees) {
+  RecordingPlateManager manager(platefile);
+  for (int row = 4; row < 6; ++row)
+    for (int col = 2; col < 4; ++col)
+      manager.empty.insert(make_tile_id(col, row, 4));
+  manager.mipmap(5, BBox2i(4, 8, 7, 7), transaction_id, false);
+
+  // The level 3 tile above the empty ones is skipped, but the rest of
+  // the pyramid is still built.
+  EXPECT_EQ(23u, manager.finished.size());
+  EXPECT_EQ(0u, manager.finished.count(make_tile_id(1, 2, 3)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(2, 2, 3)));
+  EXPECT_EQ(1u, manager.finished.count(make_tile_id(0, 0, 0)));
+  expect_children_first(manager);
+
+  // If everything at level 4 comes out empty, nothing above it is
+  // generated at all.
+  RecordingPlateManager all_empty(platefile);
+  for (int row = 4; row < 8; ++row)
+    for (int col = 2; col < 6; ++col)
+      all_empty.empty.insert(make_tile_id(col, row, 4));
+  all_empty.mipmap(5, BBox2i(4, 8, 7, 7), transaction_id, false);
+  EXPECT_EQ(16u, all_empty.finished.size());
+}
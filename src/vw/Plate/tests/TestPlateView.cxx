@@ -0,0 +1,111 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+
+#include <vw/Plate/PlateView.h>
+#include <vw/Plate/PlateFile.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Image/Algorithms.h>
+
+#include <cstdio>
+#include <sstream>
+
+using namespace vw;
+using namespace vw::platefile;
+using namespace vw::test;
+
+// Resizes the system cache, and puts the old size back on the way
+// out however the test ends.
+class SystemCacheSize {
+  size_t m_old_size;
+public:
+  SystemCacheSize(size_t size) : m_old_size(vw_system_cache().max_size()) {
+    vw_system_cache().resize(size);
+  }
+  ~SystemCacheSize() { vw_system_cache().resize(m_old_size); }
+};
+
+class PlateViewTest : public ::testing::Test {
+  protected:
+
+  static uint8 expected(int x, int y) { return uint8((3*x + 7*y) % 251); }
+
+  virtual void SetUp() {
+    plate_path = UnlinkName("PlateView.plate");
+    platefile.reset( new PlateFile(plate_path, "equi", "", 16, "png",
+                                   VW_PIXEL_GRAY, VW_CHANNEL_UINT8) );
+    int transaction_id = platefile->transaction_request("test", -1);
+
+    // Fill all 4x4 tiles of level 2.
+    platefile->write_request();
+    for (int row = 0; row < 4; ++row)
+      for (int col = 0; col < 4; ++col) {
+        ImageView<PixelGray<uint8> > tile(16, 16);
+        for (int j = 0; j < 16; ++j)
+          for (int i = 0; i < 16; ++i)
+            tile(i,j) = expected(16*col + i, 16*row + j);
+        platefile->write_update(tile, col, row, 2, transaction_id);
+      }
+    platefile->write_complete();
+    platefile->transaction_complete(transaction_id, true);
+  }
+
+  virtual void TearDown() {
+    platefile.reset();
+  }
+
+  void expect_region(PlateView<PixelGray<uint8> > const& view, BBox2i const& bbox) {
+    ImageView<PixelGray<uint8> > image = crop(view, bbox);
+    ASSERT_EQ(bbox.width(), image.cols());
+    ASSERT_EQ(bbox.height(), image.rows());
+    for (int j = 0; j < image.rows(); ++j)
+      for (int i = 0; i < image.cols(); ++i)
+        ASSERT_EQ(expected(bbox.min().x() + i, bbox.min().y() + j), image(i,j).v())
+          << "at " << bbox.min().x() + i << " " << bbox.min().y() + j;
+  }
+
+  UnlinkName plate_path;
+  boost::shared_ptr<PlateFile> platefile;
+};
+
+TEST_F(PlateViewTest, Read) {
+  PlateView<PixelGray<uint8> > view(platefile);
+  EXPECT_EQ(64, view.cols());
+  EXPECT_EQ(64, view.rows());
+
+  // Regions that cover several tiles, read and then read again
+  // through the cache, and then from a copy of the view.
+  expect_region(view, BBox2i(5, 7, 40, 30));
+  expect_region(view, BBox2i(5, 7, 40, 30));
+  expect_region(view, BBox2i(0, 0, 64, 64));
+  PlateView<PixelGray<uint8> > copy_of_view = view;
+  expect_region(copy_of_view, BBox2i(20, 33, 17, 31));
+}
+
+TEST_F(PlateViewTest, SmallCache) {
+  // With room for only a couple of tiles in the cache, the tiles are
+  // read again as they are needed.
+  SystemCacheSize cache_size(2 * 16 * 16);
+  PlateView<PixelGray<uint8> > view(platefile);
+  expect_region(view, BBox2i(0, 0, 64, 64));
+  expect_region(view, BBox2i(3, 50, 61, 14));
+  expect_region(view, BBox2i(0, 0, 64, 64));
+}
+
+TEST_F(PlateViewTest, ReadError) {
+  // Tiles whose blob has gone missing fail with the error from the
+  // blob, not a generic one.
+  for (int blob_id = 0; blob_id < 8; ++blob_id) {
+    std::ostringstream blob;
+    blob << platefile->name() << "/plate_" << blob_id << ".blob";
+    std::remove(blob.str().c_str());
+  }
+  PlateView<PixelGray<uint8> > view(platefile);
+  ImageView<PixelGray<uint8> > image;
+  EXPECT_THROW(image = crop(view, BBox2i(0, 0, 40, 40)), BlobIoErr);
+}
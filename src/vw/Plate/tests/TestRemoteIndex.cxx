@@ -0,0 +1,149 @@
+// __BEGIN_LICENSE__
+//
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+#include <gtest/gtest.h>
+#include <test/Helpers.h>
+
+#include <vw/Plate/RemoteIndex.h>
+#include <vw/Plate/IndexService.h>
+#include <vw/Plate/RpcServices.h>
+#include <vw/Plate/Exception.h>
+
+#include <boost/filesystem/convenience.hpp>
+namespace fs = boost::filesystem;
+
+using namespace std;
+using namespace vw;
+using namespace vw::platefile;
+using namespace vw::test;
+
+// Talks to an IndexServiceImpl in this process through a
+// LoopbackRpcChannel, which stands in for the AMQP index server.
+class RemoteIndexTest : public ::testing::Test {
+  protected:
+
+  virtual void SetUp() {
+    index_hdr.set_tile_size(256);
+    index_hdr.set_tile_filetype("tif");
+    index_hdr.set_pixel_format(VW_PIXEL_RGB);
+    index_hdr.set_channel_type(VW_CHANNEL_UINT8);
+    index_hdr.set_type("toast");
+
+    root_path = UnlinkName("RemoteIndex");
+    fs::create_directories(root_path);
+
+    service.reset( new IndexServiceImpl(root_path) );
+    channel.reset( new LoopbackRpcChannel(service, 10) );
+    stub.reset( new IndexService::Stub(channel.get()) );
+  }
+
+  virtual void TearDown() {
+    stub.reset();
+    channel.reset();
+    service.reset();
+  }
+
+  // Write a tile at (i, i) and (i, 511-i) on level 9, which covers
+  // four index pages.
+  void write_tiles(Index& index, int num_tiles) {
+    for (int i = 0; i < num_tiles; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        TileHeader hdr;
+        hdr.set_col(i);
+        hdr.set_row(j ? 511 - i : i);
+        hdr.set_level(9);
+        hdr.set_transaction_id(1);
+        IndexRecord rec;
+        rec.set_blob_id(j);
+        rec.set_blob_offset(i);
+        index.write_update(hdr, rec);
+      }
+    }
+  }
+
+  IndexHeader index_hdr;
+  UnlinkName root_path;
+
+  boost::shared_ptr<IndexServiceImpl> service;
+  boost::shared_ptr<LoopbackRpcChannel> channel;
+  boost::shared_ptr<IndexService> stub;
+};
+
+class TileReader {
+  Index &m_index;
+  int m_col, m_row, m_level;
+  IndexRecord &m_result;
+public:
+  TileReader(Index& index, int col, int row, int level, IndexRecord& result) :
+    m_index(index), m_col(col), m_row(row), m_level(level), m_result(result) {}
+  void operator()() {
+    m_result = m_index.read_request(m_col, m_row, m_level, -1);
+  }
+};
+
+TEST_F(RemoteIndexTest, SyncWrites) {
+  RemoteIndex index(stub, "sync.plate", index_hdr);
+  write_tiles(index, 300);
+  index.sync();
+
+  // Updates go out 50 at a time.
+  EXPECT_LE(600 / 50, channel->queries_processed());
+
+  RemoteIndex reopened(stub, "sync.plate");
+  for (int i = 0; i < 300; i += 7) {
+    IndexRecord rec = reopened.read_request(i, 511 - i, 9, -1);
+    EXPECT_EQ(1, rec.blob_id());
+    EXPECT_EQ(uint64(i), rec.blob_offset());
+  }
+}
+
+TEST_F(RemoteIndexTest, AsyncWrites) {
+  RemoteIndex index(stub, "async.plate", index_hdr, true);
+  channel->reset_stats();
+  write_tiles(index, 300);
+  index.sync();
+
+  // Updates queued while a batch is in flight go out together, so
+  // this takes fewer round trips than sending them 50 at a time.
+  EXPECT_GT(4 + 600 / 50, channel->queries_processed());
+
+  RemoteIndex reopened(stub, "async.plate");
+  for (int i = 0; i < 300; i += 7) {
+    IndexRecord rec = reopened.read_request(i, i, 9, -1);
+    EXPECT_EQ(0, rec.blob_id());
+    EXPECT_EQ(uint64(i), rec.blob_offset());
+    rec = reopened.read_request(i, 511 - i, 9, -1);
+    EXPECT_EQ(1, rec.blob_id());
+    EXPECT_EQ(uint64(i), rec.blob_offset());
+  }
+}
+
+TEST_F(RemoteIndexTest, CoalescedPageRequests) {
+  {
+    RemoteIndex writer(stub, "coalesce.plate", index_hdr);
+    write_tiles(writer, 64);
+    writer.sync();
+  }
+
+  RemoteIndex index(stub, "coalesce.plate", true);
+  channel->reset_stats();
+
+  // All of these tiles live on the same index page, so the readers
+  // should share a single page request.
+  const int num_readers = 8;
+  std::vector<IndexRecord> results(num_readers);
+  std::vector<boost::shared_ptr<Thread> > threads;
+  for (int i = 0; i < num_readers; ++i)
+    threads.push_back( boost::shared_ptr<Thread>(
+      new Thread( TileReader(index, 8*i, 8*i, 9, results[i]) ) ) );
+  for (int i = 0; i < num_readers; ++i)
+    threads[i]->join();
+
+  EXPECT_EQ(1, channel->queries_processed());
+  for (int i = 0; i < num_readers; ++i)
+    EXPECT_EQ(uint64(8*i), results[i].blob_offset());
+}
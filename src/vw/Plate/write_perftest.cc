@@ -0,0 +1,121 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file write_perftest.cc
+///
+/// Writes many small raw tiles into a local platefile, the way a
+/// large image2plate ingest would, and reports tiles per second for
+/// per-tile blob locking, a single blob lock, and batched writes at
+/// each durability level.
+///
+#include <vw/Plate/PlateFile.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+using namespace vw::platefile;
+
+static void report(std::string const& name, int num_tiles, Stopwatch const& sw) {
+  std::cout << std::setw(24) << std::left << name << std::right << std::fixed
+            << std::setw(10) << std::setprecision(3) << sw.elapsed_seconds() << " s  "
+            << std::setw(10) << std::setprecision(0) << num_tiles / sw.elapsed_seconds()
+            << " tiles/s\n";
+}
+
+int main(int argc, char** argv) {
+  std::string url;
+  int num_tiles, batch_size;
+  size_t tile_size;
+
+  po::options_description general_options("Platefile Write Performance Test Program");
+  general_options.add_options()
+    ("platefile", po::value<std::string>(&url)->default_value("write_perftest.plate"), "Platefile to create")
+    ("tiles,t", po::value<int>(&num_tiles)->default_value(16384), "Number of tiles to write per test")
+    ("tile-size", po::value<size_t>(&tile_size)->default_value(4096), "Size of each tile in bytes")
+    ("batch,b", po::value<int>(&batch_size)->default_value(256), "Tiles per write_batch() call")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  boost::filesystem::remove_all(url);
+  PlateFile platefile(url, "toast", "write_perftest", 256, "dat",
+                      VW_PIXEL_RGBA, VW_CHANNEL_UINT8);
+
+  boost::shared_array<uint8> data(new uint8[tile_size]);
+  for (size_t i = 0; i < tile_size; ++i)
+    data[i] = uint8(i);
+
+  // Lay the tiles out on the smallest level that holds them all.
+  int level = 0;
+  while ((1 << level) * (1 << level) < num_tiles)
+    ++level;
+  int width = 1 << level;
+
+  std::cout << "Writing " << num_tiles << " tiles of " << tile_size
+            << " bytes to level " << level << " of " << url << "\n\n";
+
+  int transaction_id = 1;
+
+  {
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < num_tiles; ++i) {
+      platefile.write_request();
+      platefile.write_update(data, tile_size, i % width, i / width, level, transaction_id);
+      platefile.write_complete();
+    }
+    sw.stop();
+    report("lock per tile", num_tiles, sw);
+  }
+
+  ++transaction_id;
+  {
+    Stopwatch sw;
+    sw.start();
+    platefile.write_request();
+    for (int i = 0; i < num_tiles; ++i)
+      platefile.write_update(data, tile_size, i % width, i / width, level, transaction_id);
+    platefile.write_complete();
+    sw.stop();
+    report("single lock", num_tiles, sw);
+  }
+
+  static const WriteDurability durabilities[] = { WRITE_DURABILITY_NONE, WRITE_DURABILITY_BATCH,
+                                                  WRITE_DURABILITY_SYNC };
+  static const char* durability_names[] = { "batch (none)", "batch (group commit)", "batch (sync)" };
+  for (int d = 0; d < 3; ++d) {
+    ++transaction_id;
+    Stopwatch sw;
+    sw.start();
+    std::vector<RawTile> batch;
+    for (int i = 0; i < num_tiles; ++i) {
+      batch.push_back(RawTile(data, tile_size, i % width, i / width, level, transaction_id));
+      if (int(batch.size()) == batch_size || i == num_tiles - 1) {
+        platefile.write_batch(batch, durabilities[d]);
+        batch.clear();
+      }
+    }
+    sw.stop();
+    report(durability_names[d], num_tiles, sw);
+  }
+
+  boost::filesystem::remove_all(url);
+  return 0;
+}
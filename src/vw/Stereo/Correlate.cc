@@ -18,8 +18,11 @@
 #include <vw/Image/Filter.h>
 #include <cmath>
 #include <ctime>
+#include <vector>
 #include <vw/FileIO.h>
 
+#include <boost/thread/tss.hpp>
+
 namespace vw {
   namespace stereo {
 
@@ -183,57 +186,222 @@ namespace vw {
     }
 
 
-    inline int
-    adjust_weight_image(ImageView<float> &weight,
-                        ImageView<PixelMask<Vector2f> > const& disparity_map_patch,
-                        ImageView<float> const& weight_template) {
-
-      //    const float continuity_threshold_squared = 64;  // T = 8
-      int center_pix_x = weight_template.cols()/2;
-      int center_pix_y = weight_template.rows()/2;
-      PixelMask<Vector2f> center_pix = disparity_map_patch(center_pix_x, center_pix_y);
-
-      float sum = 0;
-      int num_good_pix = 0;
-      ImageView<float>::pixel_accessor weight_row_acc = weight.origin();
-      ImageView<float>::pixel_accessor template_row_acc = weight_template.origin();
-      ImageView<PixelMask<Vector2f> >::pixel_accessor disp_row_acc = disparity_map_patch.origin();
-      for (int j = 0; j < weight_template.rows(); ++j) {
-        ImageView<float>::pixel_accessor weight_col_acc = weight_row_acc;
-        ImageView<float>::pixel_accessor template_col_acc = template_row_acc;
-        ImageView<PixelMask<Vector2f> >::pixel_accessor disp_col_acc = disp_row_acc;
-        for (int i = 0; i < weight_template.cols(); ++i ) {
-
-          // Mask is zero if the disparity map's pixel is missing...
-          if ( !is_valid(*disp_col_acc) )
-            *weight_col_acc = 0;
-
-          // ... or if there is a large discontinuity ...
-          //         if (pow( (*disp_col_acc).h()-center_pix.h(),2) + pow( (*disp_col_acc).v()-center_pix.v(),2) >= continuity_threshold_squared)
-          //           *weight_col_acc = 0;
-
-          // ... otherwise we use the weight from the weight template
-          else {
-            *weight_col_acc = *template_col_acc;
-            sum += *weight_col_acc;
-            ++num_good_pix;
+    // Samples image at (i,j) exactly as interpolate(image,
+    // BilinearInterpolation(), ZeroEdgeExtension()) would, but without
+    // going through the views.
+    template <class ChannelT>
+    inline float bilinear_sample(ImageView<ChannelT> const& image, double i, double j) {
+      typedef typename FloatType<ChannelT>::type real_type;
+      int32 x = math::impl::_floor(i), y = math::impl::_floor(j);
+      real_type normx = i-x, normy = j-y, norm1mx = 1-normx, norm1my = 1-normy;
+
+      real_type p00, p10, p01, p11;
+      if (x >= 0 && y >= 0 && x+1 < image.cols() && y+1 < image.rows()) {
+        ChannelT const* row0 = &image(x,y);
+        ChannelT const* row1 = &image(x,y+1);
+        p00 = row0[0]; p10 = row0[1];
+        p01 = row1[0]; p11 = row1[1];
+      } else {
+        ZeroEdgeExtension edge;
+        p00 = edge(image, x, y, 0);   p10 = edge(image, x+1, y, 0);
+        p01 = edge(image, x, y+1, 0); p11 = edge(image, x+1, y+1, 0);
+      }
+
+      real_type result = p00 * norm1mx;
+      result += p10 * normx;
+      result *= norm1my;
+      real_type row = p01 * norm1mx;
+      row += p11 * normx;
+      result += row * normy;
+      return channel_cast_round_if_int<ChannelT>(result);
+    }
+
+    // Working storage for the affine refiners.  The window around each
+    // pixel is copied into contiguous buffers once, and the per-pixel
+    // terms of the update are then computed a whole window at a time by
+    // straight loops over those buffers, rather than through crop and
+    // interpolation views.  Each thread keeps one of these (see
+    // affine_subpixel_scratch() below) and reuses it for every pixel of
+    // every tile it refines, so nothing is allocated per pixel.
+    struct AffineSubpixelScratch {
+      int kern_width, kern_height;
+
+      // One entry per pixel of the window, in row major order.  The
+      // window spans offsets [-width/2, width - width/2) from its center
+      // pixel in x, and likewise in y, so even sizes fit as well.
+      std::vector<float> left, I_x, I_y;  // Filtered left image and its derivatives
+      std::vector<float> w;               // Spatial weights
+      std::vector<float> right;           // Right image resampled through the current affine transform
+      std::vector<float> error;           // right - left
+      std::vector<float> weight;          // Combined robust and spatial weights
+      std::vector<float> residual, gamma_plane, gamma_noise;  // Used by the EM refiner
+
+      AffineSubpixelScratch() : kern_width(0), kern_height(0) {}
+
+      void resize(int width, int height) {
+        kern_width = width;
+        kern_height = height;
+        size_t n = width * height;
+        left.resize(n); I_x.resize(n); I_y.resize(n); w.resize(n);
+        right.resize(n); error.resize(n); weight.resize(n);
+        residual.resize(n); gamma_plane.resize(n); gamma_noise.resize(n);
+      }
+
+      int size() const { return kern_width * kern_height; }
+
+      // Copies the window centered on (x,y) out of the filtered left
+      // image and its derivatives.
+      template <class ChannelT>
+      void load(ImageView<ChannelT> const& left_image, ImageView<float> const& x_deriv,
+                ImageView<float> const& y_deriv, int x, int y) {
+        int x0 = x - kern_width/2, y0 = y - kern_height/2;
+        for (int j = 0, k = 0; j < kern_height; ++j) {
+          ChannelT const* left_row = &left_image(x0, y0+j);
+          float const* I_x_row = &x_deriv(x0, y0+j);
+          float const* I_y_row = &y_deriv(x0, y0+j);
+          for (int i = 0; i < kern_width; ++i, ++k) {
+            left[k] = left_row[i];
+            I_x[k] = I_x_row[i];
+            I_y[k] = I_y_row[i];
+          }
+        }
+      }
+
+      // Fills in w from weight_template, zeroing the weights of pixels
+      // around (x,y) that have no disparity, and normalizes it.
+      // Returns the number of pixels that do have a disparity.
+      int adjust_weights(ImageView<PixelMask<Vector2f> > const& disparity_map, int x, int y,
+                         ImageView<float> const& weight_template) {
+        int x0 = x - kern_width/2, y0 = y - kern_height/2;
+        float sum = 0;
+        int num_good_pix = 0;
+        for (int j = 0, k = 0; j < kern_height; ++j) {
+          PixelMask<Vector2f> const* disp_row = &disparity_map(x0, y0+j);
+          float const* template_row = &weight_template(0, j);
+          for (int i = 0; i < kern_width; ++i, ++k) {
+            if ( !is_valid(disp_row[i]) ) {
+              w[k] = 0;
+            } else {
+              w[k] = template_row[i];
+              sum += w[k];
+              ++num_good_pix;
+            }
+          }
+        }
+
+        if (sum == 0)
+          vw_throw(LogicErr() << "subpixel_weight: Sum of weight image was zero.  This isn't supposed to happen!");
+        for (int k = 0; k < size(); ++k)
+          w[k] /= sum;
+        return num_good_pix;
+      }
+
+      // Samples the right image at the pixels of the window under the
+      // affine transform d, relative to (x_base,y_base).
+      template <class ChannelT>
+      void resample(ImageView<ChannelT> const& right_image, float x_base, float y_base,
+                    Vector<float,6> const& d) {
+        int kern_half_width = kern_width/2, kern_half_height = kern_height/2;
+        int k = 0;
+        for (int jj = -kern_half_height; jj < kern_height - kern_half_height; ++jj) {
+          for (int ii = -kern_half_width; ii < kern_width - kern_half_width; ++ii, ++k) {
+            float xx = x_base + d[0] * ii + d[1] * jj + d[2];
+            float yy = y_base + d[3] * ii + d[4] * jj + d[5];
+            right[k] = bilinear_sample(right_image, xx, yy);
           }
+        }
+      }
 
-          disp_col_acc.next_col();
-          weight_col_acc.next_col();
-          template_col_acc.next_col();
+      // Builds the normal equations for an update to the affine
+      // transform from the per-pixel weights and errors, and solves
+      // them.  The update is returned in lhs.
+      void solve_update(Vector<float,6> &lhs) const {
+        Matrix<float,6,6> rhs;
+        for (int i = 0; i < 6; ++i)
+          lhs(i) = 0.0;
+
+        int kern_half_width = kern_width/2, kern_half_height = kern_height/2;
+        int k = 0;
+        for (int jj = -kern_half_height; jj < kern_height - kern_half_height; ++jj) {
+          for (int ii = -kern_half_width; ii < kern_width - kern_half_width; ++ii, ++k) {
+            float I_e_val = error[k];
+            float I_x_val = weight[k] * I_x[k];
+            float I_y_val = weight[k] * I_y[k];
+            float I_x_sqr = I_x_val * I_x[k];
+            float I_y_sqr = I_y_val * I_y[k];
+            float I_x_I_y = I_x_val * I_y[k];
+
+            // Left hand side
+            lhs(0) += ii * I_x_val * I_e_val;
+            lhs(1) += jj * I_x_val * I_e_val;
+            lhs(2) +=      I_x_val * I_e_val;
+            lhs(3) += ii * I_y_val * I_e_val;
+            lhs(4) += jj * I_y_val * I_e_val;
+            lhs(5) +=      I_y_val * I_e_val;
+
+            // Right Hand Side UL
+            rhs(0,0) += ii*ii * I_x_sqr;
+            rhs(0,1) += ii*jj * I_x_sqr;
+            rhs(0,2) += ii    * I_x_sqr;
+            rhs(1,1) += jj*jj * I_x_sqr;
+            rhs(1,2) += jj    * I_x_sqr;
+            rhs(2,2) +=         I_x_sqr;
+
+            // Right Hand Side UR
+            rhs(0,3) += ii*ii * I_x_I_y;
+            rhs(0,4) += ii*jj * I_x_I_y;
+            rhs(0,5) += ii    * I_x_I_y;
+            rhs(1,4) += jj*jj * I_x_I_y;
+            rhs(1,5) += jj    * I_x_I_y;
+            rhs(2,5) +=         I_x_I_y;
+
+            // Right Hand Side LR
+            rhs(3,3) += ii*ii * I_y_sqr;
+            rhs(3,4) += ii*jj * I_y_sqr;
+            rhs(3,5) += ii    * I_y_sqr;
+            rhs(4,4) += jj*jj * I_y_sqr;
+            rhs(4,5) += jj    * I_y_sqr;
+            rhs(5,5) +=         I_y_sqr;
+          }
         }
-        disp_row_acc.next_row();
-        weight_row_acc.next_row();
-        template_row_acc.next_row();
+        lhs *= -1;
+
+        // Fill in symmetric entries
+        rhs(1,0) = rhs(0,1);
+        rhs(2,0) = rhs(0,2);
+        rhs(2,1) = rhs(1,2);
+        rhs(1,3) = rhs(0,4);
+        rhs(2,3) = rhs(0,5);
+        rhs(2,4) = rhs(1,5);
+        rhs(3,0) = rhs(0,3);
+        rhs(3,1) = rhs(1,3);
+        rhs(3,2) = rhs(2,3);
+        rhs(4,0) = rhs(0,4);
+        rhs(4,1) = rhs(1,4);
+        rhs(4,2) = rhs(2,4);
+        rhs(4,3) = rhs(3,4);
+        rhs(5,0) = rhs(0,5);
+        rhs(5,1) = rhs(1,5);
+        rhs(5,2) = rhs(2,5);
+        rhs(5,3) = rhs(3,5);
+        rhs(5,4) = rhs(4,5);
+
+        // Solves lhs = rhs * x, and stores the result in-place in lhs.
+        // A singular system leaves lhs as it was.
+        try {
+          solve_symmetric_nocopy(rhs,lhs);
+        } catch (ArgumentErr &/*e*/) {}
       }
+    };
 
-      // Normalize the weight image
-      if (sum == 0)
-        vw_throw(LogicErr() << "subpixel_weight: Sum of weight image was zero.  This isn't supposed to happen!");
-      else
-        weight /= sum;
-      return num_good_pix;
+    static boost::thread_specific_ptr<AffineSubpixelScratch> affine_subpixel_scratch_ptr;
+
+    // Returns this thread's scratch space, sized for the given kernel.
+    static AffineSubpixelScratch& affine_subpixel_scratch(int kern_width, int kern_height) {
+      if (!affine_subpixel_scratch_ptr.get())
+        affine_subpixel_scratch_ptr.reset(new AffineSubpixelScratch());
+      affine_subpixel_scratch_ptr->resize(kern_width, kern_height);
+      return *affine_subpixel_scratch_ptr;
     }
 
 
@@ -273,10 +441,6 @@ namespace vw {
         int kern_half_height = kern_height/2;
         int kern_half_width = kern_width/2;
 
-        // Robust cost function settings
-        const float thresh = 0.01;
-        HuberError robust_cost_fn(thresh);
-
         int kern_pixels = kern_height * kern_width;
         int weight_threshold = kern_pixels / 2;
 
@@ -286,10 +450,7 @@ namespace vw {
         ImageView<float> x_deriv = derivative_filter(left_image, 1, 0);
         ImageView<float> y_deriv = derivative_filter(left_image, 0, 1);
         ImageView<float> weight_template = compute_gaussian_weight_image(kern_width, kern_height);
-
-        // Workspace images are allocated up here out of the tight inner
-        // loop.  We rasterize into these directly in the code below.
-        ImageView<float> w(kern_width, kern_height);
+        AffineSubpixelScratch &scratch = affine_subpixel_scratch(kern_width, kern_height);
 
         // Iterate over all of the pixels in the disparity map except for
         // the outer edges.
@@ -311,9 +472,6 @@ namespace vw {
           for ( int x = kern_half_width;
                 x < left_image.cols()-kern_half_width; ++x) {
 
-            BBox2i current_window(x-kern_half_width, y-kern_half_height, kern_width, kern_height);
-            Vector2f base_offset(-disparity_map(x,y).child());
-
             // Skip over pixels for which we have no initial disparity estimate
             if ( !is_valid(disparity_map(x,y)) )
               continue;
@@ -329,13 +487,10 @@ namespace vw {
             d(0) = 1.0;
             d(4) = 1.0;
 
-            // Compute the derivative image patches
-            CropView<ImageView<ChannelT> > left_image_patch = crop(left_image, current_window);
-            CropView<ImageView<float> > I_x = crop(x_deriv, current_window);
-            CropView<ImageView<float> > I_y = crop(y_deriv, current_window);
-
-            // Compute the base weight image
-            int good_pixels = adjust_weight_image(w, crop(disparity_map, current_window), weight_template);
+            // Copy out the image and derivative patches, and compute the
+            // base weight image
+            scratch.load(left_image, x_deriv, y_deriv, x, y);
+            int good_pixels = scratch.adjust_weights(disparity_map, x, y, weight_template);
 
             // Skip over pixels for which there are very few good matches
             // in the neighborhood.
@@ -354,141 +509,27 @@ namespace vw {
               if (norm_2( Vector<float,2>(d[2],d[5]) ) > AFFINE_SUBPIXEL_MAX_TRANSLATION)
                 break;
 
-              InterpolationView<EdgeExtensionView<ImageView<ChannelT>, ZeroEdgeExtension>, BilinearInterpolation> right_interp_image =
-                interpolate(right_image, BilinearInterpolation(), ZeroEdgeExtension());
-
               float x_base = x + disparity_map(x,y)[0];
               float y_base = y + disparity_map(x,y)[1];
+              scratch.resample(right_image, x_base, y_base, d);
+
+              // Apply the robust cost function.  We use a cauchy
+              // function to gently remove outliers for small errors.
+              // Cauchy seems to work well with thresh ~= 1e-4
+              float thresh = 1e-3;
+              for (int k = 0; k < kern_pixels; ++k) {
+                float I_e_val = scratch.right[k] - scratch.left[k] + 1e-16;
+                float error_value = fabsf(I_e_val);
+                float robust_weight = sqrtf(cauchy_robust_coefficient(error_value,thresh))/error_value;
+
+                // We combine the error value with the derivative and
+                // add this to the update equation.
+                scratch.error[k] = I_e_val;
+                scratch.weight[k] = robust_weight * scratch.w[k];
+              }
 
-              Matrix<float,6,6> rhs;
               Vector<float,6> lhs;
-
-              // Set up pixel accessors
-              typename ImageView<float>::pixel_accessor w_row = w.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_x_row = I_x.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_y_row = I_y.origin();
-              typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_row = left_image_patch.origin();
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-                  float I_e_val = right_interp_image(xx,yy) - (*left_image_patch_ptr) + 1e-16;
-                  //              error_total += pow(I_e_val,2);
-
-                  // Apply the robust cost function.  We use a cauchy
-                  // function to gently remove outliers for small errors.
-                  float thresh = 1e-3;
-
-                  // Cauchy seems to work well with thresh ~= 1e-4
-                  float error_value = fabsf(I_e_val);
-                  float robust_weight = sqrtf(cauchy_robust_coefficient(error_value,thresh))/error_value;
-
-
-                  // Huber seems to work well with thresh >= 1e-5
-                  //        float robust_weight = sqrt(huber_robust_coefficient(fabs(I_e_val),thresh))/fabs(I_e_val);
-
-                  // Disable robust cost function altogether
-                  //        float robust_weight = 1;
-
-                  // We combine the error value with the derivative and
-                  // add this to the update equation.
-                  float weight = robust_weight *(*w_ptr);
-                  //float weight = robust_weight;// *(*w_ptr);
-                  float I_x_val = weight * (*I_x_ptr);
-                  float I_y_val = weight * (*I_y_ptr);
-                  float I_x_sqr = I_x_val * (*I_x_ptr);
-                  float I_y_sqr = I_y_val * (*I_y_ptr);
-                  float I_x_I_y = I_x_val * (*I_y_ptr);
-
-                  // Left hand side
-                  lhs(0) += ii * I_x_val * I_e_val;
-                  lhs(1) += jj * I_x_val * I_e_val;
-                  lhs(2) +=      I_x_val * I_e_val;
-                  lhs(3) += ii * I_y_val * I_e_val;
-                  lhs(4) += jj * I_y_val * I_e_val;
-                  lhs(5) +=      I_y_val * I_e_val;
-
-                  // Right Hand Side UL
-                  rhs(0,0) += ii*ii * I_x_sqr;
-                  rhs(0,1) += ii*jj * I_x_sqr;
-                  rhs(0,2) += ii    * I_x_sqr;
-                  rhs(1,1) += jj*jj * I_x_sqr;
-                  rhs(1,2) += jj    * I_x_sqr;
-                  rhs(2,2) +=         I_x_sqr;
-
-                  // Right Hand Side UR
-                  rhs(0,3) += ii*ii * I_x_I_y;
-                  rhs(0,4) += ii*jj * I_x_I_y;
-                  rhs(0,5) += ii    * I_x_I_y;
-                  rhs(1,4) += jj*jj * I_x_I_y;
-                  rhs(1,5) += jj    * I_x_I_y;
-                  rhs(2,5) +=         I_x_I_y;
-
-                  // Right Hand Side LR
-                  rhs(3,3) += ii*ii * I_y_sqr;
-                  rhs(3,4) += ii*jj * I_y_sqr;
-                  rhs(3,5) += ii    * I_y_sqr;
-                  rhs(4,4) += jj*jj * I_y_sqr;
-                  rhs(4,5) += jj    * I_y_sqr;
-                  rhs(5,5) +=         I_y_sqr;
-
-                  w_ptr.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
-                }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
-              }
-              lhs *= -1;
-
-              // Fill in symmetric entries
-              rhs(1,0) = rhs(0,1);
-              rhs(2,0) = rhs(0,2);
-              rhs(2,1) = rhs(1,2);
-              rhs(1,3) = rhs(0,4);
-              rhs(2,3) = rhs(0,5);
-              rhs(2,4) = rhs(1,5);
-              rhs(3,0) = rhs(0,3);
-              rhs(3,1) = rhs(1,3);
-              rhs(3,2) = rhs(2,3);
-              rhs(4,0) = rhs(0,4);
-              rhs(4,1) = rhs(1,4);
-              rhs(4,2) = rhs(2,4);
-              rhs(4,3) = rhs(3,4);
-              rhs(5,0) = rhs(0,5);
-              rhs(5,1) = rhs(1,5);
-              rhs(5,2) = rhs(2,5);
-              rhs(5,3) = rhs(3,5);
-              rhs(5,4) = rhs(4,5);
-
-              // Solves lhs = rhs * x, and stores the result in-place in lhs.
-              //           Matrix<double,6,6> pre_rhs = rhs;
-              //           Vector<double,6> pre_lhs = lhs;
-              try {
-                solve_symmetric_nocopy(rhs,lhs);
-              } catch (ArgumentErr &/*e*/) {
-                //             std::cout << "Error @ " << x << " " << y << "\n";
-                //             std::cout << "Exception caught: " << e.what() << "\n";
-                //             std::cout << "PRERHS: " << pre_rhs << "\n";
-                //             std::cout << "PRELHS: " << pre_lhs << "\n\n";
-                //             std::cout << "RHS: " << rhs << "\n";
-                //             std::cout << "LHS: " << lhs << "\n\n";
-                //             std::cout << "DEBUG: " << rhs(0,1) << "   " << rhs(1,0) << "\n\n";
-                //             exit(0);
-              }
+              scratch.solve_update(lhs);
               d += lhs;
 
               // Termination condition
@@ -533,14 +574,9 @@ namespace vw {
         // This is the maximum number of pixels that the solution can be
         // adjusted by affine subpixel refinement.
         float AFFINE_SUBPIXEL_MAX_TRANSLATION = kern_width/2;
-        //float AFFINE_SUBPIXEL_MAX_TRANSLATION = kern_width;
         int kern_half_height = kern_height/2;
         int kern_half_width = kern_width/2;
 
-        // Robust cost function settings
-        //const float thresh = 0.01;
-        //HuberError robust_cost_fn(thresh);
-
         int kern_pixels = kern_height * kern_width;
         int weight_threshold = kern_pixels / 2;
 
@@ -550,10 +586,7 @@ namespace vw {
         ImageView<float> x_deriv = derivative_filter(left_image, 1, 0);
         ImageView<float> y_deriv = derivative_filter(left_image, 0, 1);
         ImageView<float> weight_template = compute_gaussian_weight_image(kern_width, kern_height);
-
-        // Workspace images are allocated up here out of the tight inner
-        // loop.  We rasterize into these directly in the code below.
-        ImageView<float> w(kern_width, kern_height);
+        AffineSubpixelScratch &scratch = affine_subpixel_scratch(kern_width, kern_height);
 
         // Iterate over all of the pixels in the disparity map except for
         // the outer edges.
@@ -569,14 +602,8 @@ namespace vw {
             last_time = sw.elapsed_seconds();
             sw.start();
           }
-          // For debugging:
-          // for (int x=279; x<280; ++x) {
           for (int x=kern_half_width; x<left_image.cols()-kern_half_width; ++x) {
 
-
-            BBox2i current_window(x-kern_half_width, y-kern_half_height, kern_width, kern_height);
-            Vector2 base_offset(-disparity_map(x,y).child());
-
             // Skip over pixels for which we have no initial disparity estimate
             if ( !is_valid(disparity_map(x,y)) )
               continue;
@@ -592,13 +619,10 @@ namespace vw {
             d(0) = 1.0;
             d(4) = 1.0;
 
-            // Compute the derivative image patches
-            CropView<ImageView<ChannelT> > left_image_patch = crop(left_image, current_window);
-            CropView<ImageView<float> > I_x = crop(x_deriv, current_window);
-            CropView<ImageView<float> > I_y = crop(y_deriv, current_window);
-
-            // Compute the base weight image
-            int good_pixels = adjust_weight_image(w, crop(disparity_map, current_window), weight_template);
+            // Copy out the image and derivative patches, and compute the
+            // base weight image
+            scratch.load(left_image, x_deriv, y_deriv, x, y);
+            int good_pixels = scratch.adjust_weights(disparity_map, x, y, weight_template);
 
             // Skip over pixels for which there are very few good matches
             // in the neighborhood.
@@ -620,220 +644,34 @@ namespace vw {
               if (norm_2( Vector<float,2>(d[2],d[5]) ) > AFFINE_SUBPIXEL_MAX_TRANSLATION)
                 break;
 
-              InterpolationView<EdgeExtensionView<ImageView<ChannelT>, ZeroEdgeExtension>, BilinearInterpolation> right_interp_image =
-                interpolate(right_image, BilinearInterpolation(), ZeroEdgeExtension());
-
               float x_base = x + disparity_map(x,y)[0];
               float y_base = y + disparity_map(x,y)[1];
-              //          float error_total = 0;
+              scratch.resample(right_image, x_base, y_base, d);
 
-              Matrix<float,6,6> rhs;
-              Vector<float,6> lhs;
-
-              ImageView<float> ll_value(kern_width, kern_height);
+              // Each pixel is weighted by the likelihood of its error
+              // under Gaussian noise, normalized over the window.
+              float two_sigma_2 = 1e-4;
               float sum_error_value = 0;
-              float mean_l = 0.0;
-              float mean_r = 0.0;
-
-              // Set up pixel accessors
-              typename ImageView<float>::pixel_accessor w_row = w.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_x_row = I_x.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_y_row = I_y.origin();
-              typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_row = left_image_patch.origin();
-
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-                  float I_e_val = right_interp_image(xx,yy) - (*left_image_patch_ptr);// + 1e-16;
-                  //              error_total += pow(I_e_val,2);
-
-                  // Apply the robust cost function.  We use a huber
-                  // function to gently remove outliers for small errors,
-                  // but we set a hard limit a 5 times the cost threshold
-                  // to remove major (salt&pepper) noise.
-                  //float thresh = 1e-3;
-
-                  float two_sigma_2 = 1e-4;//1e-3;//1e-4;//1e-5;//1e-6;
-
-                  ll_value(jj+kern_half_height, ii+kern_half_width) =  exp(-1*(I_e_val*I_e_val)/two_sigma_2);
-                  sum_error_value = sum_error_value + ll_value(jj+kern_half_height, ii+kern_half_width);
-
-                  mean_l = mean_l + (*left_image_patch_ptr);
-                  mean_r = mean_r + right_interp_image(xx,yy);
-                  //printf("I_e_val = %f, ll_val = %f, kern_half_height = %d, kern_half_width = %d, sum_error_value = %f\n",
-                  //             I_e_val,  ll_value(jj+kern_half_height, ii+kern_half_width), kern_half_height, kern_half_width, sum_error_value);
-
-                  w_ptr.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
-                }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
-
+              for (int k = 0; k < kern_pixels; ++k) {
+                float I_e_val = scratch.right[k] - scratch.left[k];
+                scratch.error[k] = I_e_val;
+                scratch.weight[k] = exp(-1*(I_e_val*I_e_val)/two_sigma_2);
+                sum_error_value = sum_error_value + scratch.weight[k];
               }
 
-              mean_r = mean_r/(kern_width*kern_height);
-              mean_l = mean_l/(kern_width*kern_height);
-              //printf("mean_l = %f, mean_r = %f\n", mean_l, mean_r);
-
-              // Set up pixel accessors
-              w_row = w.origin();
-              I_x_row = I_x.origin();
-              I_y_row = I_y.origin();
-              left_image_patch_row = left_image_patch.origin();
-
               curr_sum_I_e_val = 0.0;
-              //prev_sum_I_e_val = 0.0;
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-                  float I_e_val = right_interp_image(xx,yy) - (*left_image_patch_ptr);
-                  curr_sum_I_e_val = curr_sum_I_e_val + I_e_val;
-
-                  float robust_weight = ll_value(jj+kern_half_height, ii+kern_half_width)/sum_error_value;
-
-
-                  // Disable robust cost function altogether
-                  //        float robust_weight = 1;
-                  // float two_sigma_2 = 1e-5;//1e-4;//1e-5;//1e-6;
-                  // float tmp_l = (*left_image_patch_ptr) -mean_l;
-                  // float tmp_r = right_interp_image(xx,yy)-mean_r;
-                  //              float ll = exp(-1*((tmp_l*tmp_l) + (tmp_r*tmp_r))/two_sigma_2);
-
-
-                  // We combine the error value with the derivative and
-                  // add this to the update equation.
-                  float weight = robust_weight*(*w_ptr);//*ll;
-                  float I_x_val = weight * (*I_x_ptr);
-                  float I_y_val = weight * (*I_y_ptr);
-                  float I_x_sqr = I_x_val * (*I_x_ptr);
-                  float I_y_sqr = I_y_val * (*I_y_ptr);
-                  float I_x_I_y = I_x_val * (*I_y_ptr);
-
-                  // Left hand side
-                  lhs(0) += ii * I_x_val * I_e_val;
-                  lhs(1) += jj * I_x_val * I_e_val;
-                  lhs(2) +=      I_x_val * I_e_val;
-                  lhs(3) += ii * I_y_val * I_e_val;
-                  lhs(4) += jj * I_y_val * I_e_val;
-                  lhs(5) +=      I_y_val * I_e_val;
-
-                  // Right Hand Side UL
-                  rhs(0,0) += ii*ii * I_x_sqr;
-                  rhs(0,1) += ii*jj * I_x_sqr;
-                  rhs(0,2) += ii    * I_x_sqr;
-                  rhs(1,1) += jj*jj * I_x_sqr;
-                  rhs(1,2) += jj    * I_x_sqr;
-                  rhs(2,2) +=         I_x_sqr;
-
-                  // Right Hand Side UR
-                  rhs(0,3) += ii*ii * I_x_I_y;
-                  rhs(0,4) += ii*jj * I_x_I_y;
-                  rhs(0,5) += ii    * I_x_I_y;
-                  rhs(1,4) += jj*jj * I_x_I_y;
-                  rhs(1,5) += jj    * I_x_I_y;
-                  rhs(2,5) +=         I_x_I_y;
-
-                  // Right Hand Side LR
-                  rhs(3,3) += ii*ii * I_y_sqr;
-                  rhs(3,4) += ii*jj * I_y_sqr;
-                  rhs(3,5) += ii    * I_y_sqr;
-                  rhs(4,4) += jj*jj * I_y_sqr;
-                  rhs(4,5) += jj    * I_y_sqr;
-                  rhs(5,5) +=         I_y_sqr;
-
-                  w_ptr.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
-                }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
-              }
-              lhs *= -1;
-
-              // Fill in symmetric entries
-              rhs(1,0) = rhs(0,1);
-              rhs(2,0) = rhs(0,2);
-              rhs(2,1) = rhs(1,2);
-              rhs(1,3) = rhs(0,4);
-              rhs(2,3) = rhs(0,5);
-              rhs(2,4) = rhs(1,5);
-              rhs(3,0) = rhs(0,3);
-              rhs(3,1) = rhs(1,3);
-              rhs(3,2) = rhs(2,3);
-              rhs(4,0) = rhs(0,4);
-              rhs(4,1) = rhs(1,4);
-              rhs(4,2) = rhs(2,4);
-              rhs(4,3) = rhs(3,4);
-              rhs(5,0) = rhs(0,5);
-              rhs(5,1) = rhs(1,5);
-              rhs(5,2) = rhs(2,5);
-              rhs(5,3) = rhs(3,5);
-              rhs(5,4) = rhs(4,5);
-
-
-              //           if (y == 270) {
-              //                       ImageView<ChannelT> right_image_patch(kern_width, kern_height);
-              //                       for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-              //                         for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-              //                           float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-              //                           float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-              //                           right_image_patch(ii+kern_half_width, jj+kern_half_width) = right_interp_image(xx,yy);
-              //                         }
-              //                       }
-              //                       std::ostringstream ostr;
-              //                       ostr << x << "_" << y << "_" << int(blur_sigma) << "_" << iter;
-              //                       write_image("small/left-"+ostr.str()+".tif", left_image_patch);
-              //                       write_image("small/right-"+ostr.str()+".tif", right_image_patch);
-              //                       write_image("small/weight-"+ostr.str()+".tif", w);
-              //                     }
-
-
-              // Solves lhs = rhs * x, and stores the result in-place in lhs.
-              //           Matrix<double,6,6> pre_rhs = rhs;
-              //           Vector<double,6> pre_lhs = lhs;
-              try {
-                solve_symmetric_nocopy(rhs,lhs);
-              } catch (ArgumentErr &/*e*/) {
-                //             std::cout << "Error @ " << x << " " << y << "\n";
-                //             std::cout << "Exception caught: " << e.what() << "\n";
-                //             std::cout << "PRERHS: " << pre_rhs << "\n";
-                //             std::cout << "PRELHS: " << pre_lhs << "\n\n";
-                //             std::cout << "RHS: " << rhs << "\n";
-                //             std::cout << "LHS: " << lhs << "\n\n";
-                //             std::cout << "DEBUG: " << rhs(0,1) << "   " << rhs(1,0) << "\n\n";
-                //             exit(0);
+              for (int k = 0; k < kern_pixels; ++k) {
+                curr_sum_I_e_val = curr_sum_I_e_val + scratch.error[k];
+
+                // We combine the error value with the derivative and
+                // add this to the update equation.
+                float robust_weight = scratch.weight[k]/sum_error_value;
+                scratch.weight[k] = robust_weight*scratch.w[k];
               }
-              d += lhs;
 
-              //           if (y == 270)
-              //             std::cout << "Update: " << lhs << "     " << d << "     " << sqrt(error_total) << "    " << (sqrt(lhs[2]*lhs[2]+lhs[5]*lhs[5])) << "\n";
+              Vector<float,6> lhs;
+              scratch.solve_update(lhs);
+              d += lhs;
 
               if (curr_sum_I_e_val < 0){
                 curr_sum_I_e_val = - curr_sum_I_e_val;
@@ -846,11 +684,7 @@ namespace vw {
               else{
                 prev_sum_I_e_val = curr_sum_I_e_val;
               }
-
-              //if (norm_2(lhs) < 0.01)
-              //  break;
             }
-            //         std::cout << "----> " << d << "\n\n";
 
             if ( norm_2( Vector2f(d[2],d[5]) ) > AFFINE_SUBPIXEL_MAX_TRANSLATION ||
                  d[2] != d[2] ||  // Check to make sure the offset is not NaN...
@@ -860,9 +694,7 @@ namespace vw {
               disparity_map(x,y)[0] += d[2];
               disparity_map(x,y)[1] += d[5];
             }
-            //printf("iter = %d, curr_sum_I_e_val = %d\n", iter, curr_sum_I_e_val);
           }
-          //printf("iter = %d, curr_sum_I_e_val = %d\n", iter, curr_sum_I_e_val);
         }
 
       }
@@ -896,17 +728,10 @@ namespace vw {
                  disparity_map.rows() == left_input_image.rows(),
                  ArgumentErr() << "subpixel_correlation: left image and disparity map do not have the same dimensions.");
 
-      ImageView<float> confidence_image (left_input_image.cols(),
-                                         left_input_image.rows());
-
       // Input Image
       ImageView<ChannelT> left_image = LogStereoPreprocessingFilter(blur_sigma)(left_input_image);
       ImageView<ChannelT> right_image = LogStereoPreprocessingFilter(blur_sigma)(right_input_image);
 
-      // Interpolated Input Images
-      InterpolationView<EdgeExtensionView<ImageView<ChannelT>, ZeroEdgeExtension>, BilinearInterpolation> right_interp_image =
-              interpolate(right_image, BilinearInterpolation(), ZeroEdgeExtension());
-
       // This is the maximum number of pixels that the solution can be
       // adjusted by affine subpixel refinement.
       float AFFINE_SUBPIXEL_MAX_TRANSLATION = kern_width/2;
@@ -919,10 +744,7 @@ namespace vw {
       ImageView<float> x_deriv = derivative_filter(left_image, 1, 0);
       ImageView<float> y_deriv = derivative_filter(left_image, 0, 1);
       ImageView<float> weight_template = compute_spatial_weight_image(kern_width, kern_height, two_sigma_sqr);
-
-      // Workspace images are allocated up here out of the tight inner
-      // loop.  We rasterize into these directly in the code below.
-      ImageView<float> w(kern_width, kern_height);
+      AffineSubpixelScratch &scratch = affine_subpixel_scratch(kern_width, kern_height);
 
       // Iterate over all of the pixels in the disparity map except for
       // the outer edges.
@@ -934,10 +756,6 @@ namespace vw {
              x<std::min<int>(left_image.cols()-kern_half_width, region_of_interest.max().x()+1);
              ++x) {
 
-          BBox2i current_window(x-kern_half_width, y-kern_half_height,
-                                kern_width, kern_height);
-          Vector2 base_offset( -disparity_map(x,y).child() );
-
           // Skip over pixels for which we have no initial disparity estimate
           if ( !is_valid(disparity_map(x,y)) )
             continue;
@@ -958,13 +776,10 @@ namespace vw {
           d(4) = 1.0;
           d(5) = 0.0;
 
-          // Compute the derivative image patches
-          CropView<ImageView<ChannelT> > left_image_patch = crop(left_image, current_window);
-          CropView<ImageView<float> > I_x = crop(x_deriv, current_window);
-          CropView<ImageView<float> > I_y = crop(y_deriv, current_window);
-
-          // Compute the base weight image
-          int good_pixels = adjust_weight_image(w, crop(disparity_map, current_window), weight_template);
+          // Copy out the image and derivative patches, and compute the
+          // base weight image
+          scratch.load(left_image, x_deriv, y_deriv, x, y);
+          int good_pixels = scratch.adjust_weights(disparity_map, x, y, weight_template);
 
           // Skip over pixels for which there are very few good matches
           // in the neighborhood.
@@ -986,17 +801,21 @@ namespace vw {
             if (norm_2( Vector<float,2>(d[2],d[5]) ) > AFFINE_SUBPIXEL_MAX_TRANSLATION)
               break;
 
+            // d stays put through the EM iterations below, so the right
+            // image only needs to be resampled once per iteration here.
             float x_base = x + disparity_map(x,y)[0];
             float y_base = y + disparity_map(x,y)[1];
+            scratch.resample(right_image, x_base, y_base, d);
+
+            float in_curr_sum_I_e_val = 0.0;
+            for (int k = 0; k < kern_pixels; ++k) {
+              scratch.error[k] = scratch.right[k] - scratch.left[k];
+              in_curr_sum_I_e_val = in_curr_sum_I_e_val + scratch.error[k];
+            }
 
-            Matrix<float,6,6> rhs;
             Vector<float,6> lhs;
             Vector<float,6> prev_lhs;
 
-            //initial values here.
-            ImageView<float> gamma_plane(kern_width, kern_height);
-            ImageView<float> gamma_noise(kern_width, kern_height);
-
             //set init params - START
             float var2_plane = 1e-3;
             float mean_noise = 0.0;
@@ -1005,197 +824,52 @@ namespace vw {
             float w_noise = 0.2;
             //set init params - END
 
-            //EXPECTATION - START
-            float in_curr_sum_I_e_val = 0.0;
-            float in_prev_sum_I_e_val = 1000000.0;
             Vector<float,6> d_em;
             d_em = d;
 
             for (unsigned em_iter=0; em_iter<max_em_iter; em_iter++){
 
+              //EXPECTATION - START
               float noise_norm_factor = 1.0/sqrt(6.28*var2_noise);
               float plane_norm_factor = 1.0/sqrt(6.28*var2_plane);
 
-              // Set up pixel accessors
-              typename ImageView<float>::pixel_accessor w_row = w.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_x_row = I_x.origin();
-              typename CropView<ImageView<float> >::pixel_accessor I_y_row = I_y.origin();
-              typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_row = left_image_patch.origin();
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-
+              int k = 0;
+              for (int jj = -kern_half_height; jj < kern_height - kern_half_height; ++jj) {
+                for (int ii = -kern_half_width; ii < kern_width - kern_half_width; ++ii, ++k) {
                   float delta_x = d_em[0] * ii + d_em[1] * jj + d_em[2];
                   float delta_y = d_em[3] * ii + d_em[4] * jj + d_em[5];
 
-                  float temp_plane = right_interp_image(xx,yy) - (*left_image_patch_ptr) - delta_x*(*I_x_ptr) - delta_y*(*I_y_ptr);
-                  float temp_noise = right_interp_image(xx,yy) - mean_noise;
+                  float temp_plane = scratch.error[k] - delta_x*scratch.I_x[k] - delta_y*scratch.I_y[k];
+                  float temp_noise = scratch.right[k] - mean_noise;
 
                   float plane_prob = plane_norm_factor*exp(-1*(temp_plane*temp_plane)/(2*var2_plane));
                   float noise_prob = noise_norm_factor*exp(-1*(temp_noise*temp_noise)/(2*var2_noise));
 
                   float sum = plane_prob*w_plane + noise_prob*w_noise;
 
-                  gamma_plane(jj+kern_half_height, ii+kern_half_width) = plane_prob*w_plane/sum;
-                  gamma_noise(jj+kern_half_height, ii+kern_half_width) = noise_prob*w_noise/sum;
-
-                  w_row.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
+                  scratch.residual[k] = temp_plane;
+                  scratch.gamma_plane[k] = plane_prob*w_plane/sum;
+                  scratch.gamma_noise[k] = noise_prob*w_noise/sum;
                 }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
-
               }
               //EXPECTATION - END
 
               //MAXIMIZATION - START
               //compute the d_em vector
-
-              //reset lhs and rhs
-              for (int ii = 0; ii< 6; ii++) {
-                lhs(ii) = 0.0;
-                for (int jj = 0; jj < 6; jj++)
-                  rhs(ii, jj) = 0.0;
-              }
-
-              in_curr_sum_I_e_val = 0.0;
-
               float mean_noise_tmp  = 0.0;
               float sum_gamma_noise = 0.0;
               float sum_gamma_plane = 0.0;
 
-              // Set up pixel accessors
-              w_row = w.origin();
-              I_x_row = I_x.origin();
-              I_y_row = I_y.origin();
-              left_image_patch_row = left_image_patch.origin();
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-
-                  float I_e_val = right_interp_image(xx,yy) - (*left_image_patch_ptr);
-
-                  mean_noise_tmp = mean_noise_tmp + right_interp_image(xx,yy) *gamma_noise(jj+kern_half_height, ii+kern_half_width);
-                  sum_gamma_plane = sum_gamma_plane + gamma_plane(jj+kern_half_height, ii+kern_half_width);
-                  sum_gamma_noise = sum_gamma_noise + gamma_noise(jj+kern_half_height, ii+kern_half_width);
-
-                  float robust_weight = gamma_plane(jj+kern_half_height, ii+kern_half_width);
-
-                  // We combine the error value with the derivative and
-                  // add this to the update equation.
-                  float weight  = robust_weight*(*w_ptr);
-                  float I_x_val = weight * (*I_x_ptr);
-                  float I_y_val = weight * (*I_y_ptr);
-                  float I_x_sqr = I_x_val * (*I_x_ptr);
-                  float I_y_sqr = I_y_val * (*I_y_ptr);
-                  float I_x_I_y = I_x_val * (*I_y_ptr);
-
-                  // Left hand side
-                  lhs(0) += ii * I_x_val * I_e_val;
-                  lhs(1) += jj * I_x_val * I_e_val;
-                  lhs(2) +=      I_x_val * I_e_val;
-                  lhs(3) += ii * I_y_val * I_e_val;
-                  lhs(4) += jj * I_y_val * I_e_val;
-                  lhs(5) +=      I_y_val * I_e_val;
-
-                  // Right Hand Side UL
-                  rhs(0,0) += ii*ii * I_x_sqr;
-                  rhs(0,1) += ii*jj * I_x_sqr;
-                  rhs(0,2) += ii    * I_x_sqr;
-                  rhs(1,1) += jj*jj * I_x_sqr;
-                  rhs(1,2) += jj    * I_x_sqr;
-                  rhs(2,2) +=         I_x_sqr;
-
-                  // Right Hand Side UR
-                  rhs(0,3) += ii*ii * I_x_I_y;
-                  rhs(0,4) += ii*jj * I_x_I_y;
-                  rhs(0,5) += ii    * I_x_I_y;
-                  rhs(1,4) += jj*jj * I_x_I_y;
-                  rhs(1,5) += jj    * I_x_I_y;
-                  rhs(2,5) +=         I_x_I_y;
-
-                  // Right Hand Side LR
-                  rhs(3,3) += ii*ii * I_y_sqr;
-                  rhs(3,4) += ii*jj * I_y_sqr;
-                  rhs(3,5) += ii    * I_y_sqr;
-                  rhs(4,4) += jj*jj * I_y_sqr;
-                  rhs(4,5) += jj    * I_y_sqr;
-                  rhs(5,5) +=         I_y_sqr;
-
-                  w_ptr.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
-                }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
-              }
-              lhs *= -1;
-
-
-              // Fill in symmetric entries
-              rhs(1,0) = rhs(0,1);
-              rhs(2,0) = rhs(0,2);
-              rhs(2,1) = rhs(1,2);
-              rhs(1,3) = rhs(0,4);
-              rhs(2,3) = rhs(0,5);
-              rhs(2,4) = rhs(1,5);
-              rhs(3,0) = rhs(0,3);
-              rhs(3,1) = rhs(1,3);
-              rhs(3,2) = rhs(2,3);
-              rhs(4,0) = rhs(0,4);
-              rhs(4,1) = rhs(1,4);
-              rhs(4,2) = rhs(2,4);
-              rhs(4,3) = rhs(3,4);
-              rhs(5,0) = rhs(0,5);
-              rhs(5,1) = rhs(1,5);
-              rhs(5,2) = rhs(2,5);
-              rhs(5,3) = rhs(3,5);
-              rhs(5,4) = rhs(4,5);
-
-              // Solves lhs = rhs * x, and stores the result in-place in lhs.
-              //           Matrix<double,6,6> pre_rhs = rhs;
-              //           Vector<double,6> pre_lhs = lhs;
-              try {
-                solve_symmetric_nocopy(rhs,lhs);
-              } catch (ArgumentErr &/*e*/) {
-                // vw_out() << "Error @ " << x << " " << y << "\n";
-                // vw_out() << "Exception caught: " << e.what() << "\n";
-                // vw_out() << "PRERHS: " << pre_rhs << "\n";
-                // vw_out() << "PRELHS: " << pre_lhs << "\n\n";
-                // vw_out() << "RHS: " << rhs << "\n";
-                // vw_out() << "LHS: " << lhs << "\n\n";
-                // vw_out() << "DEBUG: " << rhs(0,1) << "   " << rhs(1,0) << "\n\n";
-                // exit(0);
+              for (k = 0; k < kern_pixels; ++k) {
+                mean_noise_tmp = mean_noise_tmp + scratch.right[k]*scratch.gamma_noise[k];
+                sum_gamma_plane = sum_gamma_plane + scratch.gamma_plane[k];
+                sum_gamma_noise = sum_gamma_noise + scratch.gamma_noise[k];
+
+                // We combine the error value with the derivative and
+                // add this to the update equation.
+                scratch.weight[k] = scratch.gamma_plane[k]*scratch.w[k];
               }
+              scratch.solve_update(lhs);
 
               //normalize the mean of the noise
               mean_noise = mean_noise_tmp/sum_gamma_noise;
@@ -1204,50 +878,12 @@ namespace vw {
               float var2_noise_tmp  = 0.0;
               float var2_plane_tmp  = 0.0;
 
-              // Set up pixel accessors
-              w_row = w.origin();
-              I_x_row = I_x.origin();
-              I_y_row = I_y.origin();
-              left_image_patch_row = left_image_patch.origin();
-
-              for (int jj = -kern_half_height; jj <= kern_half_height; ++jj) {
-                typename ImageView<float>::pixel_accessor w_ptr = w_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_x_ptr = I_x_row;
-                typename CropView<ImageView<float> >::pixel_accessor I_y_ptr = I_y_row;
-                typename CropView<ImageView<ChannelT> >::pixel_accessor left_image_patch_ptr = left_image_patch_row;
-
-                for (int ii = -kern_half_width; ii <= kern_half_width; ++ii) {
-
-                  // First we compute the pixel offset for the right image
-                  // and the error for the current pixel.
-                  float xx = x_base + d[0] * ii + d[1] * jj + d[2];
-                  float yy = y_base + d[3] * ii + d[4] * jj + d[5];
-
-                  float delta_x = d_em[0] * ii + d_em[1] * jj + d_em[2];
-                  float delta_y = d_em[3] * ii + d_em[4] * jj + d_em[5];
-
-                  float I_e_val = right_interp_image(xx,yy) - (*left_image_patch_ptr);
-                  float temp_plane = right_interp_image(xx,yy) - (*left_image_patch_ptr) - delta_x*(*I_x_ptr) - delta_y*(*I_y_ptr);
-                  float temp_noise = (right_interp_image(xx,yy) - mean_noise);
-
-                  in_curr_sum_I_e_val = in_curr_sum_I_e_val + I_e_val;
-
-                  var2_noise_tmp = var2_noise_tmp + temp_noise*temp_noise*gamma_noise(jj+kern_half_height, ii+kern_half_width);
-                  var2_plane_tmp = var2_plane_tmp + temp_plane*temp_plane*gamma_plane(jj+kern_half_height, ii+kern_half_width);
-
-                  w_ptr.next_col();
-                  I_x_ptr.next_col();
-                  I_y_ptr.next_col();
-                  left_image_patch_ptr.next_col();
-                }
-                w_row.next_row();
-                I_x_row.next_row();
-                I_y_row.next_row();
-                left_image_patch_row.next_row();
+              for (k = 0; k < kern_pixels; ++k) {
+                float temp_noise = (scratch.right[k] - mean_noise);
+                var2_noise_tmp = var2_noise_tmp + temp_noise*temp_noise*scratch.gamma_noise[k];
+                var2_plane_tmp = var2_plane_tmp + scratch.residual[k]*scratch.residual[k]*scratch.gamma_plane[k];
               }
 
-              confidence_image(x,y) = in_curr_sum_I_e_val; //added by Ara 02/11/2009
-
               var2_noise = var2_noise_tmp/sum_gamma_noise;
               var2_plane = var2_plane_tmp/sum_gamma_plane;
 
@@ -1267,25 +903,19 @@ namespace vw {
                 conv_error = conv_error + (prev_lhs[k]-lhs[k])*(prev_lhs[k]-lhs[k]);
 
               d_em = d + lhs;
-
-              if (in_curr_sum_I_e_val < 0)
-                in_curr_sum_I_e_val = - in_curr_sum_I_e_val;
-
-              curr_sum_I_e_val = in_curr_sum_I_e_val;
               prev_lhs = lhs;
 
               // Termination condition
               if ((conv_error < 0.001) && (em_iter > 0))
                 break;
-              else
-                in_prev_sum_I_e_val = in_curr_sum_I_e_val;
 
             } //em_iter end
 
             d += lhs;
 
-            if (curr_sum_I_e_val < 0)
-              curr_sum_I_e_val = - curr_sum_I_e_val;
+            if (in_curr_sum_I_e_val < 0)
+              in_curr_sum_I_e_val = - in_curr_sum_I_e_val;
+            curr_sum_I_e_val = in_curr_sum_I_e_val;
 
             // Termination condition
             if ((prev_sum_I_e_val < curr_sum_I_e_val) && (iter > 0))
@@ -19,7 +19,9 @@ namespace stereo {
 
   enum CorrelatorType { ABS_DIFF_CORRELATOR = 0,
                         SQR_DIFF_CORRELATOR = 1,
-                        NORM_XCORR_CORRELATOR = 2 };
+                        NORM_XCORR_CORRELATOR = 2,
+                        // Semi-global matching; see SemiGlobalCorrelator.h
+                        SEMI_GLOBAL_CORRELATOR = 3 };
 
   /// Given a type, these traits classes help to determine a suitable
   /// working type for accumulation operations in the correlator
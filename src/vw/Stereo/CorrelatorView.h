@@ -11,6 +11,7 @@
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Stereo/Correlate.h>
 #include <vw/Stereo/PyramidCorrelator.h>
+#include <vw/Stereo/SemiGlobalCorrelator.h>
 #include <vw/Stereo/DisparityMap.h>
 
 #include <ostream>
@@ -33,6 +34,8 @@ namespace stereo {
     float m_corr_score_threshold;
     int m_cost_blur;
     stereo::CorrelatorType m_correlator_type;
+    int m_sgm_num_paths, m_sgm_penalty1, m_sgm_penalty2;
+    size_t m_sgm_max_volume_bytes;
     std::string m_debug_prefix;
     bool m_do_pyramid_correlator;
 
@@ -78,6 +81,10 @@ namespace stereo {
         m_corr_score_threshold = 1.3;
         m_cost_blur = 1;
         m_correlator_type = ABS_DIFF_CORRELATOR;
+        m_sgm_num_paths = 8;
+        m_sgm_penalty1 = 16;
+        m_sgm_penalty2 = 128;
+        m_sgm_max_volume_bytes = SemiGlobalCorrelator::default_max_volume_bytes();
 
         // Calculating constants
         m_num_pyramid_levels = 4;
@@ -96,13 +103,35 @@ namespace stereo {
       }
       Vector2i kernel_size() const { return m_kernel_size; }
 
+      /// Selecting SEMI_GLOBAL_CORRELATOR replaces the pyramid with a
+      /// single pass of the SemiGlobalCorrelator; cost_blur does not
+      /// apply to it.
       void set_correlator_options(int cost_blur, stereo::CorrelatorType correlator_type) {
         m_cost_blur = cost_blur;
         m_correlator_type = correlator_type;
+        m_num_pyramid_levels = ( m_do_pyramid_correlator &&
+                                 m_correlator_type != SEMI_GLOBAL_CORRELATOR ) ? 4 : 1;
+        m_kernpad = m_kernel_size*pow(2,m_num_pyramid_levels-1)/2;
       }
       int cost_blur() const { return m_cost_blur; }
       stereo::CorrelatorType correlator_type() const { return m_correlator_type; }
 
+      /// Settings for SEMI_GLOBAL_CORRELATOR.  See SemiGlobalCorrelator.h.
+      void set_semi_global_options(int num_paths, int penalty1, int penalty2) {
+        m_sgm_num_paths = num_paths;
+        m_sgm_penalty1 = penalty1;
+        m_sgm_penalty2 = penalty2;
+      }
+      int semi_global_num_paths() const { return m_sgm_num_paths; }
+      int semi_global_penalty1() const { return m_sgm_penalty1; }
+      int semi_global_penalty2() const { return m_sgm_penalty2; }
+
+      /// The most memory the SemiGlobalCorrelator may use at once.
+      /// Blocks whose cost volume would take more are correlated in
+      /// tiles small enough to fit.
+      void set_semi_global_max_volume_bytes(size_t bytes) { m_sgm_max_volume_bytes = bytes; }
+      size_t semi_global_max_volume_bytes() const { return m_sgm_max_volume_bytes; }
+
       void set_cross_corr_threshold(float threshold) { m_cross_corr_threshold = threshold; }
       float cross_corr_threshold() const { return m_cross_corr_threshold; }
 
@@ -126,8 +155,52 @@ namespace stereo {
       }
 
       /// \cond INTERNAL
+      SemiGlobalCorrelator semi_global_correlator() const {
+        SemiGlobalCorrelator correlator(BBox2(0,0,m_search_range.width(),
+                                              m_search_range.height()),
+                                        m_kernel_size[0], m_cross_corr_threshold,
+                                        m_sgm_num_paths, m_sgm_penalty1, m_sgm_penalty2);
+        correlator.set_max_volume_bytes(m_sgm_max_volume_bytes);
+        return correlator;
+      }
+
+      // The size of the tiles that a block is split into so that the
+      // semi-global correlator's cost volume for each one, which
+      // covers the tile plus the search range and kernel padding,
+      // fits in memory.  The larger side is halved until it does.  If
+      // not even a single pixel fits, the correlator reports it.
+      Vector2i semi_global_tile_size(BBox2i const& bbox) const {
+        SemiGlobalCorrelator correlator = semi_global_correlator();
+        Vector2i tile(bbox.width(), bbox.height());
+        while ( (tile.x() > 1 || tile.y() > 1) &&
+                correlator.volume_bytes(tile.x() + m_search_range.width() + 2*m_kernpad[0],
+                                        tile.y() + m_search_range.height() + 2*m_kernpad[1])
+                > correlator.max_volume_bytes() ) {
+          if ( tile.x() >= tile.y() )
+            tile.x() = (tile.x() + 1) / 2;
+          else
+            tile.y() = (tile.y() + 1) / 2;
+        }
+        return tile;
+      }
+
       typedef CropView<ImageView<pixel_type> > prerasterize_type;
       inline prerasterize_type prerasterize(BBox2i bbox) const {
+        if ( m_correlator_type == SEMI_GLOBAL_CORRELATOR ) {
+          Vector2i tile = semi_global_tile_size(bbox);
+          if ( tile.x() < bbox.width() || tile.y() < bbox.height() ) {
+            ImageView<pixel_type> disparity_map(bbox.width(), bbox.height());
+            for (int y = bbox.min().y(); y < bbox.max().y(); y += tile.y())
+              for (int x = bbox.min().x(); x < bbox.max().x(); x += tile.x()) {
+                BBox2i tile_bbox(x, y, std::min(tile.x(), bbox.max().x() - x),
+                                 std::min(tile.y(), bbox.max().y() - y));
+                crop(disparity_map, tile_bbox - bbox.min()) = crop(prerasterize(tile_bbox), tile_bbox);
+              }
+            return CropView<ImageView<pixel_type> >(disparity_map, BBox2i(-bbox.min().x(), -bbox.min().y(),
+                                                                          bbox.width(), bbox.height()));
+          }
+        }
+
         vw_out(DebugMessage, "stereo") << "CorrelatorView: rasterizing image block " << bbox << ".\n";
 
         // The area in the right image that we'll be searching is
@@ -178,7 +251,14 @@ namespace stereo {
 
           // We have all of the settings adjusted.  Now we just have to
           // run the correlator.
-          if ( m_do_pyramid_correlator ) {
+          if ( m_correlator_type == SEMI_GLOBAL_CORRELATOR ) {
+            SemiGlobalCorrelator correlator = semi_global_correlator();
+            disparity_map = disparity_mask(correlator( cropped_left_image,
+                                                       cropped_right_image,
+                                                       m_preproc_func ),
+                                           cropped_left_mask,
+                                           cropped_right_mask );
+          } else if ( m_do_pyramid_correlator ) {
             PyramidCorrelator correlator(BBox2(0,0,m_search_range.width(),
                                                m_search_range.height()),
                                          Vector2i(m_kernel_size[0], m_kernel_size[1]),
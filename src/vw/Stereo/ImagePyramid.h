@@ -0,0 +1,267 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file ImagePyramid.h
+///
+/// An image and its mask, together with successively coarser copies
+/// of both, each half the size of the one before.  This is the input
+/// to the PyramidCorrelator.
+///
+/// An ImagePyramid is reference counted: copies share the same levels,
+/// so a pyramid can be built once and handed to any number of
+/// correlators, or kept in a vw::Cache with an ImagePyramidGenerator.
+/// Levels are built on demand (or ahead of time with build()), each
+/// one by a group of tasks on the thread pool.  A pyramid can also be
+/// written to disk and read back in a later run.
+///
+#ifndef __VW_STEREO_IMAGE_PYRAMID_H__
+#define __VW_STEREO_IMAGE_PYRAMID_H__
+
+#include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/FileIO/DiskImageResource.h>
+
+#include <vector>
+#include <sstream>
+
+#include <boost/shared_ptr.hpp>
+
+namespace vw {
+namespace stereo {
+
+  namespace detail {
+
+    // Reduce the image size by a factor of two by averaging the
+    // pixels.  Only rows [begin, end) of the output are computed.
+    template <class ChannelT>
+    void subsample_by_two(ImageView<ChannelT> const& img, ImageView<ChannelT> &out,
+                          int32 begin, int32 end) {
+      typedef typename FloatType<ChannelT>::type sum_type;
+      for (int32 p = 0; p < out.planes(); p++)
+        for (int32 j = begin; j < end; j++)
+          for (int32 i = 0; i < out.cols(); i++) {
+            sum_type sum = sum_type(img(2*i, 2*j, p)) + img(2*i + 1, 2*j, p)
+              + img(2*i, 2*j + 1, p) + img(2*i + 1, 2*j + 1, p);
+            out(i,j,p) = ChannelT(sum / 4);
+          }
+    }
+
+    // Reduce the mask size by a factor of two.  An output pixel is
+    // valid only if all four of its input pixels are.
+    inline void subsample_mask_by_two(ImageView<uint8> const& img, ImageView<uint8> &out,
+                                      int32 begin, int32 end) {
+      for (int32 p = 0; p < out.planes(); p++)
+        for (int32 j = begin; j < end; j++)
+          for (int32 i = 0; i < out.cols(); i++)
+            out(i,j,p) = ( img(2*i, 2*j, p) && img(2*i + 1, 2*j, p) &&
+                           img(2*i, 2*j + 1, p) && img(2*i + 1, 2*j + 1, p) )
+              ? ScalarTypeLimits<uint8>::highest() : uint8();
+    }
+
+    template <class ChannelT>
+    class SubsampleTask : public Task {
+      ImageView<ChannelT> const& m_image;
+      ImageView<uint8> const& m_mask;
+      ImageView<ChannelT> &m_out_image;
+      ImageView<uint8> &m_out_mask;
+      int32 m_begin, m_end;
+    public:
+      SubsampleTask(ImageView<ChannelT> const& image, ImageView<uint8> const& mask,
+                    ImageView<ChannelT> &out_image, ImageView<uint8> &out_mask,
+                    int32 begin, int32 end) :
+        m_image(image), m_mask(mask), m_out_image(out_image), m_out_mask(out_mask),
+        m_begin(begin), m_end(end) {}
+      virtual ~SubsampleTask() {}
+
+      virtual void operator()() {
+        subsample_by_two(m_image, m_out_image, m_begin, m_end);
+        subsample_mask_by_two(m_mask, m_out_mask, m_begin, m_end);
+      }
+    };
+
+  } // namespace detail
+
+  /// A reference counted image pyramid.  Level 0 is the image itself,
+  /// with its channels stored as planes, and level n is half the size
+  /// of level n-1 in each dimension.  Each level has a uint8 mask
+  /// where nonzero pixels are valid.
+  template <class ChannelT>
+  class ImagePyramid {
+    struct Levels {
+      Mutex mutex;
+      std::vector<ImageView<ChannelT> > images;
+      std::vector<ImageView<uint8> > masks;
+    };
+    boost::shared_ptr<Levels> m_levels;
+
+    static std::string level_filename(std::string const& prefix, std::string const& kind,
+                                      int level, std::string const& extension) {
+      std::ostringstream filename;
+      filename << prefix << "-" << kind << level << extension;
+      return filename.str();
+    }
+
+  public:
+    typedef ChannelT channel_type;
+
+    /// An empty pyramid.  Use read() to fill it in.
+    ImagePyramid() : m_levels(new Levels) {}
+
+    /// Starts a pyramid with the given image and mask.  Only level 0
+    /// is computed here; the rest are built when they are needed.
+    template <class ViewT, class MaskViewT>
+    ImagePyramid(ImageViewBase<ViewT> const& image, ImageViewBase<MaskViewT> const& mask)
+      : m_levels(new Levels) {
+      VW_ASSERT(image.impl().cols() == mask.impl().cols() &&
+                image.impl().rows() == mask.impl().rows(),
+                ArgumentErr() << "ImagePyramid: image and mask dimensions do not match.");
+      m_levels->images.resize(1);
+      m_levels->masks.resize(1);
+      m_levels->images[0] = channels_to_planes(image.impl());
+      m_levels->masks[0] = channels_to_planes(mask.impl());
+    }
+
+    int32 cols() const { return image(0).cols(); }
+    int32 rows() const { return image(0).rows(); }
+    int32 planes() const { return image(0).planes(); }
+
+    /// The number of levels computed (or read from disk) so far.
+    int built_levels() const {
+      Mutex::Lock lock(m_levels->mutex);
+      return int(m_levels->images.size());
+    }
+
+    /// Makes sure that at least the given number of levels exist.
+    /// The lock is not held while a level is being computed, so two
+    /// threads building the same pyramid may both do the work; the
+    /// first result to be finished is the one that is kept.
+    void build(int num_levels) const {
+      while (true) {
+        ImageView<ChannelT> image;
+        ImageView<uint8> mask;
+        size_t level;
+        {
+          Mutex::Lock lock(m_levels->mutex);
+          level = m_levels->images.size();
+          VW_ASSERT(level > 0, LogicErr() << "ImagePyramid: the pyramid is empty.");
+          if (int(level) >= num_levels)
+            return;
+          image = m_levels->images[level - 1];
+          mask = m_levels->masks[level - 1];
+        }
+
+        ImageView<ChannelT> out_image(image.cols()/2, image.rows()/2, image.planes());
+        ImageView<uint8> out_mask(mask.cols()/2, mask.rows()/2, mask.planes());
+        {
+          int32 rows = out_image.rows();
+          int32 chunk = std::max(16, (rows + 4*vw_thread_pool().num_threads() - 1) /
+                                      (4*vw_thread_pool().num_threads()));
+          TaskGroup group;
+          for (int32 begin = 0; begin < rows; begin += chunk)
+            group.add_task( boost::shared_ptr<Task>(
+              new detail::SubsampleTask<ChannelT>(image, mask, out_image, out_mask,
+                                                  begin, std::min(rows, begin + chunk)) ) );
+          group.join();
+        }
+
+        Mutex::Lock lock(m_levels->mutex);
+        if (m_levels->images.size() == level) {
+          m_levels->images.push_back(out_image);
+          m_levels->masks.push_back(out_mask);
+        }
+      }
+    }
+
+    /// Returns the image at the given level, building it (and the
+    /// levels before it) first if necessary.  The returned view
+    /// shares its pixels with the pyramid and must not be modified.
+    ImageView<ChannelT> image(int level) const {
+      build(level + 1);
+      Mutex::Lock lock(m_levels->mutex);
+      return m_levels->images[level];
+    }
+
+    /// Returns the mask at the given level, building it first if
+    /// necessary.
+    ImageView<uint8> mask(int level) const {
+      build(level + 1);
+      Mutex::Lock lock(m_levels->mutex);
+      return m_levels->masks[level];
+    }
+
+    /// Writes every level built so far to disk, as
+    /// <prefix>-image<n><extension> and <prefix>-mask<n><extension>.
+    /// The file format must be able to hold the channel type.
+    void write(std::string const& prefix, std::string const& extension = ".tif") const {
+      int num_levels = built_levels();
+      for (int n = 0; n < num_levels; ++n) {
+        write_image(level_filename(prefix, "image", n, extension), image(n));
+        write_image(level_filename(prefix, "mask", n, extension), mask(n));
+      }
+    }
+
+    /// Reads the first num_levels levels of a pyramid saved with
+    /// write().  Any further levels are built as usual.
+    static ImagePyramid read(std::string const& prefix, int num_levels,
+                             std::string const& extension = ".tif") {
+      VW_ASSERT(num_levels > 0, ArgumentErr() << "ImagePyramid::read: no levels requested.");
+      ImagePyramid pyramid;
+      pyramid.m_levels->images.resize(num_levels);
+      pyramid.m_levels->masks.resize(num_levels);
+      for (int n = 0; n < num_levels; ++n) {
+        read_image(pyramid.m_levels->images[n], level_filename(prefix, "image", n, extension));
+        read_image(pyramid.m_levels->masks[n], level_filename(prefix, "mask", n, extension));
+        VW_ASSERT(pyramid.m_levels->images[n].cols() == pyramid.m_levels->masks[n].cols() &&
+                  pyramid.m_levels->images[n].rows() == pyramid.m_levels->masks[n].rows(),
+                  IOErr() << "ImagePyramid::read: image and mask dimensions do not match at level " << n << ".");
+      }
+      return pyramid;
+    }
+  };
+
+  /// Builds an ImagePyramid for a vw::Cache, e.g.
+  ///
+  ///     Cache::Handle<ImagePyramidGenerator<ViewT,MaskViewT> > handle =
+  ///       vw_system_cache().insert( ImagePyramidGenerator<ViewT,MaskViewT>(image, mask, 4) );
+  ///     ImagePyramid<float> pyramid = *handle;
+  ///
+  /// A copy taken from the handle stays valid even if the cache later
+  /// evicts the pyramid.
+  template <class ViewT, class MaskViewT>
+  class ImagePyramidGenerator {
+    ViewT m_image;
+    MaskViewT m_mask;
+    int m_levels;
+  public:
+    typedef ImagePyramid<typename PixelChannelType<typename ViewT::pixel_type>::type> value_type;
+
+    ImagePyramidGenerator(ImageViewBase<ViewT> const& image,
+                          ImageViewBase<MaskViewT> const& mask, int levels)
+      : m_image(image.impl()), m_mask(mask.impl()), m_levels(levels) {}
+
+    size_t size() const {
+      size_t pixel_size = m_image.channels() * m_image.planes() *
+        sizeof(typename value_type::channel_type) + m_mask.channels() * m_mask.planes();
+      size_t total = 0;
+      for (int32 n = 0, cols = m_image.cols(), rows = m_image.rows();
+           n < std::max(m_levels, 1); ++n, cols /= 2, rows /= 2)
+        total += size_t(cols) * rows * pixel_size;
+      return total;
+    }
+
+    boost::shared_ptr<value_type> generate() const {
+      boost::shared_ptr<value_type> pyramid( new value_type(m_image, m_mask) );
+      pyramid->build(m_levels);
+      return pyramid;
+    }
+  };
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_IMAGE_PYRAMID_H__
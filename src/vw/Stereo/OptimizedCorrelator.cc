@@ -22,71 +22,50 @@ struct DisparityScore {
   }
 };
 
-struct AbsDifferenceFunctor : BinaryReturnTemplateType<DifferenceType> {
-  template <class Arg1T, class Arg2T>
-  typename result<AbsDifferenceFunctor(Arg1T, Arg2T)>::type
-  inline operator()(Arg1T const& arg1, Arg2T const& arg2) const { return fabs(arg1-arg2); }
-};
-
-template <class Image1T, class Image2T>
-inline BinaryPerPixelView<Image1T, Image2T, AbsDifferenceFunctor> abs_difference(ImageViewBase<Image1T> const& image1, ImageViewBase<Image2T> const& image2) {
-  return BinaryPerPixelView<Image1T, Image2T, AbsDifferenceFunctor>(image1.impl(), image2.impl(), AbsDifferenceFunctor());
-}
-
-struct SqDifferenceFunctor : BinaryReturnTemplateType<DifferenceType> {
-  template <class Arg1T, class Arg2T>
-  typename result<SqDifferenceFunctor(Arg1T, Arg2T)>::type
-  inline operator()(Arg1T const& arg1, Arg2T const& arg2) const {
-    typename result<SqDifferenceFunctor(Arg1T, Arg2T)>::type diff = arg1 - arg2;
-    return diff * diff;
-  }
-};
-
-template <class Image1T, class Image2T>
-inline BinaryPerPixelView<Image1T, Image2T, SqDifferenceFunctor> sq_difference(ImageViewBase<Image1T> const& image1, ImageViewBase<Image2T> const& image2) {
-  return BinaryPerPixelView<Image1T, Image2T, SqDifferenceFunctor>(image1.impl(), image2.impl(), SqDifferenceFunctor());
-}
-
 // ---------------------------------------------------------------------------
 //                           COST FUNCTIONS
 // ---------------------------------------------------------------------------
 
 ImageView<float> AbsDifferenceCost::calculate(int dx, int dy) {
-  BBox2i right_bbox = this->bbox() + Vector2i(dx, dy);
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > left_window(edge_extend(m_left,ZeroEdgeExtension()), this->bbox());
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > right_window(edge_extend(m_right,ZeroEdgeExtension()), right_bbox);
-  return this->box_filter(abs_difference(left_window, right_window));
+  return this->window_cost(m_left, m_right, dx, dy);
 }
 
 
 ImageView<float> SqDifferenceCost::calculate(int dx, int dy) {
-  BBox2i right_bbox = this->bbox() + Vector2i(dx, dy);
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > left_window(edge_extend(m_left,ZeroEdgeExtension()), this->bbox());
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > right_window(edge_extend(m_right,ZeroEdgeExtension()), right_bbox);
-  return this->box_filter(sq_difference(left_window, right_window));
+  return this->window_cost(m_left, m_right, dx, dy);
 }
 
 
 ImageView<float> NormXCorrCost::calculate(int dx, int dy) {
-  BBox2i right_bbox = this->bbox() + Vector2i(dx, dy);
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > left_window(edge_extend(m_left, ZeroEdgeExtension()), this->bbox());
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > left_mean_window(edge_extend(m_left_mean, ZeroEdgeExtension()), this->bbox());
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > left_variance_window(edge_extend(m_left_variance, ZeroEdgeExtension()), this->bbox());
-
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > right_window(edge_extend(m_right, ZeroEdgeExtension()), right_bbox);
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > right_mean_window(edge_extend(m_right_mean, ZeroEdgeExtension()), right_bbox);
-  CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > right_variance_window(edge_extend(m_right_variance, ZeroEdgeExtension()), right_bbox);
-
-  ImageView<float> left_right_mean = this->box_filter(left_window * right_window);
+  ImageView<float> left_right_mean = this->window_cost(m_left, m_right, dx, dy);
 
   // We take the absolute value and subtract 1 here so that
   // invalid (empty) regions of the image (which would normally
   // evaluate to zero) end up evaluating to 1.0, and areas that
-  // are highly correlated are closer to zero.
-  //return 1-abs(pow(left_right_mean - left_mean_window * right_mean_window, 2) /
-  //             left_variance_window / right_variance_window);
-  left_right_mean = left_right_mean -left_mean_window * right_mean_window;
-  return 1-abs(left_right_mean*left_right_mean / left_variance_window / right_variance_window);
+  // are highly correlated are closer to zero.  The means and
+  // variances are zero outside of the image, and as with image
+  // division, dividing by a zero variance yields zero.
+  BBox2i left_bbox = this->bbox();
+  for (int y = 0; y < left_bbox.height(); ++y) {
+    int ly = left_bbox.min().y() + y, ry = ly + dy;
+    bool right_row_valid = ry >= 0 && ry < m_right.rows();
+    float *cost = &left_right_mean(0, y);
+    for (int x = 0; x < left_bbox.width(); ++x) {
+      int lx = left_bbox.min().x() + x, rx = lx + dx;
+      float right_mean = 0, right_variance = 0;
+      if (right_row_valid && rx >= 0 && rx < m_right.cols()) {
+        right_mean = m_right_mean(rx, ry);
+        right_variance = m_right_variance(rx, ry);
+      }
+      float covariance = cost[x] - m_left_mean(lx, ly) * right_mean;
+      float left_variance = m_left_variance(lx, ly);
+      if (left_variance == 0 || right_variance == 0)
+        cost[x] = 1;
+      else
+        cost[x] = 1 - fabs(covariance * covariance / left_variance / right_variance);
+    }
+  }
+  return left_right_mean;
 }
 
 
@@ -101,7 +80,6 @@ ImageView<PixelMask<Vector2f> > vw::stereo::correlate(boost::shared_ptr<StereoCo
   int height = cost_function->rows();
 
   ImageView<DisparityScore<float> > result_buf(width, height);
-  ImageView<float> cost_buf(width, height);
 
   int current_iteration = 0;
   int total_iterations = (search_window.width() + 1) * (search_window.height() + 1);
@@ -109,33 +87,23 @@ ImageView<PixelMask<Vector2f> > vw::stereo::correlate(boost::shared_ptr<StereoCo
   BBox2i left_bbox = cost_function->bbox();
   for (int dy = search_window.min().y(); dy <= search_window.max().y(); dy++) {
     for (int dx = search_window.min().x(); dx <= search_window.max().x(); dx++) {
-      BBox2i right_bbox = cost_function->bbox() + Vector2i (dx,dy);
-
-      CropView<ImageView<DisparityScore<float> > > result_buf_window(result_buf, left_bbox);
-      CropView<ImageView<float> > cost_buf_window(cost_buf, left_bbox);
 
       // Calculate cost function
-      cost_buf_window = cost_function->calculate(dx,dy);
+      ImageView<float> cost_buf = cost_function->calculate(dx,dy);
 
-      CropView<ImageView<DisparityScore<float> > >::pixel_accessor result_row_acc = result_buf_window.origin();
-      CropView<ImageView<float> >::pixel_accessor cost_buf_row_acc = cost_buf_window.origin();
       for (int y = 0; y < left_bbox.height(); y++) {
-        CropView<ImageView<DisparityScore<float> > >::pixel_accessor result_col_acc = result_row_acc;
-        CropView<ImageView<float> >::pixel_accessor cost_buf_col_acc = cost_buf_row_acc;
+        DisparityScore<float> *result = &result_buf(left_bbox.min().x(), left_bbox.min().y() + y);
+        float const* cost = &cost_buf(0, y);
         for (int x = 0; x < left_bbox.width(); x++) {
-          if (*cost_buf_col_acc < (*result_col_acc).best) {
-            (*result_col_acc).best = *cost_buf_col_acc;
-            (*result_col_acc).hdisp = dx;
-            (*result_col_acc).vdisp = dy;
+          if (cost[x] < result[x].best) {
+            result[x].best = cost[x];
+            result[x].hdisp = dx;
+            result[x].vdisp = dy;
           }
-          if (*cost_buf_col_acc > (*result_col_acc).worst) {
-            (*result_col_acc).worst = *cost_buf_col_acc;
+          if (cost[x] > result[x].worst) {
+            result[x].worst = cost[x];
           }
-          result_col_acc.next_col();
-          cost_buf_col_acc.next_col();
         }
-        result_row_acc.next_row();
-        cost_buf_row_acc.next_row();
       }
 
       progress.report_fractional_progress(++current_iteration, total_iterations);
@@ -11,6 +11,7 @@
 #include <vw/Image/ImageMath.h>
 #include <vw/Stereo/DisparityMap.h>
 #include <vw/Stereo/Correlate.h>
+#include <vw/Stereo/SlidingWindowCost.h>
 
 // Boost
 #include <boost/thread/xtime.hpp>
@@ -28,26 +29,30 @@ namespace stereo {
     BBox2i m_left_bbox;
     ImageView<float> m_dst;
     int m_kernel_size;
-    float m_kernel_size_i2;
-    int m_half_kernel;
+    SlidingWindowCost m_box_filter, m_window_cost;
 
   public:
     // The constructor allocates the buffers for the box filter once
-    // and only once.
-    StereoCostFunction(int width, int height, BBox2i const& search_window, int kernel_size) :
+    // and only once.  window_cost selects the per-pixel cost that
+    // window_cost() sums.
+    StereoCostFunction(int width, int height, BBox2i const& search_window, int kernel_size,
+                       SlidingWindowCostType window_cost = IDENTITY_WINDOW_COST) :
     m_left_bbox(BBox2i((search_window.max().x() < 0) ? (-search_window.max().x()) : 0,
                        (search_window.max().y() < 0) ? (-search_window.max().y()) : 0,
                        (search_window.min().x() < 0) ? width - abs(search_window.max().x()) : width - abs(search_window.min().x()),
                        (search_window.min().y() < 0) ? height - abs(search_window.max().y()) : height - abs(search_window.min().y()) )),
       m_dst(m_left_bbox.width(), m_left_bbox.height()),
-      m_kernel_size(kernel_size), m_kernel_size_i2(1.0/float(kernel_size*kernel_size)),
-      m_half_kernel(kernel_size/2) {}
+      m_kernel_size(kernel_size),
+      m_box_filter(kernel_size, IDENTITY_WINDOW_COST),
+      m_window_cost(kernel_size, window_cost) {}
 
     virtual ~StereoCostFunction() {}
 
     BBox2i const& bbox() const { return m_left_bbox; }
     int kernel_size() const { return m_kernel_size; }
 
+    // The image returned by calculate() may be reused by the next
+    // call, so it must be consumed (or copied) before then.
     virtual ImageView<float> calculate(int dx, int dy) = 0;
     virtual int cols() const = 0;
     virtual int rows() const = 0;
@@ -65,37 +70,18 @@ namespace stereo {
     ImageView<float> box_filter(ImageViewBase<BoxViewT> const& img) {
       VW_ASSERT(img.impl().cols() == m_dst.cols() && img.impl().rows() == m_dst.rows(),
                 ArgumentErr() << "StereoCostFunction::box_filter() : image size (" << img.impl().cols() << " " << img.impl().rows() << ") does not match box filter size (" << m_dst.cols() << " " << m_dst.rows() << ").");
+      ImageView<float> src = img.impl();
+      m_box_filter(src, BBox2i(0, 0, src.cols(), src.rows()), src, Vector2i(), m_dst);
+      return m_dst;
+    }
 
-      Vector<float> cSum(img.impl().cols());
-
-      // Seed the column sum buffer
-      for (int x = 0; x < img.impl().cols(); x++) {
-        cSum(x) = 0;
-        for (int ky = 0; ky < m_kernel_size; ky++) {
-          cSum(x) += img.impl()(x, ky);
-        }
-      }
-
-      for (int y = 0; y < img.impl().rows() - m_kernel_size; y++) {
-        // Seed the row sum
-        float rsum = 0;
-        for (int i = 0; i < m_kernel_size; i++) {
-          rsum += cSum(i);
-        }
-
-        for (int x = 0; x < img.impl().cols() - m_kernel_size; x++) {
-          m_dst(x + m_half_kernel, y + m_half_kernel) = rsum;
-          // Update the row sum
-          rsum += cSum(x + m_kernel_size) - cSum(x);
-        }
-
-        // Update the column sum
-        for (int i = 0; i < img.impl().cols(); i++) {
-          cSum(i) += img.impl()(i, y + m_kernel_size) - img.impl()(i, y);
-        }
-      }
-
-      return m_dst * m_kernel_size_i2;
+    // Box filters the per-pixel window cost between left over the
+    // left bbox and right over the left bbox shifted by (dx, dy),
+    // without forming the per-pixel costs as an image first.
+    ImageView<float> window_cost(ImageView<float> const& left, ImageView<float> const& right,
+                                 int dx, int dy) {
+      m_window_cost(left, m_left_bbox, right, Vector2i(dx, dy), m_dst);
+      return m_dst;
     }
   };
 
@@ -108,7 +94,8 @@ namespace stereo {
                       ImageViewBase<ViewT> const& right,
                       BBox2i const& search_window,
                       int kern_size) : StereoCostFunction(left.impl().cols(), left.impl().rows(),
-                                                                 search_window, kern_size),
+                                                                 search_window, kern_size,
+                                                                 ABS_DIFFERENCE_WINDOW_COST),
                                        m_left(copy(left.impl())),
                                        m_right(copy(right.impl())) {
       VW_ASSERT(m_left.impl().cols() == m_right.impl().cols(), ArgumentErr() << "Left and right images not the same width");
@@ -132,7 +119,8 @@ namespace stereo {
                      BBox2i const& search_window,
                      int kern_size) : StereoCostFunction(left.impl().cols(),
                                                          left.impl().rows(),
-                                                         search_window, kern_size),
+                                                         search_window, kern_size,
+                                                         SQ_DIFFERENCE_WINDOW_COST),
                                       m_left(copy(left.impl())),
                                       m_right(copy(right.impl()) ) {
       VW_ASSERT(m_left.cols() == m_right.cols(), ArgumentErr() << "Left and right images not the same width");
@@ -156,19 +144,20 @@ namespace stereo {
                   ImageViewBase<ViewT> const& right,
                   BBox2i const& search_window,
                   int kern_size) : StereoCostFunction(left.impl().cols(), left.impl().rows(),
-                                                      search_window, kern_size),
+                                                      search_window, kern_size,
+                                                      PRODUCT_WINDOW_COST),
                                    m_left(copy(left.impl())),
                                    m_right(copy(right.impl())) {
       VW_ASSERT(m_left.cols() == m_right.cols(), ArgumentErr() << "Left and right images not the same width");
       VW_ASSERT(m_left.rows() == m_right.rows(), ArgumentErr() << "Left and right images not the same height");
 
-      vw::ImageView<float> left_mean_sq = this->box_filter(m_left * m_left);
-      m_left_mean = this->box_filter(m_left);
-      m_left_variance = left_mean_sq - m_left_mean * m_left_mean;
+      vw::ImageView<float> left_sq = m_left * m_left;
+      m_left_mean = box_filter_mean(m_left, kern_size);
+      m_left_variance = box_filter_mean(left_sq, kern_size) - m_left_mean * m_left_mean;
 
-      vw::ImageView<float> right_mean_sq = this->box_filter(m_right * m_right);
-      m_right_mean = this->box_filter(m_right);
-      m_right_variance = right_mean_sq - m_right_mean * m_right_mean;
+      vw::ImageView<float> right_sq = m_right * m_right;
+      m_right_mean = box_filter_mean(m_right, kern_size);
+      m_right_variance = box_filter_mean(right_sq, kern_size) - m_right_mean * m_right_mean;
     }
 
     virtual ImageView<float> calculate(int dx, int dy);
@@ -229,10 +218,15 @@ namespace stereo {
       m_cost_blur(cost_blur),
       m_correlator_type(correlator_type) {}
 
+    BBox2i search_window() const { return m_search_window; }
+    int kernel_size() const { return m_kern_size; }
+    int cost_blur() const { return m_cost_blur; }
+    stereo::CorrelatorType correlator_type() const { return m_correlator_type; }
+
     template <class ViewT, class PreProcFilterT>
     ImageView<PixelMask<Vector2f> > operator()(ImageViewBase<ViewT> const& image0,
                                                ImageViewBase<ViewT> const& image1,
-                                               PreProcFilterT const& preproc_filter) {
+                                               PreProcFilterT const& preproc_filter) const {
 
       // Check to make sure that image0 and image1 have equal dimensions
       if ((image0.impl().cols() != image1.impl().cols()) ||
@@ -0,0 +1,124 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file OptimizedCorrelatorView.h
+///
+/// A lazy disparity map that runs the OptimizedCorrelator one block
+/// at a time.  Each block is cropped out of the input images with
+/// enough padding for both the left-to-right and right-to-left passes
+/// of the consistency check, so memory use is bounded by the block
+/// size rather than the image size.  When the view is rasterized with
+/// block_rasterize() or written with block_write_image() the blocks
+/// are correlated in parallel on the thread pool.
+///
+#ifndef __VW_STEREO_OPTIMIZED_CORRELATOR_VIEW__
+#define __VW_STEREO_OPTIMIZED_CORRELATOR_VIEW__
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/EdgeExtension.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Stereo/OptimizedCorrelator.h>
+
+#include <algorithm>
+
+namespace vw {
+namespace stereo {
+
+  template <class ImageT, class PreProcFuncT>
+  class OptimizedCorrelatorView : public ImageViewBase<OptimizedCorrelatorView<ImageT, PreProcFuncT> > {
+    ImageT m_left_image, m_right_image;
+    PreProcFuncT m_preproc_func;
+    OptimizedCorrelator m_correlator;
+    Vector2i m_pad_min, m_pad_max;  // Padding used around a render box
+
+  public:
+    typedef PixelMask<Vector2f> pixel_type;
+    typedef pixel_type result_type;
+    typedef ProceduralPixelAccessor<OptimizedCorrelatorView> pixel_accessor;
+
+    OptimizedCorrelatorView(ImageT const& left_image, ImageT const& right_image,
+                            PreProcFuncT const& preproc_func, OptimizedCorrelator const& correlator) :
+      m_left_image(left_image), m_right_image(right_image),
+      m_preproc_func(preproc_func), m_correlator(correlator) {
+
+      VW_ASSERT(left_image.cols() == right_image.cols() && left_image.rows() == right_image.rows(),
+                ArgumentErr() << "OptimizedCorrelatorView: input image dimensions do not agree.");
+
+      // A left pixel is matched against right pixels anywhere in the
+      // search window, and each of those is cross checked against
+      // left pixels anywhere in the search window back from it.  On
+      // top of that we allow a kernel's worth of pixels for the
+      // correlation window, the cost blur and the preprocessing
+      // filter, all of which see the edges of the cropped block.
+      BBox2i search = correlator.search_window();
+      int window = correlator.kernel_size() + correlator.cost_blur();
+      for (int i = 0; i < 2; ++i) {
+        int lo = std::min(search.min()[i], search.min()[i] - search.max()[i]);
+        int hi = std::max(search.max()[i], search.max()[i] - search.min()[i]);
+        m_pad_min[i] = window + std::max(-lo, 0);
+        m_pad_max[i] = window + std::max(hi, 0);
+      }
+    }
+
+    inline int32 cols() const { return m_left_image.cols(); }
+    inline int32 rows() const { return m_left_image.rows(); }
+    inline int32 planes() const { return 1; }
+
+    inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+
+    inline pixel_type operator()(double /*i*/, double /*j*/, int32 /*p*/ = 0) const {
+      vw_throw(NoImplErr() << "OptimizedCorrelatorView::operator()(double i, double j, int32 p) has not been implemented.");
+      return pixel_type();
+    }
+
+    OptimizedCorrelator const& correlator() const { return m_correlator; }
+
+    /// \cond INTERNAL
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
+    inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+      BBox2i crop_bbox(bbox.min() - m_pad_min, bbox.max() + m_pad_max);
+      vw_out(DebugMessage, "stereo") << "OptimizedCorrelatorView: rasterizing image block " << bbox
+                                     << " from " << crop_bbox << ".\n";
+
+      // Both images are cropped to the same box, so the disparities
+      // need no adjustment afterwards.
+      typedef ImageView<typename ImageT::pixel_type> crop_type;
+      ImageView<pixel_type> disparity_map;
+      {
+        crop_type left = crop(edge_extend(m_left_image, ZeroEdgeExtension()), crop_bbox);
+        crop_type right = crop(edge_extend(m_right_image, ZeroEdgeExtension()), crop_bbox);
+        disparity_map = m_correlator(left, right, m_preproc_func);
+      }
+
+      // Place the block at the coordinates given by bbox, the same
+      // way CorrelatorView does.
+      return prerasterize_type(disparity_map, BBox2i(-crop_bbox.min().x(), -crop_bbox.min().y(),
+                                                     bbox.width(), bbox.height()));
+    }
+
+    template <class DestT>
+    inline void rasterize(DestT const& dest, BBox2i const& bbox) const {
+      vw::rasterize(prerasterize(bbox), dest, bbox);
+    }
+    /// \endcond
+  };
+
+  /// Returns a lazy disparity map of the left image against the right
+  /// image, computed by correlator one block at a time.
+  template <class ImageT, class PreProcFuncT>
+  OptimizedCorrelatorView<ImageT, PreProcFuncT>
+  optimized_correlator_view(ImageViewBase<ImageT> const& left_image,
+                            ImageViewBase<ImageT> const& right_image,
+                            PreProcFuncT const& preproc_func,
+                            OptimizedCorrelator const& correlator) {
+    return OptimizedCorrelatorView<ImageT, PreProcFuncT>(left_image.impl(), right_image.impl(),
+                                                         preproc_func, correlator);
+  }
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_OPTIMIZED_CORRELATOR_VIEW__
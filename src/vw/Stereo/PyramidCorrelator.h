@@ -15,6 +15,7 @@
 #include <vw/Image/Filter.h>
 #include <vw/Stereo/DisparityMap.h>
 #include <vw/Stereo/OptimizedCorrelator.h>
+#include <vw/Stereo/ImagePyramid.h>
 
 namespace vw {
 namespace stereo {
@@ -31,28 +32,6 @@ namespace stereo {
 
     std::string m_debug_prefix;
 
-    // Reduce the image size by a factor of two by averaging the pixels
-    template <class PixelT>
-    ImageView<PixelT> subsample_by_two(ImageView<PixelT> &img) {
-
-      ImageView<PixelT> outImg(img.cols()/2, img.rows()/2,img.planes());
-      int32 i, j, p;
-
-      for (p = 0; p < outImg.planes() ; p++) {
-        for (i = 0; i < outImg.cols(); i++) {
-          for (j = 0; j < outImg.rows(); j++) {
-            outImg(i,j,p) = 0.0f;
-            outImg(i,j,p) += img(2*i     , 2*j    ,p);
-            outImg(i,j,p) += img(2*i + 1 , 2*j    ,p);
-            outImg(i,j,p) += img(2*i     , 2*j + 1,p);
-            outImg(i,j,p) += img(2*i + 1 , 2*j + 1,p);
-            outImg(i,j,p) /= 4;
-          }
-        }
-      }
-      return outImg;
-    }
-
     template <class PixelT>
     ImageView<PixelT> upsample_by_two(ImageView<PixelT> &img) {
       ImageView<PixelT> outImg(img.cols()*2, img.rows()*2,img.planes());
@@ -68,29 +47,6 @@ namespace stereo {
       return outImg;
     }
 
-    // Reduce the image size by a factor of two by averaging the pixels
-    template <class MaskPixelT>
-    ImageView<MaskPixelT> subsample_mask_by_two(ImageView<MaskPixelT> &img) {
-
-      ImageView<MaskPixelT> outImg(img.cols()/2, img.rows()/2,img.planes());
-      int32 i, j, p;
-
-      for (p = 0; p < outImg.planes() ; p++) {
-        for (i = 0; i < outImg.cols(); i++) {
-          for (j = 0; j < outImg.rows(); j++) {
-            if (!img(2*i     , 2*j    ,p) ||
-                !img(2*i + 1 , 2*j    ,p) ||
-                !img(2*i     , 2*j + 1,p) ||
-                !img(2*i + 1 , 2*j + 1,p) )
-              outImg(i,j,p) =  MaskPixelT();
-            else
-              outImg(i,j,p) = ScalarTypeLimits<MaskPixelT>::highest();
-          }
-        }
-      }
-      return outImg;
-    }
-
     // Iterate over the nominal blocks, creating output blocks for correlation
     BBox2 compute_matching_blocks(BBox2i const& nominal_block, BBox2 search_range,
                                   BBox2i &left_block, BBox2i &right_block);
@@ -117,17 +73,37 @@ namespace stereo {
       return count;
     }
 
+    template <class ChannelT>
+    class BuildPyramidTask : public Task {
+      ImagePyramid<ChannelT> m_pyramid;
+      int m_levels;
+    public:
+      BuildPyramidTask(ImagePyramid<ChannelT> const& pyramid, int levels) :
+        m_pyramid(pyramid), m_levels(levels) {}
+      virtual ~BuildPyramidTask() {}
+      virtual void operator()() { m_pyramid.build(m_levels); }
+    };
+
     // do_correlation()
     //
     // Takes an image pyramid of images and conducts dense stereo
     // matching using a pyramid based approach.
     template <class ChannelT, class PreProcFilterT>
-    ImageView<PixelMask<Vector2f> > do_correlation(std::vector<ImageView<ChannelT> > left_pyramid,
-                                                   std::vector<ImageView<ChannelT> > right_pyramid,
-                                                   std::vector<ImageView<uint8> > left_masks,
-                                                   std::vector<ImageView<uint8> > right_masks,
+    ImageView<PixelMask<Vector2f> > do_correlation(ImagePyramid<ChannelT> const& left_pyramid,
+                                                   ImagePyramid<ChannelT> const& right_pyramid,
                                                    PreProcFilterT const& preproc_filter) {
 
+      // Build whatever levels are missing from both pyramids at once.
+      {
+        TaskGroup group;
+        group.add_task( boost::shared_ptr<Task>(
+          new BuildPyramidTask<ChannelT>(left_pyramid, m_pyramid_levels) ) );
+        group.add_task( boost::shared_ptr<Task>(
+          new BuildPyramidTask<ChannelT>(right_pyramid, m_pyramid_levels) ) );
+        group.join();
+      }
+      int mask_padding = std::max(m_kernel_size[0], m_kernel_size[1])/2;
+
       BBox2 initial_search_range = m_initial_search_range / pow(2.0, m_pyramid_levels-1);
       ImageView<PixelMask<Vector2f> > disparity_map;
 
@@ -142,7 +118,14 @@ namespace stereo {
 
         SubProgressCallback subbar(prog,float(m_pyramid_levels-1-n)/float(m_pyramid_levels), float(m_pyramid_levels-n)/float(m_pyramid_levels));
 
-        ImageView<PixelMask<Vector2f> > new_disparity_map(left_pyramid[n].cols(), left_pyramid[n].rows());
+        ImageView<ChannelT> left_image = left_pyramid.image(n), right_image = right_pyramid.image(n);
+        // The edge masks are rasterized before apply_mask(), which
+        // returns references to the pixels of the view it is given.
+        ImageView<PixelMask<uint8> > left_edge_mask = edge_mask(left_pyramid.mask(n), 0, mask_padding);
+        ImageView<PixelMask<uint8> > right_edge_mask = edge_mask(right_pyramid.mask(n), 0, mask_padding);
+        ImageView<uint8> left_mask = apply_mask(left_edge_mask, 0), right_mask = apply_mask(right_edge_mask, 0);
+
+        ImageView<PixelMask<Vector2f> > new_disparity_map(left_image.cols(), left_image.rows());
 
         // 1. Subdivide disparity map into subregions.  We build up
         //    the disparity map for the level, one subregion at a
@@ -155,7 +138,7 @@ namespace stereo {
         std::vector<BBox2> search_ranges;
         std::vector<BBox2i> nominal_blocks;
         if (n == (m_pyramid_levels-1) ) {
-          nominal_blocks.push_back(BBox2i(0,0,left_pyramid[n].cols(), left_pyramid[n].rows()));
+          nominal_blocks.push_back(BBox2i(0,0,left_image.cols(), left_image.rows()));
           search_ranges.push_back(initial_search_range);
         } else {
           std::vector<vw::uint32> x_kern(m_kernel_size.x()), y_kern(m_kernel_size.y());
@@ -171,7 +154,7 @@ namespace stereo {
           ImageView<PixelMask<uint32> > valid_pad = create_mask(separable_convolution_filter(valid, x_kern, y_kern));
           
           nominal_blocks = subdivide_bboxes(disparity_map, valid_pad,
-                                            BBox2i(0,0,left_pyramid[n].cols(), left_pyramid[n].rows()));
+                                            BBox2i(0,0,left_image.cols(), left_image.rows()));
           search_ranges = compute_search_ranges(disparity_map, nominal_blocks);
         }
 
@@ -192,8 +175,8 @@ namespace stereo {
                                                Vector2i(nominal_blocks[r].max().x()+int(ceil(search_ranges[r].max().x())),
                                                         nominal_blocks[r].max().y()+int(ceil(search_ranges[r].max().y()))));
           BBox2i right_image_bounds = BBox2i(0,0,
-                                             right_pyramid[n].cols(),
-                                             right_pyramid[n].rows());
+                                             right_image.cols(),
+                                             right_image.rows());
           right_image_workarea.crop(right_image_bounds);
           if (right_image_workarea.width() == 0 || right_image_workarea.height() == 0) { continue; }
           BBox2 adjusted_search_range = compute_matching_blocks(nominal_blocks[r], search_ranges[r], left_block, right_block);
@@ -207,8 +190,8 @@ namespace stereo {
 
           // Place this block in the proper place in the complete
           // disparity map.
-          ImageViewRef<ChannelT> block1 = crop(edge_extend(left_pyramid[n],ReflectEdgeExtension()),left_block);
-          ImageViewRef<ChannelT> block2 = crop(edge_extend(right_pyramid[n],ReflectEdgeExtension()),right_block);
+          ImageViewRef<ChannelT> block1 = crop(edge_extend(left_image,ReflectEdgeExtension()),left_block);
+          ImageViewRef<ChannelT> block2 = crop(edge_extend(right_image,ReflectEdgeExtension()),right_block);
           ImageView<PixelMask<Vector2f> > disparity_block;
 
           disparity_block = this->correlate( block1, block2,
@@ -239,7 +222,7 @@ namespace stereo {
                                                                 rm_half_kernel,
                                                                 rm_threshold,
                                                                 rm_min_matches_percent),
-                                             left_masks[n], right_masks[n]);
+                                             left_mask, right_mask);
 
         if (n == m_pyramid_levels - 1) {
           // At the highest level of the pyramid, use the cleaned version
@@ -248,7 +231,7 @@ namespace stereo {
           disparity_map = disparity_map_clean;
         } else if (n == 0) {
           // At the last level, return the raw results from the correlator
-          disparity_map = disparity_mask(new_disparity_map, left_masks[n], right_masks[n]);
+          disparity_map = disparity_mask(new_disparity_map, left_mask, right_mask);
         } else {
           // If we have a missing pixel that correlated properly in the previous
           // pyramid level, use the disparity found at the previous pyramid level
@@ -257,7 +240,7 @@ namespace stereo {
                                      BBox2i(0, 0, disparity_map_clean.cols(), disparity_map_clean.rows()));
           ImageView<PixelMask<Vector2f> > disparity_map_old_diff = invert_mask(intersect_mask(disparity_map_old, disparity_map_clean));
           disparity_map = disparity_mask(create_mask(apply_mask(disparity_map_clean) + apply_mask(disparity_map_old_diff)), 
-                                         left_masks[n], right_masks[n]);
+                                         left_mask, right_mask);
         }
 
         // Debugging output at each level
@@ -351,33 +334,27 @@ namespace stereo {
       // Level n : coarsest (low resolution) image ( n == pyramid_levels - 1 )
       vw_out(DebugMessage, "stereo") << "Initializing pyramid correlator with " << m_pyramid_levels << " levels.\n";
 
-      // Build the image pyramid
-      std::vector<ImageView<channel_type> > left_pyramid(m_pyramid_levels), right_pyramid(m_pyramid_levels);
-      std::vector<ImageView<uint8> > left_masks(m_pyramid_levels), right_masks(m_pyramid_levels);
-
-      left_pyramid[0] = channels_to_planes(left_image);    // Is this really what we want
-      right_pyramid[0] = channels_to_planes(right_image);  // shouldn't we channel cast to
-      left_masks[0] = channels_to_planes(left_mask);       // to scalar?
-      right_masks[0] = channels_to_planes(right_mask);
-
-      // Produce the image pyramid
-      for (int n = 1; n < m_pyramid_levels; ++n) {
-        std::ostringstream ostr;
-        ostr << n;
-
-        left_pyramid[n] = subsample_by_two(left_pyramid[n-1]);
-        right_pyramid[n] = subsample_by_two(right_pyramid[n-1]);
-        left_masks[n] = subsample_mask_by_two(left_masks[n-1]);
-        right_masks[n] = subsample_mask_by_two(right_masks[n-1]);
-      }
+      // Build the image pyramid.  Channels are stored as planes; is
+      // this really what we want, or shouldn't we channel cast to
+      // scalar?
+      ImagePyramid<channel_type> left_pyramid(left_image, left_mask);
+      ImagePyramid<channel_type> right_pyramid(right_image, right_mask);
+      return do_correlation(left_pyramid, right_pyramid, preproc_filter);
+    }
 
-      int mask_padding = std::max(m_kernel_size[0], m_kernel_size[1])/2;
-      for (int n = 0; n < m_pyramid_levels; ++n) {
-        left_masks[n] = apply_mask(edge_mask(left_masks[n], 0, mask_padding),0);
-        right_masks[n] = apply_mask(edge_mask(right_masks[n], 0, mask_padding),0);
-      }
+    /// Correlates two prebuilt image pyramids.  Any levels the
+    /// pyramids are missing are built here (and kept in the pyramids),
+    /// so the same pyramids can be passed to several correlators,
+    /// e.g. to try different search ranges or kernel sizes.
+    template <class ChannelT, class PreProcFilterT>
+    ImageView<PixelMask<Vector2f> > operator() (ImagePyramid<ChannelT> const& left_pyramid,
+                                                ImagePyramid<ChannelT> const& right_pyramid,
+                                                PreProcFilterT const& preproc_filter) {
+      VW_ASSERT(left_pyramid.cols() == right_pyramid.cols() &&
+                left_pyramid.rows() == right_pyramid.rows(),
+                ArgumentErr() << "Correlator(): input image dimensions do not match.");
 
-      return do_correlation(left_pyramid, right_pyramid, left_masks, right_masks, preproc_filter);
+      return do_correlation(left_pyramid, right_pyramid, preproc_filter);
     }
 
   };
@@ -0,0 +1,440 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Stereo/SemiGlobalCorrelator.h>
+#include <vw/Stereo/SlidingWindowCost.h>
+#include <vw/Stereo/Correlate.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#if defined(VW_ENABLE_SSE) && (VW_ENABLE_SSE==1)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VW_SEMI_GLOBAL_AVX2 1
+#endif
+#endif
+
+using namespace vw;
+using namespace vw::stereo;
+
+namespace {
+
+  // The cost of a label that is not a real disparity.  It is larger
+  // than any real aggregated cost, and small enough that adding
+  // penalties to it cannot overflow an int16.
+  const int GUARD_COST = 0x3fff;
+  const int MAX_COST = 1023;
+  const int MAX_PENALTY = 4095;
+
+  // The disparities (labels) of a pixel are stored a row of the
+  // search window at a time, with a guard label after each row, so
+  // that the labels one step away are at +-1 and +-stride.  The label
+  // count is padded with guard labels to a whole number of AVX2
+  // vectors.  Aggregated costs along a path also keep guard labels
+  // on either side, so that the neighbors of every label can be read.
+  struct LabelLayout {
+    int nx, ny, stride, count, guard;
+    LabelLayout(BBox2i const& search_window) :
+      nx(search_window.width() + 1), ny(search_window.height() + 1), stride(nx + 1) {
+      count = (ny * stride + 15) / 16 * 16;
+      guard = (stride + 15) / 16 * 16;
+    }
+  };
+
+  // The sums of the pixels in a row are locked in blocks of this many
+  // pixels.
+  const int LOCK_BLOCK = 16;
+
+  // By default, refuse to allocate more than this for the cost volume
+  // and the path costs.
+  const size_t DEFAULT_MAX_VOLUME_BYTES = size_t(1) << 30;
+
+  struct CostVolume {
+    int cols, rows, blocks;
+    LabelLayout layout;
+    int penalty1, penalty2;
+    std::vector<uint16> cost, sum;
+    boost::scoped_array<Mutex> block_mutex;
+
+    CostVolume(int cols, int rows, BBox2i const& search_window, int penalty1, int penalty2) :
+      cols(cols), rows(rows), blocks((cols + LOCK_BLOCK - 1) / LOCK_BLOCK), layout(search_window),
+      penalty1(penalty1), penalty2(penalty2),
+      cost(size_t(cols) * rows * layout.count, uint16(GUARD_COST)),
+      sum(size_t(cols) * rows * layout.count, 0), block_mutex(new Mutex[size_t(rows) * blocks]) {}
+
+    uint16* cost_at(int x, int y) { return &cost[(size_t(y) * cols + x) * layout.count]; }
+    uint16* sum_at(int x, int y) { return &sum[(size_t(y) * cols + x) * layout.count]; }
+    Mutex& mutex_at(int x, int y) { return block_mutex[size_t(y) * blocks + x / LOCK_BLOCK]; }
+  };
+
+  // Holds the lock on the block of sums that was touched last.
+  class SumLock : private boost::noncopyable {
+    CostVolume &m_volume;
+    Mutex *m_held;
+  public:
+    SumLock(CostVolume &volume) : m_volume(volume), m_held(0) {}
+    ~SumLock() { release(); }
+
+    void at(int x, int y) {
+      Mutex *mutex = &m_volume.mutex_at(x, y);
+      if (mutex == m_held)
+        return;
+      release();
+      mutex->lock();
+      m_held = mutex;
+    }
+
+    void release() {
+      if (m_held)
+        m_held->unlock();
+      m_held = 0;
+    }
+  };
+
+  // The range of x*dy - y*dx over the image.  Pixels with the same
+  // value are on the same path in direction (dx, dy).
+  void path_range(int cols, int rows, int dx, int dy, int &begin, int &end) {
+    begin = std::min(0, (cols - 1) * dy) + std::min(0, -(rows - 1) * dx);
+    end = std::max(0, (cols - 1) * dy) + std::max(0, -(rows - 1) * dx) + 1;
+  }
+
+  // Aggregates the costs of one pixel along a path:
+  //
+  //   out = cost + min(prev, prev[d+-1] + p1, min_prev + p2) - min_prev
+  //
+  // where d+-1 is any label one step away, and adds the result to
+  // sum.  Returns the smallest value written to out.
+  int aggregate(uint16 const* cost, int16 const* prev, int min_prev, int16* out, uint16* sum,
+                int n, int stride, int p1, int p2) {
+    int result = 0x7fff, i = 0;
+#if defined(VW_SEMI_GLOBAL_AVX2)
+    {
+      __m256i vp1 = _mm256_set1_epi16(int16(p1)), vjump = _mm256_set1_epi16(int16(min_prev + p2));
+      __m256i vbase = _mm256_set1_epi16(int16(min_prev)), vmin = _mm256_set1_epi16(0x7fff);
+      for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((__m256i const*)(prev + i));
+        __m256i step = _mm256_min_epi16(_mm256_loadu_si256((__m256i const*)(prev + i - 1)),
+                                        _mm256_loadu_si256((__m256i const*)(prev + i + 1)));
+        step = _mm256_min_epi16(step, _mm256_loadu_si256((__m256i const*)(prev + i - stride)));
+        step = _mm256_min_epi16(step, _mm256_loadu_si256((__m256i const*)(prev + i + stride)));
+        v = _mm256_min_epi16(_mm256_min_epi16(v, _mm256_adds_epi16(step, vp1)), vjump);
+        __m256i l = _mm256_add_epi16(_mm256_sub_epi16(v, vbase),
+                                     _mm256_loadu_si256((__m256i const*)(cost + i)));
+        _mm256_storeu_si256((__m256i*)(out + i), l);
+        _mm256_storeu_si256((__m256i*)(sum + i),
+                            _mm256_adds_epu16(_mm256_loadu_si256((__m256i const*)(sum + i)), l));
+        vmin = _mm256_min_epi16(vmin, l);
+      }
+      int16 lanes[16];
+      _mm256_storeu_si256((__m256i*)lanes, vmin);
+      for (int k = 0; k < 16; ++k)
+        result = std::min(result, int(lanes[k]));
+    }
+#endif
+#if defined(VW_ENABLE_SSE) && (VW_ENABLE_SSE==1)
+    {
+      __m128i vp1 = _mm_set1_epi16(int16(p1)), vjump = _mm_set1_epi16(int16(min_prev + p2));
+      __m128i vbase = _mm_set1_epi16(int16(min_prev)), vmin = _mm_set1_epi16(0x7fff);
+      for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const*)(prev + i));
+        __m128i step = _mm_min_epi16(_mm_loadu_si128((__m128i const*)(prev + i - 1)),
+                                     _mm_loadu_si128((__m128i const*)(prev + i + 1)));
+        step = _mm_min_epi16(step, _mm_loadu_si128((__m128i const*)(prev + i - stride)));
+        step = _mm_min_epi16(step, _mm_loadu_si128((__m128i const*)(prev + i + stride)));
+        v = _mm_min_epi16(_mm_min_epi16(v, _mm_adds_epi16(step, vp1)), vjump);
+        __m128i l = _mm_add_epi16(_mm_sub_epi16(v, vbase), _mm_loadu_si128((__m128i const*)(cost + i)));
+        _mm_storeu_si128((__m128i*)(out + i), l);
+        _mm_storeu_si128((__m128i*)(sum + i), _mm_adds_epu16(_mm_loadu_si128((__m128i const*)(sum + i)), l));
+        vmin = _mm_min_epi16(vmin, l);
+      }
+      int16 lanes[8];
+      _mm_storeu_si128((__m128i*)lanes, vmin);
+      for (int k = 0; k < 8; ++k)
+        result = std::min(result, int(lanes[k]));
+    }
+#endif
+    for (; i < n; ++i) {
+      int step = std::min(std::min(prev[i-1], prev[i+1]), std::min(prev[i-stride], prev[i+stride]));
+      int v = std::min(std::min(int(prev[i]), step + p1), min_prev + p2);
+      int l = cost[i] + v - min_prev;
+      out[i] = int16(l);
+      sum[i] = uint16(std::min(0xffff, sum[i] + l));
+      result = std::min(result, l);
+    }
+    return result;
+  }
+
+  // Computes the window costs for the labels in [begin, end).
+  class CostTask : public Task {
+    CostVolume &m_volume;
+    ImageView<float> const &m_left, &m_right;
+    BBox2i m_search_window;
+    int m_kernel_size, m_begin, m_end;
+    float m_scale;
+  public:
+    CostTask(CostVolume &volume, ImageView<float> const& left, ImageView<float> const& right,
+             BBox2i const& search_window, int kernel_size, float scale, int begin, int end) :
+      m_volume(volume), m_left(left), m_right(right), m_search_window(search_window),
+      m_kernel_size(kernel_size), m_begin(begin), m_end(end), m_scale(scale) {}
+    virtual ~CostTask() {}
+
+    virtual void operator()() {
+      LabelLayout const& layout = m_volume.layout;
+      SlidingWindowCost window_cost(m_kernel_size, ABS_DIFFERENCE_WINDOW_COST);
+      ImageView<float> cost(m_volume.cols, m_volume.rows);
+      for (int label = m_begin; label < m_end; ++label) {
+        int i = label % layout.nx, j = label / layout.nx;
+        window_cost(m_left, BBox2i(0, 0, m_volume.cols, m_volume.rows), m_right,
+                    m_search_window.min() + Vector2i(i, j), cost);
+        int index = j * layout.stride + i;
+        for (int y = 0; y < m_volume.rows; ++y) {
+          float const* row = &cost(0, y);
+          uint16 *dst = m_volume.cost_at(0, y) + index;
+          for (int x = 0; x < m_volume.cols; ++x, dst += layout.count)
+            *dst = uint16(std::min(float(MAX_COST), row[x] * m_scale + 0.5f));
+        }
+      }
+    }
+  };
+
+  // Aggregates along the left-to-right and right-to-left paths for
+  // the rows in [begin, end).
+  class HorizontalPathTask : public Task {
+    CostVolume &m_volume;
+    int m_begin, m_end;
+  public:
+    HorizontalPathTask(CostVolume &volume, int begin, int end) :
+      m_volume(volume), m_begin(begin), m_end(end) {}
+    virtual ~HorizontalPathTask() {}
+
+    virtual void operator()() {
+      LabelLayout const& layout = m_volume.layout;
+      const int size = 2 * layout.guard + layout.count, cols = m_volume.cols;
+      std::vector<int16> zero(size, 0), buffer(2 * size, int16(GUARD_COST));
+      int16 *start = &zero[layout.guard], *pixel[2] = { &buffer[layout.guard], &buffer[size + layout.guard] };
+
+      SumLock lock(m_volume);
+      for (int y = m_begin; y < m_end; ++y) {
+        int min_prev = 0;
+        for (int x = 0; x < cols; ++x) {
+          lock.at(x, y);
+          min_prev = aggregate(m_volume.cost_at(x, y), x == 0 ? start : pixel[(x-1) & 1],
+                               x == 0 ? 0 : min_prev, pixel[x & 1], m_volume.sum_at(x, y),
+                               layout.count, layout.stride, m_volume.penalty1, m_volume.penalty2);
+        }
+        for (int x = cols - 1; x >= 0; --x) {
+          lock.at(x, y);
+          min_prev = aggregate(m_volume.cost_at(x, y), x == cols - 1 ? start : pixel[(x+1) & 1],
+                               x == cols - 1 ? 0 : min_prev, pixel[x & 1], m_volume.sum_at(x, y),
+                               layout.count, layout.stride, m_volume.penalty1, m_volume.penalty2);
+        }
+        lock.release();
+      }
+    }
+  };
+
+  // Aggregates along the paths that step (dx, dy) from one pixel to
+  // the next, where dy is not zero, for the paths whose x*dy - y*dx is
+  // in [begin, end).  Those paths do not share pixels with any other
+  // task in the same direction, so only the last two costs of each
+  // path are kept.  Paths in different directions accumulate into the
+  // same sums, which are locked a block at a time.
+  class PathTask : public Task {
+    CostVolume &m_volume;
+    int m_dx, m_dy, m_begin, m_end;
+  public:
+    PathTask(CostVolume &volume, int dx, int dy, int begin, int end) :
+      m_volume(volume), m_dx(dx), m_dy(dy), m_begin(begin), m_end(end) {}
+    virtual ~PathTask() {}
+
+    virtual void operator()() {
+      LabelLayout const& layout = m_volume.layout;
+      const int size = 2 * layout.guard + layout.count;
+      const int cols = m_volume.cols, rows = m_volume.rows, paths = m_end - m_begin;
+      std::vector<int16> zero(size, 0), buffer(size_t(paths) * 2 * size, int16(GUARD_COST));
+      std::vector<int> mins(paths, 0), steps(paths, 0);
+      SumLock lock(m_volume);
+
+      for (int n = 0; n < rows; ++n) {
+        int y = m_dy > 0 ? n : rows - 1 - n;
+        for (int x = 0; x < cols; ++x) {
+          int path = x * m_dy - y * m_dx - m_begin;
+          if (path < 0 || path >= paths)
+            continue;
+          // The first pixel of a path has no predecessor in the image.
+          int16 *costs = &buffer[size_t(path) * 2 * size + layout.guard];
+          int step = steps[path]++;
+          int16 const* prev = step == 0 ? &zero[layout.guard] : costs + ((step - 1) & 1) * size;
+          lock.at(x, y);
+          mins[path] = aggregate(m_volume.cost_at(x, y), prev, mins[path], costs + (step & 1) * size,
+                                 m_volume.sum_at(x, y), layout.count, layout.stride,
+                                 m_volume.penalty1, m_volume.penalty2);
+        }
+        lock.release();
+      }
+    }
+  };
+
+  // The pixels whose windows stay inside the other image for every
+  // disparity in the search window.
+  BBox2i valid_bbox(int cols, int rows, BBox2i const& search_window, int kernel_size) {
+    int half = kernel_size / 2;
+    return BBox2i(Vector2i(std::max(0, -search_window.min().x()) + half,
+                           std::max(0, -search_window.min().y()) + half),
+                  Vector2i(cols - std::max(0, search_window.max().x()) - half,
+                           rows - std::max(0, search_window.max().y()) - half));
+  }
+
+} // namespace
+
+vw::stereo::SemiGlobalCorrelator::SemiGlobalCorrelator(BBox2i const& search_window, int kernel_size,
+                                                       float cross_correlation_threshold,
+                                                       int num_paths, int penalty1, int penalty2) :
+  m_search_window(search_window), m_kern_size(kernel_size),
+  m_cross_correlation_threshold(cross_correlation_threshold),
+  m_num_paths(num_paths), m_penalty1(penalty1), m_penalty2(penalty2),
+  m_max_volume_bytes(DEFAULT_MAX_VOLUME_BYTES) {
+  VW_ASSERT(num_paths == 8 || num_paths == 16,
+            ArgumentErr() << "SemiGlobalCorrelator: the number of paths must be 8 or 16.");
+  VW_ASSERT(0 <= penalty1 && penalty1 <= penalty2 && penalty2 <= MAX_PENALTY,
+            ArgumentErr() << "SemiGlobalCorrelator: the penalties must satisfy 0 <= penalty1 <= penalty2 <= "
+            << MAX_PENALTY << ".");
+}
+
+size_t vw::stereo::SemiGlobalCorrelator::default_max_volume_bytes() {
+  return DEFAULT_MAX_VOLUME_BYTES;
+}
+
+size_t vw::stereo::SemiGlobalCorrelator::volume_bytes(int cols, int rows) const {
+  // Every label of every pixel takes four bytes, and each direction
+  // keeps two rows of labels per path, of which there are at most
+  // 2*(cols + rows).
+  const int num_directions = m_num_paths == 16 ? 14 : 6;
+  LabelLayout layout(m_search_window);
+  const size_t label_bytes = 2 * sizeof(uint16) * (2 * layout.guard + layout.count);
+  return size_t(cols) * rows * label_bytes +
+    size_t(num_directions) * 2 * (cols + rows) * label_bytes;
+}
+
+ImageView<PixelMask<Vector2f> >
+vw::stereo::SemiGlobalCorrelator::correlate(ImageView<float> const& left_image,
+                                            ImageView<float> const& right_image) const {
+  VW_ASSERT(left_image.cols() == right_image.cols() && left_image.rows() == right_image.rows(),
+            ArgumentErr() << "SemiGlobalCorrelator: primary and secondary image dimensions do not agree.");
+  const int cols = left_image.cols(), rows = left_image.rows();
+  const int num_directions = m_num_paths == 16 ? 14 : 6;
+
+  LabelLayout layout(m_search_window);
+  const size_t bytes = volume_bytes(cols, rows);
+  if (bytes > m_max_volume_bytes)
+    vw_throw( ArgumentErr() << "SemiGlobalCorrelator: a " << cols << "x" << rows << " image with a "
+              << m_search_window.width() << "x" << m_search_window.height()
+              << " search window needs " << bytes / (1 << 20) << " MB, more than the limit of "
+              << m_max_volume_bytes / (1 << 20) << " MB.  Use a smaller search window or block size." );
+
+  CostVolume volume(cols, rows, m_search_window, m_penalty1, m_penalty2);
+
+  // Quantize the costs so that a difference of half the range of the
+  // images maps to MAX_COST.
+  float lo = ScalarTypeLimits<float>::highest(), hi = ScalarTypeLimits<float>::lowest();
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x) {
+      lo = std::min(lo, std::min(left_image(x, y), right_image(x, y)));
+      hi = std::max(hi, std::max(left_image(x, y), right_image(x, y)));
+    }
+  float scale = hi > lo ? 2.0f * MAX_COST / (hi - lo) : 0.0f;
+
+  int num_threads = vw_thread_pool().num_threads();
+  {
+    TaskGroup group;
+    int num_labels = layout.nx * layout.ny;
+    int chunk = std::max(1, (num_labels + num_threads - 1) / num_threads);
+    for (int begin = 0; begin < num_labels; begin += chunk)
+      group.add_task( boost::shared_ptr<Task>(
+        new CostTask(volume, left_image, right_image, m_search_window, m_kern_size, scale,
+                     begin, std::min(num_labels, begin + chunk)) ) );
+    group.join();
+  }
+
+  // The horizontal paths are independent from row to row, so they
+  // run in groups of scanlines.  The paths in every other direction
+  // are split between tasks the same way.
+  {
+    static const int directions[][2] = { {0,1}, {1,1}, {-1,1}, {0,-1}, {1,-1}, {-1,-1},
+                                         {1,2}, {-1,2}, {2,1}, {-2,1},
+                                         {1,-2}, {-1,-2}, {2,-1}, {-2,-1} };
+    TaskGroup group;
+    for (int d = 0; d < num_directions; ++d) {
+      int first, last;
+      path_range(cols, rows, directions[d][0], directions[d][1], first, last);
+      int chunk = std::max(1, (last - first + num_threads - 1) / num_threads);
+      for (int begin = first; begin < last; begin += chunk)
+        group.add_task( boost::shared_ptr<Task>(
+          new PathTask(volume, directions[d][0], directions[d][1], begin, std::min(last, begin + chunk)) ) );
+    }
+    int chunk = std::max(1, (rows + 2 * num_threads - 1) / (2 * num_threads));
+    for (int begin = 0; begin < rows; begin += chunk)
+      group.add_task( boost::shared_ptr<Task>(
+        new HorizontalPathTask(volume, begin, std::min(rows, begin + chunk)) ) );
+    group.join();
+  }
+
+  // Pick the disparity with the smallest aggregated cost, from left
+  // to right and from right to left.
+  ImageView<PixelMask<Vector2f> > l2r(cols, rows), r2l(cols, rows);
+  BBox2i l2r_bbox = valid_bbox(cols, rows, m_search_window, m_kern_size);
+  BBox2i r2l_bbox = valid_bbox(cols, rows, BBox2i(-m_search_window.max(), -m_search_window.min()),
+                               m_kern_size);
+  for (int y = 0; y < rows; ++y)
+    for (int x = 0; x < cols; ++x) {
+      invalidate(l2r(x, y));
+      invalidate(r2l(x, y));
+    }
+
+  for (int y = l2r_bbox.min().y(); y < l2r_bbox.max().y(); ++y)
+    for (int x = l2r_bbox.min().x(); x < l2r_bbox.max().x(); ++x) {
+      uint16 const* sum = volume.sum_at(x, y);
+      int best = 0xffff, worst = 0, best_i = 0, best_j = 0;
+      for (int j = 0; j < layout.ny; ++j)
+        for (int i = 0; i < layout.nx; ++i) {
+          int s = sum[j * layout.stride + i];
+          if (s < best) { best = s; best_i = i; best_j = j; }
+          worst = std::max(worst, s);
+        }
+      if (best < worst) {
+        l2r(x, y) = Vector2f(m_search_window.min().x() + best_i, m_search_window.min().y() + best_j);
+        validate(l2r(x, y));
+      }
+    }
+
+  for (int y = r2l_bbox.min().y(); y < r2l_bbox.max().y(); ++y)
+    for (int x = r2l_bbox.min().x(); x < r2l_bbox.max().x(); ++x) {
+      int best = 0xffff, worst = 0;
+      Vector2i best_d;
+      for (int j = 0; j < layout.ny; ++j)
+        for (int i = 0; i < layout.nx; ++i) {
+          Vector2i d = m_search_window.min() + Vector2i(i, j);
+          int s = volume.sum_at(x - d.x(), y - d.y())[j * layout.stride + i];
+          if (s < best) { best = s; best_d = d; }
+          worst = std::max(worst, s);
+        }
+      if (best < worst) {
+        r2l(x, y) = Vector2f(-best_d.x(), -best_d.y());
+        validate(r2l(x, y));
+      }
+    }
+
+  cross_corr_consistency_check(l2r, r2l, m_cross_correlation_threshold, false);
+  return l2r;
+}
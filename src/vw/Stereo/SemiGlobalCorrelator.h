@@ -0,0 +1,107 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file SemiGlobalCorrelator.h
+///
+/// Semi-global matching.  Window costs are computed for every
+/// disparity in the search window and stored, quantized to 16 bits,
+/// in a cost volume.  The costs are then aggregated along 8 or 16
+/// straight paths through the image, each of which penalizes
+/// disparity changes between neighboring pixels: penalty1 for a step
+/// of one pixel (horizontally or vertically) in disparity, and
+/// penalty2 for anything larger.  The disparity with the smallest
+/// aggregated cost wins.  Because the smoothness constraint carries
+/// information across low texture areas, a small kernel is usually
+/// enough, and a single pass can stand in for several levels of the
+/// PyramidCorrelator.
+///
+/// Costs are quantized so that a mean absolute difference of half the
+/// range of the (preprocessed) images is 1023; larger differences are
+/// clamped there.  The penalties are in the same units.
+///
+/// The cost volume and the aggregated costs take four bytes per pixel
+/// per disparity, so this is meant to be run a block at a time,
+/// e.g. by the CorrelatorView, which splits its blocks into tiles
+/// small enough to fit.  correlate() throws an ArgumentErr rather
+/// than allocate more than max_volume_bytes() (1 GB by default) for
+/// them; volume_bytes() tells how much a pair of images needs.
+///
+/// The window costs are computed on the thread pool a range of
+/// disparities at a time.  The paths in each direction are split
+/// between tasks, which accumulate into the shared sums under a lock
+/// per block of 16 pixels.  The aggregation is vectorized with SSE2
+/// (or AVX2, if the compiler targets it) when VisionWorkbench is
+/// configured with --enable-sse.
+///
+#ifndef __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
+#define __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/PixelMask.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Math/BBox.h>
+
+namespace vw {
+namespace stereo {
+
+  class SemiGlobalCorrelator {
+    BBox2i m_search_window;
+    int m_kern_size;
+    float m_cross_correlation_threshold;
+    int m_num_paths;
+    int m_penalty1, m_penalty2;
+    size_t m_max_volume_bytes;
+
+  public:
+    SemiGlobalCorrelator(BBox2i const& search_window, int kernel_size,
+                         float cross_correlation_threshold,
+                         int num_paths = 8, int penalty1 = 16, int penalty2 = 128);
+
+    BBox2i search_window() const { return m_search_window; }
+    int kernel_size() const { return m_kern_size; }
+    int num_paths() const { return m_num_paths; }
+    int penalty1() const { return m_penalty1; }
+    int penalty2() const { return m_penalty2; }
+
+    /// The most that correlate() will allocate for the cost volume
+    /// and the path costs.
+    static size_t default_max_volume_bytes();
+    void set_max_volume_bytes(size_t bytes) { m_max_volume_bytes = bytes; }
+    size_t max_volume_bytes() const { return m_max_volume_bytes; }
+
+    /// The number of bytes that correlating a pair of images of the
+    /// given size takes for the cost volume and the path costs.
+    size_t volume_bytes(int cols, int rows) const;
+
+    /// Correlates two preprocessed images of the same size, and cross
+    /// checks the result against the right to left disparities read
+    /// from the same aggregated costs.
+    ImageView<PixelMask<Vector2f> > correlate(ImageView<float> const& left_image,
+                                              ImageView<float> const& right_image) const;
+
+    template <class ViewT, class PreProcFilterT>
+    ImageView<PixelMask<Vector2f> > operator()(ImageViewBase<ViewT> const& image0,
+                                               ImageViewBase<ViewT> const& image1,
+                                               PreProcFilterT const& preproc_filter) const {
+      if ((image0.impl().cols() != image1.impl().cols()) ||
+          (image0.impl().rows() != image1.impl().rows())) {
+        vw_throw( ArgumentErr() << "Primary and secondary image dimensions do not agree!" );
+      }
+      if (!(image0.channels() == 1 && image0.impl().planes() == 1 &&
+            image1.channels() == 1 && image1.impl().planes() == 1)) {
+        vw_throw( ArgumentErr() << "Both images must be single channel/single plane images!" );
+      }
+
+      ImageView<float> left_image = pixel_cast<float>(preproc_filter(image0));
+      ImageView<float> right_image = pixel_cast<float>(preproc_filter(image1));
+      return this->correlate(left_image, right_image);
+    }
+  };
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_SEMI_GLOBAL_CORRELATOR_H__
@@ -0,0 +1,189 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+#include <vw/Stereo/SlidingWindowCost.h>
+#include <vw/Core/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(VW_ENABLE_SSE) && (VW_ENABLE_SSE==1)
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VW_SLIDING_WINDOW_AVX 1
+#endif
+#endif
+
+using namespace vw;
+using namespace vw::stereo;
+
+namespace {
+
+  template <int TypeT>
+  inline float pixel_cost(float a, float b) {
+    switch (TypeT) {
+    case ABS_DIFFERENCE_WINDOW_COST: return fabsf(a - b);
+    case SQ_DIFFERENCE_WINDOW_COST:  { float d = a - b; return d * d; }
+    case PRODUCT_WINDOW_COST:        return a * b;
+    default:                         return a;
+    }
+  }
+
+#if defined(VW_ENABLE_SSE) && (VW_ENABLE_SSE==1)
+  template <int TypeT>
+  inline __m128 pixel_cost(__m128 a, __m128 b) {
+    switch (TypeT) {
+    case ABS_DIFFERENCE_WINDOW_COST: return _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(a, b));
+    case SQ_DIFFERENCE_WINDOW_COST:  { __m128 d = _mm_sub_ps(a, b); return _mm_mul_ps(d, d); }
+    case PRODUCT_WINDOW_COST:        return _mm_mul_ps(a, b);
+    default:                         return a;
+    }
+  }
+#endif
+
+#if defined(VW_SLIDING_WINDOW_AVX)
+  template <int TypeT>
+  inline __m256 pixel_cost(__m256 a, __m256 b) {
+    switch (TypeT) {
+    case ABS_DIFFERENCE_WINDOW_COST: return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(a, b));
+    case SQ_DIFFERENCE_WINDOW_COST:  { __m256 d = _mm256_sub_ps(a, b); return _mm256_mul_ps(d, d); }
+    case PRODUCT_WINDOW_COST:        return _mm256_mul_ps(a, b);
+    default:                         return a;
+    }
+  }
+#endif
+
+  // Computes the cost of a new row of the window, adds it to the
+  // column sums, and subtracts the row it replaces in the ring.
+  template <int TypeT>
+  void slide_row(float const* a, float const* b, float* ring, float* sums, int n) {
+    int i = 0;
+#if defined(VW_SLIDING_WINDOW_AVX)
+    for (; i + 8 <= n; i += 8) {
+      __m256 v = pixel_cost<TypeT>(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i));
+      __m256 s = _mm256_add_ps(_mm256_loadu_ps(sums+i), _mm256_sub_ps(v, _mm256_loadu_ps(ring+i)));
+      _mm256_storeu_ps(sums+i, s);
+      _mm256_storeu_ps(ring+i, v);
+    }
+#endif
+#if defined(VW_ENABLE_SSE) && (VW_ENABLE_SSE==1)
+    for (; i + 4 <= n; i += 4) {
+      __m128 v = pixel_cost<TypeT>(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+      __m128 s = _mm_add_ps(_mm_loadu_ps(sums+i), _mm_sub_ps(v, _mm_loadu_ps(ring+i)));
+      _mm_storeu_ps(sums+i, s);
+      _mm_storeu_ps(ring+i, v);
+    }
+#endif
+    for (; i < n; ++i) {
+      float v = pixel_cost<TypeT>(a[i], b[i]);
+      sums[i] += v - ring[i];
+      ring[i] = v;
+    }
+  }
+
+  typedef void (*slide_row_func)(float const*, float const*, float*, float*, int);
+
+  slide_row_func slide_row_for(SlidingWindowCostType type) {
+    switch (type) {
+    case ABS_DIFFERENCE_WINDOW_COST: return &slide_row<ABS_DIFFERENCE_WINDOW_COST>;
+    case SQ_DIFFERENCE_WINDOW_COST:  return &slide_row<SQ_DIFFERENCE_WINDOW_COST>;
+    case PRODUCT_WINDOW_COST:        return &slide_row<PRODUCT_WINDOW_COST>;
+    default:                         return &slide_row<IDENTITY_WINDOW_COST>;
+    }
+  }
+
+} // namespace
+
+vw::stereo::SlidingWindowCost::SlidingWindowCost(int kernel_size, SlidingWindowCostType type) :
+  m_kernel_size(kernel_size), m_type(type) {
+  VW_ASSERT(kernel_size > 0, ArgumentErr() << "SlidingWindowCost: kernel size must be positive.");
+}
+
+// Points row at width pixels of image starting at (x, y).  Rows that
+// run off of the image are copied into buffer and padded with zeros.
+void vw::stereo::SlidingWindowCost::fetch_row(ImageView<float> const& image, int x, int y, int width,
+                                              std::vector<float> &buffer, float const*& row) const {
+  if (y >= 0 && y < image.rows() && x >= 0 && x + width <= image.cols()) {
+    row = &image(x, y);
+    return;
+  }
+  std::fill(buffer.begin(), buffer.end(), 0.0f);
+  if (y >= 0 && y < image.rows()) {
+    int begin = std::max(x, 0), end = std::min(x + width, image.cols());
+    if (begin < end)
+      std::copy(&image(begin, y), &image(begin, y) + (end - begin), &buffer[begin - x]);
+  }
+  row = &buffer[0];
+}
+
+void vw::stereo::SlidingWindowCost::operator()(ImageView<float> const& a, BBox2i const& a_bbox,
+                                               ImageView<float> const& b, Vector2i const& b_offset,
+                                               ImageView<float> &dst) {
+  const int width = a_bbox.width(), height = a_bbox.height();
+  const int k = m_kernel_size, half = k / 2;
+  VW_ASSERT(dst.cols() == width && dst.rows() == height,
+            ArgumentErr() << "SlidingWindowCost: destination size (" << dst.cols() << " " << dst.rows()
+            << ") does not match window size (" << width << " " << height << ").");
+
+  if (width <= k || height <= k) {
+    std::fill(dst.data(), dst.data() + width * height, 0.0f);
+    return;
+  }
+
+  m_col_sums.assign(width, 0.0f);
+  m_ring.assign(k * width, 0.0f);
+  m_a_row.resize(width);
+  m_b_row.resize(width);
+
+  slide_row_func slide = slide_row_for(m_type);
+  const float scale = 1.0f / float(k * k);
+  const int ax = a_bbox.min().x(), ay = a_bbox.min().y();
+  const int bx = ax + b_offset.x(), by = ay + b_offset.y();
+  float const *a_row, *b_row;
+
+  // Seed the column sums with the first kernel_size rows.
+  for (int y = 0; y < k; ++y) {
+    fetch_row(a, ax, ay + y, width, m_a_row, a_row);
+    if (m_type == IDENTITY_WINDOW_COST)
+      b_row = a_row;
+    else
+      fetch_row(b, bx, by + y, width, m_b_row, b_row);
+    slide(a_row, b_row, &m_ring[y * width], &m_col_sums[0], width);
+  }
+
+  std::fill(dst.data(), dst.data() + half * width, 0.0f);
+  for (int y = 0; y < height - k; ++y) {
+    // Run the row sum across the column sums.
+    float *out = &dst(0, y + half);
+    float row_sum = 0;
+    for (int i = 0; i < k; ++i)
+      row_sum += m_col_sums[i];
+    std::fill(out, out + half, 0.0f);
+    for (int x = 0; x < width - k; ++x) {
+      out[x + half] = row_sum * scale;
+      row_sum += m_col_sums[x + k] - m_col_sums[x];
+    }
+    std::fill(out + width - k + half, out + width, 0.0f);
+
+    // Slide the window down a row.
+    fetch_row(a, ax, ay + y + k, width, m_a_row, a_row);
+    if (m_type == IDENTITY_WINDOW_COST)
+      b_row = a_row;
+    else
+      fetch_row(b, bx, by + y + k, width, m_b_row, b_row);
+    slide(a_row, b_row, &m_ring[(y % k) * width], &m_col_sums[0], width);
+  }
+  std::fill(&dst(0, height - k + half), dst.data() + width * height, 0.0f);
+}
+
+ImageView<float> vw::stereo::box_filter_mean(ImageView<float> const& image, int kernel_size) {
+  ImageView<float> result(image.cols(), image.rows());
+  SlidingWindowCost filter(kernel_size, IDENTITY_WINDOW_COST);
+  filter(image, BBox2i(0, 0, image.cols(), image.rows()), image, Vector2i(), result);
+  return result;
+}
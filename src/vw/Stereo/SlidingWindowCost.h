@@ -0,0 +1,70 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file SlidingWindowCost.h
+///
+/// Computes box-filtered per-pixel costs between two float images
+/// with running sums, in place, without building a cost image for the
+/// whole window first.  This is the inner loop of the cost functions
+/// in OptimizedCorrelator.h.
+///
+/// The per-row arithmetic is vectorized with SSE (or AVX, if the
+/// compiler targets it) when VisionWorkbench is configured with
+/// --enable-sse, and falls back to plain C++ otherwise.
+///
+#ifndef __VW_STEREO_SLIDING_WINDOW_COST_H__
+#define __VW_STEREO_SLIDING_WINDOW_COST_H__
+
+#include <vw/Image/ImageView.h>
+#include <vw/Math/BBox.h>
+
+#include <vector>
+
+namespace vw {
+namespace stereo {
+
+  /// The per-pixel cost that is summed over the window.
+  enum SlidingWindowCostType {
+    IDENTITY_WINDOW_COST,        ///< a
+    ABS_DIFFERENCE_WINDOW_COST,  ///< |a - b|
+    SQ_DIFFERENCE_WINDOW_COST,   ///< (a - b)^2
+    PRODUCT_WINDOW_COST          ///< a * b
+  };
+
+  class SlidingWindowCost {
+    int m_kernel_size;
+    SlidingWindowCostType m_type;
+    std::vector<float> m_col_sums, m_ring, m_a_row, m_b_row;
+
+    void fetch_row(ImageView<float> const& image, int x, int y, int width,
+                   std::vector<float> &buffer, float const*& row) const;
+
+  public:
+    SlidingWindowCost(int kernel_size, SlidingWindowCostType type);
+
+    int kernel_size() const { return m_kernel_size; }
+    SlidingWindowCostType type() const { return m_type; }
+
+    /// Computes the mean cost over each kernel_size x kernel_size
+    /// window between a, cropped to a_bbox, and b, cropped to a_bbox
+    /// shifted by b_offset.  Both images are zero outside of their
+    /// bounds, and b is ignored for IDENTITY_WINDOW_COST.  The result
+    /// is written to dst at the window centers; pixels of dst within
+    /// half a kernel of its edge are set to zero.  dst must already
+    /// be the size of a_bbox.
+    void operator()(ImageView<float> const& a, BBox2i const& a_bbox,
+                    ImageView<float> const& b, Vector2i const& b_offset,
+                    ImageView<float> &dst);
+  };
+
+  /// Returns the mean of image over each kernel_size x kernel_size
+  /// window, with the same edge conventions as SlidingWindowCost.
+  ImageView<float> box_filter_mean(ImageView<float> const& image, int kernel_size);
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_SLIDING_WINDOW_COST_H__
@@ -6,12 +6,50 @@
 
 
 #include <vw/Camera/CameraModel.h>
+#include <vw/Camera/PinholeModel.h>
+#include <vw/Camera/CAHVModel.h>
+#include <vw/Camera/LensDistortion.h>
 #include <vw/Stereo/StereoModel.h>
 #include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
+
+#include <vector>
 
 using namespace vw;
 using namespace vw::stereo;
 
+namespace {
+
+  // Some camera models map pixels to rays linearly: the ray through
+  // pixel (x,y) points along matrix * (x,y,1), normalized.  Returns
+  // false for any other kind of camera.
+  bool linear_ray_matrix(camera::CameraModel const* camera, Matrix3x3 &matrix) {
+    if (camera::PinholeModel const* pinhole = dynamic_cast<camera::PinholeModel const*>(camera)) {
+      if (!dynamic_cast<camera::NullLensDistortion const*>(pinhole->lens_distortion()))
+        return false;
+      // PinholeModel::pixel_to_vector() scales the pixel by the pixel
+      // pitch before applying the inverse camera matrix.
+      matrix = inverse(submatrix(pinhole->camera_matrix(), 0, 0, 3, 3));
+      select_col(matrix, 0) *= pinhole->pixel_pitch();
+      select_col(matrix, 1) *= pinhole->pixel_pitch();
+      return true;
+    }
+    if (camera::CAHVModel const* cahv = dynamic_cast<camera::CAHVModel const*>(camera)) {
+      // CAHVModel::pixel_to_vector() takes (V - y A) x (H - x A),
+      // which expands to the following since A x A is zero, and then
+      // flips it for left handed models.
+      select_col(matrix, 0) = -cross_prod(cahv->V, cahv->A);
+      select_col(matrix, 1) = -cross_prod(cahv->A, cahv->H);
+      select_col(matrix, 2) = cross_prod(cahv->V, cahv->H);
+      if (dot_prod(cross_prod(cahv->V, cahv->H), cahv->A) < 0.0)
+        matrix *= -1.0;
+      return true;
+    }
+    return false;
+  }
+
+} // namespace
+
 ImageView<Vector3> StereoModel::operator()(ImageView<PixelMask<Vector2f> > const& disparity_map,
                                            ImageView<double> &error) const {
 
@@ -21,23 +59,14 @@ ImageView<Vector3> StereoModel::operator()(ImageView<PixelMask<Vector2f> > const
   int point_count = 0;
   int divergent = 0;
 
-  // Allocate xyz image and get pointer to buffer
-  ImageView<Vector3> xyz(disparity_map.cols(), disparity_map.rows());
-  error.set_size(disparity_map.cols(), disparity_map.rows());
-
   // Compute 3D position for each pixel in the disparity map
   vw_out() << "StereoModel: Applying camera models\n";
+  ImageView<Vector3> xyz;
+  (*this)(disparity_map, Vector2i(), xyz, error);
+
   for (int32 y = 0; y < disparity_map.rows(); y++) {
-    if (y % 100 == 0) {
-      printf("\tStereoModel computing points: %0.2f%% complete.\r", 100.0f*float(y)/disparity_map.rows());
-      fflush(stdout);
-    }
     for (int32 x = 0; x < disparity_map.cols(); x++) {
       if ( is_valid(disparity_map(x,y)) ) {
-        xyz(x,y) = (*this)(Vector2( x, y),
-                           Vector2( x+disparity_map(x,y)[0], y+disparity_map(x,y)[1]),
-                           error(x,y) );
-
         if (error(x,y) >= 0) {
           // Keep track of error statistics
           if (error(x,y) > max_error)
@@ -49,11 +78,8 @@ ImageView<Vector3> StereoModel::operator()(ImageView<PixelMask<Vector2f> > const
           xyz(x,y) = Vector3();
           divergent++;
         }
-      } else {
-        xyz(x,y) = Vector3();
-        error(x,y) = 0;
-      }
       }
+    }
   }
 
   if (divergent != 0)
@@ -67,6 +93,62 @@ ImageView<Vector3> StereoModel::operator()(ImageView<PixelMask<Vector2f> > const
 }
 
 
+void StereoModel::operator()(ImageView<PixelMask<Vector2f> > const& disparity_map,
+                             Vector2i const& origin,
+                             ImageView<Vector3> &xyz, ImageView<double> &error ) const {
+  xyz.set_size(disparity_map.cols(), disparity_map.rows());
+  error.set_size(disparity_map.cols(), disparity_map.rows());
+
+  Matrix3x3 rays1, rays2;
+  if (!linear_ray_matrix(m_camera1, rays1) || !linear_ray_matrix(m_camera2, rays2)) {
+    for (int32 y = 0; y < disparity_map.rows(); y++) {
+      for (int32 x = 0; x < disparity_map.cols(); x++) {
+        if ( is_valid(disparity_map(x,y)) ) {
+          Vector2 pix1( origin.x() + x, origin.y() + y );
+          xyz(x,y) = (*this)(pix1, pix1 + remove_mask(disparity_map(x,y)), error(x,y));
+        } else {
+          xyz(x,y) = Vector3();
+          error(x,y) = 0;
+        }
+      }
+    }
+    return;
+  }
+
+  // The rays through the first image are the sum of a term that
+  // depends only on the column and one that depends only on the row.
+  // The column terms are tabulated once for the block.
+  Vector3 originA = m_camera1->camera_center(Vector2());
+  Vector3 originB = m_camera2->camera_center(Vector2());
+  std::vector<Vector3> column_rays(disparity_map.cols());
+  for (int32 x = 0; x < disparity_map.cols(); x++)
+    column_rays[x] = double(origin.x() + x) * select_col(rays1, 0);
+
+  for (int32 y = 0; y < disparity_map.rows(); y++) {
+    Vector3 row_ray = double(origin.y() + y) * select_col(rays1, 1) + select_col(rays1, 2);
+    PixelMask<Vector2f> const* disparity = &disparity_map(0,y);
+    Vector3 *point = &xyz(0,y);
+    double *point_error = &error(0,y);
+
+    for (int32 x = 0; x < disparity_map.cols(); x++) {
+      if ( !is_valid(disparity[x]) ) {
+        point[x] = Vector3();
+        point_error[x] = 0;
+        continue;
+      }
+
+      double xB = origin.x() + x + double(disparity[x][0]);
+      double yB = origin.y() + y + double(disparity[x][1]);
+      Vector3 vecFromA = normalize(column_rays[x] + row_ray);
+      Vector3 vecFromB = normalize(Vector3(rays2(0,0)*xB + rays2(0,1)*yB + rays2(0,2),
+                                           rays2(1,0)*xB + rays2(1,1)*yB + rays2(1,2),
+                                           rays2(2,0)*xB + rays2(2,1)*yB + rays2(2,2)));
+      point[x] = triangulate_rays(originA, vecFromA, originB, vecFromB, point_error[x]);
+    }
+  }
+}
+
+
 Vector3 StereoModel::operator()(Vector2 const& pix1,
                                 Vector2 const& pix2, double& error ) const {
 
@@ -74,36 +156,9 @@ Vector3 StereoModel::operator()(Vector2 const& pix1,
     // determine range by triangulation
     Vector3 vecFromA = m_camera1->pixel_to_vector(pix1);
     Vector3 vecFromB = m_camera2->pixel_to_vector(pix2);
-
-    // If vecFromA and vecFromB are nearly parallel, there will be
-    // very large numerical uncertainty about where to place the
-    // point.  We set a threshold here to reject points that are
-    // on nearly parallel rays.  The threshold of 1e-4 corresponds
-    // to a convergence of less than theta = 0.81 degrees, so if
-    // the two rays are within 0.81 degrees of being parallel, we
-    // reject this point.
-    //
-    // This threshold was chosen empirically for now, but should
-    // probably be revisited once a more rigorous analysis has
-    // been completed. -mbroxton (11-MAR-07)
-    if ( 1-dot_prod(vecFromA, vecFromB) < 1e-4) {
-      error = 0;
-      return Vector3();
-    }
-
-    Vector3 originA = m_camera1->camera_center(pix1);
-    Vector3 originB = m_camera2->camera_center(pix2);
-    Vector3 result =  triangulate_point(originA, vecFromA,
-                                        originB, vecFromB,
-                                        error);
-
-    // Reflect points that fall behind one of the two cameras
-    if ( dot_prod(result - originA, vecFromA) < 0 ||
-         dot_prod(result - originB, vecFromB) < 0 ) {
-      result = -result + 2*originA;
-    }
-
-    return result;
+    return triangulate_rays(m_camera1->camera_center(pix1), vecFromA,
+                            m_camera2->camera_center(pix2), vecFromB,
+                            error);
 
   } catch (vw::camera::PixelToRayErr &/*e*/) {
     error = 0;
@@ -111,9 +166,40 @@ Vector3 StereoModel::operator()(Vector2 const& pix1,
   }
 }
 
+Vector3 StereoModel::triangulate_rays(Vector3 const& originA, Vector3 const& vecFromA,
+                                      Vector3 const& originB, Vector3 const& vecFromB,
+                                      double& error) const {
+  // If vecFromA and vecFromB are nearly parallel, there will be
+  // very large numerical uncertainty about where to place the
+  // point.  We set a threshold here to reject points that are
+  // on nearly parallel rays.  The threshold of 1e-4 corresponds
+  // to a convergence of less than theta = 0.81 degrees, so if
+  // the two rays are within 0.81 degrees of being parallel, we
+  // reject this point.
+  //
+  // This threshold was chosen empirically for now, but should
+  // probably be revisited once a more rigorous analysis has
+  // been completed. -mbroxton (11-MAR-07)
+  if ( 1-dot_prod(vecFromA, vecFromB) < 1e-4) {
+    error = 0;
+    return Vector3();
+  }
+
+  Vector3 result =  triangulate_point(originA, vecFromA,
+                                      originB, vecFromB,
+                                      error);
+
+  // Reflect points that fall behind one of the two cameras
+  if ( dot_prod(result - originA, vecFromA) < 0 ||
+       dot_prod(result - originB, vecFromB) < 0 ) {
+    result = -result + 2*originA;
+  }
+
+  return result;
+}
+
 double StereoModel::convergence_angle(Vector2 const& pix1, Vector2 const& pix2) const {
   Vector3 vecFromA = m_camera1->pixel_to_vector(pix1);
   Vector3 vecFromB = m_camera2->pixel_to_vector(pix2);
   return acos(dot_prod(vecFromA, vecFromB));
 }
-
@@ -40,6 +40,17 @@ namespace stereo {
     ImageView<Vector3> operator()(ImageView<PixelMask<Vector2f> > const& disparity_map,
                                   ImageView<double> &error ) const;
 
+    /// Apply a stereo model to a block of a disparity map whose top
+    /// left pixel lies at origin in the first image.  xyz and error
+    /// are resized to match the block.  Missing pixels get zero
+    /// points and errors.  If both cameras map pixels to rays
+    /// linearly (pinhole cameras without lens distortion, and CAHV
+    /// cameras) the rays are built from per-row tables rather than
+    /// by calling the camera models for every pixel.
+    void operator()(ImageView<PixelMask<Vector2f> > const& disparity_map,
+                    Vector2i const& origin,
+                    ImageView<Vector3> &xyz, ImageView<double> &error ) const;
+
     /// Apply a stereo model to a single pair of image coordinates.
     /// Returns an xyz point.  The error is set to -1 if the rays were
     /// parallel or divergent, otherwise it returns the 2-norm of the
@@ -59,6 +70,13 @@ namespace stereo {
     // Protected Methods
     //------------------------------------------------------------------
 
+    /// Intersects the ray from originA along vecFromA with the ray
+    /// from originB along vecFromB (both unit vectors).  Rays that
+    /// are nearly parallel give a zero point and zero error.
+    Vector3 triangulate_rays(Vector3 const& originA, Vector3 const& vecFromA,
+                             Vector3 const& originB, Vector3 const& vecFromB,
+                             double& error) const;
+
     /// Return the 2-norm of the error vector ( the vector from the
     /// closest point of intersectio of A to the closest point of
     /// intersection of B ), or -1 if the rays are parallel or
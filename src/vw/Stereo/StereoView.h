@@ -9,6 +9,8 @@
 #define __VW_STEREO_STEREOVIEW_H__
 
 #include <vw/Image/ImageViewBase.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
 #include <vw/Stereo/StereoModel.h>
 #include <vw/Camera/CameraModel.h>
 #include <limits>
@@ -82,8 +84,18 @@ namespace stereo {
     DisparityImageT const& disparity_map() const { return m_disparity_map; }
 
     /// \cond INTERNAL
-    typedef StereoView<typename DisparityImageT::prerasterize_type> prerasterize_type;
-    inline prerasterize_type prerasterize( BBox2i const& bbox ) const { return prerasterize_type( m_disparity_map.prerasterize(bbox), m_stereo_model ); }
+    // Blocks are triangulated a row at a time by the StereoModel, so
+    // when the view is written with block_write_image() or rasterized
+    // with block_rasterize() each block runs as one task on the
+    // thread pool.
+    typedef CropView<ImageView<Vector3> > prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      ImageView<PixelMask<Vector2f> > disparity_map = crop( m_disparity_map, bbox );
+      ImageView<Vector3> xyz;
+      ImageView<double> error;
+      m_stereo_model( disparity_map, bbox.min(), xyz, error );
+      return prerasterize_type( xyz, BBox2i( -bbox.min().x(), -bbox.min().y(), bbox.width(), bbox.height() ) );
+    }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const { vw::rasterize( prerasterize(bbox), dest, bbox ); }
     /// \endcond
   };
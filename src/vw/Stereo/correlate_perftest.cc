@@ -0,0 +1,192 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file correlate_perftest.cc
+///
+/// Times stereo::correlate() with the SAD, SSD and normalized cross
+/// correlation cost functions on a synthetic image pair, and compares
+/// them against a reference implementation of each cost that builds
+/// the per-pixel costs as a lazy view and box filters the result (the
+/// way the cost functions used to work).  Reports the rate in
+/// disparities per second (pixels times disparities searched) and the
+/// fraction of pixels on which the two disparity maps agree.
+///
+#include <vw/Stereo/OptimizedCorrelator.h>
+#include <vw/Image/UtilityViews.h>
+#include <vw/Image/Transform.h>
+#include <vw/Image/Filter.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/random/linear_congruential.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+using namespace vw::stereo;
+
+// The per-pixel costs, as lazy views.
+struct ReferenceCostFunctor : ReturnFixedType<float> {
+  SlidingWindowCostType m_type;
+  ReferenceCostFunctor(SlidingWindowCostType type) : m_type(type) {}
+  float operator()(float a, float b) const {
+    switch (m_type) {
+    case ABS_DIFFERENCE_WINDOW_COST: return fabs(a - b);
+    case SQ_DIFFERENCE_WINDOW_COST:  return (a - b) * (a - b);
+    default:                         return a * b;
+    }
+  }
+};
+
+class ReferenceCost : public StereoCostFunction {
+  typedef CropView<EdgeExtensionView<ImageView<float>, ZeroEdgeExtension> > window_type;
+  SlidingWindowCostType m_type;
+  ImageView<float> m_left, m_right;
+  ImageView<float> m_left_mean, m_left_variance, m_right_mean, m_right_variance;
+  float m_kernel_size_i2;
+  int m_half_kernel;
+
+  // Box filters img into a newly allocated image.
+  template <class BoxViewT>
+  ImageView<float> reference_box_filter(ImageViewBase<BoxViewT> const& img) {
+    Vector<float> cSum(img.impl().cols());
+    for (int x = 0; x < img.impl().cols(); x++) {
+      cSum(x) = 0;
+      for (int ky = 0; ky < m_kernel_size; ky++)
+        cSum(x) += img.impl()(x, ky);
+    }
+    for (int y = 0; y < img.impl().rows() - m_kernel_size; y++) {
+      float rsum = 0;
+      for (int i = 0; i < m_kernel_size; i++)
+        rsum += cSum(i);
+      for (int x = 0; x < img.impl().cols() - m_kernel_size; x++) {
+        m_dst(x + m_half_kernel, y + m_half_kernel) = rsum;
+        rsum += cSum(x + m_kernel_size) - cSum(x);
+      }
+      for (int i = 0; i < img.impl().cols(); i++)
+        cSum(i) += img.impl()(i, y + m_kernel_size) - img.impl()(i, y);
+    }
+    return m_dst * m_kernel_size_i2;
+  }
+
+public:
+  ReferenceCost(ImageView<float> const& left, ImageView<float> const& right,
+                BBox2i const& search_window, int kern_size, SlidingWindowCostType type) :
+    StereoCostFunction(left.cols(), left.rows(), search_window, kern_size),
+    m_type(type), m_left(left), m_right(right),
+    m_kernel_size_i2(1.0/float(kern_size*kern_size)), m_half_kernel(kern_size/2) {
+    if (m_type == PRODUCT_WINDOW_COST) {
+      m_left_mean = box_filter_mean(m_left, kern_size);
+      m_left_variance = box_filter_mean(ImageView<float>(m_left*m_left), kern_size) - m_left_mean * m_left_mean;
+      m_right_mean = box_filter_mean(m_right, kern_size);
+      m_right_variance = box_filter_mean(ImageView<float>(m_right*m_right), kern_size) - m_right_mean * m_right_mean;
+    }
+  }
+
+  virtual ImageView<float> calculate(int dx, int dy) {
+    BBox2i right_bbox = this->bbox() + Vector2i(dx, dy);
+    window_type left_window(edge_extend(m_left, ZeroEdgeExtension()), this->bbox());
+    window_type right_window(edge_extend(m_right, ZeroEdgeExtension()), right_bbox);
+    ImageView<float> cost = reference_box_filter(
+      BinaryPerPixelView<window_type, window_type, ReferenceCostFunctor>(left_window, right_window,
+                                                                         ReferenceCostFunctor(m_type)));
+    if (m_type != PRODUCT_WINDOW_COST)
+      return cost;
+
+    window_type left_mean_window(edge_extend(m_left_mean, ZeroEdgeExtension()), this->bbox());
+    window_type left_variance_window(edge_extend(m_left_variance, ZeroEdgeExtension()), this->bbox());
+    window_type right_mean_window(edge_extend(m_right_mean, ZeroEdgeExtension()), right_bbox);
+    window_type right_variance_window(edge_extend(m_right_variance, ZeroEdgeExtension()), right_bbox);
+    cost = cost - left_mean_window * right_mean_window;
+    return 1-abs(cost*cost / left_variance_window / right_variance_window);
+  }
+
+  virtual int cols() const { return m_left.cols(); }
+  virtual int rows() const { return m_left.rows(); }
+  virtual int sample_size() const { return this->kernel_size(); }
+};
+
+float agreement(ImageView<PixelMask<Vector2f> > const& a, ImageView<PixelMask<Vector2f> > const& b) {
+  int same = 0;
+  for (int y = 0; y < a.rows(); ++y)
+    for (int x = 0; x < a.cols(); ++x)
+      if (is_valid(a(x,y)) == is_valid(b(x,y)) &&
+          (!is_valid(a(x,y)) || a(x,y).child() == b(x,y).child()))
+        ++same;
+  return float(same) / float(a.cols() * a.rows());
+}
+
+double time_correlate(boost::shared_ptr<StereoCostFunction> const& cost, BBox2i const& search_window,
+                      ImageView<PixelMask<Vector2f> > &result) {
+  Stopwatch sw;
+  sw.start();
+  result = stereo::correlate(cost, search_window);
+  sw.stop();
+  return sw.elapsed_seconds();
+}
+
+int main(int argc, char** argv) {
+  int size, kernel_size, hrange, vrange;
+
+  po::options_description general_options("Stereo Cost Function Performance Test Program");
+  general_options.add_options()
+    ("size,s", po::value<int>(&size)->default_value(512), "Width and height of the test images")
+    ("kernel,k", po::value<int>(&kernel_size)->default_value(15), "Correlation kernel size")
+    ("hrange", po::value<int>(&hrange)->default_value(32), "Horizontal search range")
+    ("vrange", po::value<int>(&vrange)->default_value(4), "Vertical search range")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+
+  // A blurred noise image, and a copy shifted by a known disparity.
+  boost::rand48 gen(10);
+  ImageView<float> left = gaussian_filter(255*uniform_noise_view(gen, size, size), 1.0);
+  ImageView<float> right = transform(left, TranslateTransform(hrange/2, vrange/2),
+                                     ZeroEdgeExtension(), NearestPixelInterpolation());
+  BBox2i search_window(0, 0, hrange, vrange);
+  double disparities = double(size) * size * (hrange + 1) * (vrange + 1);
+
+  static const SlidingWindowCostType types[] = { ABS_DIFFERENCE_WINDOW_COST, SQ_DIFFERENCE_WINDOW_COST,
+                                                 PRODUCT_WINDOW_COST };
+  static const char* names[] = { "sad", "ssd", "ncc" };
+
+  std::cout << size << "x" << size << " images, " << kernel_size << "x" << kernel_size
+            << " kernel, " << (hrange + 1) * (vrange + 1) << " disparities\n";
+  for (int i = 0; i < 3; ++i) {
+    boost::shared_ptr<StereoCostFunction> cost, reference;
+    if (types[i] == ABS_DIFFERENCE_WINDOW_COST)
+      cost.reset(new AbsDifferenceCost(left, right, search_window, kernel_size));
+    else if (types[i] == SQ_DIFFERENCE_WINDOW_COST)
+      cost.reset(new SqDifferenceCost(left, right, search_window, kernel_size));
+    else
+      cost.reset(new NormXCorrCost(left, right, search_window, kernel_size));
+    reference.reset(new ReferenceCost(left, right, search_window, kernel_size, types[i]));
+
+    ImageView<PixelMask<Vector2f> > result, reference_result;
+    double reference_time = time_correlate(reference, search_window, reference_result);
+    double time = time_correlate(cost, search_window, result);
+
+    std::cout << "  " << names[i] << std::fixed << std::setprecision(3)
+              << "  reference " << reference_time << " s ("
+              << std::setprecision(1) << disparities / reference_time / 1e6 << " M/s)"
+              << std::setprecision(3) << "  sliding window " << time << " s ("
+              << std::setprecision(1) << disparities / time / 1e6 << " M/s)"
+              << std::setprecision(2) << "  speedup " << reference_time / time
+              << "x  agreement " << std::setprecision(4) << agreement(result, reference_result) << "\n";
+  }
+
+  return 0;
+}
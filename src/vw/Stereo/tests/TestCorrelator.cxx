@@ -7,15 +7,22 @@
 
 // TestCorrelator.h
 #include <gtest/gtest.h>
+#include <test/Helpers.h>
 
 #include <vw/Image/UtilityViews.h>
 #include <vw/Stereo/CorrelatorView.h>
+#include <vw/Stereo/OptimizedCorrelatorView.h>
+#include <vw/Stereo/PyramidCorrelator.h>
+#include <vw/Stereo/SlidingWindowCost.h>
+#include <vw/Image/BlockRasterize.h>
 #include <vw/Image/Transform.h>
+#include <vw/Image/Filter.h>
 
 #include <boost/random/linear_congruential.hpp>
 
 using namespace vw;
 using namespace vw::stereo;
+using namespace vw::test;
 
 //   void test_image_sum_functions() {
 //     ImageView<uint8> image = ConstantView<uint8>(1, 100, 100);
@@ -124,3 +131,298 @@ TEST_F( BasicCorrelationTest, BlurPreprocess ) {
                BlurStereoPreprocessingFilter() );
   check_error( disparity_map, 0.75 );
 }
+
+TEST_F( BasicCorrelationTest, OptimizedCorrelatorView ) {
+  OptimizedCorrelator correlator( BBox2i(0,0,6,6), 7, 2.0, 1.3 );
+  ImageView<PixelMask<Vector2f> > whole =
+    correlator( image1, image2, NullStereoPreprocessingFilter() );
+
+  // Correlating small blocks on several threads should give the same
+  // answer as correlating the whole image, away from the image edges.
+  ImageView<PixelMask<Vector2f> > tiled =
+    block_rasterize( optimized_correlator_view( image1, image2, NullStereoPreprocessingFilter(),
+                                                correlator ), Vector2i(16,16), 4 );
+  ASSERT_EQ( whole.cols(), tiled.cols() );
+  ASSERT_EQ( whole.rows(), tiled.rows() );
+  check_error( tiled, 0.95 );
+  for (int j = 13; j < whole.rows()-13; ++j)
+    for (int i = 13; i < whole.cols()-13; ++i) {
+      ASSERT_EQ( is_valid(whole(i,j)), is_valid(tiled(i,j)) ) << i << " " << j;
+      if ( is_valid(whole(i,j)) )
+        EXPECT_EQ( whole(i,j).child(), tiled(i,j).child() ) << i << " " << j;
+    }
+}
+
+TEST( PyramidCorrelator, ReusePyramids ) {
+  boost::rand48 gen(10);
+  ImageView<uint8> left = 255*uniform_noise_view( gen, 128, 128 );
+  ImageView<uint8> right = transform(left, TranslateTransform(6,2),
+                                     ZeroEdgeExtension(), NearestPixelInterpolation());
+  ImageView<uint8> valid(128,128);
+  fill(valid, 255);
+  PyramidCorrelator correlator( BBox2(0,0,10,6), Vector2i(7,7), 2.0, 1.3,
+                                1, ABS_DIFF_CORRELATOR, 2 );
+  ImageView<PixelMask<Vector2f> > direct =
+    correlator( left, right, valid, valid, NullStereoPreprocessingFilter() );
+
+  // Prebuilt pyramids give the same answer, and can be correlated
+  // again without being rebuilt.
+  ImagePyramid<uint8> left_pyramid(left, valid), right_pyramid(right, valid);
+  ImageView<PixelMask<Vector2f> > reused =
+    correlator( left_pyramid, right_pyramid, NullStereoPreprocessingFilter() );
+  EXPECT_EQ( 2, left_pyramid.built_levels() );
+  EXPECT_EQ( 2, right_pyramid.built_levels() );
+  ImageView<uint8> level1 = left_pyramid.image(1);
+  reused = correlator( left_pyramid, right_pyramid, NullStereoPreprocessingFilter() );
+  EXPECT_EQ( level1.data(), left_pyramid.image(1).data() );
+
+  ASSERT_EQ( direct.cols(), reused.cols() );
+  ASSERT_EQ( direct.rows(), reused.rows() );
+  int count_valid = 0, count_correct = 0;
+  for (int j = 0; j < direct.rows(); ++j)
+    for (int i = 0; i < direct.cols(); ++i) {
+      ASSERT_EQ( is_valid(direct(i,j)), is_valid(reused(i,j)) ) << i << " " << j;
+      if ( is_valid(direct(i,j)) ) {
+        EXPECT_EQ( direct(i,j).child(), reused(i,j).child() ) << i << " " << j;
+        count_valid++;
+        if ( reused(i,j).child() == Vector2f(6,2) )
+          count_correct++;
+      }
+    }
+  EXPECT_LT( 100*100, count_valid );
+  EXPECT_LT( 0.95, float(count_correct)/float(count_valid) );
+}
+
+TEST_F( BasicCorrelationTest, SemiGlobal ) {
+  typedef CorrelatorView<uint8, PixelMask<uint8>, NullStereoPreprocessingFilter> view_type;
+  view_type corr( image1, image2, mask, mask, NullStereoPreprocessingFilter() );
+  corr.set_search_range( BBox2i(0,0,6,6) );
+  corr.set_kernel_size( Vector2i(3,3) );
+  corr.set_correlator_options( 1, SEMI_GLOBAL_CORRELATOR );
+  corr.set_cross_corr_threshold( 1.0 );
+  ImageView<PixelMask<Vector2f> > disparity_map = corr;
+  check_error( disparity_map, 0.95 );
+
+  corr.set_semi_global_options( 16, 16, 128 );
+  disparity_map = corr;
+  check_error( disparity_map, 0.95 );
+
+  // A block whose cost volume doesn't fit is correlated in tiles
+  // that do, rather than failing.
+  corr.set_semi_global_options( 8, 16, 128 );
+  corr.set_semi_global_max_volume_bytes( 256*1024 );
+  SemiGlobalCorrelator correlator( BBox2i(0,0,6,6), 3, 1.0 );
+  correlator.set_max_volume_bytes( 256*1024 );
+  EXPECT_THROW( correlator( image1, image2, NullStereoPreprocessingFilter() ), ArgumentErr );
+  disparity_map = corr;
+  check_error( disparity_map, 0.95 );
+}
+
+TEST( SemiGlobalCorrelator, LowTexture ) {
+  // A horizontal ramp with a few bumps, shifted by 2 pixels.  Away
+  // from the bumps a 3x3 block matcher cannot tell the vertical
+  // disparity; the smoothness constraint carries it over.
+  ImageView<uint8> left(60,40);
+  for (int j = 0; j < left.rows(); ++j)
+    for (int i = 0; i < left.cols(); ++i)
+      left(i,j) = uint8(2*i + ((i*7 + j*13) % 17 == 0 ? 40 : 0));
+  ImageView<uint8> right = transform(left, TranslateTransform(2,0),
+                                     ZeroEdgeExtension(), NearestPixelInterpolation());
+
+  SemiGlobalCorrelator correlator( BBox2i(0,-1,4,2), 3, 1.0 );
+  ImageView<PixelMask<Vector2f> > disparity_map =
+    correlator( left, right, NullStereoPreprocessingFilter() );
+
+  int count_valid = 0, count_correct = 0;
+  for (int j = 0; j < disparity_map.rows(); ++j)
+    for (int i = 0; i < disparity_map.cols(); ++i)
+      if ( is_valid(disparity_map(i,j)) ) {
+        count_valid++;
+        if ( disparity_map(i,j).child() == Vector2f(2,0) )
+          count_correct++;
+      }
+  EXPECT_LT( 1000, count_valid );
+  EXPECT_LT( 0.95, float(count_correct)/float(count_valid) );
+}
+
+TEST( SemiGlobalCorrelator, VolumeLimit ) {
+  // A 2001x2001 search window needs several GB per pixel block.
+  ImageView<float> image(64,64);
+  SemiGlobalCorrelator correlator( BBox2i(-1000,-1000,2000,2000), 3, 1.0 );
+  EXPECT_THROW( correlator.correlate( image, image ), ArgumentErr );
+}
+
+TEST( Subpixel, AffineRecoversShift ) {
+  // Blurred noise shifted by a fractional disparity, refined from the
+  // nearest whole pixel disparity.
+  boost::rand48 gen(10);
+  ImageView<float> left = gaussian_filter(uniform_noise_view(gen, 64, 64), 1.5);
+  ImageView<float> right = transform(left, TranslateTransform(2.3,-0.4),
+                                     ZeroEdgeExtension(), BicubicInterpolation());
+  ImageView<PixelMask<Vector2f> > initial(64,64);
+  fill(initial, PixelMask<Vector2f>(Vector2f(2,0)));
+
+  ImageView<PixelMask<Vector2f> > affine = copy(initial);
+  subpixel_correlation_affine_2d(affine, left, right, 9, 9);
+  ImageView<PixelMask<Vector2f> > em = copy(initial);
+  subpixel_correlation_affine_2d_EM(em, left, right, 9, 9, BBox2i(0,0,64,64));
+
+  // Individual pixels can be thrown off by the noise, so check the
+  // averages over the interior.
+  Vector2 affine_sum, em_sum;
+  int affine_count = 0, em_count = 0;
+  for (int j = 10; j < 54; ++j)
+    for (int i = 10; i < 54; ++i) {
+      if ( is_valid(affine(i,j)) ) {
+        affine_sum += affine(i,j).child();
+        affine_count++;
+      }
+      if ( is_valid(em(i,j)) ) {
+        em_sum += em(i,j).child();
+        em_count++;
+      }
+    }
+  EXPECT_LT( 0.9 * 44 * 44, affine_count );
+  EXPECT_LT( 0.9 * 44 * 44, em_count );
+  EXPECT_VECTOR_NEAR( Vector2(2.3,-0.4), affine_sum / affine_count, 0.02 );
+  EXPECT_VECTOR_NEAR( Vector2(2.3,-0.4), em_sum / em_count, 0.02 );
+}
+
+TEST( ImagePyramid, Levels ) {
+  ImageView<uint8> image(9,7), mask(9,7);
+  for (int j = 0; j < image.rows(); ++j)
+    for (int i = 0; i < image.cols(); ++i) {
+      image(i,j) = uint8(20*i + 10*j);
+      mask(i,j) = (i == 5 && j == 2) ? 0 : 255;
+    }
+
+  ImagePyramid<uint8> pyramid(image, mask);
+  EXPECT_EQ( 1, pyramid.built_levels() );
+
+  // Copies share their levels, which are built on demand.
+  ImagePyramid<uint8> copy = pyramid;
+  ImageView<uint8> level1 = copy.image(1);
+  EXPECT_EQ( 2, pyramid.built_levels() );
+  ASSERT_EQ( 4, level1.cols() );
+  ASSERT_EQ( 3, level1.rows() );
+  for (int j = 0; j < level1.rows(); ++j)
+    for (int i = 0; i < level1.cols(); ++i)
+      EXPECT_EQ( 40*i + 20*j + 15, level1(i,j) ) << i << " " << j;
+
+  ImageView<uint8> mask1 = pyramid.mask(1);
+  for (int j = 0; j < mask1.rows(); ++j)
+    for (int i = 0; i < mask1.cols(); ++i)
+      EXPECT_EQ( (i == 2 && j == 1) ? 0 : 255, mask1(i,j) ) << i << " " << j;
+
+  pyramid.build(4);
+  EXPECT_EQ( 4, copy.built_levels() );
+  EXPECT_EQ( 1, copy.image(3).cols() );
+  EXPECT_EQ( 0, copy.image(3).rows() );
+}
+
+TEST( ImagePyramid, WriteRead ) {
+  boost::rand48 gen(10);
+  ImageView<uint8> image = 255*uniform_noise_view( gen, 32, 32 ), mask(32,32);
+  fill(mask, 255);
+  mask(3,4) = 0;
+  ImagePyramid<uint8> pyramid(image, mask);
+  pyramid.build(2);
+
+  UnlinkName image0("ImagePyramid-image0.pgm"), mask0("ImagePyramid-mask0.pgm");
+  UnlinkName image1("ImagePyramid-image1.pgm"), mask1("ImagePyramid-mask1.pgm");
+  std::string prefix = image0.substr(0, image0.size() - std::string("-image0.pgm").size());
+  pyramid.write(prefix, ".pgm");
+
+  ImagePyramid<uint8> loaded = ImagePyramid<uint8>::read(prefix, 2, ".pgm");
+  EXPECT_EQ( 2, loaded.built_levels() );
+  for (int n = 0; n < 3; ++n) {
+    ImageView<uint8> expected = pyramid.image(n), actual = loaded.image(n);
+    ASSERT_EQ( expected.cols(), actual.cols() );
+    ASSERT_EQ( expected.rows(), actual.rows() );
+    for (int j = 0; j < expected.rows(); ++j)
+      for (int i = 0; i < expected.cols(); ++i) {
+        EXPECT_EQ( expected(i,j), actual(i,j) );
+        EXPECT_EQ( pyramid.mask(n)(i,j), loaded.mask(n)(i,j) );
+      }
+  }
+}
+
+// The mean cost over the kernel_size window of a (cropped to bbox) and
+// b (offset from it), summed pixel by pixel, with the edge conventions
+// documented in SlidingWindowCost.h.
+static ImageView<float> brute_force_window_cost( ImageView<float> const& a, BBox2i const& bbox,
+                                                 ImageView<float> const& b, Vector2i const& offset,
+                                                 int kernel_size, SlidingWindowCostType type ) {
+  int width = bbox.width(), height = bbox.height(), half = kernel_size/2;
+  ImageView<float> result(width, height);
+  fill(result, 0.0f);
+  if (width <= kernel_size || height <= kernel_size)
+    return result;
+  for (int y = half; y < height - kernel_size + half; ++y)
+    for (int x = half; x < width - kernel_size + half; ++x) {
+      double sum = 0;
+      for (int j = y - half; j < y - half + kernel_size; ++j)
+        for (int i = x - half; i < x - half + kernel_size; ++i) {
+          int ax = bbox.min().x() + i, ay = bbox.min().y() + j;
+          int bx = ax + offset.x(), by = ay + offset.y();
+          double av = (ax >= 0 && ax < a.cols() && ay >= 0 && ay < a.rows()) ? a(ax,ay) : 0;
+          double bv = (bx >= 0 && bx < b.cols() && by >= 0 && by < b.rows()) ? b(bx,by) : 0;
+          switch (type) {
+          case ABS_DIFFERENCE_WINDOW_COST: sum += fabs(av - bv); break;
+          case SQ_DIFFERENCE_WINDOW_COST:  sum += (av - bv)*(av - bv); break;
+          case PRODUCT_WINDOW_COST:        sum += av * bv; break;
+          default:                         sum += av; break;
+          }
+        }
+      result(x,y) = float(sum / (kernel_size*kernel_size));
+    }
+  return result;
+}
+
+TEST( SlidingWindowCost, BruteForce ) {
+  boost::rand48 gen(10);
+  ImageView<float> a = uniform_noise_view( gen, 23, 19 );
+  ImageView<float> b = uniform_noise_view( gen, 23, 19 );
+
+  const SlidingWindowCostType types[] = { IDENTITY_WINDOW_COST, ABS_DIFFERENCE_WINDOW_COST,
+                                          SQ_DIFFERENCE_WINDOW_COST, PRODUCT_WINDOW_COST };
+  const int kernels[] = { 1, 3, 4, 5, 7 };
+  // Windows inside the image, hanging off of every edge, and offsets
+  // that push b past the edges.
+  const BBox2i boxes[] = { BBox2i(0,0,23,19), BBox2i(2,3,15,11), BBox2i(-4,-3,14,12),
+                           BBox2i(12,9,16,15), BBox2i(-2,-2,27,23) };
+  const Vector2i offsets[] = { Vector2i(0,0), Vector2i(3,-2), Vector2i(-5,4) };
+
+  for (unsigned t = 0; t < sizeof(types)/sizeof(*types); ++t)
+    for (unsigned k = 0; k < sizeof(kernels)/sizeof(*kernels); ++k) {
+      SlidingWindowCost cost( kernels[k], types[t] );
+      for (unsigned n = 0; n < sizeof(boxes)/sizeof(*boxes); ++n)
+        for (unsigned o = 0; o < sizeof(offsets)/sizeof(*offsets); ++o) {
+          SCOPED_TRACE( ::testing::Message() << "type " << types[t] << " kernel " << kernels[k]
+                        << " bbox " << boxes[n] << " offset " << offsets[o] );
+          ImageView<float> expected =
+            brute_force_window_cost( a, boxes[n], b, offsets[o], kernels[k], types[t] );
+          ImageView<float> actual( boxes[n].width(), boxes[n].height() );
+          fill(actual, -1.0f);
+          cost( a, boxes[n], b, offsets[o], actual );
+          for (int j = 0; j < actual.rows(); ++j)
+            for (int i = 0; i < actual.cols(); ++i)
+              ASSERT_NEAR( expected(i,j), actual(i,j), 1e-5 ) << "at " << i << " " << j;
+        }
+    }
+}
+
+TEST( SlidingWindowCost, TooSmall ) {
+  ImageView<float> a(5,5), dst(5,5);
+  fill(a, 1.0f);
+  fill(dst, -1.0f);
+  SlidingWindowCost cost( 5, IDENTITY_WINDOW_COST );
+  cost( a, BBox2i(0,0,5,5), a, Vector2i(), dst );
+  for (int j = 0; j < dst.rows(); ++j)
+    for (int i = 0; i < dst.cols(); ++i)
+      EXPECT_EQ( 0, dst(i,j) );
+
+  ImageView<float> mean = box_filter_mean( a, 3 );
+  EXPECT_NEAR( 1.0, mean(2,2), 1e-6 );
+  EXPECT_EQ( 0, mean(0,0) );
+}
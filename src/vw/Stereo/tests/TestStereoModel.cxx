@@ -10,6 +10,10 @@
 #include <test/Helpers.h>
 
 #include <vw/Stereo/StereoModel.h>
+#include <vw/Stereo/StereoView.h>
+#include <vw/Camera/CAHVModel.h>
+#include <vw/Camera/LensDistortion.h>
+#include <vw/Image/BlockRasterize.h>
 #include <vw/Camera/PinholeModel.h>
 #include <vw/Camera/CameraModel.h>
 #include <vw/Math/EulerAngles.h>
@@ -80,4 +84,69 @@ TEST( StereoModel, AdjustedStereo ) {
   EXPECT_VECTOR_NEAR( point, pt2, 1e-6 );
 }
 
+// A disparity map with a few missing pixels, to be triangulated as
+// though it were the block of the left image starting at origin.
+static ImageView<PixelMask<Vector2f> > test_disparity_map() {
+  ImageView<PixelMask<Vector2f> > disparity_map(40,30);
+  for (int j = 0; j < disparity_map.rows(); ++j)
+    for (int i = 0; i < disparity_map.cols(); ++i) {
+      disparity_map(i,j) = PixelMask<Vector2f>(Vector2f(-20 - 0.1*i + 0.05*j, 0.3 - 0.02*j));
+      if ((i*7 + j*3) % 11 == 0)
+        invalidate(disparity_map(i,j));
+    }
+  return disparity_map;
+}
+
+static void check_block_triangulation(CameraModel const* camera1, CameraModel const* camera2) {
+  StereoModel model(camera1, camera2);
+  ImageView<PixelMask<Vector2f> > disparity_map = test_disparity_map();
+  Vector2i origin(100,80);
+
+  ImageView<Vector3> xyz;
+  ImageView<double> error;
+  model(disparity_map, origin, xyz, error);
+  ASSERT_EQ( disparity_map.cols(), xyz.cols() );
+  ASSERT_EQ( disparity_map.rows(), error.rows() );
+
+  for (int j = 0; j < disparity_map.rows(); ++j)
+    for (int i = 0; i < disparity_map.cols(); ++i) {
+      if (!is_valid(disparity_map(i,j))) {
+        EXPECT_VECTOR_DOUBLE_EQ( Vector3(), xyz(i,j) );
+        EXPECT_EQ( 0, error(i,j) );
+        continue;
+      }
+      Vector2 pix1 = origin + Vector2(i,j);
+      double expected_error;
+      Vector3 expected = model(pix1, pix1 + disparity_map(i,j).child(), expected_error);
+      EXPECT_VECTOR_NEAR( expected, xyz(i,j), 1e-8 * norm_2(expected) );
+      EXPECT_NEAR( expected_error, error(i,j), 1e-8 * norm_2(expected) );
+    }
+}
 
+TEST( StereoModel, BlockPinhole ) {
+  Quaternion<double> q1 = euler_to_quaternion(0.02, -0.3, 0.01, "xyz");
+  Quaternion<double> q2 = euler_to_quaternion(-0.01, -0.25, 0.03, "xyz");
+  PinholeModel pin1( Vector3(0,0,0), q1.rotation_matrix(), 600, 610, 320, 240 );
+  PinholeModel pin2( Vector3(1,0.1,0), q2.rotation_matrix(), 600, 610, 320, 240 );
+  pin2.set_pixel_pitch( 0.5 );
+  check_block_triangulation( &pin1, &pin2 );
+
+  // CAHV cameras are also linear, and lens distortion goes through
+  // the camera models.
+  CAHVModel cahv1( pin1 ), cahv2( pin2 );
+  check_block_triangulation( &cahv1, &cahv2 );
+  pin1.set_lens_distortion( TsaiLensDistortion( Vector4(-0.2, 0.1, 0.001, 0.002) ) );
+  check_block_triangulation( &pin1, &pin2 );
+}
+
+TEST( StereoModel, StereoViewBlocks ) {
+  PinholeModel pin1( Vector3(0,0,0), math::identity_matrix<3>(), 600, 600, 320, 240 );
+  PinholeModel pin2( Vector3(1,0,0), math::identity_matrix<3>(), 600, 600, 320, 240 );
+  ImageView<PixelMask<Vector2f> > disparity_map = test_disparity_map();
+  StereoView<ImageView<PixelMask<Vector2f> > > stereo_view( disparity_map, &pin1, &pin2 );
+
+  ImageView<Vector3> xyz = block_rasterize( stereo_view, Vector2i(16,16), 2 );
+  for (int j = 0; j < disparity_map.rows(); ++j)
+    for (int i = 0; i < disparity_map.cols(); ++i)
+      EXPECT_VECTOR_NEAR( stereo_view(i,j), xyz(i,j), 1e-8 * norm_2(xyz(i,j)) );
+}
@@ -0,0 +1,91 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+// TestSubpixel.cxx
+#include <gtest/gtest.h>
+
+#include <vw/Stereo/Correlate.h>
+#include <vw/Image/UtilityViews.h>
+#include <vw/Image/Filter.h>
+#include <vw/Image/Transform.h>
+
+#include <boost/random/linear_congruential.hpp>
+
+#include <cmath>
+
+using namespace vw;
+using namespace vw::stereo;
+
+// The right image is the left one shifted by a known fractional
+// disparity, which the refiners should recover from a whole-pixel
+// starting guess.
+class SubpixelTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    // Blurred noise, with a few holes in the initial disparity map.
+    boost::rand48 gen(10);
+    left = gaussian_filter(uniform_noise_view(gen, 40, 36), 1.5);
+    right = transform(left, TranslateTransform(2.3,-0.4), ZeroEdgeExtension(), BicubicInterpolation());
+    initial.set_size(40,36);
+    fill(initial, PixelMask<Vector2f>(Vector2f(2,0)));
+    for (int i = 0; i < 40; i += 7)
+      invalidate(initial(i, (i*5) % 36));
+  }
+
+  // Checks the refined disparities in a region away from the edges,
+  // where the shifted image is filled with zeros.
+  void expect_shift(ImageView<PixelMask<Vector2f> > const& disparity, BBox2i const& region) {
+    int count = 0, count_close = 0;
+    Vector2 sum;
+    for (int j = region.min().y(); j < region.max().y(); ++j)
+      for (int i = region.min().x(); i < region.max().x(); ++i) {
+        if ( !is_valid(disparity(i,j)) )
+          continue;
+        count++;
+        sum += disparity(i,j).child();
+        if ( norm_2( disparity(i,j).child() - Vector2f(2.3,-0.4) ) < 0.25 )
+          count_close++;
+      }
+    ASSERT_LT( region.width() * region.height() * 2 / 3, count );
+    EXPECT_NEAR( 2.3, sum[0] / count, 0.08 );
+    EXPECT_NEAR( -0.4, sum[1] / count, 0.08 );
+    EXPECT_LT( count * 85 / 100, count_close );
+  }
+
+  ImageView<float> left, right;
+  ImageView<PixelMask<Vector2f> > initial;
+};
+
+// Odd and even window sizes.
+static const int kern_sizes[3][2] = { {9,9}, {7,5}, {8,6} };
+
+TEST_F( SubpixelTest, Affine ) {
+  for (int n = 0; n < 3; ++n) {
+    ImageView<PixelMask<Vector2f> > disparity = copy(initial);
+    subpixel_correlation_affine_2d(disparity, left, right, kern_sizes[n][0], kern_sizes[n][1]);
+    expect_shift( disparity, BBox2i(8,6,22,24) );
+  }
+}
+
+TEST_F( SubpixelTest, Bayesian ) {
+  for (int n = 0; n < 3; ++n) {
+    ImageView<PixelMask<Vector2f> > disparity = copy(initial);
+    subpixel_correlation_affine_2d_bayesian(disparity, left, right, kern_sizes[n][0], kern_sizes[n][1]);
+    expect_shift( disparity, BBox2i(8,6,22,24) );
+  }
+}
+
+TEST_F( SubpixelTest, EM ) {
+  for (int n = 0; n < 3; ++n) {
+    // Pixels outside the region of interest are left alone.
+    BBox2i roi(8,6,16,18);
+    ImageView<PixelMask<Vector2f> > disparity = copy(initial);
+    subpixel_correlation_affine_2d_EM(disparity, left, right, kern_sizes[n][0], kern_sizes[n][1], roi);
+    expect_shift( disparity, roi );
+    EXPECT_EQ( Vector2f(2,0), disparity(35,30).child() );
+  }
+}
@@ -0,0 +1,117 @@
+// __BEGIN_LICENSE__
+// Copyright (C) 2006-2010 United States Government as represented by
+// the Administrator of the National Aeronautics and Space Administration.
+// All Rights Reserved.
+// __END_LICENSE__
+
+
+/// \file triangulate_perftest.cc
+///
+/// Times triangulation of a synthetic disparity map from a pair of
+/// pinhole cameras, and reports the point cloud throughput in points
+/// per second: one pixel at a time through the camera models, a whole
+/// image at a time with the StereoModel's ray tables, and through a
+/// StereoView rasterized in blocks on the thread pool.
+///
+#include <vw/Stereo/StereoModel.h>
+#include <vw/Stereo/StereoView.h>
+#include <vw/Camera/PinholeModel.h>
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Settings.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+using namespace vw::stereo;
+using namespace vw::camera;
+
+static void report(std::string const& name, double seconds, int points, Vector3 const& sum) {
+  std::cout << "  " << std::setw(10) << std::left << name << std::right << std::fixed
+            << std::setprecision(3) << seconds << " s  "
+            << std::setprecision(0) << points / seconds << " points/s"
+            << std::setprecision(6) << "  mean " << sum / points << "\n";
+}
+
+static Vector3 sum_points(ImageView<Vector3> const& xyz) {
+  Vector3 sum;
+  for (int j = 0; j < xyz.rows(); ++j)
+    for (int i = 0; i < xyz.cols(); ++i)
+      sum += xyz(i,j);
+  return sum;
+}
+
+int main(int argc, char** argv) {
+  int size, block_size, threads;
+
+  po::options_description general_options("Triangulation Performance Test Program");
+  general_options.add_options()
+    ("size,s", po::value<int>(&size)->default_value(1024), "Width and height of the disparity map")
+    ("block-size,b", po::value<int>(&block_size)->default_value(256), "Block size for the StereoView")
+    ("threads,t", po::value<int>(&threads)->default_value(0), "Number of threads (default: system setting)")
+    ("help", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 0;
+  }
+  if (threads > 0)
+    vw_settings().set_default_num_threads(threads);
+
+  // Two cameras looking at a tilted plane, and the disparities that
+  // plane would produce between them.
+  PinholeModel left_camera( Vector3(0,0,0), math::identity_matrix<3>(),
+                            size, size, size/2, size/2 );
+  PinholeModel right_camera( Vector3(1,0,0), math::identity_matrix<3>(),
+                             size, size, size/2, size/2 );
+  ImageView<PixelMask<Vector2f> > disparity_map(size, size);
+  for (int j = 0; j < size; ++j)
+    for (int i = 0; i < size; ++i)
+      disparity_map(i,j) = PixelMask<Vector2f>(Vector2f(-40 - 20.0f * j / size, 0));
+
+  StereoModel model(&left_camera, &right_camera);
+  int points = size * size;
+  std::cout << size << "x" << size << " disparity map, "
+            << vw_settings().default_num_threads() << " threads\n";
+
+  {
+    ImageView<Vector3> xyz(size, size);
+    Stopwatch sw;
+    sw.start();
+    double error;
+    for (int j = 0; j < size; ++j)
+      for (int i = 0; i < size; ++i)
+        xyz(i,j) = model(Vector2(i,j), Vector2(i,j) + disparity_map(i,j).child(), error);
+    sw.stop();
+    report("per-pixel", sw.elapsed_seconds(), points, sum_points(xyz));
+  }
+
+  {
+    ImageView<Vector3> xyz;
+    ImageView<double> error;
+    Stopwatch sw;
+    sw.start();
+    model(disparity_map, Vector2i(), xyz, error);
+    sw.stop();
+    report("rows", sw.elapsed_seconds(), points, sum_points(xyz));
+  }
+
+  {
+    Stopwatch sw;
+    sw.start();
+    ImageView<Vector3> xyz = block_rasterize(StereoView<ImageView<PixelMask<Vector2f> > >(disparity_map, model),
+                                             Vector2i(block_size, block_size));
+    sw.stop();
+    report("blocks", sw.elapsed_seconds(), points, sum_points(xyz));
+  }
+
+  return 0;
+}